@@ -0,0 +1,363 @@
+#version 430 core
+
+// Shared by Assign05/06/07; the app picks a variant with #defines:
+//   LIGHTING_UNLIT    Per-vertex color only (Assign05)
+//   LIGHTING_PHONG    Diffuse + Phong specular (Assign06)
+//   LIGHTING_GGX      Cook-Torrance with GGX NDF (Assign07; the default)
+//   USE_METALLIC      GGX: blend F0/diffuse by the metallic uniform (otherwise dielectric)
+//   USE_BRDF_LUT      GGX: Fresnel/geometry averaged over the lobe from the split-sum table
+//                     (only the NDF is evaluated per fragment)
+//   STRIP_DEAD_PHONG  GGX: leave out the Phong terms that never reach the output
+//   CLUSTERED_LIGHTS  GGX: many point lights from shader storage, culled per froxel
+//                     (see ClusteredLights.hpp) instead of the single light uniform
+//   GBUFFER_PASS      GGX: write albedo, octahedral normal and metallic/roughness to the
+//                     G-buffer instead of shading (see GBufferGL.hpp)
+//   DEFERRED_LIGHTING GGX: full-screen pass that shades each pixel once from the G-buffer
+//   DEPTH_ONLY        With LIGHTING_UNLIT: depth pre-pass, no color output
+//   SHADOW_PASS       With DEPTH_ONLY: write linear distance to the light as depth (cube shadow map)
+//   USE_SHADOWS       GGX: single light is shadowed by the cube map (see ShadowMapGL.hpp)
+//   USE_ALBEDO_MAP    Vertex color is multiplied by the material's base color texture
+//                     (see TextureCache.hpp)
+//   USE_TEXTURE_ARRAYS With USE_ALBEDO_MAP: sample the texture array layer the material
+//                     table gives for materialIndex instead of a per-draw binding
+//                     (see TextureArrays.hpp)
+#if !defined(LIGHTING_UNLIT) && !defined(LIGHTING_PHONG) && !defined(LIGHTING_GGX)
+#define LIGHTING_GGX 1
+#endif
+
+layout(location = 0) out vec4 out_color;
+
+#ifdef GBUFFER_PASS
+layout(location = 1) out vec2 out_normal;
+layout(location = 2) out vec2 out_material;
+#endif
+
+#ifdef DEFERRED_LIGHTING
+// Surface attributes are read from the G-buffer (by readGBuffer) instead of interpolated
+layout(binding = 1) uniform sampler2D gbufferAlbedo;
+layout(binding = 2) uniform sampler2D gbufferNormal;
+layout(binding = 3) uniform sampler2D gbufferMaterial;
+layout(binding = 4) uniform sampler2D gbufferDepth;
+uniform mat4 invProjMat;
+
+vec4 interPos;
+vec3 interNormal;
+#else
+in vec4 vertexColor; // Now interpolated across face
+#endif
+
+#if defined(USE_ALBEDO_MAP) && defined(USE_TEXTURE_ARRAYS)
+// Array/layer per material ((-1, -1): untextured); 8 arrays = MAX_TEXTURE_ARRAYS
+layout(std430, binding = 3) readonly buffer MaterialBuffer { ivec2 materialLayers[]; };
+layout(binding = 7) uniform sampler2DArray albedoArrays[8];
+uniform int materialIndex;
+in vec2 interUV;
+#elif defined(USE_ALBEDO_MAP)
+layout(binding = 6) uniform sampler2D albedoMap;
+in vec2 interUV;
+#endif
+
+// Surface color for this fragment (set by readAlbedo, or by readGBuffer when deferred)
+vec4 albedo;
+
+#ifndef DEFERRED_LIGHTING
+void readAlbedo() {
+#if defined(USE_ALBEDO_MAP) && defined(USE_TEXTURE_ARRAYS)
+    // Same material for the whole draw, so the sampler index is dynamically uniform
+    ivec2 entry = materialLayers[materialIndex];
+    albedo = vertexColor;
+    if (entry.x >= 0) albedo *= texture(albedoArrays[entry.x], vec3(interUV, float(entry.y)));
+#elif defined(USE_ALBEDO_MAP)
+    albedo = vertexColor * texture(albedoMap, interUV);
+#else
+    albedo = vertexColor;
+#endif
+}
+#endif
+
+#ifdef SHADOW_PASS
+in vec3 shadowPos;
+uniform float shadowFar;
+#endif
+
+#ifndef LIGHTING_UNLIT
+#ifndef DEFERRED_LIGHTING
+in vec4 interPos;
+in vec3 interNormal;
+#endif
+
+struct PointLight {
+    vec4 pos;
+    vec4 color;
+};
+
+uniform PointLight light;
+#endif
+
+#ifdef LIGHTING_GGX
+#if defined(DEFERRED_LIGHTING)
+float metallic;
+float roughness;
+#elif defined(USE_METALLIC)
+uniform float metallic;
+uniform float roughness;
+#else
+const float metallic = 0.0;
+uniform float roughness;
+#endif
+
+#ifdef CLUSTERED_LIGHTS
+// View-space lights and per-froxel lists (offset, count) into clusterIndices
+struct ClusterLight {
+    vec4 posRadius;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer ClusterLightBuffer { ClusterLight clusterLights[]; };
+layout(std430, binding = 1) readonly buffer ClusterRangeBuffer { uvec2 clusterRanges[]; };
+layout(std430, binding = 2) readonly buffer ClusterIndexBuffer { uint clusterIndices[]; };
+
+uniform ivec3 clusterDims;
+uniform vec4 clusterScale;  // tilesX / width, tilesY / height, slices / log(far / near), log(near)
+#endif
+
+#ifdef USE_SHADOWS
+// Linear distance / far from the light per direction, compared in hardware
+layout(binding = 5) uniform samplerCubeShadow shadowCube;
+uniform mat3 shadowViewToWorld;     // View-space directions -> cube map (world) axes
+uniform vec2 shadowParams;          // 1 / far, depth bias (world units)
+
+// 1 = lit, 0 = shadowed (2x2 PCF from linear filtering)
+float getShadow(vec3 lightToFrag) {
+    float dist = length(lightToFrag);
+    return texture(shadowCube, vec4(shadowViewToWorld * lightToFrag, (dist - shadowParams.y) * shadowParams.x));
+}
+#endif
+
+#ifdef USE_BRDF_LUT
+// Split-sum table (RG16F): x = NdotV, y = roughness; F0 * r + g
+layout(binding = 15) uniform sampler2D brdfLUT;
+#endif
+
+const float PI = 3.14159265359;
+
+vec3 getFresnelAtAngleZero(vec3 albedo, float metallic) {
+    vec3 F0 = vec3(0.04);
+    F0 = mix(F0, albedo, metallic);
+    return F0;
+}
+
+vec3 getFresnel(vec3 F0, vec3 L, vec3 H) {
+    float cosAngle = max(0.0, dot(L, H));
+    return F0 + (1.0 - F0) * pow(1.0 - cosAngle, 5.0);
+}
+
+float getNDF(vec3 H, vec3 N, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH = max(0.0, dot(N, H));
+    float NdotH2 = NdotH * NdotH;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    return a2 / (PI * denom * denom);
+}
+
+float getSchlickGeo(vec3 B, vec3 N, float roughness) {
+    float k = (roughness + 1.0) * (roughness + 1.0) / 8.0;
+    return dot(N, B) / (dot(N, B) * (1.0 - k) + k);
+}
+
+float getGF(vec3 L, vec3 V, vec3 N, float roughness) {
+    float GL = getSchlickGeo(L, N, roughness);
+    float GV = getSchlickGeo(V, N, roughness);
+    return GL * GV;
+}
+#endif
+
+#ifdef LIGHTING_UNLIT
+void main() {
+#if defined(SHADOW_PASS)
+    // Distance rather than projected depth, so all six faces compare the same way
+    gl_FragDepth = clamp(length(shadowPos) / shadowFar, 0.0, 1.0);
+#elif !defined(DEPTH_ONLY)
+    // Per-vertex color only
+    readAlbedo();
+    out_color = albedo;
+#endif
+}
+#endif
+
+#ifdef LIGHTING_PHONG
+void main() {
+    readAlbedo();
+
+    // Normalize interNormal
+    vec3 N = normalize(interNormal);
+
+    // Calculate the light vector L
+    vec3 L = normalize(vec3(light.pos - interPos));
+
+    // Calculate the diffuse coefficient
+    float diffuseCoefficient = max(0.0, dot(N, L));
+
+    // Calculate diffuse color
+    vec3 diffColor = diffuseCoefficient * vec3(albedo * light.color);
+
+    // Calculate specular coefficient 
+    float shininess = 10.0;
+    vec3 R = reflect(-L, N);
+    vec3 V = normalize(-interPos.xyz);
+    float specularCoefficient = pow(max(dot(R, V), 0.0), shininess);
+
+    // Calculate specular color
+    vec3 specularColor = diffuseCoefficient * light.color.rgb * specularCoefficient;
+    
+    // Set final color
+    out_color = vec4(diffColor + specularColor, 1.0);
+}
+#endif
+
+#if defined(GBUFFER_PASS) || defined(DEFERRED_LIGHTING)
+// Unit vector <-> octahedral mapping in [0,1]^2 (two 16-bit channels are plenty for shading)
+vec2 encodeOctahedral(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0) e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+vec3 decodeOctahedral(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+#endif
+
+#ifdef DEFERRED_LIGHTING
+// Fill the surface globals for this pixel; false where no geometry was drawn
+bool readGBuffer() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbufferDepth, pixel, 0).r;
+    if (depth >= 1.0) return false;
+
+    // View-space position from depth
+    vec2 ndc = (gl_FragCoord.xy / vec2(textureSize(gbufferDepth, 0))) * 2.0 - 1.0;
+    vec4 viewPos = invProjMat * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    interPos = vec4(viewPos.xyz / viewPos.w, 1.0);
+
+    interNormal = decodeOctahedral(texelFetch(gbufferNormal, pixel, 0).rg);
+    albedo = texelFetch(gbufferAlbedo, pixel, 0);
+    vec2 material = texelFetch(gbufferMaterial, pixel, 0).rg;
+    metallic = material.r;
+    roughness = material.g;
+    return true;
+}
+#endif
+
+#ifdef GBUFFER_PASS
+void main() {
+    readAlbedo();
+    out_color = vec4(albedo.rgb, 1.0);
+    out_normal = encodeOctahedral(normalize(interNormal));
+    out_material = vec2(metallic, roughness);
+}
+#elif defined(LIGHTING_GGX)
+// Light reflected toward V from one light (direction L, incoming color lightColor)
+vec3 getGGXColor(vec3 N, vec3 V, vec3 L, vec3 lightColor) {
+    // Calculate F0 using getFresnelAtAngleZero
+    vec3 F0 = getFresnelAtAngleZero(vec3(albedo), metallic);
+
+    // Calculate the normalized half-vector H
+    vec3 H = normalize(L + V);
+
+#ifdef USE_BRDF_LUT
+    // Look up the lobe's average Fresnel/geometry term
+    vec2 brdf = texture(brdfLUT, vec2(max(0.0, dot(N, V)), roughness)).rg;
+    vec3 kS = F0 * brdf.x + brdf.y;
+#else
+    // Calculate Fresnel reflectance F
+    vec3 F = getFresnel(F0, L, H);
+
+    vec3 kS = F;
+#endif
+    vec3 kD = vec3(1.0) - kS;
+    kD *= (1.0 - metallic) * vec3(albedo) / PI;
+
+#ifndef STRIP_DEAD_PHONG
+    // Calculate the diffuse coefficient
+    float diffuseCoefficient = max(0.0, dot(N, L));
+
+    // Calculate diffuse color
+    vec3 diffColor = diffuseCoefficient * albedo.rgb * lightColor;
+
+    // Calculate specular coefficient 
+    float shininess = 10.0;
+    vec3 R = reflect(-L, N);
+    float specularCoefficient = pow(max(dot(R, V), 0.0), shininess);
+
+    // Calculate specular color
+    vec3 specularColor = specularCoefficient * vec3(1.0, 1.0, 1.0);
+#endif
+
+    // Calculate specular reflection
+    float NDF = getNDF(H, N, roughness);
+#ifdef USE_BRDF_LUT
+    // GGX lobe pdf (NDF * NdotH / (4 * VdotH)) weighted by the averaged term
+    vec3 specular = kS * NDF * max(0.0, dot(N, H)) / (4.0 * max(0.0, dot(V, H)) * max(0.0, dot(N, L)) + 0.0001);
+#else
+    float G = getGF(L, V, N, roughness);
+    vec3 specular = kS * NDF * G / (4.0 * max(0.0, dot(N, L)) * max(0.0, dot(N, V)) + 0.0001);
+#endif
+
+    return (kD + specular) * lightColor * max(0.0, dot(N, L));
+}
+
+#ifdef CLUSTERED_LIGHTS
+// Smooth inverse-square falloff that reaches zero at the light's radius
+float getLightFalloff(float dist, float radius) {
+    float ratio = dist / radius;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window / (dist * dist + 1.0);
+}
+#endif
+
+void main() {
+#ifdef DEFERRED_LIGHTING
+    if (!readGBuffer()) discard;
+#else
+    readAlbedo();
+#endif
+
+    // Normalize interNormal
+    vec3 N = normalize(interNormal);
+
+    // Calculate the normalized view vector V
+    vec3 V = normalize(-interPos.xyz);
+
+#ifdef CLUSTERED_LIGHTS
+    // Only the lights assigned to this fragment's froxel
+    vec3 cell = vec3(gl_FragCoord.xy * clusterScale.xy, (log(-interPos.z) - clusterScale.w) * clusterScale.z);
+    ivec3 clusterID = clamp(ivec3(cell), ivec3(0), clusterDims - 1);
+    uvec2 range = clusterRanges[clusterID.x + clusterDims.x * (clusterID.y + clusterDims.y * clusterID.z)];
+
+    vec3 finalColor = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        ClusterLight cl = clusterLights[clusterIndices[range.x + i]];
+        vec3 toLight = cl.posRadius.xyz - interPos.xyz;
+        float dist = length(toLight);
+        finalColor += getGGXColor(N, V, toLight / dist, cl.color.rgb * getLightFalloff(dist, cl.posRadius.w));
+    }
+#else
+    vec3 L = normalize(vec3(light.pos - interPos));
+    vec3 finalColor = getGGXColor(N, V, L, vec3(light.color));
+#ifdef USE_SHADOWS
+    finalColor *= getShadow(vec3(interPos - light.pos));
+#endif
+#endif
+    
+    // Set final color
+    out_color = vec4(finalColor, 1.0);
+}
+#endif
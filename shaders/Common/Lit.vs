@@ -0,0 +1,82 @@
+#version 430 core
+// Change to 410 for macOS
+
+// Shared by Assign05/06/07; the app picks a variant with #defines
+// (LIGHTING_UNLIT, LIGHTING_PHONG or LIGHTING_GGX; see Lit.fs)
+// DEFERRED_LIGHTING draws a full-screen triangle instead of the mesh
+// DEPTH_ONLY (with LIGHTING_UNLIT) only reads position, for the depth pre-pass
+// SHADOW_PASS (with DEPTH_ONLY) also passes the position relative to the light to Lit.fs
+// USE_ALBEDO_MAP also passes the first UV channel on
+
+layout(location=0) in vec3 position;
+layout(location=1) in vec4 color;
+#ifndef LIGHTING_UNLIT
+layout(location=2) in vec3 normal;
+#endif
+#ifdef USE_ALBEDO_MAP
+layout(location=3) in vec2 texcoord;
+#endif
+
+uniform mat4 modelMat;
+uniform mat4 projMat;
+uniform mat4 viewMat;
+
+#ifndef LIGHTING_UNLIT
+uniform mat3 normMat;
+#endif
+
+out vec4 vertexColor;
+#ifndef LIGHTING_UNLIT
+out vec4 interPos;
+out vec3 interNormal;
+#endif
+#ifdef USE_ALBEDO_MAP
+out vec2 interUV;
+#endif
+
+#ifdef SHADOW_PASS
+// The shadow face's view matrix is centered on the light
+out vec3 shadowPos;
+#endif
+
+// Every variant must produce bit-identical depth, so a pass after the
+// depth pre-pass can test with GL_EQUAL
+invariant gl_Position;
+
+#ifdef DEFERRED_LIGHTING
+// Full-screen triangle (no vertex buffer needed) on the far plane, so a GL_GREATER
+// depth test against the scene's depth skips background pixels
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 1.0, 1.0);
+}
+#else
+void main()
+{		
+    // Get position of vertex (object space)
+    vec4 objPos = vec4(position, 1.0);
+
+    // Transform vertex position using modelMat
+    vec4 viewPos = viewMat * modelMat * objPos;
+    gl_Position = projMat * viewPos; 
+
+#ifndef LIGHTING_UNLIT
+    interPos = viewPos;
+    interNormal = normMat * normal;
+#endif
+
+#ifdef SHADOW_PASS
+    shadowPos = viewPos.xyz;
+#endif
+
+#ifndef DEPTH_ONLY
+    // Output per-vertex color
+    vertexColor = color;
+#endif
+
+#ifdef USE_ALBEDO_MAP
+    interUV = texcoord;
+#endif
+}
+#endif
@@ -9,7 +9,11 @@
 #include "MeshData.hpp"
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
+#include "GLDebugOutput.hpp"
 #include "Shader.hpp"
+#include "ProgramCache.hpp"
+#include "FramePacing.hpp"
+#include "GLState.hpp"
 using namespace std;
 
 // Create very simple mesh: a quad (4 vertices, 6 indices, 2 triangles)
@@ -58,6 +62,12 @@ int main(int argc, char **argv) {
 	// Are we in debugging mode?
 	bool DEBUG_MODE = true;
 
+	// Frame pacing (--vsync, --uncapped, --fps <N>)
+	FramePacer pacer;
+	parseFramePacingArgs(argc, argv, pacer);
+	parseGLDebugArgs(argc, argv);
+	parseProgramCacheArgs(argc, argv);
+
 	// GLFW setup
 	// Switch to 4.1 if necessary for macOS
 	GLFWwindow* window = setupGLFW("Assign01: janisr", 4, 3, 800, 800, DEBUG_MODE);
@@ -65,6 +75,9 @@ int main(int argc, char **argv) {
 	// GLEW setup
 	setupGLEW(window);
 
+	// Apply frame pacing mode
+	setupFramePacing(pacer);
+
 	// Check OpenGL version
 	checkOpenGLVersion();
 
@@ -85,7 +98,7 @@ int main(int argc, char **argv) {
 		if(DEBUG_MODE) printShaderCode(vertexCode, fragCode);
 
 		// Create shader program from code
-		programID = initShaderProgramFromSource(vertexCode, fragCode);
+		programID = initShaderProgramCached(vertexCode, fragCode);
 	}
 	catch (exception e) {		
 		// Close program
@@ -102,19 +115,24 @@ int main(int argc, char **argv) {
 	createMeshGL(m, mgl);
 	
 	// Enable depth testing
-	glEnable(GL_DEPTH_TEST);
+	setDepthTest(true);
+
+	// Only redraw when something changed (--on-demand)
+	setupOnDemandRedraw(window, pacer);
 
 	while (!glfwWindowShouldClose(window)) {
+		if (!waitForRedraw(pacer)) continue;
+
 		// Set viewport size
 		int fwidth, fheight;
 		glfwGetFramebufferSize(window, &fwidth, &fheight);
-		glViewport(0, 0, fwidth, fheight);
+		setViewport(0, 0, fwidth, fheight);
 
 		// Clear the framebuffer
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Use shader program
-		glUseProgram(programID);
+		useProgram(programID);
 
 		// Draw object
 		drawMesh(mgl);	
@@ -123,16 +141,21 @@ int main(int argc, char **argv) {
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 
-		// Sleep for 15 ms
-		this_thread::sleep_for(chrono::milliseconds(15));
+		// Wait for next frame (if needed) and record frame time
+		endFrame(pacer);
+		endGLStateFrame();
 	}
 
+	// Report frame timing
+	printFrameStats(pacer);
+	printGLStateStats();
+
 	// Clean up mesh
 	cleanupMesh(mgl);
 
 	// Clean up shader programs
-	glUseProgram(0);
-	glDeleteProgram(programID);
+	useProgram(0);
+	deleteProgram(programID);
 		
 	// Destroy window and stop GLFW
 	cleanupGLFW(window);
@@ -9,7 +9,11 @@
 #include "MeshData.hpp"
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
+#include "GLDebugOutput.hpp"
 #include "Shader.hpp"
+#include "ProgramCache.hpp"
+#include "FramePacing.hpp"
+#include "GLState.hpp"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -143,6 +147,12 @@ int main(int argc, char **argv) {
     // Are we in debugging mode?
     bool DEBUG_MODE = true;
 
+    // Frame pacing (--vsync, --uncapped, --fps <N>)
+    FramePacer pacer;
+    parseFramePacingArgs(argc, argv, pacer);
+    parseGLDebugArgs(argc, argv);
+    parseProgramCacheArgs(argc, argv);
+
     // GLFW setup
     // Switch to 4.1 if necessary for macOS
     GLFWwindow* window = setupGLFW("Assign03: janisr", 4, 3, 800, 800, DEBUG_MODE);
@@ -150,6 +160,9 @@ int main(int argc, char **argv) {
     // GLEW setup
     setupGLEW(window);
 
+    // Apply frame pacing mode
+    setupFramePacing(pacer);
+
     // Check OpenGL version
     checkOpenGLVersion();
 
@@ -188,7 +201,7 @@ int main(int argc, char **argv) {
 		if(DEBUG_MODE) printShaderCode(vertexCode, fragCode);
 
 		// Create shader program from code
-		programID = initShaderProgramFromSource(vertexCode, fragCode);
+		programID = initShaderProgramCached(vertexCode, fragCode);
 	}
 	catch (exception e) {		
 		// Close program
@@ -212,20 +225,25 @@ int main(int argc, char **argv) {
     }
 
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+    setDepthTest(true);
+
+    // Only redraw when something changed (--on-demand)
+    setupOnDemandRedraw(window, pacer);
 
     // Main rendering loop
     while (!glfwWindowShouldClose(window)) {
+        if (!waitForRedraw(pacer)) continue;
+
         // Set viewport size
         int fwidth, fheight;
         glfwGetFramebufferSize(window, &fwidth, &fheight);
-        glViewport(0, 0, fwidth, fheight);
+        setViewport(0, 0, fwidth, fheight);
 
         // Clear the framebuffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Use shader program
-        glUseProgram(programID);
+        useProgram(programID);
 
         // Draw each MeshGL object
         for (auto& mgl : meshGLVector) {
@@ -236,18 +254,23 @@ int main(int argc, char **argv) {
         glfwSwapBuffers(window);
         glfwPollEvents();
 
-        // Sleep for 15 ms
-        // this_thread::sleep_for(chrono::milliseconds(15));
+        // Wait for next frame (if needed) and record frame time
+        endFrame(pacer);
+        endGLStateFrame();
     }
 
+    // Report frame timing
+    printFrameStats(pacer);
+    printGLStateStats();
+
     // Clean up all MeshGL objects
     for (auto& mgl : meshGLVector) {
         cleanupMesh(mgl);
     }
 
     // Clean up GLFW and OpenGL resources
-    glUseProgram(0);
-    glDeleteProgram(programID);
+    useProgram(0);
+    deleteProgram(programID);
     cleanupGLFW(window);
 
     return 0;
@@ -9,7 +9,11 @@
 #include "MeshData.hpp"
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
+#include "GLDebugOutput.hpp"
 #include "Shader.hpp"
+#include "ProgramCache.hpp"
+#include "FramePacing.hpp"
+#include "GLState.hpp"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -215,6 +219,12 @@ int main(int argc, char **argv) {
     // Are we in debugging mode?
     bool DEBUG_MODE = true;
 
+    // Frame pacing (--vsync, --uncapped, --fps <N>)
+    FramePacer pacer;
+    parseFramePacingArgs(argc, argv, pacer);
+    parseGLDebugArgs(argc, argv);
+    parseProgramCacheArgs(argc, argv);
+
     // GLFW setup
     // Switch to 4.1 if necessary for macOS
     GLFWwindow* window = setupGLFW("Assign04: janisr", 4, 3, 800, 800, DEBUG_MODE);
@@ -222,6 +232,9 @@ int main(int argc, char **argv) {
     // GLEW setup
     setupGLEW(window);
 
+    // Apply frame pacing mode
+    setupFramePacing(pacer);
+
     // Check OpenGL version
     checkOpenGLVersion();
 
@@ -242,7 +255,7 @@ int main(int argc, char **argv) {
 		if(DEBUG_MODE) printShaderCode(vertexCode, fragCode);
 
 		// Create shader program from code
-		programID = initShaderProgramFromSource(vertexCode, fragCode);
+		programID = initShaderProgramCached(vertexCode, fragCode);
 	}
 	catch (exception e) {		
 		// Close program
@@ -282,10 +295,10 @@ int main(int argc, char **argv) {
     }
 
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+    setDepthTest(true);
 
     // Use shader program
-    glUseProgram(programID);
+    useProgram(programID);
 
     // Get the model matrix location
     GLint modelMatLoc = glGetUniformLocation(programID, "modelMat");
@@ -293,18 +306,23 @@ int main(int argc, char **argv) {
     // Set the key callback function
     glfwSetKeyCallback(window, keyCallback);
 
+    // Only redraw when something changed (--on-demand)
+    setupOnDemandRedraw(window, pacer);
+
     // Main rendering loop
     while (!glfwWindowShouldClose(window)) {
+        if (!waitForRedraw(pacer)) continue;
+
         // Set viewport size
         int fwidth, fheight;
         glfwGetFramebufferSize(window, &fwidth, &fheight);
-        glViewport(0, 0, fwidth, fheight);
+        setViewport(0, 0, fwidth, fheight);
 
         // Clear the framebuffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Use shader program
-        glUseProgram(programID);
+        useProgram(programID);
 
         // Draw the scene recursively
         renderScene(meshGLVector, scene->mRootNode, glm::mat4(1.0f), modelMatLoc, 0);
@@ -312,8 +330,16 @@ int main(int argc, char **argv) {
         // Swap buffers and poll for window events
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        // Wait for next frame (if needed) and record frame time
+        endFrame(pacer);
+        endGLStateFrame();
     }
 
+    // Report frame timing
+    printFrameStats(pacer);
+    printGLStateStats();
+
     // Clean up all MeshGL objects
     for (auto& mgl : meshGLVector) {
         cleanupMesh(mgl);
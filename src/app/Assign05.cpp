@@ -9,7 +9,12 @@
 #include "MeshData.hpp"
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
+#include "GLDebugOutput.hpp"
 #include "Shader.hpp"
+#include "ProgramCache.hpp"
+#include "ShaderPermutation.hpp"
+#include "FramePacing.hpp"
+#include "GLState.hpp"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -268,6 +273,12 @@ int main(int argc, char **argv) {
     // Are we in debugging mode?
     bool DEBUG_MODE = true;
 
+    // Frame pacing (--vsync, --uncapped, --fps <N>)
+    FramePacer pacer;
+    parseFramePacingArgs(argc, argv, pacer);
+    parseGLDebugArgs(argc, argv);
+    parseProgramCacheArgs(argc, argv);
+
     // GLFW setup
     // Switch to 4.1 if necessary for macOS
     GLFWwindow* window = setupGLFW("Assign05: janisr", 4, 3, 800, 800, DEBUG_MODE);
@@ -275,6 +286,9 @@ int main(int argc, char **argv) {
     // GLEW setup
     setupGLEW(window);
 
+    // Apply frame pacing mode
+    setupFramePacing(pacer);
+
     // Get the initial position of the mouse
     double mx, my;
     glfwGetCursorPos(window, &mx, &my);
@@ -296,16 +310,20 @@ int main(int argc, char **argv) {
 
     // Create and load shaders
 	GLuint programID = 0;
+	ShaderPermutationSet shaderPerms;
 	try {		
-		// Load vertex shader code and fragment shader code
-		string vertexCode = readFileToString("./shaders/Assign05/Basic.vs");
-		string fragCode = readFileToString("./shaders/Assign05/Basic.fs");
+		// Load the shared shader code
+		loadShaderPermutations(shaderPerms, "./shaders/Common/Lit.vs", "./shaders/Common/Lit.fs");
 
 		// Print out shader code, just to check
-		if(DEBUG_MODE) printShaderCode(vertexCode, fragCode);
-
-		// Create shader program from code
-		programID = initShaderProgramFromSource(vertexCode, fragCode);
+		if(DEBUG_MODE) {
+			string vertexCode, fragCode;
+			getShaderVariantSource(shaderPerms, { "LIGHTING_UNLIT" }, vertexCode, fragCode);
+			printShaderCode(vertexCode, fragCode);
+		}
+
+		// Build this assignment's variant (cached under the same key as the other apps use)
+		programID = getShaderVariant(shaderPerms, { "LIGHTING_UNLIT" });
 	}
 	catch (exception e) {		
 		// Close program
@@ -345,10 +363,10 @@ int main(int argc, char **argv) {
     }
 
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+    setDepthTest(true);
 
     // Use shader program
-    glUseProgram(programID);
+    useProgram(programID);
 
     // Get the model, view, and projection locations
     GLint modelMatLoc = glGetUniformLocation(programID, "modelMat");
@@ -358,18 +376,23 @@ int main(int argc, char **argv) {
     // Set the key callback function
     glfwSetKeyCallback(window, keyCallback);
 
+    // Only redraw when something changed (--on-demand)
+    setupOnDemandRedraw(window, pacer);
+
     // Main rendering loop
     while (!glfwWindowShouldClose(window)) {
+        if (!waitForRedraw(pacer)) continue;
+
         // Set viewport size
         int fwidth, fheight;
         glfwGetFramebufferSize(window, &fwidth, &fheight);
-        glViewport(0, 0, fwidth, fheight);
+        setViewport(0, 0, fwidth, fheight);
 
         // Clear the framebuffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Use shader program
-        glUseProgram(programID);
+        useProgram(programID);
 
         // Create view matrix
         glm::mat4 view = glm::lookAt(eye, lookAt, glm::vec3(0.0f, 1.0f, 0.0f));
@@ -394,13 +417,24 @@ int main(int argc, char **argv) {
         // Swap buffers and poll for window events
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        // Wait for next frame (if needed) and record frame time
+        endFrame(pacer);
+        endGLStateFrame();
     }
 
+    // Report frame timing
+    printFrameStats(pacer);
+    printGLStateStats();
+
     // Clean up all MeshGL objects
     for (auto& mgl : meshGLVector) {
         cleanupMesh(mgl);
     }
 
+    // Clean up shader programs
+    cleanupShaderPermutations(shaderPerms);
+
     cleanupGLFW(window);
 
     return 0;
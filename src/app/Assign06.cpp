@@ -9,7 +9,12 @@
 #include "MeshData.hpp"
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
+#include "GLDebugOutput.hpp"
 #include "Shader.hpp"
+#include "ProgramCache.hpp"
+#include "ShaderPermutation.hpp"
+#include "FramePacing.hpp"
+#include "GLState.hpp"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -32,6 +37,16 @@ struct PointLight {
 // Global Point Light object
 PointLight light;
 
+// Uniform handles (resolved once after linking)
+struct SceneUniforms {
+    UniformHandle<glm::mat4> modelMat;
+    UniformHandle<glm::mat4> viewMat;
+    UniformHandle<glm::mat4> projMat;
+    UniformHandle<glm::mat3> normMat;
+    UniformHandle<glm::vec4> lightPos;
+    UniformHandle<glm::vec4> lightColor;
+};
+
 float rotAngle = 0.0f;
 
 // Globals
@@ -80,7 +95,7 @@ static void mouse_position_callback(GLFWwindow* window, double xpos, double ypos
     mousePos = glm::vec2(xpos, ypos);
 }
 
-void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, GLint modelMatLoc, GLint normMatLoc, glm::mat4 viewMat, int level) {
+void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, ShaderReflection &refl, SceneUniforms &uniforms, glm::mat4 viewMat, int level) {
     // Get transformation for the current node
     glm::mat4 nodeT;
     aiMatToGLM4(node->mTransformation, nodeT);
@@ -101,10 +116,13 @@ void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, G
     glm::mat3 normMat = glm::transpose(glm::inverse(glm::mat3(viewMat * tmpModel)));
 
     // Pass normal matrix to shader
-    glUniformMatrix3fv(normMatLoc, 1, GL_FALSE, glm::value_ptr(normMat));
+    setUniform(refl, uniforms.normMat, normMat);
 
     // Pass tmpModel as model matrix
-    glUniformMatrix4fv(modelMatLoc, 1, GL_FALSE, glm::value_ptr(tmpModel));
+    setUniform(refl, uniforms.modelMat, tmpModel);
+
+    // Upload everything staged since the last draw
+    flushUniforms(refl);
 
     // Render each mesh in the node
     for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
@@ -114,7 +132,7 @@ void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, G
 
     // Render each child node recursively
     for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-        renderScene(allMeshes, node->mChildren[i], modelMat, modelMatLoc, normMatLoc, viewMat, level + 1);
+        renderScene(allMeshes, node->mChildren[i], modelMat, refl, uniforms, viewMat, level + 1);
     }
 }
 
@@ -296,6 +314,12 @@ int main(int argc, char **argv) {
     // Are we in debugging mode?
     bool DEBUG_MODE = true;
 
+    // Frame pacing (--vsync, --uncapped, --fps <N>)
+    FramePacer pacer;
+    parseFramePacingArgs(argc, argv, pacer);
+    parseGLDebugArgs(argc, argv);
+    parseProgramCacheArgs(argc, argv);
+
     // GLFW setup
     // Switch to 4.1 if necessary for macOS
     GLFWwindow* window = setupGLFW("Assign06: janisr", 4, 3, 800, 800, DEBUG_MODE);
@@ -303,6 +327,9 @@ int main(int argc, char **argv) {
     // GLEW setup
     setupGLEW(window);
 
+    // Apply frame pacing mode
+    setupFramePacing(pacer);
+
     // Get the initial position of the mouse
     double mx, my;
     glfwGetCursorPos(window, &mx, &my);
@@ -324,16 +351,20 @@ int main(int argc, char **argv) {
 
     // Create and load shaders
     GLuint programID = 0;
+    ShaderPermutationSet shaderPerms;
     try {        
-        // Load vertex shader code and fragment shader code
-        string vertexCode = readFileToString("./shaders/Assign06/Basic.vs");
-        string fragCode = readFileToString("./shaders/Assign06/Basic.fs");
+        // Load the shared shader code
+        loadShaderPermutations(shaderPerms, "./shaders/Common/Lit.vs", "./shaders/Common/Lit.fs");
 
         // Print out shader code, just to check
-        if(DEBUG_MODE) printShaderCode(vertexCode, fragCode);
+        if(DEBUG_MODE) {
+            string vertexCode, fragCode;
+            getShaderVariantSource(shaderPerms, { "LIGHTING_PHONG" }, vertexCode, fragCode);
+            printShaderCode(vertexCode, fragCode);
+        }
 
-        // Create shader program from code
-        programID = initShaderProgramFromSource(vertexCode, fragCode);
+        // Build this assignment's variant (cached under the same key as the other apps use)
+        programID = getShaderVariant(shaderPerms, { "LIGHTING_PHONG" });
     }
     catch (exception e) {        
         // Close program
@@ -373,18 +404,19 @@ int main(int argc, char **argv) {
     }
 
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+    setDepthTest(true);
 
     // Use shader program
-    glUseProgram(programID);
+    useProgram(programID);
 
-    // Get the model, view, and projection locations
-    GLint modelMatLoc = glGetUniformLocation(programID, "modelMat");
-    GLuint viewMatLoc = glGetUniformLocation(programID, "viewMat");
-    GLuint projMatLoc = glGetUniformLocation(programID, "projMat");
-
-    // Get the normal matrix location
-    GLint normMatLoc = glGetUniformLocation(programID, "normMat");
+    // Reflect program and resolve typed uniform handles
+    ShaderReflection refl;
+    reflectShaderProgram(programID, refl);
+    SceneUniforms uniforms;
+    uniforms.modelMat = getUniform<glm::mat4>(refl, "modelMat");
+    uniforms.viewMat = getUniform<glm::mat4>(refl, "viewMat");
+    uniforms.projMat = getUniform<glm::mat4>(refl, "projMat");
+    uniforms.normMat = getUniform<glm::mat3>(refl, "normMat");
 
     // Set the key callback function
     glfwSetKeyCallback(window, keyCallback);
@@ -394,22 +426,28 @@ int main(int argc, char **argv) {
     light.pos = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f); // Initial light position (world space)
     light.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f); // Initial light color (white)
 
-    // Get uniform locations for light properties
-    GLuint lightPosLoc = glGetUniformLocation(programID, "light.pos");
-    GLuint lightColorLoc = glGetUniformLocation(programID, "light.color");
+    // Get uniform handles for light properties
+    uniforms.lightPos = getUniform<glm::vec4>(refl, "light.pos");
+    uniforms.lightColor = getUniform<glm::vec4>(refl, "light.color");
+    if (DEBUG_MODE) printShaderReflection(refl);
+
+    // Only redraw when something changed (--on-demand)
+    setupOnDemandRedraw(window, pacer);
 
     // Main rendering loop
     while (!glfwWindowShouldClose(window)) {
+        if (!waitForRedraw(pacer)) continue;
+
         // Set viewport size
         int fwidth, fheight;
         glfwGetFramebufferSize(window, &fwidth, &fheight);
-        glViewport(0, 0, fwidth, fheight);
+        setViewport(0, 0, fwidth, fheight);
 
         // Clear the framebuffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Use shader program
-        glUseProgram(programID);
+        useProgram(programID);
 
         // Create view matrix
         glm::mat4 view = glm::lookAt(eye, lookAt, glm::vec3(0.0f, 1.0f, 0.0f));
@@ -418,11 +456,11 @@ int main(int argc, char **argv) {
         glm::vec4 lightPosView = view * light.pos;
 
         // Pass light properties to shader
-        glUniform4fv(lightPosLoc, 1, glm::value_ptr(lightPosView));
-        glUniform4fv(lightColorLoc, 1, glm::value_ptr(light.color));
+        setUniform(refl, uniforms.lightPos, lightPosView);
+        setUniform(refl, uniforms.lightColor, light.color);
 
         // Pass view matrix to shader
-        glUniformMatrix4fv(viewMatLoc, 1, GL_FALSE, glm::value_ptr(view));
+        setUniform(refl, uniforms.viewMat, view);
 
         // Calculate aspect ratio
         int width, height;
@@ -433,21 +471,32 @@ int main(int argc, char **argv) {
         glm::mat4 projection = glm::perspective(glm::radians(90.0f), aspectRatio, 0.01f, 50.0f);
 
         // Pass projection matrix to shader
-        glUniformMatrix4fv(projMatLoc, 1, GL_FALSE, glm::value_ptr(projection));
+        setUniform(refl, uniforms.projMat, projection);
 
         // Main drawing function
-        renderScene(meshGLVector, scene->mRootNode, glm::mat4(1.0f), modelMatLoc, normMatLoc, view, 0);
+        renderScene(meshGLVector, scene->mRootNode, glm::mat4(1.0f), refl, uniforms, view, 0);
 
         // Swap buffers and poll for window events
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        // Wait for next frame (if needed) and record frame time
+        endFrame(pacer);
+        endGLStateFrame();
     }
 
+    // Report frame timing
+    printFrameStats(pacer);
+    printGLStateStats();
+
     // Clean up all MeshGL objects
     for (auto& mgl : meshGLVector) {
         cleanupMesh(mgl);
     }
 
+    // Clean up shader programs
+    cleanupShaderPermutations(shaderPerms);
+
     cleanupGLFW(window);
 
     return 0;
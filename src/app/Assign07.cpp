@@ -2,6 +2,9 @@
 #include <fstream>
 #include <sstream>
 #include <thread>
+#include <atomic>
+#include <cstring>
+#include <ctime>
 #include <vector>
 #include <GL/glew.h>					
 #include <GLFW/glfw3.h>
@@ -9,7 +12,26 @@
 #include "MeshData.hpp"
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
+#include "GLDebugOutput.hpp"
 #include "Shader.hpp"
+#include "ProgramCache.hpp"
+#include "ShaderCompileQueue.hpp"
+#include "ShaderHotReload.hpp"
+#include "ShaderPermutation.hpp"
+#include "BRDFLookup.hpp"
+#include "FramebufferGL.hpp"
+#include "GBufferGL.hpp"
+#include "ShadowMapGL.hpp"
+#include "TextureCache.hpp"
+#include "TextureArrays.hpp"
+#include "FrameCapture.hpp"
+#include "FrameStream.hpp"
+#include "ThreadPool.hpp"
+#include "FramePacing.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+#include "TripleBuffer.hpp"
+#include "SPSCQueue.hpp"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -32,15 +54,127 @@ struct PointLight {
 // Global Point Light object
 PointLight light;
 
+// Uniform handles (resolved once after linking)
+struct SceneUniforms {
+    UniformHandle<glm::mat4> modelMat;
+    UniformHandle<glm::mat4> viewMat;
+    UniformHandle<glm::mat4> projMat;
+    UniformHandle<glm::mat3> normMat;
+    UniformHandle<glm::vec4> lightPos;
+    UniformHandle<glm::vec4> lightColor;
+    UniformHandle<float> roughness;
+    UniformHandle<float> metallic;
+    UniformHandle<glm::mat4> invProjMat;
+    UniformHandle<glm::mat3> shadowViewToWorld;
+    UniformHandle<glm::vec2> shadowParams;
+    UniformHandle<int> materialIndex;
+};
+
 float rotAngle = 0.0f;
 float metallic = 0.0;
 float roughness = 0.1;
 
+// Lighting models in shaders/Common/Lit.fs (L cycles through them)
+const char *LIGHTING_MODELS[] = { "LIGHTING_GGX", "LIGHTING_PHONG", "LIGHTING_UNLIT" };
+const int LIGHTING_MODEL_CNT = 3;
+int lightingModel = 0;
+bool useBRDFLookup = false;	// U: GGX Fresnel/geometry from the split-sum table
+bool useDeferred = false;	// G: GGX through the G-buffer + full-screen lighting pass
+bool useDepthPrepass = false;	// Z: position-only depth pass first, then shade with GL_EQUAL
+bool useShadows = false;	// H: cube shadow map for the light (GGX)
+
+// Bumped whenever a shadow-casting transform changes (the cached shadow map is re-rendered then)
+uint64_t casterVersion = 0;
+
+// Bumped by F12; the render thread captures the next frame it draws into screenshots/
+uint64_t captureRequests = 0;
+
+// F11 toggles recording every drawn frame to a Y4M clip (screenshots/, or --record target)
+bool recording = false;
+string recordTarget;
+
+// Base color textures (decoded in the background, then moved into array layers;
+// meshes draw untextured until theirs is in)
+TextureCache textureCache;
+TextureArrays textureArrays;
+vector<int> meshMaterials;			// Per mesh: index into the material table
+bool useAlbedoMaps = false;			// Any mesh has a texture (set once after import)
+
 // Globals
 glm::vec3 eye(0.0f, 0.0f, 1.0f); // Default camera position
 glm::vec3 lookAt(0.0f, 0.0f, 0.0f); // Default look-at point
 glm::vec2 mousePos(0.0f, 0.0f); // Initial mouse position
 
+// The globals above belong to the main (event) thread.
+// The render thread only ever sees complete copies of them, published once per update.
+struct SceneSnapshot {
+    glm::vec3 eye;
+    glm::vec3 lookAt;
+    float rotAngle;
+    float metallic;
+    float roughness;
+    int lightingModel;
+    bool useBRDFLookup;
+    bool useDeferred;
+    bool useDepthPrepass;
+    bool useShadows;
+    uint64_t casterVersion;
+    uint64_t captureRequests;
+    bool recording;
+    PointLight light;
+    int fbWidth;
+    int fbHeight;
+};
+
+// Main thread -> render thread
+TripleBuffer<SceneSnapshot> sceneSnapshots;
+
+// Where a clip goes: the --record target, or screenshots/Assign07_YYYYMMDD-HHMMSS.y4m
+string makeRecordingTarget() {
+    if (!recordTarget.empty()) return recordTarget;
+    time_t now = time(nullptr);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+    return string("screenshots/Assign07_") + stamp + ".y4m";
+}
+
+// Raw input from the GLFW callbacks; drained and coalesced once per update
+enum InputEventType {
+    INPUT_CURSOR,
+    INPUT_KEY
+};
+
+struct InputEvent {
+    InputEventType type;
+    double x;
+    double y;
+    int key;
+};
+
+SPSCQueue<InputEvent, 1024> inputQueue;
+long long droppedInputEvents = 0;
+
+// Copy the current simulation state into a snapshot and hand it to the render thread
+void publishSceneSnapshot(GLFWwindow* window) {
+    SceneSnapshot &snap = sceneSnapshots.writeSlot();
+    snap.eye = eye;
+    snap.lookAt = lookAt;
+    snap.rotAngle = rotAngle;
+    snap.metallic = metallic;
+    snap.roughness = roughness;
+    snap.lightingModel = lightingModel;
+    snap.useBRDFLookup = useBRDFLookup;
+    snap.useDeferred = useDeferred;
+    snap.useDepthPrepass = useDepthPrepass;
+    snap.useShadows = useShadows;
+    snap.casterVersion = casterVersion;
+    snap.captureRequests = captureRequests;
+    snap.recording = recording;
+    snap.light = light;
+    glfwGetFramebufferSize(window, &snap.fbWidth, &snap.fbHeight);
+    sceneSnapshots.publish();
+}
+
 glm::mat4 makeLocalRotate(glm::vec3 offset, glm::vec3 axis, float angle) {
     glm::mat4 translateBack = glm::translate(glm::mat4(1.0f), offset);
     glm::mat4 rotate = glm::rotate(glm::mat4(1.0f), glm::radians(angle), axis);
@@ -48,7 +182,7 @@ glm::mat4 makeLocalRotate(glm::vec3 offset, glm::vec3 axis, float angle) {
     return translateForward * rotate * translateBack;
 }
 
-glm::mat4 makeRotateZ(glm::vec3 offset) {
+glm::mat4 makeRotateZ(glm::vec3 offset, float rotAngle) {
     // Convert rotAngle to radians
     float radians = glm::radians(rotAngle);
 
@@ -62,27 +196,13 @@ glm::mat4 makeRotateZ(glm::vec3 offset) {
 }
 
 static void mouse_position_callback(GLFWwindow* window, double xpos, double ypos) {
-    glm::vec2 relMouse = glm::vec2(xpos, ypos) - mousePos;
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-    if (width > 0 && height > 0) {
-        float scaleX = relMouse.x / static_cast<float>(width);
-        float scaleY = relMouse.y / static_cast<float>(height);
-
-        glm::vec3 cameraDir = glm::normalize(lookAt - eye);
-        glm::vec3 globalYAxis = glm::vec3(0.0f, 1.0f, 0.0f);
-        glm::vec3 localXAxis = glm::normalize(glm::cross(cameraDir, globalYAxis));
-
-        glm::mat4 rotationX = makeLocalRotate(eye, localXAxis, 30.0f * scaleY);
-        glm::mat4 rotationY = makeLocalRotate(eye, globalYAxis, 30.0f * scaleX);
-
-        lookAt = glm::vec3(rotationX * glm::vec4(lookAt, 1.0));
-        lookAt = glm::vec3(rotationY * glm::vec4(lookAt, 1.0));
-    }
-    mousePos = glm::vec2(xpos, ypos);
+    // Only record the (absolute) position; the camera is updated once per frame.
+    // Dropping an event on overflow is harmless, since the next one carries the total motion.
+    InputEvent e = { INPUT_CURSOR, xpos, ypos, 0 };
+    if (!inputQueue.tryPush(e)) droppedInputEvents++;
 }
 
-void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, GLint modelMatLoc, GLint normMatLoc, glm::mat4 viewMat, int level) {
+void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, ShaderReflection &refl, SceneUniforms &uniforms, glm::mat4 viewMat, float rotAngle, int level, bool depthOnly = false) {
     // Get transformation for the current node
     glm::mat4 nodeT;
     aiMatToGLM4(node->mTransformation, nodeT);
@@ -94,7 +214,7 @@ void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, G
     glm::vec3 pos = glm::vec3(modelMat[3]);
 
     // Proper local Z rotation
-    glm::mat4 R = makeRotateZ(pos);
+    glm::mat4 R = makeRotateZ(pos, rotAngle);
 
     // Generate temporary model matrix
     glm::mat4 tmpModel = R * modelMat;
@@ -102,83 +222,219 @@ void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, G
     // Calculate the normal matrix
     glm::mat3 normMat = glm::transpose(glm::inverse(glm::mat3(viewMat * tmpModel)));
 
-    // Pass normal matrix to shader
-    glUniformMatrix3fv(normMatLoc, 1, GL_FALSE, glm::value_ptr(normMat));
+    {
+        PROFILE_CPU_ZONE("uniform upload");
+
+        // Pass normal matrix to shader
+        setUniform(refl, uniforms.normMat, normMat);
 
-    // Pass tmpModel as model matrix
-    glUniformMatrix4fv(modelMatLoc, 1, GL_FALSE, glm::value_ptr(tmpModel));
+        // Pass tmpModel as model matrix
+        setUniform(refl, uniforms.modelMat, tmpModel);
+
+        // Upload everything staged since the last draw
+        flushUniforms(refl);
+    }
 
     // Render each mesh in the node
-    for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-        int index = node->mMeshes[i];
-        drawMesh(allMeshes.at(index));
+    {
+        PROFILE_CPU_ZONE("draw");
+        for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+            int index = node->mMeshes[i];
+            if (depthOnly) {
+                drawMeshDepth(allMeshes.at(index));
+                continue;
+            }
+            if (useAlbedoMaps) {
+                // All textures are already bound as arrays; only the table index changes
+                setUniform(refl, uniforms.materialIndex, meshMaterials.at(index));
+                flushUniforms(refl);
+            }
+            drawMesh(allMeshes.at(index));
+        }
     }
 
     // Render each child node recursively
     for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-        renderScene(allMeshes, node->mChildren[i], modelMat, modelMatLoc, normMatLoc, viewMat, level + 1);
+        renderScene(allMeshes, node->mChildren[i], modelMat, refl, uniforms, viewMat, rotAngle, level + 1, depthOnly);
     }
 }
 
+// Shader variant for this state: only pay for the metallic blend when it is in use
+vector<string> getSceneDefines(int lightingModel, float metallic, bool useBRDFLookup, bool useShadows, bool useAlbedoMap) {
+    vector<string> defines = { LIGHTING_MODELS[lightingModel] };
+    if (useAlbedoMap) {
+        defines.push_back("USE_ALBEDO_MAP");
+        defines.push_back("USE_TEXTURE_ARRAYS");
+    }
+    if (lightingModel == 0) {
+        defines.push_back("STRIP_DEAD_PHONG");
+        if (metallic > 0.0f) defines.push_back("USE_METALLIC");
+        if (useBRDFLookup) defines.push_back("USE_BRDF_LUT");
+        if (useShadows) defines.push_back("USE_SHADOWS");
+    }
+    return defines;
+}
+
+// Deferred GGX: the G-buffer pass only needs the material inputs,
+// the lighting pass reads metallic back from the G-buffer
+vector<string> getGBufferDefines(float metallic, bool useAlbedoMap) {
+    vector<string> defines = { "LIGHTING_GGX", "GBUFFER_PASS" };
+    if (metallic > 0.0f) defines.push_back("USE_METALLIC");
+    if (useAlbedoMap) {
+        defines.push_back("USE_ALBEDO_MAP");
+        defines.push_back("USE_TEXTURE_ARRAYS");
+    }
+    return defines;
+}
+
+vector<string> getDeferredLightingDefines(bool useBRDFLookup, bool useShadows) {
+    vector<string> defines = getSceneDefines(0, 0.0f, useBRDFLookup, useShadows, false);
+    defines.push_back("DEFERRED_LIGHTING");
+    return defines;
+}
+
+// Reflect program and (re)resolve all uniform handles used by the scene
+void resolveSceneUniforms(GLuint programID, ShaderReflection &refl, SceneUniforms &uniforms) {
+    reflectShaderProgram(programID, refl);
+    uniforms.modelMat = getUniform<glm::mat4>(refl, "modelMat");
+    uniforms.viewMat = getUniform<glm::mat4>(refl, "viewMat");
+    uniforms.projMat = getUniform<glm::mat4>(refl, "projMat");
+    uniforms.normMat = getUniform<glm::mat3>(refl, "normMat");
+    uniforms.lightPos = getUniform<glm::vec4>(refl, "light.pos");
+    uniforms.lightColor = getUniform<glm::vec4>(refl, "light.color");
+    uniforms.roughness = getUniform<float>(refl, "roughness");
+    uniforms.metallic = getUniform<float>(refl, "metallic");
+    if (useAlbedoMaps) uniforms.materialIndex = getUniform<int>(refl, "materialIndex");
+}
+
+// Same for the deferred lighting pass (it only sees the light and the projection)
+void resolveLightingUniforms(GLuint programID, ShaderReflection &refl, SceneUniforms &uniforms) {
+    reflectShaderProgram(programID, refl);
+    uniforms.lightPos = getUniform<glm::vec4>(refl, "light.pos");
+    uniforms.lightColor = getUniform<glm::vec4>(refl, "light.color");
+    uniforms.invProjMat = getUniform<glm::mat4>(refl, "invProjMat");
+}
+
+// Same for the depth pre-pass (transforms only)
+void resolveDepthUniforms(GLuint programID, ShaderReflection &refl, SceneUniforms &uniforms) {
+    reflectShaderProgram(programID, refl);
+    uniforms.modelMat = getUniform<glm::mat4>(refl, "modelMat");
+    uniforms.viewMat = getUniform<glm::mat4>(refl, "viewMat");
+    uniforms.projMat = getUniform<glm::mat4>(refl, "projMat");
+}
+
+// Shadow lookup uniforms of a USE_SHADOWS variant (forward or deferred lighting)
+void resolveShadowUniforms(ShaderReflection &refl, SceneUniforms &uniforms) {
+    uniforms.shadowViewToWorld = getUniform<glm::mat3>(refl, "shadowViewToWorld");
+    uniforms.shadowParams = getUniform<glm::vec2>(refl, "shadowParams");
+}
+
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    if (action == GLFW_PRESS || action == GLFW_REPEAT) {
+    if ((action == GLFW_PRESS || action == GLFW_REPEAT) && key >= 0 && key <= GLFW_KEY_LAST) {
+        InputEvent e = { INPUT_KEY, 0.0, 0.0, key };
+        if (!inputQueue.tryPush(e)) droppedInputEvents++;
+    }
+}
+
+// Drain queued input and apply it: one camera rotation for all cursor motion,
+// and key presses/repeats counted and applied in one step per key
+void applyInputEvents(GLFWwindow* window) {
+    static int keyCounts[GLFW_KEY_LAST + 1];
+    memset(keyCounts, 0, sizeof(keyCounts));
+
+    bool cursorMoved = false;
+    glm::vec2 latestMouse = mousePos;
+    int colorKey = -1;
+
+    InputEvent e;
+    while (inputQueue.tryPop(e)) {
+        if (e.type == INPUT_CURSOR) {
+            latestMouse = glm::vec2(e.x, e.y);
+            cursorMoved = true;
+        }
+        else {
+            keyCounts[e.key]++;
+            if (e.key >= GLFW_KEY_1 && e.key <= GLFW_KEY_4) colorKey = e.key;
+        }
+    }
+
+    if (keyCounts[GLFW_KEY_ESCAPE] > 0) {
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+
+    // Mouse look (summed motion since last update)
+    if (cursorMoved) {
+        glm::vec2 relMouse = latestMouse - mousePos;
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        if (width > 0 && height > 0) {
+            float scaleX = relMouse.x / static_cast<float>(width);
+            float scaleY = relMouse.y / static_cast<float>(height);
+
+            glm::vec3 cameraDir = glm::normalize(lookAt - eye);
+            glm::vec3 globalYAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::vec3 localXAxis = glm::normalize(glm::cross(cameraDir, globalYAxis));
+
+            glm::mat4 rotationX = makeLocalRotate(eye, localXAxis, 30.0f * scaleY);
+            glm::mat4 rotationY = makeLocalRotate(eye, globalYAxis, 30.0f * scaleX);
+
+            lookAt = glm::vec3(rotationX * glm::vec4(lookAt, 1.0));
+            lookAt = glm::vec3(rotationY * glm::vec4(lookAt, 1.0));
+        }
+        mousePos = latestMouse;
+    }
+
+    // Movement (W/S forward/back, D/A right/left)
+    int forwardSteps = keyCounts[GLFW_KEY_W] - keyCounts[GLFW_KEY_S];
+    int rightSteps = keyCounts[GLFW_KEY_D] - keyCounts[GLFW_KEY_A];
+    if (forwardSteps != 0 || rightSteps != 0) {
         float speed = 0.1f;
         glm::vec3 cameraDir = glm::normalize(lookAt - eye);
         glm::vec3 globalYAxis = glm::vec3(0.0f, 1.0f, 0.0f);
         glm::vec3 localXAxis = glm::normalize(glm::cross(cameraDir, globalYAxis));
-        switch (key) {
-            case GLFW_KEY_ESCAPE:
-                glfwSetWindowShouldClose(window, GLFW_TRUE);
-                break;
-            case GLFW_KEY_J:
-                rotAngle += 1.0f;
-                break;
-            case GLFW_KEY_K:
-                rotAngle -= 1.0f;
-                break;
-            case GLFW_KEY_W:
-                eye += speed * cameraDir;
-                lookAt += speed * cameraDir;
-                break;
-            case GLFW_KEY_S:
-                eye -= speed * cameraDir;
-                lookAt -= speed * cameraDir;
-                break;
-            case GLFW_KEY_D:
-                eye += speed * localXAxis;
-                lookAt += speed * localXAxis;
-                break;
-            case GLFW_KEY_A:
-                eye -= speed * localXAxis;
-                lookAt -= speed * localXAxis;
-                break;
-            case GLFW_KEY_V:
-                metallic = max(0.0f, metallic - 0.1f);
-                break;
-            case GLFW_KEY_B:
-                metallic = min(1.0f, metallic + 0.1f);
-                break;
-            case GLFW_KEY_N:
-                roughness = max(0.1f, roughness - 0.1f);
-                break;
-            case GLFW_KEY_M:
-                roughness = min(0.7f, roughness + 0.1f);
-                break;
-            case GLFW_KEY_1:
-                light.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f); // White
-                break;
-            case GLFW_KEY_2:
-                light.color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f); // Red
-                break;
-            case GLFW_KEY_3:
-                light.color = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f); // Green
-                break;
-            case GLFW_KEY_4:
-                light.color = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f); // Blue
-                break;
-            default:
-                break;
-        }
+        glm::vec3 move = speed * (static_cast<float>(forwardSteps) * cameraDir + static_cast<float>(rightSteps) * localXAxis);
+        eye += move;
+        lookAt += move;
+    }
+
+    // Local Z rotation (J/K; moves every node, so the shadow casters changed)
+    int rotSteps = keyCounts[GLFW_KEY_J] - keyCounts[GLFW_KEY_K];
+    if (rotSteps != 0) {
+        rotAngle += 1.0f * rotSteps;
+        casterVersion++;
+    }
+
+    // Material (V/B metallic, N/M roughness)
+    metallic = glm::clamp(metallic + 0.1f * (keyCounts[GLFW_KEY_B] - keyCounts[GLFW_KEY_V]), 0.0f, 1.0f);
+    roughness = glm::clamp(roughness + 0.1f * (keyCounts[GLFW_KEY_M] - keyCounts[GLFW_KEY_N]), 0.1f, 0.7f);
+
+    // Lighting model (L; the variant is compiled the first time it is drawn)
+    lightingModel = (lightingModel + keyCounts[GLFW_KEY_L]) % LIGHTING_MODEL_CNT;
+    if (keyCounts[GLFW_KEY_U] % 2 == 1) useBRDFLookup = !useBRDFLookup;
+    if (keyCounts[GLFW_KEY_G] % 2 == 1) useDeferred = !useDeferred;
+    if (keyCounts[GLFW_KEY_Z] % 2 == 1) useDepthPrepass = !useDepthPrepass;
+    if (keyCounts[GLFW_KEY_H] % 2 == 1) useShadows = !useShadows;
+
+    // Screenshot (F12; held-down repeats within one update count once)
+    if (keyCounts[GLFW_KEY_F12] > 0) captureRequests++;
+    if (keyCounts[GLFW_KEY_F11] % 2 == 1) recording = !recording;
+
+    // Light color (last of 1-4 wins)
+    switch (colorKey) {
+        case GLFW_KEY_1:
+            light.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f); // White
+            break;
+        case GLFW_KEY_2:
+            light.color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f); // Red
+            break;
+        case GLFW_KEY_3:
+            light.color = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f); // Green
+            break;
+        case GLFW_KEY_4:
+            light.color = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f); // Blue
+            break;
+        default:
+            break;
     }
 }
 
@@ -269,7 +525,7 @@ void createSimplePentagon(Mesh &m) {
     m.indices.push_back(4);
 }
 
-void extractMeshData(aiMesh *mesh, Mesh &m) {
+void extractMeshData(aiMesh *mesh, Mesh &m, glm::vec4 color) {
     // Clear out the Mesh's vertices and indices
     m.vertices.clear();
     m.indices.clear();
@@ -286,8 +542,14 @@ void extractMeshData(aiMesh *mesh, Mesh &m) {
         aiVector3D aiNorm = mesh->mNormals[i];
         vertex.normal = glm::vec3(aiNorm.x, aiNorm.y, aiNorm.z);
 
-        // Set the color of the Vertex to yellow
-        vertex.color = glm::vec4(1.0f, 1.0f, 0.0f, 1.0f); // Yellow
+        // Yellow, or white for textured meshes so the texture shows as is
+        vertex.color = color;
+
+        // First UV channel (if any)
+        if (mesh->HasTextureCoords(0)) {
+            aiVector3D aiUV = mesh->mTextureCoords[0][i];
+            vertex.texcoord = glm::vec2(aiUV.x, aiUV.y);
+        }
 
         // Add the Vertex to the Mesh's vertices list
         m.vertices.push_back(vertex);
@@ -310,6 +572,18 @@ int main(int argc, char **argv) {
     // Are we in debugging mode?
     bool DEBUG_MODE = true;
 
+    // Frame pacing (--vsync, --uncapped, --fps <N>)
+    FramePacer pacer;
+    parseFramePacingArgs(argc, argv, pacer);
+    parseGLDebugArgs(argc, argv);
+    parseProgramCacheArgs(argc, argv);
+
+    // Profiling (--profile, --profile-csv <file>)
+    parseProfilerArgs(argc, argv);
+
+    // Clip recording (--record file.y4m|"|command": record from the first frame; F11 toggles)
+    if (consumeOption(argc, argv, "--record", recordTarget)) recording = true;
+
     // GLFW setup
     // Switch to 4.1 if necessary for macOS
     GLFWwindow* window = setupGLFW("Assign07: janisr", 4, 3, 800, 800, DEBUG_MODE);
@@ -317,6 +591,9 @@ int main(int argc, char **argv) {
     // GLEW setup
     setupGLEW(window);
 
+    // Create GPU timer queries
+    setupGPUProfiler();
+
     // Get the initial position of the mouse
     double mx, my;
     glfwGetCursorPos(window, &mx, &my);
@@ -337,17 +614,23 @@ int main(int argc, char **argv) {
     glClearColor(0.2f, 0.2f, 0.4f, 1.0f); // Dark blue
 
     // Create and load shaders
-    GLuint programID = 0;
+    // (only submitted here; the driver compiles them while the model is imported)
+    ShaderCompileQueue compileQueue;
+    ShaderPermutationSet shaderPerms;
+    // (textures are only known after the import; a textured model switches variants on the first frame)
+    vector<string> startDefines = getSceneDefines(lightingModel, metallic, useBRDFLookup, useShadows, false);
+    int mainProgramJob = -1;
     try {        
-        // Load vertex shader code and fragment shader code
-        string vertexCode = readFileToString("./shaders/Assign07/Basic.vs");
-        string fragCode = readFileToString("./shaders/Assign07/Basic.fs");
+        // Load the shared shader sources; variants are these plus #defines
+        loadShaderPermutations(shaderPerms, "./shaders/Common/Lit.vs", "./shaders/Common/Lit.fs");
+        string vertexCode, fragCode;
+        getShaderVariantSource(shaderPerms, startDefines, vertexCode, fragCode);
 
         // Print out shader code, just to check
         if(DEBUG_MODE) printShaderCode(vertexCode, fragCode);
 
-        // Create shader program from code
-        programID = initShaderProgramFromSource(vertexCode, fragCode);
+        // Queue the first variant (the rest are built when first drawn)
+        mainProgramJob = queueProgramCompile(compileQueue, "Assign07", vertexCode, fragCode, getShaderDefinesKey(startDefines));
     }
     catch (exception e) {        
         // Close program
@@ -363,8 +646,12 @@ int main(int argc, char **argv) {
 
     // Load the model using Assimp
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(modelPath, 
-        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
+    const aiScene* scene = nullptr;
+    {
+        PROFILE_CPU_ZONE("import");
+        scene = importer.ReadFile(modelPath, 
+            aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
+    }
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         cerr << "ERROR: Failed to load model: " << modelPath << endl;
@@ -372,33 +659,76 @@ int main(int argc, char **argv) {
         return -1;
     }
 
+    // Start decoding textures first, so the workers overlap with the mesh upload and the first frames
+    // (the material table owns the references; meshes sharing a texture share a material)
+    ThreadPool texturePool;
+    startThreadPool(texturePool);
+    setupTextureCache(textureCache, texturePool);
+    setupTextureArrays(textureArrays, textureCache);
+    textureCache.onDecoded = [&pacer]() { markFrameDirty(pacer); };
+
+    // Screenshots are read back asynchronously and encoded on the same pool
+    FrameCapture frameCapture;
+    setupFrameCapture(frameCapture, texturePool, "screenshots", "Assign07");
+    uint64_t lastCaptureRequests = 0;
+
+    // Clips: every drawn frame is read back and handed to the stream's writer thread
+    FrameStream frameStream;
+    bool streaming = false;
+    bool recordingStopped = false;		// Open failed or the window was resized; wait for F11
+    vector<bool> meshTextured;
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        Texture *texture = acquireMaterialTexture(textureCache, scene, scene->mMeshes[i]->mMaterialIndex, modelPath);
+        meshTextured.push_back(texture != nullptr);
+        meshMaterials.push_back(addTextureMaterial(textureArrays, texture));
+        if (texture) useAlbedoMaps = true;
+    }
+
     // Create MeshGL vector to store all meshes
     vector<MeshGL> meshGLVector;
 
     // Process each mesh in the loaded model
-    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-        Mesh m;
-        extractMeshData(scene->mMeshes[i], m); // Extract mesh data from Assimp's mesh
+    {
+        PROFILE_CPU_ZONE("upload");
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+            Mesh m;
+            glm::vec4 color = meshTextured[i] ? glm::vec4(1.0f) : glm::vec4(1.0f, 1.0f, 0.0f, 1.0f);
+            extractMeshData(scene->mMeshes[i], m, color); // Extract mesh data from Assimp's mesh
 
-        MeshGL mgl;
-        createMeshGL(m, mgl); // Convert mesh data to GPU-ready format
+            MeshGL mgl;
+            createMeshGL(m, mgl); // Convert mesh data to GPU-ready format
 
-        meshGLVector.push_back(mgl); // Store MeshGL for drawing
+            meshGLVector.push_back(mgl); // Store MeshGL for drawing
+        }
+    }
+
+    // Collect the shader program (usually finished by now)
+    GLuint programID = 0;
+    try {
+        programID = getCompiledProgram(compileQueue, mainProgramJob);
+        addShaderVariant(shaderPerms, startDefines, programID);
+        if(DEBUG_MODE) printShaderCompileStats(compileQueue);
+    }
+    catch (exception e) {
+        cleanupGLFW(window);
+        exit(EXIT_FAILURE);
     }
 
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+    setDepthTest(true);
 
     // Use shader program
-    glUseProgram(programID);
+    useProgram(programID);
 
-    // Get the model, view, and projection locations
-    GLint modelMatLoc = glGetUniformLocation(programID, "modelMat");
-    GLuint viewMatLoc = glGetUniformLocation(programID, "viewMat");
-    GLuint projMatLoc = glGetUniformLocation(programID, "projMat");
+    // Reflect program and resolve typed uniform handles
+    ShaderReflection refl;
+    SceneUniforms uniforms;
+    resolveSceneUniforms(programID, refl, uniforms);
+    if (DEBUG_MODE) printShaderReflection(refl);
 
-    // Get the normal matrix location
-    GLint normMatLoc = glGetUniformLocation(programID, "normMat");
+    // Rebuild the variants in the background when the shader files are edited
+    watchShaderPermutations(shaderPerms);
+    setupShaderHotReload();
 
     // Set the key callback function
     glfwSetKeyCallback(window, keyCallback);
@@ -408,60 +738,393 @@ int main(int argc, char **argv) {
     light.pos = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f); // Initial light position (world space)
     light.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f); // Initial light color (white)
 
-    // Get uniform locations for light properties
-    GLuint lightPosLoc = glGetUniformLocation(programID, "light.pos");
-    GLuint lightColorLoc = glGetUniformLocation(programID, "light.color");
-    GLuint roughLoc = glGetUniformLocation(programID, "roughness");
-    GLuint metalLoc = glGetUniformLocation(programID, "metallic");
-
-    // Main rendering loop
-    while (!glfwWindowShouldClose(window)) {
-        // Set viewport size
-        int fwidth, fheight;
-        glfwGetFramebufferSize(window, &fwidth, &fheight);
-        glViewport(0, 0, fwidth, fheight);
-
-        // Clear the framebuffer
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // Use shader program
-        glUseProgram(programID);
-
-        // Create view matrix
-        glm::mat4 view = glm::lookAt(eye, lookAt, glm::vec3(0.0f, 1.0f, 0.0f));
-
-        // Calculate the position of the light in eye/view space
-        glm::vec4 lightPosView = view * light.pos;
 
-        // Pass light properties to shader
-        glUniform4fv(lightPosLoc, 1, glm::value_ptr(lightPosView));
-        glUniform4fv(lightColorLoc, 1, glm::value_ptr(light.color));
-
-        // Pass in roughness and metallic
-        glUniform1f(roughLoc, roughness);
-        glUniform1f(metalLoc, metallic);
-
-        // Pass view matrix to shader
-        glUniformMatrix4fv(viewMatLoc, 1, GL_FALSE, glm::value_ptr(view));
-
-        // Calculate aspect ratio
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
-        float aspectRatio = (height > 0) ? static_cast<float>(width) / static_cast<float>(height) : 1.0f;
+    // Only redraw when input/window events arrive (--on-demand)
+    setupOnDemandRedraw(window, pacer);
+
+    // Initial snapshot so the render thread has something to draw
+    SceneSnapshot initialSnap;
+    initialSnap.eye = eye;
+    initialSnap.lookAt = lookAt;
+    initialSnap.rotAngle = rotAngle;
+    initialSnap.metallic = metallic;
+    initialSnap.roughness = roughness;
+    initialSnap.lightingModel = lightingModel;
+    initialSnap.useBRDFLookup = useBRDFLookup;
+    initialSnap.useDeferred = useDeferred;
+    initialSnap.useDepthPrepass = useDepthPrepass;
+    initialSnap.useShadows = useShadows;
+    initialSnap.casterVersion = casterVersion;
+    initialSnap.captureRequests = captureRequests;
+    initialSnap.recording = recording;
+    initialSnap.light = light;
+    glfwGetFramebufferSize(window, &initialSnap.fbWidth, &initialSnap.fbHeight);
+    sceneSnapshots.reset(initialSnap);
+
+    // Split-sum table (computed the first time a variant needs it)
+    BRDFLookup brdfLUT;
+
+    // Deferred path (G toggles; only GGX is shaded deferred).
+    // The G-buffer and the lit target are created on first use and follow the window size.
+    GBufferGL gbuffer;
+    FramebufferGL deferredTarget;
+    GLuint lightingProgramID = 0;
+    ShaderReflection lightingRefl;
+    SceneUniforms lightingUniforms;
+
+    // Depth pre-pass (Z toggles; built the first time it is used)
+    GLuint depthProgramID = 0;
+    ShaderReflection depthRefl;
+    SceneUniforms depthUniforms;
+
+    // Shadow map (H toggles; created the first time it is used, re-rendered only when stale)
+    ShadowMapGL shadowMap;
+    GLuint shadowProgramID = 0;
+    ShaderReflection shadowRefl;
+    SceneUniforms shadowUniforms;
+
+    // Clip frame rate under vsync follows the display
+    queryDisplayRefresh(pacer, window);
+
+    // Hand the OpenGL context over to the render thread
+    glfwMakeContextCurrent(NULL);
+    atomic<bool> renderRunning(true);
+
+    // Render thread: owns the context; draws the latest published snapshot
+    thread renderThread([&]() {
+        glfwMakeContextCurrent(window);
+
+        // Apply frame pacing mode (swap interval is per-context/thread)
+        setupFramePacing(pacer);
+
+        while (renderRunning.load()) {
+            // Swap in edited shaders once they have linked (errors keep the last good program)
+            if (updateShaderPermutations(shaderPerms)) {
+                markFrameDirty(pacer);
+            }
+
+            // Hand finished screenshot readbacks to the pool (keep the loop going until all are out)
+            updateFrameCapture(frameCapture);
+            if (!isFrameCaptureIdle(frameCapture)) markFrameDirty(pacer);
+
+            // While recording, draw every frame (the clip assumes a constant frame rate)
+            if (streaming) markFrameDirty(pacer);
+
+            // In on-demand mode, sleep until the main thread publishes a change
+            if (!waitForRedrawSignal(pacer)) continue;
+
+            // Upload textures decoded since the last frame (bounded per frame; keep drawing until all are in),
+            // copy them into their array layers and bind the arrays for the whole frame
+            if (useAlbedoMaps) {
+                PROFILE_CPU_ZONE("texture upload");
+                updateTextureCache(textureCache);
+                updateTextureArrays(textureArrays);
+                bindTextureArrays(textureArrays);
+                if (!isTextureCacheIdle(textureCache) || !isTextureArraysIdle(textureArrays)) markFrameDirty(pacer);
+            }
+
+            // Pick up the newest complete state (if any)
+            sceneSnapshots.acquire();
+            const SceneSnapshot &snap = sceneSnapshots.readSlot();
+
+            // Variant for this frame (built on first use; a broken one keeps the current program)
+            if (snap.useBRDFLookup && !brdfLUT.texID) {
+                createBRDFLookup(brdfLUT);
+                bindBRDFLookup(brdfLUT);
+            }
+            bool deferred = snap.useDeferred && snap.lightingModel == 0;
+            bool shadows = snap.useShadows && snap.lightingModel == 0;
+            try {
+                vector<string> defines = deferred ? getGBufferDefines(snap.metallic, useAlbedoMaps)
+                                                  : getSceneDefines(snap.lightingModel, snap.metallic, snap.useBRDFLookup, shadows, useAlbedoMaps);
+                GLuint variantID = getShaderVariant(shaderPerms, defines);
+                if (variantID != programID) {
+                    programID = variantID;
+                    resolveSceneUniforms(programID, refl, uniforms);
+                    if (shadows && !deferred) resolveShadowUniforms(refl, uniforms);
+                }
+                if (deferred) {
+                    GLuint lightingID = getShaderVariant(shaderPerms, getDeferredLightingDefines(snap.useBRDFLookup, shadows));
+                    if (lightingID != lightingProgramID) {
+                        lightingProgramID = lightingID;
+                        resolveLightingUniforms(lightingProgramID, lightingRefl, lightingUniforms);
+                        if (shadows) resolveShadowUniforms(lightingRefl, lightingUniforms);
+                    }
+                }
+            }
+            catch (exception &e) {
+                // Broken lighting variant: show what the G-buffer pass drew (albedo) until it is fixed
+                deferred = false;
+            }
+            if (deferred && (gbuffer.width != snap.fbWidth || gbuffer.height != snap.fbHeight) && snap.fbWidth > 0 && snap.fbHeight > 0) {
+                if (gbuffer.FBO) {
+                    cleanupGBufferGL(gbuffer);
+                    cleanupFramebufferGL(deferredTarget);
+                }
+                try {
+                    createGBufferGL(gbuffer, snap.fbWidth, snap.fbHeight);
+                    createFramebufferGL(deferredTarget, snap.fbWidth, snap.fbHeight);
+                }
+                catch (exception &e) {
+                    if (gbuffer.FBO) cleanupGBufferGL(gbuffer);
+                }
+            }
+            deferred = deferred && gbuffer.FBO != 0;
+
+            bool depthPrepass = snap.useDepthPrepass;
+            if (depthPrepass) {
+                try {
+                    GLuint depthID = getShaderVariant(shaderPerms, { "LIGHTING_UNLIT", "DEPTH_ONLY" });
+                    if (depthID != depthProgramID) {
+                        depthProgramID = depthID;
+                        resolveDepthUniforms(depthProgramID, depthRefl, depthUniforms);
+                    }
+                }
+                catch (exception &e) {
+                    depthPrepass = false;
+                }
+            }
+
+            if (shadows) {
+                try {
+                    if (!shadowMap.cubeTex) {
+                        createShadowMapGL(shadowMap, 1024, 0.01f, 10.0f);
+                        bindShadowMap(shadowMap);
+                    }
+                    GLuint shadowID = getShaderVariant(shaderPerms, { "LIGHTING_UNLIT", "DEPTH_ONLY", "SHADOW_PASS" });
+                    if (shadowID != shadowProgramID) {
+                        shadowProgramID = shadowID;
+                        resolveDepthUniforms(shadowProgramID, shadowRefl, shadowUniforms);
+                        setUniform(shadowRefl, getUniform<float>(shadowRefl, "shadowFar"), shadowMap.farZ);
+                        invalidateShadowMap(shadowMap);
+                    }
+                }
+                catch (exception &e) {
+                    shadows = false;
+                }
+            }
+
+            // Read back GPU timings from earlier frames
+            beginProfileFrame();
+
+            // Re-render the shadow map only if the light or a caster moved since it was drawn
+            glm::vec3 lightPosWorld = glm::vec3(snap.light.pos);
+            if (shadows && isShadowMapStale(shadowMap, lightPosWorld, snap.casterVersion)) {
+                PROFILE_CPU_ZONE("shadow map");
+                PROFILE_GPU_ZONE("shadow map");
+                auto shadowStart = chrono::steady_clock::now();
+                useProgram(shadowProgramID);
+                setUniform(shadowRefl, shadowUniforms.projMat, getShadowProjection(shadowMap));
+                for (int face = 0; face < 6; face++) {
+                    glm::mat4 faceView = getShadowFaceView(lightPosWorld, face);
+                    beginShadowFace(shadowMap, face);
+                    setUniform(shadowRefl, shadowUniforms.viewMat, faceView);
+                    renderScene(meshGLVector, scene->mRootNode, glm::mat4(1.0f), shadowRefl, shadowUniforms, faceView, snap.rotAngle, 0, true);
+                }
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                finishShadowUpdate(shadowMap, lightPosWorld, snap.casterVersion,
+                                   chrono::duration<double, milli>(chrono::steady_clock::now() - shadowStart).count());
+            }
+
+            // Set viewport size
+            setViewport(0, 0, snap.fbWidth, snap.fbHeight);
+
+            // Clear the framebuffer (deferred: the G-buffer; the lit result is copied over the whole window)
+            if (deferred) glBindFramebuffer(GL_FRAMEBUFFER, gbuffer.FBO);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // Use shader program
+            useProgram(programID);
+
+            // Create view matrix
+            glm::mat4 view = glm::lookAt(snap.eye, snap.lookAt, glm::vec3(0.0f, 1.0f, 0.0f));
+
+            // Calculate the position of the light in eye/view space
+            glm::vec4 lightPosView = view * snap.light.pos;
+
+            // Calculate aspect ratio
+            float aspectRatio = (snap.fbHeight > 0) ? static_cast<float>(snap.fbWidth) / static_cast<float>(snap.fbHeight) : 1.0f;
+
+            // Create projection matrix
+            glm::mat4 projection = glm::perspective(glm::radians(90.0f), aspectRatio, 0.01f, 50.0f);
+
+            {
+                PROFILE_CPU_ZONE("uniform upload");
+
+                // Stage per-frame uniforms (uploaded with the first draw; unchanged values are skipped)
+                // Pass light properties to shader
+                setUniform(refl, uniforms.lightPos, lightPosView);
+                setUniform(refl, uniforms.lightColor, snap.light.color);
+
+                // Pass in roughness and metallic
+                setUniform(refl, uniforms.roughness, snap.roughness);
+                setUniform(refl, uniforms.metallic, snap.metallic);
+
+                // Pass view matrix to shader
+                setUniform(refl, uniforms.viewMat, view);
+
+                // Pass projection matrix to shader
+                setUniform(refl, uniforms.projMat, projection);
+
+                // Shadow lookups happen in the shading pass (the lighting pass when deferred)
+                if (shadows) {
+                    ShaderReflection &shadeRefl = deferred ? lightingRefl : refl;
+                    SceneUniforms &shadeUniforms = deferred ? lightingUniforms : uniforms;
+                    setUniform(shadeRefl, shadeUniforms.shadowViewToWorld, glm::mat3(glm::inverse(view)));
+                    setUniform(shadeRefl, shadeUniforms.shadowParams, glm::vec2(1.0f / shadowMap.farZ, 0.01f));
+                }
+            }
+
+            // Depth pre-pass: positions only, no color; afterwards only the nearest surface passes GL_EQUAL
+            if (depthPrepass) {
+                PROFILE_CPU_ZONE("depth pre-pass");
+                PROFILE_GPU_ZONE("depth pre-pass");
+                useProgram(depthProgramID);
+                setUniform(depthRefl, depthUniforms.viewMat, view);
+                setUniform(depthRefl, depthUniforms.projMat, projection);
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                renderScene(meshGLVector, scene->mRootNode, glm::mat4(1.0f), depthRefl, depthUniforms, view, snap.rotAngle, 0, true);
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                setDepthFunc(GL_EQUAL);
+                setDepthMask(false);
+                useProgram(programID);
+            }
+
+            // Main drawing function
+            {
+                PROFILE_CPU_ZONE("traversal");
+                PROFILE_GPU_ZONE("draw");
+                renderScene(meshGLVector, scene->mRootNode, glm::mat4(1.0f), refl, uniforms, view, snap.rotAngle, 0);
+            }
+            if (depthPrepass) {
+                setDepthFunc(GL_LESS);
+                setDepthMask(true);
+            }
+
+            // Deferred: shade every covered pixel once from the G-buffer, then copy to the window
+            if (deferred) {
+                PROFILE_CPU_ZONE("deferred lighting");
+                PROFILE_GPU_ZONE("deferred lighting");
+                glBindFramebuffer(GL_FRAMEBUFFER, deferredTarget.FBO);
+                glClear(GL_COLOR_BUFFER_BIT);
+                useProgram(lightingProgramID);
+                setUniform(lightingRefl, lightingUniforms.lightPos, lightPosView);
+                setUniform(lightingRefl, lightingUniforms.lightColor, snap.light.color);
+                setUniform(lightingRefl, lightingUniforms.invProjMat, glm::inverse(projection));
+                flushUniforms(lightingRefl);
+                drawGBufferLighting(gbuffer, deferredTarget.FBO);
+
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, deferredTarget.FBO);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+                glBlitFramebuffer(0, 0, deferredTarget.width, deferredTarget.height, 0, 0, deferredTarget.width, deferredTarget.height,
+                                  GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            }
+
+            // Queue a readback of the finished frame (mapped and encoded a frame or two later)
+            if (snap.captureRequests != lastCaptureRequests) {
+                PROFILE_CPU_ZONE("capture");
+                requestFrameCapture(frameCapture, 0, GL_BACK, snap.fbWidth, snap.fbHeight);
+                lastCaptureRequests = snap.captureRequests;
+            }
+
+            // Clip recording: a clip ends when recording is toggled off or the window is resized
+            if (!snap.recording) recordingStopped = false;
+            if (streaming && (!snap.recording || snap.fbWidth != frameStream.width || snap.fbHeight != frameStream.height)) {
+                if (snap.recording) {
+                    cerr << "WARNING: Window resized; recording stopped (F11 twice starts a new clip)" << endl;
+                    recordingStopped = true;
+                }
+                closeFrameStream(frameStream);
+                printFrameStreamStats(frameStream);
+                streaming = false;
+            }
+            if (snap.recording && !streaming && !recordingStopped) {
+                streaming = openFrameStream(frameStream, makeRecordingTarget(), STREAM_Y4M, snap.fbWidth, snap.fbHeight,
+                                            max(1, (int)(getPacedFPS(pacer) + 0.5)));
+                if (streaming) cerr << "Recording to " << frameStream.target << endl;
+                else recordingStopped = true;
+            }
+            if (streaming) {
+                PROFILE_CPU_ZONE("record");
+                streamFrame(frameStream, 0, GL_BACK);
+            }
+
+            // Swap buffers (may block on vsync; the main thread keeps handling input)
+            {
+                PROFILE_CPU_ZONE("swap");
+                glfwSwapBuffers(window);
+            }
+
+            // Wait for next frame (if needed) and record frame time
+            endFrame(pacer);
+            endGLStateFrame();
+
+            // Collect this frame's profile zones
+            endProfileFrame();
+        }
 
-        // Create projection matrix
-        glm::mat4 projection = glm::perspective(glm::radians(90.0f), aspectRatio, 0.01f, 50.0f);
+        glfwMakeContextCurrent(NULL);
+    });
 
-        // Pass projection matrix to shader
-        glUniformMatrix4fv(projMatLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    // Main thread: event handling and simulation
+    while (!glfwWindowShouldClose(window)) {
+        // Wait briefly for input; callbacks only queue events
+        // (on-demand: block until something happens)
+        glfwWaitEventsTimeout(pacer.onDemand ? 0.5 : 0.004);
+
+        // Apply all queued input at once, then publish the updated state
+        if (!pacer.onDemand || takeInputPending(pacer)) {
+            applyInputEvents(window);
+            publishSceneSnapshot(window);
+            markFrameDirty(pacer);
+        }
+    }
 
-        // Main drawing function
-        renderScene(meshGLVector, scene->mRootNode, glm::mat4(1.0f), modelMatLoc, normMatLoc, view, 0);
+    // Stop the render thread (waking it if idle) and take the context back
+    renderRunning.store(false);
+    markFrameDirty(pacer);
+    renderThread.join();
+    glfwMakeContextCurrent(window);
+
+    // Report frame timing
+    printFrameStats(pacer);
+    printGLStateStats();
+    if (droppedInputEvents > 0) cout << "Dropped input events: " << droppedInputEvents << endl;
+
+    if (DEBUG_MODE) printShaderPermutationStats(shaderPerms);
+    cleanupShaderPermutations(shaderPerms);
+    cleanupBRDFLookup(brdfLUT);
+    if (shadowMap.cubeTex) {
+        if (DEBUG_MODE) printShadowMapStats(shadowMap);
+        cleanupShadowMapGL(shadowMap);
+    }
+    if (gbuffer.FBO) {
+        cleanupGBufferGL(gbuffer);
+        cleanupFramebufferGL(deferredTarget);
+    }
+    cleanupShaderHotReload();
+
+    // Finish pending screenshots (uses the texture pool) and the clip being recorded
+    printFrameCaptureStats(frameCapture);
+    cleanupFrameCapture(frameCapture);
+    if (streaming) {
+        closeFrameStream(frameStream);
+        printFrameStreamStats(frameStream);
+    }
 
-        // Swap buffers and poll for window events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    // Drop the arrays and any texture references they still hold, then the cache itself (waits for stray decodes)
+    if (DEBUG_MODE) {
+        printTextureCacheStats(textureCache);
+        printTextureArrayStats(textureArrays);
     }
+    cleanupTextureArrays(textureArrays);
+    cleanupTextureCache(textureCache);
+    stopThreadPool(texturePool);
+
+    // Report profile zones (and write CSV if requested)
+    finishProfiling();
+    cleanupGPUProfiler();
 
     // Clean up all MeshGL objects
     for (auto& mgl : meshGLVector) {
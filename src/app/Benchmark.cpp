@@ -0,0 +1,1123 @@
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+#include "MeshData.hpp"
+#include "MeshGLData.hpp"
+#include "GLSetup.hpp"
+#include "GLDebugOutput.hpp"
+#include "Shader.hpp"
+#include "ProgramCache.hpp"
+#include "ShaderCompileQueue.hpp"
+#include "ShaderPermutation.hpp"
+#include "FramePacing.hpp"
+#include "GLState.hpp"
+#include "FramebufferGL.hpp"
+#include "GBufferGL.hpp"
+#include "ShadowMapGL.hpp"
+#include "TextureCache.hpp"
+#include "TextureArrays.hpp"
+#include "FrameCapture.hpp"
+#include "FrameStream.hpp"
+#include "CaptureEncoder.hpp"
+#include "stb_image_write.h"
+#include "stb_image.h"
+#include "BRDFLookup.hpp"
+#include "ClusteredLights.hpp"
+#include "ThreadPool.hpp"
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtx/transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+#include "Utility.hpp"
+
+#define GLM_ENABLE_EXPERIMENTAL
+
+using namespace std;
+
+// Headless benchmark: renders the Assign07 PBR scene into an FBO along a scripted
+// camera path and reports frame-time percentiles, draw counts and triangle throughput as JSON.
+//
+// Usage: Benchmark [--frames N] [--warmup N] [--size WxH] [--path file] [--json file]
+//                  [--debug [--gl-debug off|sync|async ...]] [--no-shader-cache] [--compile-bench]
+//                  [--defines NAME[=VALUE],...] [--variant-bench] [--lights N]
+//                  [--deferred] [--overdraw N] [--depth-prepass] [--shadows [--shadow-every-frame]]
+//                  [--no-precompressed] [--no-texture-arrays]
+//                  [--capture-every N [--capture-dir dir] [--capture-sync] [--capture-format png|stb|qoi]]
+//                  [--encode-bench]
+//                  [--stream file.y4m|file.rgb|"|command" [--stream-raw] [--stream-fps N]] model
+// --defines picks the shaders/Common/Lit variant (default: LIGHTING_GGX,USE_METALLIC);
+// --variant-bench also times each variant in BENCH_VARIANTS from a fixed camera.
+// --lights N replaces the single light with N random point lights (clustered forward lighting).
+// --deferred renders a G-buffer and shades it in one full-screen pass (GGX variants only);
+// --overdraw N stacks N copies of the model back-to-front along the view direction.
+// --depth-prepass lays down depth with a position-only pass first; shading then uses GL_EQUAL.
+// --shadows adds a cached cube shadow map for the main light (GGX variants only); it is only
+// re-rendered when casters move (--overdraw copies follow the camera), unless --shadow-every-frame.
+// Base color textures stream in while the warmup/measured frames run (USE_ALBEDO_MAP is added
+// when the model has any); the JSON reports when the first frame and the last texture were done.
+// KTX2/DDS files next to the images (see TextureCompressor) are used unless --no-precompressed.
+// Textures are packed into texture arrays selected per draw by material index (USE_TEXTURE_ARRAYS);
+// --no-texture-arrays binds each mesh's own texture before its draw instead.
+// --capture-every N saves every Nth measured frame as a PNG through the asynchronous readback
+// ring (FrameCapture.hpp); --capture-sync reads back and encodes inline instead, for comparison.
+// --capture-format picks the encoder (CaptureEncoder.hpp: parallel-strip PNG by default).
+// --encode-bench times every capture encoder on the last frame (run it with --size 3840x2160).
+// --stream writes every measured frame to a Y4M clip (raw rgb24 with --stream-raw or a .rgb/.raw
+// name) through the readback ring and writer thread of FrameStream.hpp; "|command" pipes it
+// (e.g. "|ffmpeg -i - clip.mp4"). Dropped frames are reported and in the JSON.
+
+// Struct for Point Light
+struct PointLight {
+    glm::vec4 pos;
+    glm::vec4 color;
+};
+
+// Camera keyframe
+struct CameraKey {
+    glm::vec3 eye;
+    glm::vec3 lookAt;
+};
+
+// Per-frame counters
+struct DrawCounts {
+    long long drawCalls = 0;
+    long long triangles = 0;
+};
+
+// Variants compared by --variant-bench (fragment shading cost on this renderer)
+const vector<vector<string>> BENCH_VARIANTS = {
+    { "LIGHTING_UNLIT" },
+    { "LIGHTING_PHONG" },
+    { "LIGHTING_GGX", "USE_METALLIC" },
+    { "LIGHTING_GGX", "USE_METALLIC", "STRIP_DEAD_PHONG" },
+    { "LIGHTING_GGX", "USE_METALLIC", "USE_BRDF_LUT" },
+    { "LIGHTING_GGX", "USE_METALLIC", "USE_BRDF_LUT", "STRIP_DEAD_PHONG" }
+};
+
+// Depth pre-pass variant (position-only vertex stream, no color output)
+const vector<string> DEPTH_PREPASS_DEFINES = { "LIGHTING_UNLIT", "DEPTH_ONLY" };
+
+// Shadow map faces (position-only, linear distance as depth)
+const vector<string> SHADOW_PASS_DEFINES = { "LIGHTING_UNLIT", "DEPTH_ONLY", "SHADOW_PASS" };
+
+// Result for one variant
+struct VariantCost {
+    string name;
+    double meanMS = 0.0;
+    long long coveredPixels = 0;
+};
+
+// Result for one capture encoder
+struct EncoderCost {
+    string name;
+    double ms = 0.0;            // Best of the runs
+    size_t bytes = 0;
+    bool roundTrip = false;     // Decodes to the same pixels (PNG encoders; stb_image cannot read QOI)
+};
+
+// Uniform handles (resolved once after linking)
+struct SceneUniforms {
+    UniformHandle<glm::mat4> modelMat;
+    UniformHandle<glm::mat4> viewMat;
+    UniformHandle<glm::mat4> projMat;
+    UniformHandle<glm::mat3> normMat;
+    UniformHandle<glm::vec4> lightPos;
+    UniformHandle<glm::vec4> lightColor;
+    UniformHandle<float> roughness;
+    UniformHandle<float> metallic;
+    UniformHandle<glm::mat4> invProjMat;
+    UniformHandle<glm::mat3> shadowViewToWorld;
+    UniformHandle<int> materialIndex;
+};
+
+void extractMeshData(aiMesh *mesh, Mesh &m, glm::vec4 color) {
+    // Clear out the Mesh's vertices and indices
+    m.vertices.clear();
+    m.indices.clear();
+
+    // Loop through all vertices in the aiMesh
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+        Vertex vertex;
+
+        // Convert aiVector3D to glm::vec3 for position
+        aiVector3D aiPos = mesh->mVertices[i];
+        vertex.position = glm::vec3(aiPos.x, aiPos.y, aiPos.z);
+
+        // Convert aiVector3D to glm::vec3 for normal
+        aiVector3D aiNorm = mesh->mNormals[i];
+        vertex.normal = glm::vec3(aiNorm.x, aiNorm.y, aiNorm.z);
+
+        // Same yellow (white when textured) as Assign07
+        vertex.color = color;
+        if (mesh->HasTextureCoords(0)) {
+            aiVector3D aiUV = mesh->mTextureCoords[0][i];
+            vertex.texcoord = glm::vec2(aiUV.x, aiUV.y);
+        }
+
+        // Add the Vertex to the Mesh's vertices list
+        m.vertices.push_back(vertex);
+    }
+
+    // Loop through all faces in the aiMesh
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        aiFace face = mesh->mFaces[i];
+        for (unsigned int j = 0; j < face.mNumIndices; j++) {
+            m.indices.push_back(face.mIndices[j]);
+        }
+    }
+}
+
+// Grow bounding box by every vertex of the scene (in world space)
+void computeSceneBounds(const aiScene *scene, aiNode *node, glm::mat4 parentMat, glm::vec3 &minB, glm::vec3 &maxB) {
+    glm::mat4 nodeT;
+    aiMatToGLM4(node->mTransformation, nodeT);
+    glm::mat4 modelMat = parentMat * nodeT;
+
+    for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+        for (unsigned int v = 0; v < mesh->mNumVertices; v++) {
+            aiVector3D p = mesh->mVertices[v];
+            glm::vec3 wp = glm::vec3(modelMat * glm::vec4(p.x, p.y, p.z, 1.0f));
+            minB = glm::min(minB, wp);
+            maxB = glm::max(maxB, wp);
+        }
+    }
+
+    for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+        computeSceneBounds(scene, node->mChildren[i], modelMat, minB, maxB);
+    }
+}
+
+// Base color textures per mesh (empty for untextured models): either a material table
+// index into the texture arrays, or (--no-texture-arrays) the texture itself
+TextureCache textureCache;
+TextureArrays textureArrays;
+bool useTextureArrays = false;
+vector<int> meshMaterials;
+vector<Texture*> meshTextures;
+
+void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, ShaderReflection &refl, SceneUniforms &uniforms, glm::mat4 viewMat, DrawCounts &counts, bool depthOnly = false) {
+    // Get transformation for the current node
+    glm::mat4 nodeT;
+    aiMatToGLM4(node->mTransformation, nodeT);
+
+    // Compute current model matrix
+    glm::mat4 modelMat = parentMat * nodeT;
+
+    if (node->mNumMeshes > 0) {
+        // Calculate the normal matrix
+        glm::mat3 normMat = glm::transpose(glm::inverse(glm::mat3(viewMat * modelMat)));
+
+        // Pass matrices to shader
+        setUniform(refl, uniforms.normMat, normMat);
+        setUniform(refl, uniforms.modelMat, modelMat);
+        flushUniforms(refl);
+
+        // Render each mesh in the node
+        for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+            MeshGL &mgl = allMeshes.at(node->mMeshes[i]);
+            if (depthOnly) drawMeshDepth(mgl);
+            else {
+                if (!meshMaterials.empty()) {
+                    setUniform(refl, uniforms.materialIndex, meshMaterials.at(node->mMeshes[i]));
+                    flushUniforms(refl);
+                }
+                else if (!meshTextures.empty()) bindCachedTexture(textureCache, meshTextures.at(node->mMeshes[i]));
+                drawMesh(mgl);
+            }
+            counts.drawCalls++;
+            counts.triangles += mgl.indexCnt / 3;
+        }
+    }
+
+    // Render each child node recursively
+    for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+        renderScene(allMeshes, node->mChildren[i], modelMat, refl, uniforms, viewMat, counts, depthOnly);
+    }
+}
+
+// Draw the scene copyCnt times, farthest copy first, each one spacing further along viewDir
+// (worst case for forward shading: every nearer copy shades over the ones behind it)
+void renderOverdrawScene(vector<MeshGL> &allMeshes, const aiScene *scene, ShaderReflection &refl, SceneUniforms &uniforms, glm::mat4 viewMat,
+                         glm::vec3 viewDir, float spacing, int copyCnt, DrawCounts &counts, bool depthOnly = false) {
+    for (int i = copyCnt - 1; i >= 0; i--) {
+        glm::mat4 offset = glm::translate(glm::mat4(1.0f), viewDir * (spacing * i));
+        renderScene(allMeshes, scene->mRootNode, offset, refl, uniforms, viewMat, counts, depthOnly);
+    }
+}
+
+// Default path: orbit around the scene bounds, bobbing up and down
+vector<CameraKey> makeOrbitPath(glm::vec3 center, float radius) {
+    vector<CameraKey> path;
+    const int keyCnt = 8;
+    for (int i = 0; i <= keyCnt; i++) {
+        float angle = glm::radians(360.0f * i / keyCnt);
+        float height = (i % 2 == 0) ? 0.5f : -0.25f;
+        CameraKey key;
+        key.eye = center + radius * glm::vec3(sin(angle) * 2.0f, height, cos(angle) * 2.0f);
+        key.lookAt = center;
+        path.push_back(key);
+    }
+    return path;
+}
+
+// Load keyframes: one "ex ey ez lx ly lz" per line ('#' starts a comment)
+vector<CameraKey> loadCameraPath(string filename) {
+    string allS = readFileToString(filename);
+    istringstream lines(allS);
+    vector<CameraKey> path;
+    string line;
+    while (getline(lines, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream ss(line);
+        CameraKey key;
+        if (ss >> key.eye.x >> key.eye.y >> key.eye.z >> key.lookAt.x >> key.lookAt.y >> key.lookAt.z) {
+            path.push_back(key);
+        }
+    }
+    if (path.size() < 2) {
+        throw runtime_error("Camera path needs at least two keyframes: " + filename);
+    }
+    return path;
+}
+
+// Interpolate along the path (t in [0,1])
+CameraKey sampleCameraPath(vector<CameraKey> &path, float t) {
+    float f = t * (path.size() - 1);
+    int i = min((int)f, (int)path.size() - 2);
+    float u = f - i;
+    CameraKey key;
+    key.eye = glm::mix(path[i].eye, path[i + 1].eye, u);
+    key.lookAt = glm::mix(path[i].lookAt, path[i + 1].lookAt, u);
+    return key;
+}
+
+// Pixels that differ from the clear color (0.2, 0.2, 0.4)
+long long countCoveredPixels(FramebufferGL &fb) {
+    vector<unsigned char> pixels;
+    readFramebufferRGBA(fb, pixels);
+    long long coveredPixels = 0;
+    unsigned char clearR = (unsigned char)(0.2f * 255.0f + 0.5f);
+    unsigned char clearB = (unsigned char)(0.4f * 255.0f + 0.5f);
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        if (abs(pixels[i] - clearR) > 2 || abs(pixels[i + 2] - clearB) > 2) coveredPixels++;
+    }
+    return coveredPixels;
+}
+
+// Reflect program, resolve the scene's uniform handles and stage the fixed ones
+void setupSceneUniforms(GLuint programID, ShaderReflection &refl, SceneUniforms &uniforms, glm::mat4 projection, PointLight light, float roughness, float metallic) {
+    reflectShaderProgram(programID, refl);
+    uniforms.modelMat = getUniform<glm::mat4>(refl, "modelMat");
+    uniforms.viewMat = getUniform<glm::mat4>(refl, "viewMat");
+    uniforms.projMat = getUniform<glm::mat4>(refl, "projMat");
+    uniforms.normMat = getUniform<glm::mat3>(refl, "normMat");
+    uniforms.lightPos = getUniform<glm::vec4>(refl, "light.pos");
+    uniforms.lightColor = getUniform<glm::vec4>(refl, "light.color");
+    uniforms.roughness = getUniform<float>(refl, "roughness");
+    uniforms.metallic = getUniform<float>(refl, "metallic");
+    if (useTextureArrays) uniforms.materialIndex = getUniform<int>(refl, "materialIndex");
+
+    setUniform(refl, uniforms.projMat, projection);
+    setUniform(refl, uniforms.lightColor, light.color);
+    setUniform(refl, uniforms.roughness, roughness);
+    setUniform(refl, uniforms.metallic, metallic);
+}
+
+// Same for the deferred lighting pass (it only sees the light and the projection)
+void setupLightingUniforms(GLuint programID, ShaderReflection &refl, SceneUniforms &uniforms, glm::mat4 projection, PointLight light) {
+    reflectShaderProgram(programID, refl);
+    uniforms.lightPos = getUniform<glm::vec4>(refl, "light.pos");
+    uniforms.lightColor = getUniform<glm::vec4>(refl, "light.color");
+    uniforms.invProjMat = getUniform<glm::mat4>(refl, "invProjMat");
+
+    setUniform(refl, uniforms.lightColor, light.color);
+    setUniform(refl, uniforms.invProjMat, glm::inverse(projection));
+}
+
+// Same for the depth pre-pass (transforms only)
+void setupDepthUniforms(GLuint programID, ShaderReflection &refl, SceneUniforms &uniforms, glm::mat4 projection) {
+    reflectShaderProgram(programID, refl);
+    uniforms.modelMat = getUniform<glm::mat4>(refl, "modelMat");
+    uniforms.viewMat = getUniform<glm::mat4>(refl, "viewMat");
+    uniforms.projMat = getUniform<glm::mat4>(refl, "projMat");
+
+    setUniform(refl, uniforms.projMat, projection);
+}
+
+// Render the six faces of the shadow map from the light (depth only; caller restores its target)
+void renderShadowMap(ShadowMapGL &sm, GLuint programID, ShaderReflection &refl, SceneUniforms &uniforms, vector<MeshGL> &allMeshes,
+                     const aiScene *scene, glm::vec3 lightPos, glm::vec3 viewDir, float spacing, int copyCnt, DrawCounts &counts) {
+    useProgram(programID);
+    setUniform(refl, uniforms.projMat, getShadowProjection(sm));
+    for (int face = 0; face < 6; face++) {
+        glm::mat4 faceView = getShadowFaceView(lightPos, face);
+        beginShadowFace(sm, face);
+        setUniform(refl, uniforms.viewMat, faceView);
+        renderOverdrawScene(allMeshes, scene, refl, uniforms, faceView, viewDir, spacing, copyCnt, counts, true);
+    }
+}
+
+// Time every variant in BENCH_VARIANTS from the path's first camera (so each one shades the same pixels)
+vector<VariantCost> runVariantBenchmark(ShaderPermutationSet &perms, vector<MeshGL> &allMeshes, const aiScene *scene, FramebufferGL &fb,
+                                        CameraKey key, glm::mat4 projection, PointLight light, float roughness, float metallic, int frameCnt, int warmupCnt) {
+    vector<VariantCost> costs;
+    glm::mat4 view = glm::lookAt(key.eye, key.lookAt, glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::vec4 lightPosView = view * light.pos;
+
+    for (const vector<string> &defines : BENCH_VARIANTS) {
+        GLuint programID = getShaderVariant(perms, defines);
+        useProgram(programID);
+        ShaderReflection refl;
+        SceneUniforms uniforms;
+        setupSceneUniforms(programID, refl, uniforms, projection, light, roughness, metallic);
+        setUniform(refl, uniforms.viewMat, view);
+        setUniform(refl, uniforms.lightPos, lightPosView);
+
+        vector<float> frameTimesMS;
+        for (int f = -warmupCnt; f < frameCnt; f++) {
+            auto frameStart = chrono::steady_clock::now();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            DrawCounts counts;
+            renderScene(allMeshes, scene->mRootNode, glm::mat4(1.0f), refl, uniforms, view, counts);
+            glFinish();
+            endGLStateFrame();
+            chrono::duration<float, milli> frameTime = chrono::steady_clock::now() - frameStart;
+            if (f >= 0) frameTimesMS.push_back(frameTime.count());
+        }
+
+        VariantCost cost;
+        cost.name = getShaderDefinesKey(defines);
+        cost.meanMS = computeFrameStats(frameTimesMS).meanMS;
+        cost.coveredPixels = countCoveredPixels(fb);
+        costs.push_back(cost);
+    }
+    return costs;
+}
+
+// Time stbi_write_png against CaptureEncoder's PNG (one strip, then strips on the pool) and QOI
+// on the same top-down RGBA image; best of runCnt runs each
+vector<EncoderCost> runEncodeBenchmark(const vector<unsigned char> &pixels, int width, int height, ThreadPool &pool, int runCnt) {
+    struct Encoder {
+        string name;
+        CaptureFormat format;
+        ThreadPool *pool;
+    };
+    vector<Encoder> encoders = {
+        { "stbi_write_png", CAPTURE_PNG_STB, nullptr },
+        { "png_1_thread", CAPTURE_PNG, nullptr },
+        { "png_" + to_string(pool.workers.size() + 1) + "_threads", CAPTURE_PNG, &pool },
+        { "qoi", CAPTURE_QOI, nullptr }
+    };
+
+    vector<EncoderCost> costs;
+    vector<unsigned char> encoded;
+    for (Encoder &encoder : encoders) {
+        EncoderCost cost;
+        cost.name = encoder.name;
+        for (int run = 0; run < runCnt; run++) {
+            auto start = chrono::steady_clock::now();
+            encodeCaptureImage(encoder.format, pixels.data(), width, height, 4, encoded, encoder.pool);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            cost.ms = (run == 0) ? ms : min(cost.ms, ms);
+        }
+        cost.bytes = encoded.size();
+        if (encoder.format != CAPTURE_QOI) {
+            int w = 0, h = 0, comp = 0;
+            unsigned char *decoded = stbi_load_from_memory(encoded.data(), (int)encoded.size(), &w, &h, &comp, 4);
+            cost.roundTrip = decoded && w == width && h == height && memcmp(decoded, pixels.data(), pixels.size()) == 0;
+            stbi_image_free(decoded);
+        }
+        costs.push_back(cost);
+    }
+    return costs;
+}
+
+// Stress scene: count random point lights in and around the bounds (fixed seed, so runs compare)
+vector<ClusterLight> makeRandomLights(int count, glm::vec3 minB, glm::vec3 maxB, float radius) {
+    mt19937 rng(450);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    glm::vec3 margin(radius);
+    float lightRadius = 0.2f * radius;
+
+    vector<ClusterLight> lights;
+    for (int i = 0; i < count; i++) {
+        glm::vec3 t(unit(rng), unit(rng), unit(rng));
+        glm::vec3 pos = (minB - margin) + t * ((maxB + margin) - (minB - margin));
+        glm::vec3 color(unit(rng), unit(rng), unit(rng));
+
+        // Bright enough that the falloff (1 / (d^2 + 1)) still shows at a fraction of the radius
+        ClusterLight light;
+        light.posRadius = glm::vec4(pos, lightRadius);
+        light.color = glm::vec4(color * (1.0f + 0.1f * lightRadius * lightRadius), 1.0f);
+        lights.push_back(light);
+    }
+    return lights;
+}
+
+// Compile every shaders/<app>/Basic.vs/.fs pair (plus each lighting variant of
+// shaders/Common/Lit.vs/.fs) once serially and once through the
+// compile queue; returns wall times (ms). A per-pass comment makes each source unique,
+// so neither our program cache nor the driver's own shader cache can serve it.
+void runCompileBenchmark(int &programCnt, double &serialMS, double &queuedMS) {
+    vector<pair<string, string>> sources;
+    for (auto &entry : filesystem::directory_iterator("./shaders")) {
+        filesystem::path vs = entry.path() / "Basic.vs";
+        filesystem::path fs = entry.path() / "Basic.fs";
+        if (filesystem::exists(vs) && filesystem::exists(fs)) {
+            sources.push_back({ readFileToString(vs.string()), readFileToString(fs.string()) });
+        }
+    }
+    ShaderPermutationSet litPerms;
+    loadShaderPermutations(litPerms, "./shaders/Common/Lit.vs", "./shaders/Common/Lit.fs");
+    for (string lighting : { "LIGHTING_UNLIT", "LIGHTING_PHONG", "LIGHTING_GGX" }) {
+        string vertexCode, fragCode;
+        getShaderVariantSource(litPerms, { lighting }, vertexCode, fragCode);
+        sources.push_back({ vertexCode, fragCode });
+    }
+    programCnt = (int)sources.size();
+    string nonce = to_string(chrono::steady_clock::now().time_since_epoch().count());
+
+    // Serial: compile + link + status check, one program after another
+    auto start = chrono::steady_clock::now();
+    for (auto &src : sources) {
+        string tag = "\n// serial " + nonce + "\n";
+        GLuint programID = initShaderProgramFromSource(src.first + tag, src.second + tag);
+        deleteProgram(programID);
+    }
+    serialMS = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    // Queued: submit everything, then poll
+    start = chrono::steady_clock::now();
+    ShaderCompileQueue queue;
+    for (size_t i = 0; i < sources.size(); i++) {
+        string tag = "\n// queued " + nonce + "\n";
+        queueProgramCompile(queue, "program " + to_string(i), sources[i].first + tag, sources[i].second + tag);
+    }
+    waitShaderCompileQueue(queue);
+    queuedMS = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    for (size_t i = 0; i < queue.jobs.size(); i++) {
+        GLuint programID = getCompiledProgram(queue, (int)i);
+        deleteProgram(programID);
+    }
+}
+
+// Main
+int main(int argc, char **argv) {
+    // Benchmark options
+    int frameCnt = 300;
+    int warmupCnt = 10;
+    int width = 1280;
+    int height = 720;
+    string pathFile, jsonFile, value;
+    if (consumeOption(argc, argv, "--frames", value)) frameCnt = max(1, atoi(value.c_str()));
+    if (consumeOption(argc, argv, "--warmup", value)) warmupCnt = max(0, atoi(value.c_str()));
+    if (consumeOption(argc, argv, "--size", value)) sscanf(value.c_str(), "%dx%d", &width, &height);
+    consumeOption(argc, argv, "--path", pathFile);
+    consumeOption(argc, argv, "--json", jsonFile);
+    bool debugging = consumeFlag(argc, argv, "--debug");
+    bool compileBench = consumeFlag(argc, argv, "--compile-bench");
+    bool variantBench = consumeFlag(argc, argv, "--variant-bench");
+    int lightCnt = 0;
+    if (consumeOption(argc, argv, "--lights", value)) lightCnt = max(0, atoi(value.c_str()));
+    bool deferred = consumeFlag(argc, argv, "--deferred");
+    int overdrawCnt = 1;
+    if (consumeOption(argc, argv, "--overdraw", value)) overdrawCnt = max(1, atoi(value.c_str()));
+    bool depthPrepass = consumeFlag(argc, argv, "--depth-prepass");
+    bool shadows = consumeFlag(argc, argv, "--shadows");
+    bool shadowEveryFrame = consumeFlag(argc, argv, "--shadow-every-frame");
+    bool noPrecompressed = consumeFlag(argc, argv, "--no-precompressed");
+    bool noTextureArrays = consumeFlag(argc, argv, "--no-texture-arrays");
+    int captureEvery = 0;
+    string captureDir = "benchmark_captures";
+    if (consumeOption(argc, argv, "--capture-every", value)) captureEvery = max(0, atoi(value.c_str()));
+    consumeOption(argc, argv, "--capture-dir", captureDir);
+    bool captureSync = consumeFlag(argc, argv, "--capture-sync");
+    CaptureFormat captureFormat = CAPTURE_PNG;
+    if (consumeOption(argc, argv, "--capture-format", value) && !parseCaptureFormat(value, captureFormat)) {
+        cerr << "ERROR: Unknown capture format " << value << " (png, stb or qoi)." << endl;
+        return EXIT_FAILURE;
+    }
+    bool encodeBench = consumeFlag(argc, argv, "--encode-bench");
+    string streamTarget;
+    consumeOption(argc, argv, "--stream", streamTarget);
+    bool streamRaw = consumeFlag(argc, argv, "--stream-raw");
+    int streamFPS = 60;
+    if (consumeOption(argc, argv, "--stream-fps", value)) streamFPS = max(1, atoi(value.c_str()));
+    if (streamTarget == "-") {
+        cerr << "ERROR: --stream - is not supported here (the JSON goes to stdout); use \"|command\" instead." << endl;
+        return EXIT_FAILURE;
+    }
+    if (!streamTarget.empty()) {
+        string ext = filesystem::path(streamTarget).extension().string();
+        if (ext == ".rgb" || ext == ".raw") streamRaw = true;
+    }
+    vector<string> defines = { "LIGHTING_GGX", "USE_METALLIC" };
+    if (consumeOption(argc, argv, "--defines", value)) {
+        defines.clear();
+        stringstream list(value);
+        string define;
+        while (getline(list, define, ',')) {
+            if (!define.empty()) defines.push_back(define);
+        }
+    }
+    if (lightCnt > 0) defines.push_back("CLUSTERED_LIGHTS");
+    if (shadows) defines.push_back("USE_SHADOWS");
+
+    // Deferred: the geometry pass only needs the material inputs; the chosen variant shades the G-buffer
+    bool useMetallic = find(defines.begin(), defines.end(), "USE_METALLIC") != defines.end();
+    vector<string> geometryDefines = defines;
+    vector<string> lightingDefines;
+    if (deferred) {
+        geometryDefines = { "LIGHTING_GGX", "GBUFFER_PASS" };
+        if (useMetallic) geometryDefines.push_back("USE_METALLIC");
+        for (string &define : defines) {
+            if (define != "USE_METALLIC") lightingDefines.push_back(define);
+        }
+        lightingDefines.push_back("DEFERRED_LIGHTING");
+    }
+    parseGLDebugArgs(argc, argv);
+    parseProgramCacheArgs(argc, argv);
+
+    string modelPath = "sampleModels/teapot.obj";
+    if (argc >= 2) {
+        modelPath = argv[1];
+    }
+
+    // Offscreen context
+    HeadlessGL ctx;
+    if (!setupHeadlessGL(ctx, 4, 3, debugging)) {
+        cerr << "ERROR: Could not create a headless OpenGL context." << endl;
+        return EXIT_FAILURE;
+    }
+    checkOpenGLVersion();
+    if (debugging) checkAndSetupOpenGLDebugging();
+    string renderer = (const char*)glGetString(GL_RENDERER);
+
+    // Serial vs. queued shader compile times
+    int compileProgramCnt = 0;
+    double compileSerialMS = 0.0, compileQueuedMS = 0.0;
+    if (compileBench) {
+        bool cacheWasEnabled = isProgramCacheActive();
+        setProgramCacheEnabled(false);
+        try {
+            runCompileBenchmark(compileProgramCnt, compileSerialMS, compileQueuedMS);
+        }
+        catch (exception &e) {
+            cerr << "ERROR: " << e.what() << endl;
+            cleanupHeadlessGL(ctx);
+            return EXIT_FAILURE;
+        }
+        setProgramCacheEnabled(cacheWasEnabled);
+    }
+
+    // Load the model using Assimp
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(modelPath,
+        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
+
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        cerr << "ERROR: Failed to load model: " << modelPath << endl;
+        cleanupHeadlessGL(ctx);
+        return EXIT_FAILURE;
+    }
+
+    // Textures decode on the pool from here on (while the shaders compile and the first frames render)
+    ThreadPool pool;
+    startThreadPool(pool);
+    setupTextureCache(textureCache, pool);
+    if (noPrecompressed) textureCache.preferCompressed = false;
+    auto textureStart = chrono::steady_clock::now();
+    bool textured = false;
+    vector<bool> meshTextured;
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        Texture *texture = acquireMaterialTexture(textureCache, scene, scene->mMeshes[i]->mMaterialIndex, modelPath);
+        meshTextures.push_back(texture);
+        meshTextured.push_back(texture != nullptr);
+        if (texture) textured = true;
+    }
+    if (textured) {
+        defines.push_back("USE_ALBEDO_MAP");
+        if (deferred) geometryDefines.push_back("USE_ALBEDO_MAP");
+        useTextureArrays = !noTextureArrays;
+        if (useTextureArrays) {
+            // The material table takes over the references
+            setupTextureArrays(textureArrays, textureCache);
+            for (Texture *texture : meshTextures) meshMaterials.push_back(addTextureMaterial(textureArrays, texture));
+            meshTextures.clear();
+            defines.push_back("USE_TEXTURE_ARRAYS");
+            if (deferred) geometryDefines.push_back("USE_TEXTURE_ARRAYS");
+        }
+        if (!deferred) geometryDefines = defines;
+    }
+    else {
+        meshTextures.clear();
+    }
+
+    // Create and load shaders
+    ShaderPermutationSet shaderPerms;
+    GLuint programID = 0;
+    GLuint lightingProgramID = 0;
+    GLuint depthProgramID = 0;
+    GLuint shadowProgramID = 0;
+    try {
+        loadShaderPermutations(shaderPerms, "./shaders/Common/Lit.vs", "./shaders/Common/Lit.fs");
+        programID = getShaderVariant(shaderPerms, geometryDefines);
+        if (deferred) lightingProgramID = getShaderVariant(shaderPerms, lightingDefines);
+        if (depthPrepass) depthProgramID = getShaderVariant(shaderPerms, DEPTH_PREPASS_DEFINES);
+        if (shadows) shadowProgramID = getShaderVariant(shaderPerms, SHADOW_PASS_DEFINES);
+    }
+    catch (exception &e) {
+        cerr << "ERROR: " << e.what() << endl;
+        stopThreadPool(pool);
+        cleanupHeadlessGL(ctx);
+        return EXIT_FAILURE;
+    }
+
+    // Upload meshes
+    vector<MeshGL> meshGLVector;
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        Mesh m;
+        extractMeshData(scene->mMeshes[i], m, meshTextured[i] ? glm::vec4(1.0f) : glm::vec4(1.0f, 1.0f, 0.0f, 1.0f));
+        MeshGL mgl;
+        createMeshGL(m, mgl);
+        meshGLVector.push_back(mgl);
+    }
+
+    // Camera path (scripted or default orbit)
+    glm::vec3 minB(1e30f), maxB(-1e30f);
+    computeSceneBounds(scene, scene->mRootNode, glm::mat4(1.0f), minB, maxB);
+    glm::vec3 center = 0.5f * (minB + maxB);
+    float radius = max(0.5f * glm::length(maxB - minB), 0.001f);
+
+    vector<CameraKey> path;
+    try {
+        path = pathFile.empty() ? makeOrbitPath(center, radius) : loadCameraPath(pathFile);
+    }
+    catch (exception &e) {
+        cerr << "ERROR: " << e.what() << endl;
+        stopThreadPool(pool);
+        cleanupHeadlessGL(ctx);
+        return EXIT_FAILURE;
+    }
+
+    // Offscreen render target
+    FramebufferGL fb;
+    GBufferGL gbuffer;
+    try {
+        createFramebufferGL(fb, width, height);
+        if (deferred) createGBufferGL(gbuffer, width, height);
+    }
+    catch (exception &e) {
+        cerr << "ERROR: " << e.what() << endl;
+        stopThreadPool(pool);
+        cleanupHeadlessGL(ctx);
+        return EXIT_FAILURE;
+    }
+
+    // Fixed render state (as in Assign07, with the light placed relative to the model)
+    PointLight light;
+    light.pos = glm::vec4(center + radius * glm::vec3(1.0f, 1.0f, 1.0f), 1.0f);
+    light.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    float metallic = 0.0f;
+    float roughness = 0.3f;
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), (float)width / (float)height, 0.01f * radius, 50.0f * radius);
+
+    // Split-sum table for the USE_BRDF_LUT variants (BRDF_LOOKUP_UNIT)
+    BRDFLookup brdfLUT;
+    if (variantBench || find(defines.begin(), defines.end(), "USE_BRDF_LUT") != defines.end()) {
+        createBRDFLookup(brdfLUT);
+        bindBRDFLookup(brdfLUT);
+    }
+
+    useProgram(programID);
+    ShaderReflection refl;
+    SceneUniforms uniforms;
+    setupSceneUniforms(programID, refl, uniforms, projection, light, roughness, metallic);
+    if (!refl.missingUniforms.empty() || !refl.mismatchedUniforms.empty()) printShaderReflection(refl);
+
+    // Lights and cluster lookup go to whichever program shades (the lighting pass when deferred)
+    ShaderReflection lightingRefl;
+    SceneUniforms lightingUniforms;
+    if (deferred) setupLightingUniforms(lightingProgramID, lightingRefl, lightingUniforms, projection, light);
+    ShaderReflection &shadeRefl = deferred ? lightingRefl : refl;
+    SceneUniforms &shadeUniforms = deferred ? lightingUniforms : uniforms;
+
+    ShaderReflection depthRefl;
+    SceneUniforms depthUniforms;
+    if (depthPrepass) setupDepthUniforms(depthProgramID, depthRefl, depthUniforms, projection);
+
+    // Cached shadow map: covers the scene's surroundings; bias scales with the model
+    ShadowMapGL shadowMap;
+    ShaderReflection shadowRefl;
+    SceneUniforms shadowUniforms;
+    if (shadows) {
+        try {
+            createShadowMapGL(shadowMap, 1024, 0.01f * radius, 10.0f * radius);
+        }
+        catch (exception &e) {
+            cerr << "ERROR: " << e.what() << endl;
+            stopThreadPool(pool);
+            cleanupHeadlessGL(ctx);
+            return EXIT_FAILURE;
+        }
+        bindShadowMap(shadowMap);
+        setupDepthUniforms(shadowProgramID, shadowRefl, shadowUniforms, getShadowProjection(shadowMap));
+        setUniform(shadowRefl, getUniform<float>(shadowRefl, "shadowFar"), shadowMap.farZ);
+        shadeUniforms.shadowViewToWorld = getUniform<glm::mat3>(shadeRefl, "shadowViewToWorld");
+        setUniform(shadeRefl, getUniform<glm::vec2>(shadeRefl, "shadowParams"), glm::vec2(1.0f / shadowMap.farZ, 0.01f * radius));
+    }
+
+    // Many-light stress scene: froxel grid over the projection, lights assigned on the pool each frame
+    ClusteredLights clusters;
+    vector<ClusterLight> sceneLights;
+    double assignTotalMS = 0.0;
+    double meanClusterLights = 0.0;
+    int maxClusterLights = 0;
+    if (lightCnt > 0) {
+        setupClusteredLights(clusters);
+        setClusterProjection(clusters, projection, 0.01f * radius, 50.0f * radius);
+        sceneLights = makeRandomLights(lightCnt, minB, maxB, radius);
+        setUniform(shadeRefl, getUniform<glm::ivec3>(shadeRefl, "clusterDims"), glm::ivec3(clusters.tilesX, clusters.tilesY, clusters.slices));
+        setUniform(shadeRefl, getUniform<glm::vec4>(shadeRefl, "clusterScale"), getClusterScale(clusters, width, height));
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fb.FBO);
+    setViewport(0, 0, width, height);
+    setDepthTest(true);
+    glClearColor(0.2f, 0.2f, 0.4f, 1.0f);
+
+    // Frame captures go to the pool too (encoding overlaps the following frames)
+    FrameCapture frameCapture;
+    if (captureEvery > 0) setupFrameCapture(frameCapture, pool, captureDir, "Benchmark");
+    frameCapture.format = captureFormat;
+    int syncCaptureCnt = 0;
+
+    // Every measured frame streamed to a clip (conversion and writing on the stream's own thread)
+    FrameStream frameStream;
+    bool streaming = false;
+    if (!streamTarget.empty()) {
+        streaming = openFrameStream(frameStream, streamTarget, streamRaw ? STREAM_RAW_RGB : STREAM_Y4M, width, height, streamFPS);
+        if (!streaming) {
+            if (captureEvery > 0) cleanupFrameCapture(frameCapture);
+            stopThreadPool(pool);
+            cleanupHeadlessGL(ctx);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Render warmup + measured frames; glFinish() so each sample includes GPU time
+    vector<float> frameTimesMS;
+    DrawCounts counts;
+    double firstFrameMS = -1.0;
+    double texturesReadyMS = -1.0;
+    int texturesReadyFrame = -1;
+    auto benchStart = chrono::steady_clock::now();
+    for (int f = -warmupCnt; f < frameCnt; f++) {
+        auto frameStart = chrono::steady_clock::now();
+        if (captureEvery > 0) updateFrameCapture(frameCapture);
+
+        // Whatever finished decoding since the last frame (the rest draw white meanwhile)
+        if (textured && texturesReadyFrame < 0) {
+            updateTextureCache(textureCache);
+            if (useTextureArrays) {
+                updateTextureArrays(textureArrays);
+                bindTextureArrays(textureArrays);
+            }
+        }
+
+        CameraKey key = sampleCameraPath(path, (frameCnt > 1) ? (float)max(f, 0) / (frameCnt - 1) : 0.0f);
+        glm::mat4 view = glm::lookAt(key.eye, key.lookAt, glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::vec4 lightPosView = view * light.pos;
+
+        glm::vec3 viewDir = glm::normalize(key.lookAt - key.eye);
+
+        // Shadow map: only when casters moved (the overdraw copies follow the camera)
+        if (shadows) {
+            uint64_t casterVersion = (overdrawCnt > 1) ? (uint64_t)(f + warmupCnt) : 0;
+            if (shadowEveryFrame) invalidateShadowMap(shadowMap);
+            if (isShadowMapStale(shadowMap, glm::vec3(light.pos), casterVersion)) {
+                auto shadowStart = chrono::steady_clock::now();
+                DrawCounts shadowCounts;
+                renderShadowMap(shadowMap, shadowProgramID, shadowRefl, shadowUniforms, meshGLVector, scene,
+                                glm::vec3(light.pos), viewDir, 0.05f * radius, overdrawCnt, shadowCounts);
+                glFinish();
+                finishShadowUpdate(shadowMap, glm::vec3(light.pos), casterVersion,
+                                   chrono::duration<double, milli>(chrono::steady_clock::now() - shadowStart).count());
+                glBindFramebuffer(GL_FRAMEBUFFER, fb.FBO);
+                setViewport(0, 0, width, height);
+            }
+            setUniform(shadeRefl, shadeUniforms.shadowViewToWorld, glm::mat3(glm::inverse(view)));
+        }
+
+        if (deferred) glBindFramebuffer(GL_FRAMEBUFFER, gbuffer.FBO);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        setUniform(refl, uniforms.viewMat, view);
+        setUniform(shadeRefl, shadeUniforms.lightPos, lightPosView);
+
+        if (lightCnt > 0) {
+            assignClusterLights(clusters, sceneLights, view, pool);
+            uploadClusterLights(clusters);
+            if (f >= 0) {
+                assignTotalMS += clusters.assignMS;
+                meanClusterLights += clusters.meanLightsPerCluster;
+                maxClusterLights = max(maxClusterLights, clusters.maxLightsPerCluster);
+            }
+        }
+
+        DrawCounts frameCounts;
+
+        // Depth pre-pass: afterwards only the nearest surface passes GL_EQUAL, so each pixel is shaded once
+        if (depthPrepass) {
+            useProgram(depthProgramID);
+            setUniform(depthRefl, depthUniforms.viewMat, view);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            renderOverdrawScene(meshGLVector, scene, depthRefl, depthUniforms, view, viewDir, 0.05f * radius, overdrawCnt, frameCounts, true);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            setDepthFunc(GL_EQUAL);
+            setDepthMask(false);
+        }
+
+        useProgram(programID);
+        renderOverdrawScene(meshGLVector, scene, refl, uniforms, view, viewDir, 0.05f * radius, overdrawCnt, frameCounts);
+        if (depthPrepass) {
+            setDepthFunc(GL_LESS);
+            setDepthMask(true);
+        }
+
+        // Deferred: one full-screen pass over the G-buffer into the output target
+        if (deferred) {
+            glBindFramebuffer(GL_FRAMEBUFFER, fb.FBO);
+            glClear(GL_COLOR_BUFFER_BIT);
+            useProgram(lightingProgramID);
+            flushUniforms(lightingRefl);
+            drawGBufferLighting(gbuffer, fb.FBO);
+        }
+        if (captureEvery > 0 && f >= 0 && f % captureEvery == 0) {
+            if (captureSync) {
+                vector<unsigned char> pixels;
+                readFramebufferRGBA(fb, pixels);
+                string filename = (filesystem::path(captureDir) / ("Benchmark_sync_" + to_string(syncCaptureCnt++) + ".png")).string();
+                stbi_flip_vertically_on_write(1);
+                stbi_write_png(filename.c_str(), width, height, 4, pixels.data(), width * 4);
+                stbi_flip_vertically_on_write(0);
+            }
+            else requestFrameCapture(frameCapture, fb.FBO, GL_COLOR_ATTACHMENT0, width, height);
+        }
+        if (streaming && f >= 0) streamFrame(frameStream, fb.FBO, GL_COLOR_ATTACHMENT0);
+        glFinish();
+        endGLStateFrame();
+
+        // Time from the texture requests to the first frame, and to the frame with every texture in
+        double sinceTexturesMS = chrono::duration<double, milli>(chrono::steady_clock::now() - textureStart).count();
+        if (firstFrameMS < 0.0) firstFrameMS = sinceTexturesMS;
+        if (textured && texturesReadyFrame < 0 && isTextureCacheIdle(textureCache) &&
+            (!useTextureArrays || isTextureArraysIdle(textureArrays))) {
+            texturesReadyMS = sinceTexturesMS;
+            texturesReadyFrame = f + warmupCnt;
+        }
+
+        if (f < 0) {
+            benchStart = chrono::steady_clock::now();
+            continue;
+        }
+        chrono::duration<float, milli> frameTime = chrono::steady_clock::now() - frameStart;
+        frameTimesMS.push_back(frameTime.count());
+        counts.drawCalls += frameCounts.drawCalls;
+        counts.triangles += frameCounts.triangles;
+    }
+    double totalSec = chrono::duration<double>(chrono::steady_clock::now() - benchStart).count();
+    if (captureEvery > 0) waitFrameCapture(frameCapture);
+    if (streaming) {
+        closeFrameStream(frameStream);
+        printFrameStreamStats(frameStream);
+    }
+
+    // Sanity check: the model must have covered some pixels
+    long long coveredPixels = countCoveredPixels(fb);
+
+    // Fragment cost per variant
+    vector<VariantCost> variantCosts;
+    if (variantBench) {
+        try {
+            // Halfway to the target, so the model covers more of the screen
+            CameraKey key = sampleCameraPath(path, 0.0f);
+            key.eye = glm::mix(key.lookAt, key.eye, 0.5f);
+            variantCosts = runVariantBenchmark(shaderPerms, meshGLVector, scene, fb, key,
+                                               projection, light, roughness, metallic, frameCnt, warmupCnt);
+        }
+        catch (exception &e) {
+            cerr << "ERROR: " << e.what() << endl;
+            stopThreadPool(pool);
+            cleanupHeadlessGL(ctx);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Capture encoders on the last frame
+    vector<EncoderCost> encoderCosts;
+    if (encodeBench) {
+        vector<unsigned char> bottomUp, pixels;
+        readFramebufferRGBA(fb, bottomUp);
+        size_t stride = (size_t)width * 4;
+        pixels.resize(bottomUp.size());
+        for (int y = 0; y < height; y++) {
+            memcpy(pixels.data() + y * stride, bottomUp.data() + (size_t)(height - 1 - y) * stride, stride);
+        }
+        encoderCosts = runEncodeBenchmark(pixels, width, height, pool, 3);
+    }
+
+    // Report
+    FrameStats stats = computeFrameStats(frameTimesMS);
+    ostringstream json;
+    json << "{" << endl;
+    json << "  \"model\": " << jsonString(modelPath) << "," << endl;
+    json << "  \"renderer\": " << jsonString(renderer) << "," << endl;
+    json << "  \"debug_output\": " << jsonString(!debugging ? "none" : (getGLDebugMode() == DEBUG_OUTPUT_SYNC ? "sync" : (getGLDebugMode() == DEBUG_OUTPUT_ASYNC ? "async" : "off"))) << "," << endl;
+    json << "  \"width\": " << width << "," << endl;
+    json << "  \"height\": " << height << "," << endl;
+    ProgramCacheStats cacheStats = getProgramCacheStats();
+    json << "  \"shader_load_ms\": " << cacheStats.loadMS << "," << endl;
+    json << "  \"shader_variant\": " << jsonString(getShaderDefinesKey(defines)) << "," << endl;
+    json << "  \"render_path\": " << jsonString(deferred ? "deferred" : "forward") << "," << endl;
+    json << "  \"overdraw\": " << overdrawCnt << "," << endl;
+    json << "  \"depth_prepass\": " << (depthPrepass ? "true" : "false") << "," << endl;
+    json << "  \"shader_cache\": " << jsonString(cacheStats.hits > 0 ? "hit" : "miss") << "," << endl;
+    if (compileBench) {
+        json << "  \"compile_programs\": " << compileProgramCnt << "," << endl;
+        json << "  \"compile_serial_ms\": " << compileSerialMS << "," << endl;
+        json << "  \"compile_queued_ms\": " << compileQueuedMS << "," << endl;
+    }
+    json << "  \"frames\": " << stats.frameCnt << "," << endl;
+    json << "  \"total_seconds\": " << totalSec << "," << endl;
+    json << "  \"frame_ms\": { \"mean\": " << stats.meanMS << ", \"p50\": " << stats.p50MS;
+    json << ", \"p99\": " << stats.p99MS << ", \"max\": " << stats.maxMS << " }," << endl;
+    json << "  \"draw_calls_per_frame\": " << counts.drawCalls / frameCnt << "," << endl;
+    json << "  \"triangles_per_frame\": " << counts.triangles / frameCnt << "," << endl;
+    json << "  \"triangles_per_second\": " << (totalSec > 0.0 ? counts.triangles / totalSec : 0.0) << "," << endl;
+    GLStateCounters stateCounters = getGLStateFrameCounters();
+    json << "  \"gl_state_calls_last_frame\": { \"issued\": " << stateCounters.issued << ", \"elided\": " << stateCounters.elided << " }," << endl;
+    if (variantBench) {
+        // Shading cost relative to the first (unlit) variant, per covered pixel
+        json << "  \"brdf_lut_ms\": " << brdfLUT.computeMS << "," << endl;
+        json << "  \"variant_costs\": [" << endl;
+        for (size_t i = 0; i < variantCosts.size(); i++) {
+            VariantCost &cost = variantCosts[i];
+            double extraNS = (cost.meanMS - variantCosts[0].meanMS) * 1e6;
+            json << "    { \"variant\": " << jsonString(cost.name) << ", \"frame_ms\": " << cost.meanMS;
+            json << ", \"covered_pixels\": " << cost.coveredPixels;
+            json << ", \"shading_ns_per_pixel\": " << (cost.coveredPixels > 0 ? extraNS / cost.coveredPixels : 0.0) << " }";
+            json << (i + 1 < variantCosts.size() ? "," : "") << endl;
+        }
+        json << "  ]," << endl;
+    }
+    if (encodeBench) {
+        json << "  \"encoders\": [" << endl;
+        for (size_t i = 0; i < encoderCosts.size(); i++) {
+            EncoderCost &cost = encoderCosts[i];
+            json << "    { \"encoder\": " << jsonString(cost.name) << ", \"ms\": " << cost.ms << ", \"bytes\": " << cost.bytes;
+            json << ", \"mpix_per_second\": " << (cost.ms > 0.0 ? (double)width * height / (cost.ms * 1000.0) : 0.0);
+            json << ", \"speedup_vs_stb\": " << (cost.ms > 0.0 ? encoderCosts[0].ms / cost.ms : 0.0);
+            if (cost.name != "qoi") json << ", \"round_trip\": " << (cost.roundTrip ? "true" : "false");
+            json << " }" << (i + 1 < encoderCosts.size() ? "," : "") << endl;
+        }
+        json << "  ]," << endl;
+    }
+    if (lightCnt > 0) {
+        json << "  \"clustered_lights\": { \"lights\": " << lightCnt;
+        json << ", \"grid\": \"" << clusters.tilesX << "x" << clusters.tilesY << "x" << clusters.slices << "\"";
+        json << ", \"assign_ms\": " << assignTotalMS / frameCnt;
+        json << ", \"mean_lights_per_cluster\": " << meanClusterLights / frameCnt;
+        json << ", \"max_lights_per_cluster\": " << maxClusterLights << " }," << endl;
+    }
+    if (shadows) {
+        json << "  \"shadow_map\": { \"size\": " << shadowMap.size << ", \"updates\": " << shadowMap.updateCnt;
+        json << ", \"reused\": " << shadowMap.reuseCnt;
+        json << ", \"update_ms\": " << (shadowMap.updateCnt > 0 ? shadowMap.updateMS / shadowMap.updateCnt : 0.0) << " }," << endl;
+    }
+    if (textured) {
+        json << "  \"textures\": { \"requested\": " << textureCache.requestCnt << ", \"loaded\": " << textureCache.loadCnt;
+        json << ", \"failed\": " << textureCache.failedCnt << ", \"compressed\": " << textureCache.compressedCnt;
+        json << ", \"decode_ms\": " << textureCache.decodeMS;
+        json << ", \"upload_ms\": " << textureCache.uploadMS << ", \"uploaded_mb\": " << textureCache.uploadedBytes / (1024.0 * 1024.0);
+        json << ", \"first_frame_ms\": " << firstFrameMS << ", \"all_ready_ms\": " << texturesReadyMS;
+        json << ", \"all_ready_frame\": " << texturesReadyFrame;
+        if (useTextureArrays) {
+            json << ", \"arrays\": " << textureArrays.arrays.size() << ", \"array_layers\": " << textureArrays.placedCnt;
+            json << ", \"array_copy_ms\": " << textureArrays.copyMS;
+        }
+        json << " }," << endl;
+    }
+    if (captureEvery > 0) {
+        json << "  \"capture\": { \"mode\": \"" << (captureSync ? "sync" : "async") << "\", \"every\": " << captureEvery;
+        if (!captureSync) json << ", \"format\": " << jsonString(getCaptureFormatName(captureFormat));
+        if (captureSync) json << ", \"saved\": " << syncCaptureCnt;
+        else {
+            json << ", \"saved\": " << frameCapture.savedCnt << ", \"dropped\": " << frameCapture.droppedCnt;
+            json << ", \"render_thread_ms\": " << frameCapture.issueMS + frameCapture.mapMS;
+            json << ", \"encode_ms\": " << frameCapture.encodeMS << ", \"max_latency_ms\": " << frameCapture.maxLatencyMS;
+        }
+        json << " }," << endl;
+    }
+    if (streaming) {
+        json << "  \"stream\": { \"format\": \"" << (streamRaw ? "rgb24" : "y4m") << "\", \"frames\": " << frameStream.frameCnt;
+        json << ", \"written\": " << frameStream.writtenCnt << ", \"dropped\": " << frameStream.droppedCnt;
+        json << ", \"repeated\": " << frameStream.repeatedCnt << ", \"write_failed\": " << (frameStream.writeFailed ? "true" : "false");
+        json << ", \"render_thread_ms\": " << frameStream.renderThreadMS / max(1LL, frameStream.frameCnt);
+        json << ", \"convert_ms\": " << frameStream.convertMS / max(1LL, frameStream.convertedCnt);
+        json << ", \"write_ms\": " << frameStream.writeMS / max(1LL, frameStream.writtenCnt);
+        json << ", \"written_mb\": " << frameStream.writtenBytes / (1024.0 * 1024.0) << " }," << endl;
+    }
+    json << "  \"covered_pixels\": " << coveredPixels << endl;
+    json << "}" << endl;
+
+    cout << json.str();
+    if (!jsonFile.empty()) {
+        ofstream out(jsonFile);
+        out << json.str();
+    }
+
+    // Cleanup
+    for (auto& mgl : meshGLVector) {
+        cleanupMesh(mgl);
+    }
+    cleanupFramebufferGL(fb);
+    if (captureEvery > 0) cleanupFrameCapture(frameCapture);
+    if (deferred) cleanupGBufferGL(gbuffer);
+    cleanupBRDFLookup(brdfLUT);
+    if (shadows) cleanupShadowMapGL(shadowMap);
+    if (lightCnt > 0) cleanupClusteredLights(clusters);
+    if (useTextureArrays) cleanupTextureArrays(textureArrays);
+    else {
+        for (Texture *texture : meshTextures) {
+            releaseTexture(textureCache, texture);
+        }
+    }
+    cleanupTextureCache(textureCache);
+    stopThreadPool(pool);
+    useProgram(0);
+    cleanupShaderPermutations(shaderPerms);
+    cleanupHeadlessGL(ctx);
+
+    if (coveredPixels == 0) {
+        cerr << "ERROR: Nothing was rendered." << endl;
+        return EXIT_FAILURE;
+    }
+    if (streaming && frameStream.writeFailed) {
+        cerr << "ERROR: The frame stream could not be written completely." << endl;
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include "glm/glm.hpp"
+#include "MeshData.hpp"
+#include "SoftwareRasterizer.hpp"
+#include "ThreadPool.hpp"
+#include "FramePacing.hpp"
+#include "Utility.hpp"
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include "glm/gtc/matrix_transform.hpp"
+using namespace std;
+
+// CPU renderer for machines without a GPU: renders Assign07's opening view (same model loading,
+// node transforms, camera, light and GGX shading) with SoftwareRasterizer and writes a PNG.
+// No window or GL context is created. Albedo maps are not sampled, so every mesh gets the
+// untextured yellow.
+//
+// Usage: SoftwareRender [--size WxH] [--frames N] [--threads N] [--out file.png] [--json file]
+//                       [--eye x,y,z] [--look-at x,y,z] [--rot degrees] [model]
+// Prints frame times and throughput (Mtris/s, Mpix/s) as JSON.
+
+// One mesh instance with its final model matrix
+struct SoftwareDraw {
+    int meshIndex;
+    glm::mat4 modelMat;
+};
+
+glm::mat4 makeRotateZ(glm::vec3 offset, float rotAngle) {
+    // Convert rotAngle to radians
+    float radians = glm::radians(rotAngle);
+
+    // Generate transformation matrices
+    glm::mat4 translate1 = glm::translate(glm::mat4(1.0f), -offset);
+    glm::mat4 rotate = glm::rotate(glm::mat4(1.0f), radians, glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 translate2 = glm::translate(glm::mat4(1.0f), offset);
+
+    // Form composite transformation
+    return translate2 * rotate * translate1;
+}
+
+// Same traversal as Assign07's renderScene, collecting draws instead of issuing them
+void collectDraws(aiNode *node, glm::mat4 parentMat, float rotAngle, vector<SoftwareDraw> &draws) {
+    // Get transformation for the current node
+    glm::mat4 nodeT;
+    aiMatToGLM4(node->mTransformation, nodeT);
+
+    // Compute current model matrix
+    glm::mat4 modelMat = parentMat * nodeT;
+
+    // Proper local Z rotation about the node's location
+    glm::vec3 pos = glm::vec3(modelMat[3]);
+    glm::mat4 R = makeRotateZ(pos, rotAngle);
+    glm::mat4 tmpModel = R * modelMat;
+
+    for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+        draws.push_back({ (int)node->mMeshes[i], tmpModel });
+    }
+
+    for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+        collectDraws(node->mChildren[i], modelMat, rotAngle, draws);
+    }
+}
+
+void extractMeshData(aiMesh *mesh, Mesh &m, glm::vec4 color) {
+    // Clear out the Mesh's vertices and indices
+    m.vertices.clear();
+    m.indices.clear();
+
+    // Loop through all vertices in the aiMesh
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+        Vertex vertex;
+
+        // Convert aiVector3D to glm::vec3 for position
+        aiVector3D aiPos = mesh->mVertices[i];
+        vertex.position = glm::vec3(aiPos.x, aiPos.y, aiPos.z);
+
+        // Convert aiVector3D to glm::vec3 for normal
+        aiVector3D aiNorm = mesh->mNormals[i];
+        vertex.normal = glm::vec3(aiNorm.x, aiNorm.y, aiNorm.z);
+
+        vertex.color = color;
+        if (mesh->HasTextureCoords(0)) {
+            aiVector3D aiUV = mesh->mTextureCoords[0][i];
+            vertex.texcoord = glm::vec2(aiUV.x, aiUV.y);
+        }
+
+        // Add the Vertex to the Mesh's vertices list
+        m.vertices.push_back(vertex);
+    }
+
+    // Loop through all faces in the aiMesh
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        aiFace face = mesh->mFaces[i];
+        for (unsigned int j = 0; j < face.mNumIndices; j++) {
+            m.indices.push_back(face.mIndices[j]);
+        }
+    }
+}
+
+// "x,y,z"
+bool parseVec3(string value, glm::vec3 &v) {
+    return sscanf(value.c_str(), "%f,%f,%f", &v.x, &v.y, &v.z) == 3;
+}
+
+// Main
+int main(int argc, char **argv) {
+    // Assign07's window size, camera and light by default
+    int width = 800;
+    int height = 800;
+    int frameCnt = 10;
+    int threadCnt = 0;
+    float rotAngle = 0.0f;
+    glm::vec3 eye(0.0f, 0.0f, 1.0f);
+    glm::vec3 lookAt(0.0f, 0.0f, 0.0f);
+    string outFile = "screenshots/SoftwareRender.png";
+    string jsonFile, value;
+    if (consumeOption(argc, argv, "--size", value)) sscanf(value.c_str(), "%dx%d", &width, &height);
+    if (consumeOption(argc, argv, "--frames", value)) frameCnt = max(1, atoi(value.c_str()));
+    if (consumeOption(argc, argv, "--threads", value)) threadCnt = max(0, atoi(value.c_str()));
+    if (consumeOption(argc, argv, "--rot", value)) rotAngle = (float)atof(value.c_str());
+    if (consumeOption(argc, argv, "--eye", value) && !parseVec3(value, eye)) {
+        cerr << "ERROR: --eye expects x,y,z" << endl;
+        return 1;
+    }
+    if (consumeOption(argc, argv, "--look-at", value) && !parseVec3(value, lookAt)) {
+        cerr << "ERROR: --look-at expects x,y,z" << endl;
+        return 1;
+    }
+    consumeOption(argc, argv, "--out", outFile);
+    consumeOption(argc, argv, "--json", jsonFile);
+
+    string modelPath = "sampleModels/bunnyteatime.glb";
+    if (argc >= 2) {
+        modelPath = argv[1];
+    }
+
+    // Load the model using Assimp
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(modelPath,
+        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        cerr << "ERROR: Failed to load model: " << modelPath << endl;
+        return 1;
+    }
+
+    vector<Mesh> meshes(scene->mNumMeshes);
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        extractMeshData(scene->mMeshes[i], meshes[i], glm::vec4(1.0f, 1.0f, 0.0f, 1.0f));
+    }
+    vector<SoftwareDraw> draws;
+    collectDraws(scene->mRootNode, glm::mat4(1.0f), rotAngle, draws);
+
+    ThreadPool pool;
+    startThreadPool(pool, threadCnt);
+    SoftwareRenderer renderer;
+    if (!setupSoftwareRenderer(renderer, width, height, pool)) {
+        stopThreadPool(pool);
+        return 1;
+    }
+
+    // Assign07's camera and light (light given in world space, shaded in view space)
+    glm::mat4 view = glm::lookAt(eye, lookAt, glm::vec3(0.0f, 1.0f, 0.0f));
+    float aspectRatio = (float)width / (float)height;
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), aspectRatio, 0.01f, 50.0f);
+    SoftwareLight light;
+    light.pos = glm::vec3(view * glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+    light.color = glm::vec3(1.0f);
+    SoftwareMaterial material;
+    material.metallic = 0.0f;
+    material.roughness = 0.1f;
+
+    // One untimed frame first (allocates the bins), then the measured ones
+    vector<float> frameTimesMS;
+    SoftwareFrameStats totals;
+    for (int frame = -1; frame < frameCnt; frame++) {
+        auto start = chrono::steady_clock::now();
+        beginSoftwareFrame(renderer, view, projection, light, glm::vec3(0.2f, 0.2f, 0.4f));
+        for (SoftwareDraw &draw : draws) {
+            drawSoftwareMesh(renderer, meshes.at(draw.meshIndex), draw.modelMat, material);
+        }
+        endSoftwareFrame(renderer);
+        if (frame < 0) continue;
+
+        frameTimesMS.push_back((float)chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+        SoftwareFrameStats &s = renderer.stats;
+        totals.inputTriangles += s.inputTriangles;
+        totals.setupTriangles += s.setupTriangles;
+        totals.binnedTriangles += s.binnedTriangles;
+        totals.testedBlocks += s.testedBlocks;
+        totals.depthRejectedBlocks += s.depthRejectedBlocks;
+        totals.shadedPixels += s.shadedPixels;
+        totals.vertexMS += s.vertexMS;
+        totals.setupMS += s.setupMS;
+        totals.rasterMS += s.rasterMS;
+    }
+    int threadsUsed = (int)pool.workers.size() + 1;
+    stopThreadPool(pool);
+    bool written = writeSoftwareImage(renderer, outFile);
+
+    // Throughput over the measured frames
+    FrameStats stats = computeFrameStats(frameTimesMS);
+    double totalSec = stats.meanMS * stats.frameCnt / 1000.0;
+    double outputPixels = (double)width * height * frameCnt;
+    ostringstream json;
+    json << "{" << endl;
+    json << "  \"model\": " << jsonString(modelPath) << "," << endl;
+    json << "  \"renderer\": \"software\"," << endl;
+    json << "  \"threads\": " << threadsUsed << "," << endl;
+    json << "  \"width\": " << width << "," << endl;
+    json << "  \"height\": " << height << "," << endl;
+    json << "  \"tiles\": \"" << renderer.tilesX << "x" << renderer.tilesY << "\"," << endl;
+    json << "  \"frames\": " << stats.frameCnt << "," << endl;
+    json << "  \"frame_ms\": { \"mean\": " << stats.meanMS << ", \"p50\": " << stats.p50MS;
+    json << ", \"p99\": " << stats.p99MS << ", \"max\": " << stats.maxMS << " }," << endl;
+    json << "  \"phase_ms\": { \"vertex\": " << totals.vertexMS / frameCnt << ", \"setup_bin\": " << totals.setupMS / frameCnt;
+    json << ", \"raster_shade\": " << totals.rasterMS / frameCnt << " }," << endl;
+    json << "  \"triangles_per_frame\": " << totals.inputTriangles / frameCnt << "," << endl;
+    json << "  \"setup_triangles_per_frame\": " << totals.setupTriangles / frameCnt << "," << endl;
+    json << "  \"tiles_per_triangle\": " << (totals.setupTriangles > 0 ? (double)totals.binnedTriangles / totals.setupTriangles : 0.0) << "," << endl;
+    json << "  \"hiz_rejected_block_fraction\": " << (totals.testedBlocks > 0 ? (double)totals.depthRejectedBlocks / totals.testedBlocks : 0.0) << "," << endl;
+    json << "  \"shaded_pixels_per_frame\": " << totals.shadedPixels / frameCnt << "," << endl;
+    json << "  \"mtris_per_second\": " << (totalSec > 0.0 ? totals.inputTriangles / totalSec / 1e6 : 0.0) << "," << endl;
+    json << "  \"mpix_per_second\": " << (totalSec > 0.0 ? outputPixels / totalSec / 1e6 : 0.0) << "," << endl;
+    json << "  \"shaded_mpix_per_second\": " << (totalSec > 0.0 ? totals.shadedPixels / totalSec / 1e6 : 0.0) << "," << endl;
+    json << "  \"image\": " << jsonString(written ? outFile : "") << endl;
+    json << "}" << endl;
+
+    cout << json.str();
+    if (!jsonFile.empty()) {
+        ofstream out(jsonFile);
+        out << json.str();
+    }
+    return written ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "stb_image.h"
+#include "TextureCache.hpp"
+#include "BlockCompression.hpp"
+#include "CompressedTexture.hpp"
+#include "ThreadPool.hpp"
+#include "Utility.hpp"
+using namespace std;
+
+// Offline texture compressor: converts images stb_image can read (PNG, JPG, TGA, ...) into
+// block-compressed KTX2 or DDS files with a full mip chain. Written next to the input by
+// default, where TextureCache picks them up in place of the original.
+//
+// Usage: TextureCompressor [--format bc1|bc3|bc5|bc7] [--container ktx2|dds] [--no-mips]
+//                          [--out dir] [--threads N] image...
+// Without --format, images with an alpha channel become BC7 and the rest BC1.
+
+// Compress one image; returns false if it could not be read or written
+bool compressFile(string inputPath, string outDir, bool formatGiven, BlockFormat format, string container,
+                  bool generateMips, ThreadPool &pool) {
+    auto start = chrono::steady_clock::now();
+
+    int width = 0, height = 0, channels = 0;
+    stbi_uc *data = stbi_load(inputPath.c_str(), &width, &height, &channels, 4);
+    if (!data) {
+        cerr << "ERROR: Could not load " << inputPath << ": " << stbi_failure_reason() << endl;
+        return false;
+    }
+
+    // Same box filter as the runtime path, so both produce the same chain
+    DecodedTexture rgba;
+    rgba.pixels.assign(data, data + (size_t)width * height * 4);
+    if (generateMips) {
+        generateMipChain(rgba, width, height);
+    }
+    else {
+        rgba.mipOffsets = { 0 };
+        rgba.mipWidths = { width };
+        rgba.mipHeights = { height };
+    }
+    stbi_image_free(data);
+
+    CompressedImage image;
+    image.format = formatGiven ? format : ((channels == 4 || channels == 2) ? BLOCK_BC7 : BLOCK_BC1);
+    image.hasAlpha = (channels == 4 || channels == 2);
+    for (size_t level = 0; level < rgba.mipOffsets.size(); level++) {
+        image.mipOffsets.push_back(image.data.size());
+        image.mipWidths.push_back(rgba.mipWidths.at(level));
+        image.mipHeights.push_back(rgba.mipHeights.at(level));
+        image.data.resize(image.data.size() + getCompressedLevelSize(image.format, rgba.mipWidths.at(level), rgba.mipHeights.at(level)));
+    }
+    for (size_t level = 0; level < rgba.mipOffsets.size(); level++) {
+        compressImage(image.format, rgba.pixels.data() + rgba.mipOffsets.at(level), rgba.mipWidths.at(level), rgba.mipHeights.at(level),
+                      image.data.data() + image.mipOffsets.at(level), &pool);
+    }
+
+    filesystem::path outputPath = filesystem::path(inputPath).replace_extension("." + container);
+    if (!outDir.empty()) {
+        error_code ec;
+        filesystem::create_directories(outDir, ec);
+        if (ec) {
+            cerr << "ERROR: Could not create " << outDir << ": " << ec.message() << endl;
+            return false;
+        }
+        outputPath = filesystem::path(outDir) / outputPath.filename();
+    }
+    try {
+        if (container == "dds") writeDDS(outputPath.string(), image);
+        else writeKTX2(outputPath.string(), image);
+    }
+    catch (exception &e) {
+        cerr << "ERROR: " << e.what() << endl;
+        return false;
+    }
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    double ratio = (double)rgba.pixels.size() / (double)image.data.size();
+    cout << inputPath << " -> " << outputPath.string() << ": " << width << "x" << height << " " << getBlockFormatName(image.format);
+    cout << ", " << image.mipOffsets.size() << " levels, " << rgba.pixels.size() / 1024 << " KB -> " << image.data.size() / 1024 << " KB";
+    cout << " (" << ratio << ":1), " << ms << " ms" << endl;
+    return true;
+}
+
+// Main
+int main(int argc, char **argv) {
+    string value, outDir;
+    string container = "ktx2";
+    BlockFormat format = BLOCK_BC7;
+    bool formatGiven = false;
+    int threadCnt = 0;
+    if (consumeOption(argc, argv, "--format", value)) {
+        if (!parseBlockFormat(value, format)) {
+            cerr << "ERROR: Unknown format " << value << " (expected bc1, bc3, bc5 or bc7)" << endl;
+            return 1;
+        }
+        formatGiven = true;
+    }
+    if (consumeOption(argc, argv, "--container", value)) {
+        if (value != "ktx2" && value != "dds") {
+            cerr << "ERROR: Unknown container " << value << " (expected ktx2 or dds)" << endl;
+            return 1;
+        }
+        container = value;
+    }
+    consumeOption(argc, argv, "--out", outDir);
+    if (consumeOption(argc, argv, "--threads", value)) threadCnt = max(0, atoi(value.c_str()));
+    bool generateMips = !consumeFlag(argc, argv, "--no-mips");
+
+    if (argc < 2) {
+        cerr << "Usage: TextureCompressor [--format bc1|bc3|bc5|bc7] [--container ktx2|dds] [--no-mips] [--out dir] [--threads N] image..." << endl;
+        return 1;
+    }
+
+    ThreadPool pool;
+    startThreadPool(pool, threadCnt);
+    int failedCnt = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!compressFile(argv[i], outDir, formatGiven, format, container, generateMips, pool)) failedCnt++;
+    }
+    stopThreadPool(pool);
+
+    return (failedCnt > 0) ? 1 : 0;
+}
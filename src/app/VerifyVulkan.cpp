@@ -8,8 +8,6 @@
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image.h"
 #include "stb_image_write.h"
 
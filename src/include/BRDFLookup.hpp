@@ -0,0 +1,31 @@
+#ifndef BRDF_LOOKUP_H
+#define BRDF_LOOKUP_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+using namespace std;
+
+// Texture unit of the table (Lit.fs brdfLUT binding). Its own unit, since unit 0 is
+// used as scratch (uploads bind there and then unbind).
+const GLuint BRDF_LOOKUP_UNIT = 15;
+
+// Split-sum BRDF integration table (Karis, "Real Shading in Unreal Engine 4"):
+// for each (NdotV, roughness) the GGX lobe's average Fresnel/geometry term is
+// stored as a scale and bias on F0, i.e. F0 * lut.r + lut.g.
+// x = NdotV, y = roughness (same roughness parameterization as shaders/Common/Lit.fs).
+struct BRDFLookup {
+	GLuint texID = 0;
+	int size = 0;
+	int sampleCnt = 0;
+	double computeMS = 0.0;
+};
+
+void computeBRDFLookup(vector<uint16_t> &halfRG, int size, int sampleCnt);
+void createBRDFLookup(BRDFLookup &lut, int size = 128, int sampleCnt = 512);
+void bindBRDFLookup(BRDFLookup &lut, GLuint unit = BRDF_LOOKUP_UNIT);
+void cleanupBRDFLookup(BRDFLookup &lut);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include "ThreadPool.hpp"
+using namespace std;
+
+// GPU block-compressed formats (4x4 texel blocks)
+enum BlockFormat {
+	BLOCK_BC1,		// RGB, 8 bytes/block (8:1 vs. RGBA8)
+	BLOCK_BC3,		// RGBA (BC1 color + BC4 alpha), 16 bytes/block
+	BLOCK_BC5,		// Two channels (RG, e.g. normal maps), 16 bytes/block
+	BLOCK_BC7,		// RGBA, 16 bytes/block, best quality (mode 6 only here)
+	BLOCK_FORMAT_CNT
+};
+
+string getBlockFormatName(BlockFormat format);
+bool parseBlockFormat(string name, BlockFormat &format);
+int getBlockBytes(BlockFormat format);
+size_t getCompressedLevelSize(BlockFormat format, int width, int height);
+
+// Encode one 4x4 block of RGBA8 texels (row-major) into out
+void encodeBlock(BlockFormat format, const unsigned char rgba[64], unsigned char *out);
+
+// Encode a whole RGBA8 image (edge blocks repeat the last row/column); rows of blocks run on the pool
+void compressImage(BlockFormat format, const unsigned char *rgba, int width, int height, unsigned char *out, ThreadPool *pool = nullptr);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CAPTURE_ENCODER_H
+#define CAPTURE_ENCODER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ThreadPool.hpp"
+using namespace std;
+
+// Image encoders for captures (stbi_write_png is single-threaded and slow at 4K):
+//   QOI: lossless, one pass, no entropy coder (a few times faster than any deflate).
+//   PNG: rows are split into horizontal strips; each strip is filtered and deflated with zlib
+//        on the pool (seeded with the previous strip's last 32 KB, so compression barely suffers),
+//        ends byte-aligned with a sync flush, and goes into its own IDAT chunk. The strips'
+//        Adler-32s are combined into the one zlib trailer and each IDAT gets its own CRC,
+//        so the result is an ordinary PNG.
+
+enum CaptureFormat {
+	CAPTURE_PNG,			// Parallel strips (encodePNG)
+	CAPTURE_PNG_STB,		// stbi_write_png (single thread; for comparison)
+	CAPTURE_QOI,
+	CAPTURE_FORMAT_CNT
+};
+
+// Default zlib level for encodePNG (stb uses 8 with a much weaker compressor)
+const int CAPTURE_PNG_LEVEL = 6;
+
+string getCaptureFormatName(CaptureFormat format);
+string getCaptureFormatExtension(CaptureFormat format);
+bool parseCaptureFormat(string name, CaptureFormat &format);
+
+void encodeQOI(const unsigned char *pixels, int width, int height, int channels, vector<unsigned char> &out);
+void encodePNG(const unsigned char *pixels, int width, int height, int channels, vector<unsigned char> &out,
+			   ThreadPool *pool = nullptr, int level = CAPTURE_PNG_LEVEL);
+bool encodeCaptureImage(CaptureFormat format, const unsigned char *pixels, int width, int height, int channels,
+						vector<unsigned char> &out, ThreadPool *pool = nullptr);
+bool writeCaptureFile(string filename, const vector<unsigned char> &bytes);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+#include "ThreadPool.hpp"
+using namespace std;
+
+// Clustered forward lighting: the view frustum is split into a grid of froxels
+// (screen tiles x exponential depth slices), each light is assigned to the froxels
+// its sphere of influence touches, and the fragment shader (Lit.fs, CLUSTERED_LIGHTS)
+// only loops over the lights of its own froxel.
+
+// Point light with a finite range (layout matches ClusterLight in Lit.fs, std430)
+struct ClusterLight {
+	glm::vec4 posRadius;		// Position (xyz) and radius of influence (w)
+	glm::vec4 color;
+};
+
+// Shader storage bindings used by Lit.fs
+const GLuint CLUSTER_LIGHT_BINDING = 0;
+const GLuint CLUSTER_RANGE_BINDING = 1;
+const GLuint CLUSTER_INDEX_BINDING = 2;
+
+struct ClusteredLights {
+	// Grid
+	int tilesX = 16;
+	int tilesY = 9;
+	int slices = 24;
+	float nearZ = 0.1f;
+	float farZ = 100.0f;
+	glm::mat4 projection = glm::mat4(1.0f);
+	vector<glm::vec3> clusterMin;		// View-space bounds of each froxel
+	vector<glm::vec3> clusterMax;
+
+	// Per-frame results (view-space lights; per froxel: offset and count into lightIndices)
+	vector<ClusterLight> viewLights;
+	vector<uint32_t> clusterRanges;
+	vector<uint32_t> lightIndices;
+	vector<vector<uint32_t>> sliceIndices;	// Scratch, one list per depth slice
+
+	// Shader storage buffers (grown as needed)
+	GLuint lightSSBO = 0;
+	GLuint rangeSSBO = 0;
+	GLuint indexSSBO = 0;
+	size_t lightBytes = 0;
+	size_t rangeBytes = 0;
+	size_t indexBytes = 0;
+
+	// Stats for the last update
+	double assignMS = 0.0;
+	int maxLightsPerCluster = 0;
+	double meanLightsPerCluster = 0.0;		// Over froxels with at least one light
+};
+
+void setupClusteredLights(ClusteredLights &cl, int tilesX = 16, int tilesY = 9, int slices = 24);
+void setClusterProjection(ClusteredLights &cl, glm::mat4 projection, float nearZ, float farZ);
+glm::vec4 getClusterScale(ClusteredLights &cl, int width, int height);
+void assignClusterLights(ClusteredLights &cl, vector<ClusterLight> &worldLights, glm::mat4 viewMat, ThreadPool &pool);
+void uploadClusterLights(ClusteredLights &cl);
+void cleanupClusteredLights(ClusteredLights &cl);
+
+#endif
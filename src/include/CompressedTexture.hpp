@@ -0,0 +1,37 @@
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "BlockCompression.hpp"
+using namespace std;
+
+// Block-compressed image with its mip chain (level 0 first, back to back), as stored in
+// a KTX2 or DDS container. Uploaded as is with glCompressedTexImage2D (no decode on the CPU).
+struct CompressedImage {
+	BlockFormat format = BLOCK_BC7;
+	bool hasAlpha = true;			// BC1 only: RGBA (punch-through) vs. RGB variant of the format
+	vector<unsigned char> data;
+	vector<size_t> mipOffsets;
+	vector<int> mipWidths;
+	vector<int> mipHeights;
+};
+
+// Container recognized from its first bytes
+bool isKTX2File(const vector<unsigned char> &bytes);
+bool isDDSFile(const vector<unsigned char> &bytes);
+
+// Parse a KTX2 (no supercompression) or DDS file; false (with a message) if it is not BC1/3/5/7
+bool parseCompressedTexture(const vector<unsigned char> &bytes, CompressedImage &image, string &error);
+
+void writeKTX2(string filename, CompressedImage &image);
+void writeDDS(string filename, CompressedImage &image);
+
+// OpenGL side
+GLenum getCompressedGLFormat(CompressedImage &image);
+bool isBlockFormatSupported(BlockFormat format);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "ThreadPool.hpp"
+#include "CaptureEncoder.hpp"
+using namespace std;
+
+// In-app screenshots without a stall: requestFrameCapture() only queues a glReadPixels
+// into a pixel pack buffer (plus a fence) and returns. updateFrameCapture(), called once
+// per frame, maps a buffer only after its fence has signalled (a frame or two later) and
+// hands the mapped pointer to a pool worker, which copies the rows out (flipped to top-down)
+// and encodes the file (CaptureEncoder.hpp; the PNG strips go to the same pool). The buffer
+// is unmapped and reused once the worker has its copy.
+
+enum CaptureSlotState {
+	CAPTURE_FREE,
+	CAPTURE_READING,		// glReadPixels queued; waiting for the fence
+	CAPTURE_COPYING			// Mapped; a worker is copying the pixels out
+};
+
+struct CaptureSlot {
+	GLuint pbo = 0;
+	size_t capacity = 0;
+	GLsync fence = 0;
+	CaptureSlotState state = CAPTURE_FREE;
+	atomic<bool> copied{ false };	// Set by the worker once the mapped memory is no longer needed
+	int width = 0;
+	int height = 0;
+	string filename;
+	chrono::steady_clock::time_point requestTime;	// For the latency stat
+};
+
+struct FrameCapture {
+	ThreadPool *pool = nullptr;
+	vector<CaptureSlot> slots;		// Ring; a request with every slot busy is dropped
+	int nextSlot = 0;
+	string directory;
+	string prefix;
+	int sequence = 0;
+	CaptureFormat format = CAPTURE_PNG;	// Set before the first request
+
+	// Worker -> GL thread
+	mutex lock;
+	condition_variable wake;
+	int encodingCnt = 0;
+
+	// Stats (worker ones guarded by lock)
+	int requestCnt = 0;
+	int droppedCnt = 0;
+	int savedCnt = 0;
+	int failedCnt = 0;
+	double issueMS = 0.0;			// Render thread: queueing the reads
+	double mapMS = 0.0;				// Render thread: polling fences, mapping, unmapping
+	double encodeMS = 0.0;			// Workers: copy + encode + write
+	double maxLatencyMS = 0.0;		// Request to file written
+};
+
+void setupFrameCapture(FrameCapture &fc, ThreadPool &pool, string directory, string prefix, int slotCnt = 3);
+bool requestFrameCapture(FrameCapture &fc, GLuint readFBO, GLenum readBuffer, int width, int height, string filename = "");
+int updateFrameCapture(FrameCapture &fc);
+bool isFrameCaptureIdle(FrameCapture &fc);
+void waitFrameCapture(FrameCapture &fc);
+void cleanupFrameCapture(FrameCapture &fc);
+void printFrameCaptureStats(FrameCapture &fc);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <ctime>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+using namespace std;
+
+// How the main loop is paced
+enum FramePacingMode {
+	PACING_VSYNC,		// Swap interval 1; glfwSwapBuffers waits on the display
+	PACING_UNCAPPED,	// Swap interval 0; render as fast as possible (benchmarking)
+	PACING_TARGET_FPS	// Swap interval 0; sleep + spin until the next frame deadline
+};
+
+// Summary of recorded frame times (milliseconds)
+struct FrameStats {
+	int frameCnt = 0;
+	double meanMS = 0.0;
+	double p50MS = 0.0;
+	double p99MS = 0.0;
+	double maxMS = 0.0;
+};
+
+// Struct for holding frame pacing state
+struct FramePacer {
+	FramePacingMode mode = PACING_VSYNC;
+	double targetFPS = 60.0;
+	double refreshHz = 0.0;				// Display refresh rate (0 if unknown; see queryDisplayRefresh)
+	bool started = false;
+	chrono::steady_clock::time_point lastFrameEnd;
+	chrono::steady_clock::time_point nextDeadline;
+	vector<float> frameTimesMS;
+
+	// Render-on-demand (--on-demand): only draw when something marked the frame dirty
+	bool onDemand = false;
+	bool inputPending = false;			// Set by window/input callbacks (main thread only)
+	atomic<bool> dirty{true};			// Set by markFrameDirty() from any thread
+	atomic<bool> animating{false};		// While true, every frame is dirty
+	mutex wakeMutex;
+	condition_variable wakeCondition;
+
+	// Idle bookkeeping
+	long long framesRendered = 0;
+	long long idleWakeups = 0;
+	chrono::steady_clock::time_point runStart;
+	clock_t cpuStart = 0;
+	double energyStartJ = -1.0;
+};
+
+void parseFramePacingArgs(int &argc, char **argv, FramePacer &pacer);
+string framePacingModeName(FramePacer &pacer);
+void setupFramePacing(FramePacer &pacer);
+void endFrame(FramePacer &pacer);
+FrameStats computeFrameStats(vector<float> frameTimesMS);
+void queryDisplayRefresh(FramePacer &pacer, GLFWwindow *window);
+double getPacedFPS(FramePacer &pacer);
+void printFrameStats(FramePacer &pacer);
+
+void setupOnDemandRedraw(GLFWwindow *window, FramePacer &pacer);
+void markFrameDirty(FramePacer &pacer);
+bool takeInputPending(FramePacer &pacer);
+bool waitForRedraw(FramePacer &pacer);
+bool waitForRedrawSignal(FramePacer &pacer);
+void printIdleStats(FramePacer &pacer);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "SPSCQueue.hpp"
+using namespace std;
+
+// Every-frame capture for clips (PNG per frame cannot keep up at 60 fps):
+//   render thread: glReadPixels into a ring of pixel pack buffers, fenced; mapped in order
+//                  once the fence has signalled, without waiting
+//   -> bounded lock-free queue (mapped pointers, no copies)
+//   -> writer thread: converts straight out of the mapped memory (RGB -> YUV 4:2:0 for Y4M,
+//                     or RGB24), gives the buffer back, then writes to a file or a pipe.
+// A frame whose buffer is still in use when it is requested is dropped. The writer sees
+// the gap in frame numbers, reports it and repeats the previous frame so the clip keeps its timing.
+
+// Readback buffers (frames in flight) at most; the queue holds all of them
+const int MAX_STREAM_SLOTS = 16;
+
+enum StreamFormat {
+	STREAM_Y4M,			// YUV4MPEG2, 4:2:0, full-range BT.601 (C420jpeg)
+	STREAM_RAW_RGB		// Headerless rgb24 frames (ffmpeg -f rawvideo -pix_fmt rgb24)
+};
+
+enum StreamSlotState {
+	STREAM_FREE,
+	STREAM_READING,		// glReadPixels queued; waiting for the fence
+	STREAM_QUEUED		// Mapped and handed to the writer
+};
+
+struct StreamSlot {
+	GLuint pbo = 0;
+	GLsync fence = 0;
+	StreamSlotState state = STREAM_FREE;
+	long long frameIndex = 0;
+	atomic<bool> consumed{ false };		// Set by the writer once it no longer reads the mapping
+};
+
+// Queue entry (render thread -> writer)
+struct StreamItem {
+	StreamSlot *slot = nullptr;
+	const unsigned char *pixels = nullptr;		// Mapped, bottom-up RGBA8
+	long long frameIndex = 0;
+};
+
+struct FrameStream {
+	StreamFormat format = STREAM_Y4M;
+	int width = 0;
+	int height = 0;
+	int fps = 60;
+	string target;
+	FILE *out = nullptr;
+	bool isPipe = false;
+
+	// Render thread
+	vector<StreamSlot> slots;
+	int nextSlot = 0;				// Next to read into; the ring is oldest-first from here
+	long long frameCnt = 0;			// streamFrame() calls
+	long long droppedCnt = 0;		// No free buffer at request time (or the map failed)
+	bool dropping = false;			// Previous frame was dropped (one warning per run)
+	double renderThreadMS = 0.0;
+
+	// Render thread -> writer
+	SPSCQueue<StreamItem, MAX_STREAM_SLOTS> queue;
+	mutex wakeLock;
+	condition_variable wake;
+	atomic<bool> running{ false };
+	thread writer;
+
+	// Writer thread (read after closeFrameStream)
+	vector<unsigned char> frameBytes;	// Last converted frame (repeated for drops)
+	long long convertedCnt = 0;
+	long long writtenCnt = 0;		// Including repeats
+	long long repeatedCnt = 0;
+	long long lastWrittenIndex = -1;
+	vector<long long> gapStarts;		// First dropped frame of each gap (first few)
+	double convertMS = 0.0;
+	double writeMS = 0.0;
+	size_t writtenBytes = 0;
+	bool writeFailed = false;
+};
+
+bool openFrameStream(FrameStream &fs, string target, StreamFormat format, int width, int height, int fps = 60, int slotCnt = 4);
+void streamFrame(FrameStream &fs, GLuint readFBO, GLenum readBuffer);
+void updateFrameStream(FrameStream &fs);
+void closeFrameStream(FrameStream &fs);
+void printFrameStreamStats(FrameStream &fs);
+
+// Conversion of one bottom-up RGBA8 image (top-down output; vectorized with SSE2)
+void convertRGBAToYUV420(const unsigned char *rgba, int width, int height, unsigned char *yuv);
+void convertRGBAToRGB(const unsigned char *rgba, int width, int height, unsigned char *rgb);
+size_t getStreamFrameBytes(StreamFormat format, int width, int height);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef FRAMEBUFFER_GL_H
+#define FRAMEBUFFER_GL_H
+
+#include <iostream>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+using namespace std;
+
+// Struct for holding an offscreen render target (color + depth textures)
+struct FramebufferGL {
+	GLuint FBO = 0;
+	GLuint colorTex = 0;
+	GLuint depthTex = 0;
+	int width = 0;
+	int height = 0;
+};
+
+void createFramebufferGL(FramebufferGL &fb, int width, int height);
+void cleanupFramebufferGL(FramebufferGL &fb);
+void readFramebufferRGBA(FramebufferGL &fb, vector<unsigned char> &pixels);
+
+#endif
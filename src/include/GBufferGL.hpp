@@ -0,0 +1,37 @@
+#ifndef GBUFFER_GL_H
+#define GBUFFER_GL_H
+
+#include <iostream>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+using namespace std;
+
+// Texture units the deferred lighting pass reads the G-buffer from
+// (unit 0 is kept for uploads; the BRDF lookup table is on unit 15, see BRDFLookup.hpp)
+const GLuint GBUFFER_ALBEDO_UNIT = 1;
+const GLuint GBUFFER_NORMAL_UNIT = 2;
+const GLuint GBUFFER_MATERIAL_UNIT = 3;
+const GLuint GBUFFER_DEPTH_UNIT = 4;
+
+// Compact G-buffer for deferred shading (9 bytes of color per pixel + depth):
+//   0: RGBA8 albedo
+//   1: RG16  octahedral view-space normal
+//   2: RG8   metallic, roughness
+// Position is not stored; the lighting pass reconstructs it from depth.
+struct GBufferGL {
+	GLuint FBO = 0;
+	GLuint albedoTex = 0;
+	GLuint normalTex = 0;
+	GLuint materialTex = 0;
+	GLuint depthTex = 0;
+	GLuint emptyVAO = 0;		// Full-screen triangle comes from gl_VertexID
+	int width = 0;
+	int height = 0;
+};
+
+void createGBufferGL(GBufferGL &gb, int width, int height);
+void cleanupGBufferGL(GBufferGL &gb);
+void bindGBufferTextures(GBufferGL &gb);
+void drawGBufferLighting(GBufferGL &gb, GLuint targetFBO);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef GL_DEBUG_OUTPUT_H
+#define GL_DEBUG_OUTPUT_H
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+using namespace std;
+
+// How checkAndSetupOpenGLDebugging() routes driver messages
+enum GLDebugMode {
+	DEBUG_OUTPUT_OFF,		// Debug context, but no callback
+	DEBUG_OUTPUT_SYNC,		// GL_DEBUG_OUTPUT_SYNCHRONOUS + printing callback (break on the offending call)
+	DEBUG_OUTPUT_ASYNC		// Callback only queues records; a logger thread prints them (default)
+};
+
+const int GL_DEBUG_QUEUE_SIZE = 1024;			// Records buffered between callback and logger
+const int GL_DEBUG_MESSAGE_MAX = 192;			// Characters kept per message
+
+// Compact record pushed by the callback (fixed size; no allocation)
+struct GLDebugRecord {
+	GLenum source;
+	GLenum type;
+	GLenum severity;
+	GLuint id;
+	uint64_t timeNS;
+	char message[GL_DEBUG_MESSAGE_MAX];
+};
+
+// Counters for the summary at shutdown
+struct GLDebugCounters {
+	atomic<long long> received{0};
+	atomic<long long> filtered{0};		// Dropped by severity/source filter
+	atomic<long long> dropped{0};		// Queue was full
+	long long printed = 0;
+	long long duplicates = 0;			// Same source/type/id seen before
+	long long rateLimited = 0;			// Over the per-second budget
+};
+
+void parseGLDebugArgs(int &argc, char **argv);
+void setGLDebugMode(GLDebugMode mode);
+GLDebugMode getGLDebugMode();
+
+// Runtime filters (safe to call from any thread at any time)
+void setGLDebugMinSeverity(GLenum severity);
+bool isGLDebugSeverityEnabled(GLenum severity);
+void setGLDebugSourceEnabled(GLenum source, bool enabled);
+void setGLDebugRateLimit(int messagesPerSecond);
+
+void APIENTRY asyncGLDebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+									GLsizei length, const GLchar *message, const void *userParam);
+void startGLDebugLogger();
+void stopGLDebugLogger();
+
+string getGLDebugSourceName(GLenum source);
+string getGLDebugTypeName(GLenum type);
+string getGLDebugSeverityName(GLenum severity);
+
+#endif
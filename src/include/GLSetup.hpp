@@ -16,4 +16,16 @@ void setupGLEW(GLFWwindow* window);
 void checkOpenGLVersion();
 void checkAndSetupOpenGLDebugging();
 
+// Offscreen context for headless runs: EGL (surfaceless/pbuffer) when available,
+// otherwise a hidden GLFW window. Render into an FBO; there is no default framebuffer to show.
+struct HeadlessGL {
+	void *eglDisplay = nullptr;
+	void *eglContext = nullptr;
+	void *eglSurface = nullptr;
+	GLFWwindow *window = nullptr;
+};
+
+bool setupHeadlessGL(HeadlessGL &ctx, int major, int minor, bool debugging);
+void cleanupHeadlessGL(HeadlessGL &ctx);
+
 #endif
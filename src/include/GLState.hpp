@@ -0,0 +1,71 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <iostream>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+using namespace std;
+
+// Buffer targets whose bindings are tracked (others go straight to GL)
+enum GLBufferSlot {
+	BUFFER_SLOT_ARRAY,
+	BUFFER_SLOT_ELEMENT_ARRAY,		// Part of VAO state; forgotten when the VAO changes
+	BUFFER_SLOT_UNIFORM,
+	BUFFER_SLOT_SHADER_STORAGE,
+	BUFFER_SLOT_PIXEL_PACK,
+	BUFFER_SLOT_PIXEL_UNPACK,
+	BUFFER_SLOT_CNT
+};
+
+// Shadow copy of the context state we manage.
+// Everything starts out "unknown" so the first call always reaches GL.
+struct GLStateCache {
+	bool known = false;
+
+	GLuint program = 0;
+	GLuint vertexArray = 0;
+	GLuint buffers[BUFFER_SLOT_CNT] = {};
+	bool bufferKnown[BUFFER_SLOT_CNT] = {};
+
+	bool depthTest = false;
+	bool depthMask = true;
+	GLenum depthFunc = GL_LESS;
+	bool blend = false;
+	GLenum blendSrc = GL_ONE;
+	GLenum blendDst = GL_ZERO;
+	GLint viewport[4] = {0, 0, 0, 0};
+};
+
+// Issued vs. skipped state changes
+struct GLStateCounters {
+	long long issued = 0;
+	long long elided = 0;
+};
+
+// Call after creating/making a context current, or after code that changes
+// this state behind the cache's back (third-party code, raw GL calls)
+void invalidateGLState();
+
+void useProgram(GLuint program);
+void bindVertexArray(GLuint vao);
+void bindBuffer(GLenum target, GLuint buffer);
+void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+void bindTexture(GLuint unit, GLenum target, GLuint texture);
+void setDepthTest(bool enabled);
+void setDepthMask(bool enabled);
+void setDepthFunc(GLenum func);
+void setBlend(bool enabled);
+void setBlendFunc(GLenum src, GLenum dst);
+void setViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+// Deleting an object unbinds it in GL, so the cache must forget it too
+void deleteProgram(GLuint &program);
+void deleteVertexArray(GLuint &vao);
+void deleteBuffer(GLuint &buffer);
+
+// Per-frame accounting
+void endGLStateFrame();
+GLStateCounters getGLStateFrameCounters();
+void printGLStateStats();
+
+#endif
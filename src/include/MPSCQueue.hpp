@@ -0,0 +1,69 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+using namespace std;
+
+// Bounded lock-free multi-producer/single-consumer queue.
+// Each slot carries a sequence number, so producers claim slots with one CAS
+// and the consumer knows when a claimed slot has actually been written.
+// Capacity must be a power of two. tryPush() fails (never blocks) when full.
+template <typename T, size_t Capacity>
+class MPSCQueue {
+	static_assert((Capacity & (Capacity - 1)) == 0, "MPSCQueue capacity must be a power of two");
+
+public:
+	MPSCQueue() {
+		for(size_t i = 0; i < Capacity; i++) slots[i].sequence.store(i, memory_order_relaxed);
+	}
+
+	// Producer side (any thread)
+	bool tryPush(const T &item) {
+		size_t head = headIndex.load(memory_order_relaxed);
+		while(true) {
+			Slot &slot = slots[head & (Capacity - 1)];
+			size_t sequence = slot.sequence.load(memory_order_acquire);
+			long diff = (long)sequence - (long)head;
+			if(diff == 0) {
+				// Slot is free for this position; try to claim it
+				if(headIndex.compare_exchange_weak(head, head + 1, memory_order_relaxed)) {
+					slot.item = item;
+					slot.sequence.store(head + 1, memory_order_release);
+					return true;
+				}
+			}
+			else if(diff < 0) {
+				// Consumer has not freed this slot yet: full
+				return false;
+			}
+			else {
+				// Another producer took it; retry with the current head
+				head = headIndex.load(memory_order_relaxed);
+			}
+		}
+	}
+
+	// Consumer side (one thread)
+	bool tryPop(T &item) {
+		Slot &slot = slots[tailIndex & (Capacity - 1)];
+		size_t sequence = slot.sequence.load(memory_order_acquire);
+		if(sequence != tailIndex + 1) return false;
+		item = slot.item;
+		slot.sequence.store(tailIndex + Capacity, memory_order_release);
+		tailIndex++;
+		return true;
+	}
+
+private:
+	struct Slot {
+		atomic<size_t> sequence;
+		T item;
+	};
+
+	Slot slots[Capacity];
+	alignas(64) atomic<size_t> headIndex{0};
+	alignas(64) size_t tailIndex = 0;		// Owned by consumer
+};
+
+#endif
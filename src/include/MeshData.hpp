@@ -11,6 +11,7 @@ struct Vertex {
 	glm::vec3 position;
 	glm::vec3 normal;
 	glm::vec4 color;
+	glm::vec2 texcoord = glm::vec2(0.0f);	// First UV channel (0,0 if the model has none)
 };
 
 // Struct for holding mesh data
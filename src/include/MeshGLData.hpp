@@ -14,11 +14,14 @@ struct MeshGL {
 	GLuint VBO = 0;
 	GLuint EBO = 0;
 	GLuint VAO = 0;
+	GLuint positionVBO = 0;		// Tightly packed positions (12 bytes/vertex) for depth-only passes
+	GLuint depthVAO = 0;		// positionVBO at location 0 + the same EBO
 	int indexCnt = 0;
 };
 
 void createMeshGL(Mesh &m, MeshGL &mgl);
 void drawMesh(MeshGL &mgl);
+void drawMeshDepth(MeshGL &mgl);
 void cleanupMesh(MeshGL &mgl);
 
 #endif
@@ -0,0 +1,94 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+using namespace std;
+
+// Limits for the profiler (fixed so nothing allocates on the hot path)
+const int MAX_PROFILE_ZONES = 64;
+const int MAX_PROFILE_THREADS = 32;
+const int PROFILE_THREAD_RING_SIZE = 4096;		// CPU records per thread between collections
+const int PROFILE_ROLLING_FRAMES = 256;			// Frames kept for rolling statistics
+const int MAX_GPU_ZONES_PER_FRAME = 32;
+const int GPU_PROFILE_LATENCY = 4;				// Frames between issuing and reading GPU queries
+
+// One finished CPU zone
+struct ProfileRecord {
+	int zoneID;
+	uint64_t startNS;
+	uint64_t durationNS;
+};
+
+// Per-thread single-producer/single-consumer ring of CPU zone records.
+// The owning thread writes at head; endProfileFrame() reads from tail.
+struct ProfileThreadBuffer {
+	ProfileRecord records[PROFILE_THREAD_RING_SIZE];
+	atomic<uint32_t> head{0};
+	atomic<uint32_t> tail{0};
+	atomic<uint32_t> dropped{0};
+};
+
+// Rolling statistics for a zone (milliseconds)
+struct ProfileZoneStats {
+	string name;
+	bool isGPU = false;
+	int sampleCnt = 0;
+	double meanMS = 0.0;
+	double minMS = 0.0;
+	double maxMS = 0.0;
+	double p95MS = 0.0;
+	double lastMS = 0.0;
+};
+
+void parseProfilerArgs(int &argc, char **argv);
+void setProfilingEnabled(bool enabled);
+bool isProfilingEnabled();
+uint64_t profileNowNS();
+
+int registerProfileZone(string name, bool isGPU = false);
+void recordProfileZone(int zoneID, uint64_t startNS, uint64_t endNS);
+
+// Scoped CPU zone: times from construction to destruction
+struct CPUProfileScope {
+	int zoneID;
+	uint64_t startNS;
+	CPUProfileScope(int id);
+	~CPUProfileScope();
+};
+
+void setupGPUProfiler();
+void cleanupGPUProfiler();
+int beginGPUZone(int zoneID);
+void endGPUZone(int slot);
+
+// Scoped GPU zone: brackets the enclosed GL commands with timestamp queries
+struct GPUProfileScope {
+	int slot;
+	GPUProfileScope(int zoneID);
+	~GPUProfileScope();
+};
+
+void beginProfileFrame();
+void endProfileFrame();
+vector<ProfileZoneStats> getProfileStats();
+void printProfileStats();
+bool writeProfileCSV(string filename);
+void finishProfiling();
+
+// Zone macros; the zone name is registered once per call site
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_CPU_ZONE(name) \
+	static int PROFILE_CONCAT(profZoneID_, __LINE__) = registerProfileZone(name); \
+	CPUProfileScope PROFILE_CONCAT(profZone_, __LINE__)(PROFILE_CONCAT(profZoneID_, __LINE__))
+#define PROFILE_GPU_ZONE(name) \
+	static int PROFILE_CONCAT(profGPUZoneID_, __LINE__) = registerProfileZone(name, true); \
+	GPUProfileScope PROFILE_CONCAT(profGPUZone_, __LINE__)(PROFILE_CONCAT(profGPUZoneID_, __LINE__))
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+using namespace std;
+
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+// Entries are keyed by the shader sources, the defines used to build them,
+// and the driver's vendor/renderer/version strings.
+
+// Hit/miss counters and timing for this run
+struct ProgramCacheStats {
+	int hits = 0;
+	int misses = 0;
+	int rejected = 0;			// Binary found but the driver refused it (recompiled from source)
+	int stores = 0;
+	double loadMS = 0.0;		// Time spent creating programs through the cache
+	double savedMS = 0.0;		// Recorded source-compile time of hits minus their load time
+};
+
+void setProgramCacheDir(string dir);
+void setProgramCacheEnabled(bool enabled);
+void parseProgramCacheArgs(int &argc, char **argv);
+uint64_t hashProgramKey(string vertexShaderCode, string fragmentShaderCode, string defines);
+bool isProgramCacheActive();
+GLuint findCachedProgram(string vertexShaderCode, string fragmentShaderCode, string defines);
+void storeProgramBinary(string vertexShaderCode, string fragmentShaderCode, string defines, GLuint programID, double compileMS);
+GLuint initShaderProgramCached(string vertexShaderCode, string fragmentShaderCode, string defines = "");
+ProgramCacheStats getProgramCacheStats();
+void printProgramCacheStats();
+
+#endif
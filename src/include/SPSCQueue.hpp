@@ -0,0 +1,48 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+using namespace std;
+
+// Bounded lock-free single-producer/single-consumer queue.
+// Capacity must be a power of two. tryPush() fails (never blocks) when full,
+// tryPop() fails when empty.
+template <typename T, size_t Capacity>
+class SPSCQueue {
+	static_assert((Capacity & (Capacity - 1)) == 0, "SPSCQueue capacity must be a power of two");
+
+public:
+	// Producer side
+	bool tryPush(const T &item) {
+		size_t head = headIndex.load(memory_order_relaxed);
+		if(head - tailIndex.load(memory_order_acquire) >= Capacity) return false;
+		items[head & (Capacity - 1)] = item;
+		headIndex.store(head + 1, memory_order_release);
+		return true;
+	}
+
+	// Consumer side
+	bool tryPop(T &item) {
+		size_t tail = tailIndex.load(memory_order_relaxed);
+		if(tail == headIndex.load(memory_order_acquire)) return false;
+		item = items[tail & (Capacity - 1)];
+		tailIndex.store(tail + 1, memory_order_release);
+		return true;
+	}
+
+	// Approximate number of queued items (exact from either endpoint's own thread)
+	size_t size() const {
+		return headIndex.load(memory_order_acquire) - tailIndex.load(memory_order_acquire);
+	}
+
+	bool empty() const { return size() == 0; }
+
+private:
+	T items[Capacity];
+	// Separate cache lines so producer and consumer do not false-share
+	alignas(64) atomic<size_t> headIndex{0};
+	alignas(64) atomic<size_t> tailIndex{0};
+};
+
+#endif
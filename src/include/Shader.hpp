@@ -5,15 +5,124 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <unordered_map>
+#include <cstring>
 #include <GL/glew.h>					
 #include <GLFW/glfw3.h>
 #include "glm/glm.hpp"
 using namespace std;
 
 string readFileToString(string filename);
+vector<string> getLoadedShaderFiles();
 void printShaderCode(string &vertexCode, string &fragCode);
 GLuint createAndCompileShader(const char *shaderCode, GLenum shaderType);
-GLuint createAndLinkShaderProgram(std::vector<GLuint> allShaderIDs);
-GLuint initShaderProgramFromSource(string vertexShaderCode, string fragmentShaderCode);
+GLuint createAndLinkShaderProgram(std::vector<GLuint> allShaderIDs, bool retrievable = false);
+GLuint initShaderProgramFromSource(string vertexShaderCode, string fragmentShaderCode, bool retrievable = false);
+
+// Compile-time variants: each define is "NAME" or "NAME=VALUE"
+string applyShaderDefines(string code, vector<string> defines);
+string getShaderDefinesKey(vector<string> defines);
+
+// Program submitted for compilation without waiting on it.
+// With GL_KHR_parallel_shader_compile the driver compiles on its own threads
+// and isProgramCompileDone() polls GL_COMPLETION_STATUS_KHR; otherwise the first
+// status query simply blocks, as before.
+struct PendingProgram {
+	GLuint vertID = 0;
+	GLuint fragID = 0;
+	GLuint programID = 0;
+};
+
+bool setupParallelShaderCompile();
+void beginProgramCompile(PendingProgram &pending, string vertexShaderCode, string fragmentShaderCode, bool retrievable = false);
+bool isProgramCompileDone(PendingProgram &pending);
+GLuint finishProgramCompile(PendingProgram &pending);
+void cancelProgramCompile(PendingProgram &pending);
+
+// Active uniform or vertex attribute found by reflection
+struct ShaderVariable {
+	string name;
+	GLenum type = GL_NONE;
+	GLint location = -1;
+	GLint arraySize = 1;
+	GLint blockIndex = -1;		// Uniform block (-1 for default block / attributes)
+	int slot = -1;				// Index into ShaderReflection::values (default-block uniforms)
+	bool requested = false;		// Resolved by the app at least once
+};
+
+// Active uniform block found by reflection
+struct ShaderBlock {
+	string name;
+	GLint binding = 0;
+	GLint dataSize = 0;
+	GLint variableCnt = 0;
+};
+
+// Staged value for one uniform location (uploaded by flushUniforms)
+struct UniformValue {
+	GLint location = -1;
+	GLenum type = GL_NONE;
+	unsigned char data[64];		// Large enough for a mat4
+	int size = 0;
+	bool dirty = false;
+	bool everSet = false;
+};
+
+// Hashed tables of everything a program exposes, plus per-uniform staging
+struct ShaderReflection {
+	GLuint programID = 0;
+	unordered_map<string, ShaderVariable> uniforms;
+	unordered_map<string, ShaderBlock> uniformBlocks;
+	unordered_map<string, ShaderVariable> attributes;
+	vector<UniformValue> values;
+
+	// Problems found while resolving handles (for the report)
+	vector<string> missingUniforms;
+	vector<string> mismatchedUniforms;
+	int uploadCnt = 0;			// glProgramUniform* calls issued by flushUniforms
+	int skippedCnt = 0;			// Staged values that matched what was already uploaded
+};
+
+// Typed uniform handle; resolved once at startup with getUniform<T>()
+template <typename T>
+struct UniformHandle {
+	int slot = -1;
+	GLint location = -1;
+	bool valid() const { return slot >= 0; }
+};
+
+// GL type enum that matches each C++ uniform type
+inline GLenum getUniformGLType(const float*) { return GL_FLOAT; }
+inline GLenum getUniformGLType(const int*) { return GL_INT; }
+inline GLenum getUniformGLType(const glm::ivec3*) { return GL_INT_VEC3; }
+inline GLenum getUniformGLType(const glm::vec2*) { return GL_FLOAT_VEC2; }
+inline GLenum getUniformGLType(const glm::vec3*) { return GL_FLOAT_VEC3; }
+inline GLenum getUniformGLType(const glm::vec4*) { return GL_FLOAT_VEC4; }
+inline GLenum getUniformGLType(const glm::mat3*) { return GL_FLOAT_MAT3; }
+inline GLenum getUniformGLType(const glm::mat4*) { return GL_FLOAT_MAT4; }
+
+void reflectShaderProgram(GLuint programID, ShaderReflection &refl);
+int resolveUniform(ShaderReflection &refl, string name, GLenum expectedType, GLint &location);
+void stageUniform(ShaderReflection &refl, int slot, const void *data, int size);
+void flushUniforms(ShaderReflection &refl);
+string getGLTypeName(GLenum type);
+void printShaderReflection(ShaderReflection &refl);
+
+// Look up uniform by name and check its type (missing/mismatched ones are
+// recorded and return an invalid handle, which setUniform ignores)
+template <typename T>
+UniformHandle<T> getUniform(ShaderReflection &refl, string name) {
+	UniformHandle<T> handle;
+	handle.slot = resolveUniform(refl, name, getUniformGLType((const T*)nullptr), handle.location);
+	return handle;
+}
+
+// Stage a value; nothing reaches GL until flushUniforms()
+template <typename T>
+void setUniform(ShaderReflection &refl, UniformHandle<T> handle, const T &value) {
+	static_assert(sizeof(T) <= sizeof(UniformValue::data), "Uniform type too large");
+	if(handle.slot < 0) return;
+	stageUniform(refl, handle.slot, &value, (int)sizeof(T));
+}
 
 #endif
@@ -0,0 +1,44 @@
+#ifndef SHADER_COMPILE_QUEUE_H
+#define SHADER_COMPILE_QUEUE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Shader.hpp"
+using namespace std;
+
+// One program in the queue
+struct ShaderCompileJob {
+	string name;
+	string vertexCode;
+	string fragCode;
+	string defines;
+	PendingProgram pending;
+	GLuint programID = 0;
+	bool done = false;
+	bool failed = false;
+	bool fromCache = false;
+	double submitMS = 0.0;		// Queue time when this job was submitted
+	double finishMS = 0.0;		// Time from submitting the queue's first job until this one finished
+};
+
+// All programs are submitted up front and then polled with GL_COMPLETION_STATUS_KHR,
+// so the driver can compile them concurrently (and while the CPU imports models).
+struct ShaderCompileQueue {
+	vector<ShaderCompileJob> jobs;
+	bool started = false;
+	chrono::steady_clock::time_point start;
+	double wallMS = 0.0;		// Submit of first job -> last job finished
+	double blockedMS = 0.0;		// Time spent inside waitShaderCompileQueue
+};
+
+int queueProgramCompile(ShaderCompileQueue &queue, string name, string vertexShaderCode, string fragmentShaderCode, string defines = "");
+int pollShaderCompileQueue(ShaderCompileQueue &queue);
+void waitShaderCompileQueue(ShaderCompileQueue &queue);
+GLuint getCompiledProgram(ShaderCompileQueue &queue, int index);
+void printShaderCompileStats(ShaderCompileQueue &queue);
+
+#endif
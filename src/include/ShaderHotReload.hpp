@@ -0,0 +1,38 @@
+#ifndef SHADER_HOT_RELOAD_H
+#define SHADER_HOT_RELOAD_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Shader.hpp"
+using namespace std;
+
+// Program whose source files are watched; rebuilt in the background when they change.
+// programID always refers to the last program that compiled and linked.
+struct ReloadableProgram {
+	string vertexPath;
+	string fragPath;
+	vector<string> defines;		// Permutation the program was built with (see applyShaderDefines)
+	GLuint programID = 0;
+
+	// Rebuild in progress (old program stays in use until it is done)
+	PendingProgram pending;
+	bool compiling = false;
+	bool changed = false;
+	chrono::steady_clock::time_point lastChange;
+	chrono::steady_clock::time_point compileStart;
+
+	int reloadCnt = 0;
+	int failedCnt = 0;
+};
+
+bool setupShaderHotReload();
+void cleanupShaderHotReload();
+void watchShaderProgram(ReloadableProgram &prog, string vertexPath, string fragPath, GLuint programID, vector<string> defines = {});
+void unwatchShaderProgram(ReloadableProgram &prog);
+bool updateReloadableProgram(ReloadableProgram &prog);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SHADER_PERMUTATION_H
+#define SHADER_PERMUTATION_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Shader.hpp"
+#include "ShaderHotReload.hpp"
+using namespace std;
+
+// One vertex/fragment file pair compiled into several variants, each with its own #defines
+// (e.g., LIGHTING_PHONG vs. LIGHTING_GGX). A variant is built the first time it is asked for,
+// through the program cache, and kept until cleanupShaderPermutations().
+
+struct ShaderVariant {
+	vector<string> defines;
+	ReloadableProgram program;		// programID is the linked program (follows hot reloads)
+	bool failed = false;			// Did not compile; not retried until the files change
+};
+
+struct ShaderPermutationSet {
+	string vertexPath;
+	string fragPath;
+	string vertexCode;
+	string fragCode;
+	unordered_map<string, ShaderVariant> variants;	// getShaderDefinesKey() -> variant
+	bool watched = false;			// Register variants for hot reload
+
+	int buildCnt = 0;				// Variants built (from source or cache)
+	double buildMS = 0.0;
+};
+
+void loadShaderPermutations(ShaderPermutationSet &perms, string vertexPath, string fragPath);
+void getShaderVariantSource(ShaderPermutationSet &perms, vector<string> defines, string &vertexCode, string &fragCode);
+void addShaderVariant(ShaderPermutationSet &perms, vector<string> defines, GLuint programID);
+GLuint getShaderVariant(ShaderPermutationSet &perms, vector<string> defines);
+void watchShaderPermutations(ShaderPermutationSet &perms);
+bool updateShaderPermutations(ShaderPermutationSet &perms);
+void cleanupShaderPermutations(ShaderPermutationSet &perms);
+void printShaderPermutationStats(ShaderPermutationSet &perms);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SHADOW_MAP_GL_H
+#define SHADOW_MAP_GL_H
+
+#include <iostream>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+using namespace std;
+
+// Texture unit the USE_SHADOWS variants of shaders/Common/Lit.fs sample the cube from
+const GLuint SHADOW_MAP_UNIT = 5;
+
+// Omnidirectional shadow map for one point light: a depth cube map holding the
+// linear distance to the nearest caster (divided by farZ) in each direction,
+// sampled with hardware comparison (samplerCubeShadow).
+//
+// The map is cached: it is only re-rendered when the light moves or the
+// app's caster version changes (bump it whenever a shadow-casting transform
+// changes), so a static scene pays for the six face passes once.
+struct ShadowMapGL {
+	GLuint cubeTex = 0;
+	GLuint FBO = 0;
+	int size = 0;
+	float nearZ = 0.01f;
+	float farZ = 50.0f;
+
+	// What the current contents were rendered for
+	bool valid = false;
+	glm::vec3 lightPos = glm::vec3(0.0f);
+	uint64_t casterVersion = 0;
+
+	// Updates vs. frames that reused the cached map
+	int updateCnt = 0;
+	int reuseCnt = 0;
+	double updateMS = 0.0;		// Total CPU time spent issuing updates
+};
+
+void createShadowMapGL(ShadowMapGL &sm, int size = 1024, float nearZ = 0.01f, float farZ = 50.0f);
+bool isShadowMapStale(ShadowMapGL &sm, glm::vec3 lightPos, uint64_t casterVersion);
+glm::mat4 getShadowProjection(ShadowMapGL &sm);
+glm::mat4 getShadowFaceView(glm::vec3 lightPos, int face);
+void beginShadowFace(ShadowMapGL &sm, int face);
+void finishShadowUpdate(ShadowMapGL &sm, glm::vec3 lightPos, uint64_t casterVersion, double ms);
+void invalidateShadowMap(ShadowMapGL &sm);
+void bindShadowMap(ShadowMapGL &sm, GLuint unit = SHADOW_MAP_UNIT);
+void cleanupShadowMapGL(ShadowMapGL &sm);
+void printShadowMapStats(ShadowMapGL &sm);
+
+#endif
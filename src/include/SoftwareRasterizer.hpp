@@ -0,0 +1,106 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+#include "MeshData.hpp"
+#include "ThreadPool.hpp"
+using namespace std;
+
+// CPU rendering backend for machines without a GPU (same Mesh, camera and light as Assign07):
+//   draw:  vertices are transformed on the pool; triangles are clipped (near/far and a guard band),
+//          set up (fixed-point edge equations, depth plane) and binned into screen tiles in fixed
+//          batches, so each batch fills its own bins and submission order is kept without locks
+//   end:   tiles are claimed by the pool's threads one at a time. Each triangle is first tested
+//          per 8x8 block against the block's farthest depth (hierarchical z) and its edges, then
+//          4 pixels at a time with SSE2 edge functions. Only the nearest triangle per pixel is
+//          kept, and each covered pixel is shaded once with the GGX of shaders/Common/Lit.fs.
+// The color buffer is RGBA8, top row first (ready for stbi_write_png).
+
+const int SWR_TILE_SIZE = 64;
+const int SWR_BLOCK_SIZE = 8;
+const int SWR_SUBPIXEL_BITS = 4;
+const int SWR_BATCH_TRIS = 2048;		// Input triangles per setup/binning batch
+const int SWR_MAX_SIZE = 4096;			// Largest width/height (keeps edge equations in 32 bits)
+
+// Per-draw surface parameters (Lit.fs uniforms)
+struct SoftwareMaterial {
+	float metallic = 0.0f;
+	float roughness = 0.1f;
+};
+
+// Point light in view space
+struct SoftwareLight {
+	glm::vec3 pos = glm::vec3(0.0f);
+	glm::vec3 color = glm::vec3(1.0f);
+};
+
+// Transformed vertex (clip position plus what Lit.vs passes to the fragment shader)
+struct SoftwareVertex {
+	glm::vec4 clip;
+	glm::vec3 viewPos;
+	glm::vec3 normal;
+	glm::vec3 color;
+};
+
+// Set-up triangle; edge k is opposite vertex k and is >= 0 inside
+struct SoftwareTriangle {
+	int edgeA[3];				// Per subpixel step in x (y0 - y1)
+	int edgeB[3];				// Per subpixel step in y (x1 - x0)
+	long long edgeC[3];			// Bias for the top-left rule folded in
+	int minX, minY, maxX, maxY;	// Pixel bounds (inclusive, clamped to the screen)
+	float zOrigin, dzdx, dzdy;	// Depth plane (at the center of pixel 0,0; per pixel)
+	float minZ;
+	float invArea;				// For barycentrics
+	float invW[3];
+	SoftwareVertex v[3];		// Attributes divided by w (perspective-correct interpolation)
+	SoftwareMaterial material;
+};
+
+// Triangles set up from one range of input triangles and their per-tile lists
+struct SoftwareBatch {
+	vector<SoftwareTriangle> triangles;
+	vector<vector<int>> tileTriangles;		// Indices into triangles, per tile
+};
+
+struct SoftwareFrameStats {
+	long long inputTriangles = 0;
+	long long setupTriangles = 0;		// After clipping and dropping empty/offscreen ones
+	long long binnedTriangles = 0;		// Triangle-tile pairs
+	long long testedBlocks = 0;
+	long long depthRejectedBlocks = 0;	// Rejected by the hierarchical depth test
+	long long shadedPixels = 0;
+	double vertexMS = 0.0;
+	double setupMS = 0.0;				// Clipping, setup and binning
+	double rasterMS = 0.0;				// Rasterization and shading
+};
+
+struct SoftwareRenderer {
+	int width = 0;
+	int height = 0;
+	int tilesX = 0;
+	int tilesY = 0;
+	ThreadPool *pool = nullptr;
+
+	// Current frame
+	glm::mat4 viewMat = glm::mat4(1.0f);
+	glm::mat4 projMat = glm::mat4(1.0f);
+	SoftwareLight light;
+	glm::vec3 clearColor = glm::vec3(0.0f);
+	vector<SoftwareVertex> vertices;		// Current draw
+	vector<SoftwareBatch> batches;			// Kept across frames (bins keep their capacity)
+	int batchCnt = 0;						// In use this frame
+
+	vector<unsigned char> color;			// RGBA8, top-down
+	SoftwareFrameStats stats;
+};
+
+bool setupSoftwareRenderer(SoftwareRenderer &sr, int width, int height, ThreadPool &pool);
+void beginSoftwareFrame(SoftwareRenderer &sr, glm::mat4 viewMat, glm::mat4 projMat, SoftwareLight light, glm::vec3 clearColor);
+void drawSoftwareMesh(SoftwareRenderer &sr, const Mesh &mesh, glm::mat4 modelMat, SoftwareMaterial material);
+void endSoftwareFrame(SoftwareRenderer &sr);
+bool writeSoftwareImage(SoftwareRenderer &sr, string filename);
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef TEXTURE_ARRAYS_H
+#define TEXTURE_ARRAYS_H
+
+#include <iostream>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+#include "TextureCache.hpp"
+using namespace std;
+
+// Material textures packed into GL_TEXTURE_2D_ARRAYs: every texture with the same size,
+// format and mip count becomes one layer of the same array, and a material table in a
+// shader storage buffer says which array and layer each material samples.
+// All arrays and the table are bound once per pass (bindTextureArrays); a draw only
+// selects its material (the materialIndex uniform of Lit.fs, USE_TEXTURE_ARRAYS),
+// so meshes with different textures need no texture binds in between, and a
+// multi-draw path can index the same table with gl_DrawID.
+
+// Texture units albedoArrays[] in Lit.fs is bound to (ALBEDO_ARRAY_UNIT + array index)
+const GLuint ALBEDO_ARRAY_UNIT = 7;
+const int MAX_TEXTURE_ARRAYS = 8;
+
+// Shader storage binding of the material table (after the clustered light buffers)
+const GLuint MATERIAL_TABLE_BINDING = 3;
+
+// One array: all layers share size, format and mip count
+struct TextureArrayGL {
+	GLuint texID = 0;
+	int width = 0;
+	int height = 0;
+	int mipCnt = 0;
+	GLenum internalFormat = GL_NONE;
+	int layerCnt = 0;
+	int layerCapacity = 0;		// Doubled (and the layers copied over) when full
+	size_t layerBytes = 0;
+};
+
+// Material table entry (layout matches materialLayers in Lit.fs, std430 ivec2)
+struct MaterialLayer {
+	GLint arrayIndex = -1;		// -1: untextured (or not loaded yet)
+	GLint layer = -1;
+};
+
+struct TextureArrays {
+	TextureCache *cache = nullptr;
+	vector<TextureArrayGL> arrays;
+
+	// Per material: its texture until it has been copied into a layer, and where it went
+	vector<string> keys;			// Texture key ("" for untextured)
+	vector<Texture*> pending;
+	vector<MaterialLayer> materials;
+	GLuint materialSSBO = 0;
+	size_t materialBytes = 0;
+	bool tableDirty = true;
+
+	// Stats
+	int placedCnt = 0;
+	int overflowCnt = 0;		// Textures that did not fit into MAX_TEXTURE_ARRAYS arrays
+	size_t copiedBytes = 0;
+	double copyMS = 0.0;
+};
+
+void setupTextureArrays(TextureArrays &ta, TextureCache &cache);
+int addTextureMaterial(TextureArrays &ta, Texture *texture);
+int updateTextureArrays(TextureArrays &ta);
+bool isTextureArraysIdle(TextureArrays &ta);
+void bindTextureArrays(TextureArrays &ta);
+void cleanupTextureArrays(TextureArrays &ta);
+void printTextureArrayStats(TextureArrays &ta);
+
+#endif
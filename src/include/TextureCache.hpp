@@ -0,0 +1,102 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <assimp/scene.h>
+#include "ThreadPool.hpp"
+#include "BlockCompression.hpp"
+using namespace std;
+
+// Texture unit the USE_ALBEDO_MAP variants of shaders/Common/Lit.fs sample the base color from
+const GLuint ALBEDO_MAP_UNIT = 6;
+
+// One cached image (RGBA8 with a full mip chain, or BC1/3/5/7 as stored in a KTX2/DDS file).
+// texID stays 0 until the decoded pixels have been uploaded; bindCachedTexture()
+// substitutes the cache's 1x1 white texture meanwhile, so nothing waits on a decode.
+struct Texture {
+	string key;				// Normalized file path (or model path + "*N" for embedded images)
+	GLuint texID = 0;
+	int width = 0;
+	int height = 0;
+	int mipCnt = 0;
+	GLenum internalFormat = GL_NONE;	// GL_RGBA8 or the block-compressed format
+	size_t gpuBytes = 0;
+	bool compressed = false;
+	int refCnt = 0;
+	bool ready = false;
+	bool failed = false;
+};
+
+// Decoder output handed from a worker to the GL thread: all mip levels back to back
+// (compressedFormat != 0: blocks as read from the file, uploaded without decoding)
+struct DecodedTexture {
+	string key;
+	GLenum compressedFormat = 0;
+	BlockFormat blockFormat = BLOCK_BC7;
+	vector<unsigned char> pixels;
+	vector<size_t> mipOffsets;
+	vector<int> mipWidths;
+	vector<int> mipHeights;
+	bool failed = false;
+};
+
+// Path-keyed, reference-counted texture cache.
+// acquire*() queue the decode (stb_image + CPU box-filter mips) on a thread pool and
+// return at once; updateTextureCache() uploads finished images through a pixel
+// unpack buffer, a bounded number of bytes per call, so a model with dozens of
+// textures fills in over a few frames instead of stalling the first one.
+// Everything except the decode itself happens on the thread that owns the context.
+//
+// With preferCompressed, a request for foo.png loads foo.ktx2 or foo.dds instead when
+// one exists next to it (see the TextureCompressor tool): 4-8x less memory and upload
+// traffic, and no decode or mip generation at load time.
+struct TextureCache {
+	ThreadPool *pool = nullptr;
+	unordered_map<string, Texture> textures;	// Node-based: Texture pointers stay valid
+
+	// Worker -> GL thread
+	mutex decodedLock;
+	condition_variable decodedWake;
+	deque<DecodedTexture> decoded;
+	int decodingCnt = 0;						// Queued or running decode jobs
+
+	// Called on a worker after each decode (e.g. to request a redraw)
+	function<void()> onDecoded;
+
+	GLuint fallbackTex = 0;						// 1x1 white
+	GLuint uploadPBO = 0;
+	size_t uploadBudget = 0;					// Bytes per updateTextureCache() call (at least one image)
+	bool preferCompressed = true;				// Off if the context lacks S3TC or BPTC
+
+	// Stats
+	int requestCnt = 0;
+	int loadCnt = 0;
+	int failedCnt = 0;
+	int compressedCnt = 0;
+	double decodeMS = 0.0;						// Summed over workers (guarded by decodedLock)
+	double uploadMS = 0.0;
+	size_t uploadedBytes = 0;					// = GPU memory of everything uploaded so far
+};
+
+void setupTextureCache(TextureCache &cache, ThreadPool &pool, size_t uploadBudget = 16 << 20);
+Texture* acquireTexture(TextureCache &cache, string path);
+Texture* acquireMaterialTexture(TextureCache &cache, const aiScene *scene, unsigned int materialIndex, string modelPath);
+void releaseTexture(TextureCache &cache, Texture *texture);
+int updateTextureCache(TextureCache &cache);
+bool isTextureCacheIdle(TextureCache &cache);
+void waitTextureCache(TextureCache &cache);
+void bindCachedTexture(TextureCache &cache, Texture *texture, GLuint unit = ALBEDO_MAP_UNIT);
+void generateMipChain(DecodedTexture &image, int width, int height);
+void cleanupTextureCache(TextureCache &cache);
+void printTextureCacheStats(TextureCache &cache);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+using namespace std;
+
+// Fixed set of worker threads fed from one job queue.
+// parallelFor() splits a range across the workers and the calling thread.
+struct ThreadPool {
+	vector<thread> workers;
+	deque<function<void()>> jobs;
+	mutex lock;
+	condition_variable wake;		// Jobs queued or stopping
+	condition_variable idle;		// Queue empty and no job running
+	int runningCnt = 0;
+	bool stopping = false;
+};
+
+void startThreadPool(ThreadPool &pool, int threadCnt = 0);
+void stopThreadPool(ThreadPool &pool);
+void submitJob(ThreadPool &pool, function<void()> job);
+void waitThreadPool(ThreadPool &pool);
+void parallelFor(ThreadPool &pool, int count, function<void(int begin, int end)> body);
+
+#endif
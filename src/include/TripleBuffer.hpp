@@ -0,0 +1,53 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+using namespace std;
+
+// Lock-free single-producer/single-consumer triple buffer.
+// The producer fills writeSlot() and publish()es it; the consumer calls acquire()
+// and then reads readSlot(). Neither side ever waits: the producer always has a
+// free slot, and the consumer always sees a complete (most recent) snapshot.
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : writeIndex(0), readIndex(1), middle(2) {}
+
+	// Initialize all three slots (before any other thread touches the buffer)
+	void reset(const T &value) {
+		for(int i = 0; i < 3; i++) slots[i] = value;
+		writeIndex = 0;
+		readIndex = 1;
+		middle.store(2);
+	}
+
+	// Producer side
+	T& writeSlot() { return slots[writeIndex]; }
+
+	void publish() {
+		// Hand our slot over (marked fresh) and take whichever slot was in the middle
+		int old = middle.exchange(writeIndex | FRESH_BIT, memory_order_acq_rel);
+		writeIndex = old & INDEX_MASK;
+	}
+
+	// Consumer side; returns true if a newer snapshot was picked up
+	bool acquire() {
+		if(!(middle.load(memory_order_relaxed) & FRESH_BIT)) return false;
+		int old = middle.exchange(readIndex, memory_order_acq_rel);
+		readIndex = old & INDEX_MASK;
+		return true;
+	}
+
+	const T& readSlot() const { return slots[readIndex]; }
+
+private:
+	static const int INDEX_MASK = 3;
+	static const int FRESH_BIT = 4;
+
+	T slots[3];
+	int writeIndex;			// Owned by producer
+	int readIndex;			// Owned by consumer
+	atomic<int> middle;		// Shared: index of the spare slot + fresh flag
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define UTILITY_H
 
 #include <iostream>
+#include <string>
 #include <assimp/scene.h>
 #include "glm/glm.hpp"
 #define GLM_ENABLE_EXPERIMENTAL
@@ -12,4 +13,12 @@ void aiMatToGLM4(aiMatrix4x4 &a, glm::mat4 &m);
 void printTab(int cnt);
 void printNodeInfo(aiNode *node, glm::mat4 &nodeT, glm::mat4 &parentMat, glm::mat4 &currentMat, int level);
 
+// Command line helpers; matched options are removed from argv so positional
+// arguments (e.g., the model path) stay at argv[1]
+bool consumeFlag(int &argc, char **argv, string flag);
+bool consumeOption(int &argc, char **argv, string name, string &value);
+
+// Quoted and escaped, for hand-written JSON reports
+string jsonString(string s);
+
 #endif
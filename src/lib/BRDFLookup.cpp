@@ -0,0 +1,116 @@
+#include "BRDFLookup.hpp"
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+
+static const float PI = 3.14159265359f;
+
+// Low-discrepancy point i of n (Hammersley: i/n and the radical inverse of i)
+static glm::vec2 getHammersley(uint32_t i, uint32_t n) {
+	uint32_t bits = i;
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return glm::vec2((float)i / (float)n, (float)bits * 2.3283064365386963e-10f);
+}
+
+// Half vector distributed like the GGX NDF (normal is +Z)
+static glm::vec3 sampleGGX(glm::vec2 xi, float roughness) {
+	float a = roughness * roughness;
+	float phi = 2.0f * PI * xi.x;
+	float cosTheta = sqrt((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+	float sinTheta = sqrt(1.0f - cosTheta * cosTheta);
+	return glm::vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+}
+
+// Schlick-GGX for one direction (same k as getSchlickGeo in the shader)
+static float getSchlickGeo(float NdotB, float roughness) {
+	float k = (roughness + 1.0f) * (roughness + 1.0f) / 8.0f;
+	return NdotB / (NdotB * (1.0f - k) + k);
+}
+
+// Integrate one texel: average of F*G*VdotH/(NdotH*NdotV) over GGX samples, split into scale/bias on F0
+static glm::vec2 integrateBRDF(float NdotV, float roughness, int sampleCnt) {
+	glm::vec3 V(sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+	float A = 0.0f;
+	float B = 0.0f;
+	for(int i = 0; i < sampleCnt; i++) {
+		glm::vec3 H = sampleGGX(getHammersley(i, sampleCnt), roughness);
+		glm::vec3 L = 2.0f * glm::dot(V, H) * H - V;
+		float NdotL = max(L.z, 0.0f);
+		float NdotH = max(H.z, 0.0f);
+		float VdotH = max(glm::dot(V, H), 0.0f);
+		if(NdotL <= 0.0f) continue;
+
+		float G = getSchlickGeo(NdotL, roughness) * getSchlickGeo(NdotV, roughness);
+		float GVis = G * VdotH / (NdotH * NdotV);
+		float Fc = pow(1.0f - VdotH, 5.0f);
+		A += (1.0f - Fc) * GVis;
+		B += Fc * GVis;
+	}
+	return glm::vec2(A, B) / (float)sampleCnt;
+}
+
+// Fill size x size RG table (half floats, rows = roughness); rows are split across all cores
+void computeBRDFLookup(vector<uint16_t> &halfRG, int size, int sampleCnt) {
+	halfRG.assign((size_t)size * size * 2, 0);
+	int threadCnt = max(1, min((int)thread::hardware_concurrency(), size));
+	vector<thread> workers;
+	for(int t = 0; t < threadCnt; t++) {
+		workers.push_back(thread([&, t]() {
+			for(int y = t; y < size; y += threadCnt) {
+				float roughness = ((float)y + 0.5f) / (float)size;
+				for(int x = 0; x < size; x++) {
+					float NdotV = ((float)x + 0.5f) / (float)size;
+					glm::vec2 AB = integrateBRDF(NdotV, roughness, sampleCnt);
+					size_t index = ((size_t)y * size + x) * 2;
+					halfRG[index] = (uint16_t)glm::packHalf1x16(AB.x);
+					halfRG[index + 1] = (uint16_t)glm::packHalf1x16(AB.y);
+				}
+			}
+		}));
+	}
+	for(thread &worker : workers) worker.join();
+}
+
+// Compute table on the CPU and upload it as an RG16F texture (bilinear, clamped)
+void createBRDFLookup(BRDFLookup &lut, int size, int sampleCnt) {
+	auto start = chrono::steady_clock::now();
+	vector<uint16_t> halfRG;
+	computeBRDFLookup(halfRG, size, sampleCnt);
+	lut.computeMS = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	lut.size = size;
+	lut.sampleCnt = sampleCnt;
+
+	glGenTextures(1, &(lut.texID));
+	glBindTexture(GL_TEXTURE_2D, lut.texID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, size, size);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RG, GL_HALF_FLOAT, halfRG.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	cout << "BRDF lookup: " << size << "x" << size << " RG16F, " << sampleCnt << " samples/texel, ";
+	cout << lut.computeMS << " ms" << endl;
+}
+
+// Bind table to texture unit (Lit.fs expects BRDF_LOOKUP_UNIT)
+void bindBRDFLookup(BRDFLookup &lut, GLuint unit) {
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, lut.texID);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void cleanupBRDFLookup(BRDFLookup &lut) {
+	if(lut.texID) glDeleteTextures(1, &(lut.texID));
+	lut.texID = 0;
+}
@@ -0,0 +1,303 @@
+#include "BlockCompression.hpp"
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+static const char *BLOCK_FORMAT_NAMES[BLOCK_FORMAT_CNT] = { "bc1", "bc3", "bc5", "bc7" };
+
+string getBlockFormatName(BlockFormat format) {
+	return BLOCK_FORMAT_NAMES[format];
+}
+
+bool parseBlockFormat(string name, BlockFormat &format) {
+	transform(name.begin(), name.end(), name.begin(), ::tolower);
+	for(int i = 0; i < BLOCK_FORMAT_CNT; i++) {
+		if(name == BLOCK_FORMAT_NAMES[i]) {
+			format = (BlockFormat)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+int getBlockBytes(BlockFormat format) {
+	return (format == BLOCK_BC1) ? 8 : 16;
+}
+
+size_t getCompressedLevelSize(BlockFormat format, int width, int height) {
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes(format);
+}
+
+// Endpoints of the line that best fits the block's texels (first channelCnt channels):
+// principal axis by power iteration, extent from the smallest/largest projection
+static void findEndpoints(const unsigned char rgba[64], int channelCnt, float e0[4], float e1[4]) {
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float minC[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+	float maxC[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for(int i = 0; i < 16; i++) {
+		for(int c = 0; c < channelCnt; c++) {
+			float v = rgba[i * 4 + c];
+			mean[c] += v;
+			minC[c] = min(minC[c], v);
+			maxC[c] = max(maxC[c], v);
+		}
+	}
+	for(int c = 0; c < channelCnt; c++) mean[c] /= 16.0f;
+
+	float cov[4][4] = {};
+	for(int i = 0; i < 16; i++) {
+		for(int a = 0; a < channelCnt; a++) {
+			for(int b = 0; b < channelCnt; b++) {
+				cov[a][b] += (rgba[i * 4 + a] - mean[a]) * (rgba[i * 4 + b] - mean[b]);
+			}
+		}
+	}
+
+	// Start from the bounding box diagonal (already close for most blocks)
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for(int c = 0; c < channelCnt; c++) axis[c] = maxC[c] - minC[c];
+	for(int iter = 0; iter < 8; iter++) {
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float len = 0.0f;
+		for(int a = 0; a < channelCnt; a++) {
+			for(int b = 0; b < channelCnt; b++) next[a] += cov[a][b] * axis[b];
+			len += next[a] * next[a];
+		}
+		if(len < 1e-12f) break;
+		len = sqrt(len);
+		for(int c = 0; c < channelCnt; c++) axis[c] = next[c] / len;
+	}
+
+	float len = 0.0f;
+	for(int c = 0; c < channelCnt; c++) len += axis[c] * axis[c];
+	if(len < 1e-12f) {
+		// Flat block
+		for(int c = 0; c < channelCnt; c++) e0[c] = e1[c] = mean[c];
+		return;
+	}
+	len = sqrt(len);
+	for(int c = 0; c < channelCnt; c++) axis[c] /= len;
+
+	float tMin = 1e30f, tMax = -1e30f;
+	for(int i = 0; i < 16; i++) {
+		float t = 0.0f;
+		for(int c = 0; c < channelCnt; c++) t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+		tMin = min(tMin, t);
+		tMax = max(tMax, t);
+	}
+	for(int c = 0; c < channelCnt; c++) {
+		e0[c] = min(max(mean[c] + axis[c] * tMin, 0.0f), 255.0f);
+		e1[c] = min(max(mean[c] + axis[c] * tMax, 0.0f), 255.0f);
+	}
+}
+
+static int getSquaredError(const int *a, const unsigned char *b, int channelCnt) {
+	int err = 0;
+	for(int c = 0; c < channelCnt; c++) err += (a[c] - b[c]) * (a[c] - b[c]);
+	return err;
+}
+
+static uint16_t packRGB565(const float rgb[3]) {
+	int r = (int)(rgb[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(rgb[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(rgb[2] * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t c, int rgb[3]) {
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 color block: two RGB565 endpoints (color0 > color1: four-color mode) + 2-bit indices
+static void encodeBC1(const unsigned char rgba[64], unsigned char out[8]) {
+	float e0[4], e1[4];
+	findEndpoints(rgba, 3, e0, e1);
+	uint16_t c0 = packRGB565(e1);
+	uint16_t c1 = packRGB565(e0);
+	if(c0 < c1) swap(c0, c1);
+
+	uint32_t indices = 0;
+	if(c0 != c1) {
+		int palette[4][3];
+		unpackRGB565(c0, palette[0]);
+		unpackRGB565(c1, palette[1]);
+		for(int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for(int i = 0; i < 16; i++) {
+			int best = 0, bestErr = 1 << 30;
+			for(int p = 0; p < 4; p++) {
+				int err = getSquaredError(palette[p], rgba + i * 4, 3);
+				if(err < bestErr) {
+					bestErr = err;
+					best = p;
+				}
+			}
+			indices |= (uint32_t)best << (2 * i);
+		}
+	}
+
+	out[0] = c0 & 0xFF;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF;
+	out[3] = c1 >> 8;
+	memcpy(out + 4, &indices, 4);
+}
+
+// BC4 single-channel block (channel of rgba): two 8-bit endpoints (a0 > a1: eight values) + 3-bit indices
+static void encodeBC4(const unsigned char rgba[64], int channel, unsigned char out[8]) {
+	int a0 = 0, a1 = 255;
+	for(int i = 0; i < 16; i++) {
+		a0 = max(a0, (int)rgba[i * 4 + channel]);
+		a1 = min(a1, (int)rgba[i * 4 + channel]);
+	}
+
+	uint64_t indices = 0;
+	if(a0 != a1) {
+		int palette[8] = { a0, a1 };
+		for(int p = 2; p < 8; p++) palette[p] = ((8 - p) * a0 + (p - 1) * a1) / 7;
+		for(int i = 0; i < 16; i++) {
+			int v = rgba[i * 4 + channel];
+			int best = 0, bestErr = 1 << 30;
+			for(int p = 0; p < 8; p++) {
+				int err = abs(palette[p] - v);
+				if(err < bestErr) {
+					bestErr = err;
+					best = p;
+				}
+			}
+			indices |= (uint64_t)best << (3 * i);
+		}
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for(int b = 0; b < 6; b++) out[2 + b] = (unsigned char)(indices >> (8 * b));
+}
+
+// Little-endian bit writer for one 128-bit BC7 block
+struct BlockBits {
+	unsigned char *out;
+	int pos = 0;
+};
+
+static void writeBits(BlockBits &bits, uint32_t value, int count) {
+	for(int i = 0; i < count; i++, bits.pos++) {
+		if(value & (1u << i)) bits.out[bits.pos >> 3] |= (unsigned char)(1 << (bits.pos & 7));
+	}
+}
+
+// BC7 mode 6: one subset, RGBA 7.7.7.7 endpoints + one p-bit each, 4-bit indices
+static void encodeBC7(const unsigned char rgba[64], unsigned char out[16]) {
+	static const int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float e[2][4];
+	findEndpoints(rgba, 4, e[0], e[1]);
+
+	// Quantize each endpoint with whichever p-bit reproduces it more closely
+	int q[2][4], p[2], ends[2][4];
+	for(int k = 0; k < 2; k++) {
+		float bestErr = 1e30f;
+		for(int pbit = 0; pbit < 2; pbit++) {
+			int tq[4];
+			float err = 0.0f;
+			for(int c = 0; c < 4; c++) {
+				tq[c] = min(max((int)((e[k][c] - pbit) / 2.0f + 0.5f), 0), 127);
+				float d = (float)((tq[c] << 1) | pbit) - e[k][c];
+				err += d * d;
+			}
+			if(err < bestErr) {
+				bestErr = err;
+				p[k] = pbit;
+				memcpy(q[k], tq, sizeof(tq));
+			}
+		}
+		for(int c = 0; c < 4; c++) ends[k][c] = (q[k][c] << 1) | p[k];
+	}
+
+	int palette[16][4];
+	for(int w = 0; w < 16; w++) {
+		for(int c = 0; c < 4; c++) palette[w][c] = ((64 - WEIGHTS[w]) * ends[0][c] + WEIGHTS[w] * ends[1][c] + 32) >> 6;
+	}
+	int indices[16];
+	for(int i = 0; i < 16; i++) {
+		int best = 0, bestErr = 1 << 30;
+		for(int w = 0; w < 16; w++) {
+			int err = getSquaredError(palette[w], rgba + i * 4, 4);
+			if(err < bestErr) {
+				bestErr = err;
+				best = w;
+			}
+		}
+		indices[i] = best;
+	}
+
+	// The first index is stored without its top bit, so it must be < 8: swap the endpoints if not
+	if(indices[0] >= 8) {
+		swap(q[0], q[1]);
+		swap(p[0], p[1]);
+		for(int i = 0; i < 16; i++) indices[i] = 15 - indices[i];
+	}
+
+	memset(out, 0, 16);
+	BlockBits bits;
+	bits.out = out;
+	writeBits(bits, 1 << 6, 7);
+	for(int c = 0; c < 4; c++) {
+		writeBits(bits, q[0][c], 7);
+		writeBits(bits, q[1][c], 7);
+	}
+	writeBits(bits, p[0], 1);
+	writeBits(bits, p[1], 1);
+	writeBits(bits, indices[0], 3);
+	for(int i = 1; i < 16; i++) writeBits(bits, indices[i], 4);
+}
+
+void encodeBlock(BlockFormat format, const unsigned char rgba[64], unsigned char *out) {
+	switch(format) {
+	case BLOCK_BC1:
+		encodeBC1(rgba, out);
+		break;
+	case BLOCK_BC3:
+		encodeBC4(rgba, 3, out);
+		encodeBC1(rgba, out + 8);
+		break;
+	case BLOCK_BC5:
+		encodeBC4(rgba, 0, out);
+		encodeBC4(rgba, 1, out + 8);
+		break;
+	default:
+		encodeBC7(rgba, out);
+		break;
+	}
+}
+
+void compressImage(BlockFormat format, const unsigned char *rgba, int width, int height, unsigned char *out, ThreadPool *pool) {
+	int blocksX = (width + 3) / 4;
+	int blocksY = (height + 3) / 4;
+	int blockBytes = getBlockBytes(format);
+
+	auto encodeRows = [=](int begin, int end) {
+		unsigned char block[64];
+		for(int by = begin; by < end; by++) {
+			for(int bx = 0; bx < blocksX; bx++) {
+				for(int y = 0; y < 4; y++) {
+					int sy = min(by * 4 + y, height - 1);
+					for(int x = 0; x < 4; x++) {
+						int sx = min(bx * 4 + x, width - 1);
+						memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+					}
+				}
+				encodeBlock(format, block, out + ((size_t)by * blocksX + bx) * blockBytes);
+			}
+		}
+	};
+
+	if(pool) parallelFor(*pool, blocksY, encodeRows);
+	else encodeRows(0, blocksY);
+}
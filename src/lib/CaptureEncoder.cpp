@@ -0,0 +1,367 @@
+#include "CaptureEncoder.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <zlib.h>
+#include "stb_image_write.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+string getCaptureFormatName(CaptureFormat format) {
+	switch(format) {
+		case CAPTURE_PNG: return "png";
+		case CAPTURE_PNG_STB: return "stb";
+		case CAPTURE_QOI: return "qoi";
+		default: return "unknown";
+	}
+}
+
+string getCaptureFormatExtension(CaptureFormat format) {
+	return (format == CAPTURE_QOI) ? ".qoi" : ".png";
+}
+
+// "png", "stb" or "qoi"
+bool parseCaptureFormat(string name, CaptureFormat &format) {
+	for(int i = 0; i < CAPTURE_FORMAT_CNT; i++) {
+		if(name == getCaptureFormatName((CaptureFormat)i)) {
+			format = (CaptureFormat)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void putU32(vector<unsigned char> &out, unsigned long v) {
+	out.push_back((unsigned char)(v >> 24));
+	out.push_back((unsigned char)(v >> 16));
+	out.push_back((unsigned char)(v >> 8));
+	out.push_back((unsigned char)v);
+}
+
+// QOI (qoiformat.org): every pixel becomes a run, an index into the 64 most recently seen
+// colors, a small difference to the previous pixel, or the literal color
+void encodeQOI(const unsigned char *pixels, int width, int height, int channels, vector<unsigned char> &out) {
+	size_t pixelCnt = (size_t)width * height;
+	out.clear();
+	out.reserve(14 + pixelCnt * (channels + 1) / 2 + 8);
+	out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+	putU32(out, (unsigned long)width);
+	putU32(out, (unsigned long)height);
+	out.push_back((unsigned char)channels);
+	out.push_back(0);		// sRGB with linear alpha
+
+	unsigned char index[64][4] = {};
+	unsigned char prev[4] = { 0, 0, 0, 255 };
+	int run = 0;
+	for(size_t i = 0; i < pixelCnt; i++) {
+		const unsigned char *p = pixels + i * channels;
+		unsigned char px[4] = { p[0], p[1], p[2], (unsigned char)(channels == 4 ? p[3] : 255) };
+		if(memcmp(px, prev, 4) == 0) {
+			if(++run == 62 || i == pixelCnt - 1) {
+				out.push_back((unsigned char)(0xc0 | (run - 1)));
+				run = 0;
+			}
+			continue;
+		}
+		if(run > 0) {
+			out.push_back((unsigned char)(0xc0 | (run - 1)));
+			run = 0;
+		}
+
+		int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+		if(memcmp(index[hash], px, 4) == 0) {
+			out.push_back((unsigned char)hash);
+		}
+		else {
+			memcpy(index[hash], px, 4);
+			if(px[3] == prev[3]) {
+				int dr = (signed char)(px[0] - prev[0]);
+				int dg = (signed char)(px[1] - prev[1]);
+				int db = (signed char)(px[2] - prev[2]);
+				int drg = dr - dg;
+				int dbg = db - dg;
+				if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+					out.push_back((unsigned char)(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+				}
+				else if(dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+					out.push_back((unsigned char)(0x80 | (dg + 32)));
+					out.push_back((unsigned char)((drg + 8) << 4 | (dbg + 8)));
+				}
+				else {
+					out.insert(out.end(), { 0xfe, px[0], px[1], px[2] });
+				}
+			}
+			else {
+				out.insert(out.end(), { 0xff, px[0], px[1], px[2], px[3] });
+			}
+		}
+		memcpy(prev, px, 4);
+	}
+	out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+}
+
+static inline int paethPredictor(int a, int b, int c) {
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if(pa <= pb && pa <= pc) return a;
+	if(pb <= pc) return b;
+	return c;
+}
+
+// Filter one row with all five PNG filters and keep the one with the smallest sum of
+// absolute (signed) bytes, the usual heuristic. dst gets the filter type byte, then the row.
+static void filterRow(const unsigned char *row, const unsigned char *prev, int rowBytes, int bpp,
+					  unsigned char *dst, vector<unsigned char> &scratch) {
+	scratch.resize((size_t)rowBytes * 5);
+	unsigned char *out[5];
+	for(int f = 0; f < 5; f++) out[f] = scratch.data() + (size_t)f * rowBytes;
+	long long sums[5] = {};
+
+	auto filterBytes = [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			int x = row[i];
+			int a = (i >= bpp) ? row[i - bpp] : 0;
+			int b = prev[i];
+			int c = (i >= bpp) ? prev[i - bpp] : 0;
+			out[0][i] = (unsigned char)x;
+			out[1][i] = (unsigned char)(x - a);
+			out[2][i] = (unsigned char)(x - b);
+			out[3][i] = (unsigned char)(x - ((a + b) >> 1));
+			out[4][i] = (unsigned char)(x - paethPredictor(a, b, c));
+			for(int f = 0; f < 5; f++) sums[f] += abs((int)(signed char)out[f][i]);
+		}
+	};
+
+	// The first pixel has no left neighbour
+	int i = min(bpp, rowBytes);
+	filterBytes(0, i);
+#ifdef __SSE2__
+	// 16 bytes per step. Filtering only reads unfiltered bytes, so every filter is independent
+	// per byte; Paeth is evaluated in 16-bit lanes. |signed byte| is min(v, -v) as unsigned,
+	// summed with _mm_sad_epu8.
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i sumVecs[5] = { zero, zero, zero, zero, zero };
+	auto paeth8 = [&](__m128i a, __m128i b, __m128i c) {
+		__m128i bc = _mm_sub_epi16(b, c);
+		__m128i ac = _mm_sub_epi16(a, c);
+		__m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+		__m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+		__m128i abc = _mm_add_epi16(bc, ac);
+		__m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+		__m128i useA = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)), _mm_set1_epi16(-1));
+		__m128i useB = _mm_andnot_si128(_mm_cmpgt_epi16(pb, pc), _mm_set1_epi16(-1));
+		__m128i bOrC = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c));
+		return _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, bOrC));
+	};
+	for(; i + 16 <= rowBytes; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+		__m128i a = _mm_loadu_si128((const __m128i*)(row + i - bpp));
+		__m128i b = _mm_loadu_si128((const __m128i*)(prev + i));
+		__m128i c = _mm_loadu_si128((const __m128i*)(prev + i - bpp));
+
+		// floor((a + b) / 2): _mm_avg_epu8 rounds up, so take the carry back off
+		__m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+		__m128i pred = _mm_packus_epi16(
+			paeth8(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero)),
+			paeth8(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero)));
+
+		__m128i filtered[5] = { x, _mm_sub_epi8(x, a), _mm_sub_epi8(x, b), _mm_sub_epi8(x, avg), _mm_sub_epi8(x, pred) };
+		for(int f = 0; f < 5; f++) {
+			_mm_storeu_si128((__m128i*)(out[f] + i), filtered[f]);
+			__m128i absBytes = _mm_min_epu8(filtered[f], _mm_sub_epi8(zero, filtered[f]));
+			sumVecs[f] = _mm_add_epi64(sumVecs[f], _mm_sad_epu8(absBytes, zero));
+		}
+	}
+	for(int f = 0; f < 5; f++) {
+		sums[f] += _mm_cvtsi128_si32(sumVecs[f]) + _mm_cvtsi128_si32(_mm_srli_si128(sumVecs[f], 8));
+	}
+#endif
+	filterBytes(i, rowBytes);
+
+	int best = (int)(min_element(sums, sums + 5) - sums);
+	dst[0] = (unsigned char)best;
+	memcpy(dst + 1, out[best], rowBytes);
+}
+
+// Filter rows [rowBegin, rowEnd) into out (1 + rowBytes per row)
+static void filterRows(const unsigned char *pixels, int rowBytes, int bpp, int rowBegin, int rowEnd, vector<unsigned char> &out) {
+	vector<unsigned char> zeroRow(rowBytes, 0);
+	vector<unsigned char> scratch;
+	out.resize((size_t)(rowEnd - rowBegin) * (rowBytes + 1));
+	for(int y = rowBegin; y < rowEnd; y++) {
+		const unsigned char *row = pixels + (size_t)y * rowBytes;
+		const unsigned char *prev = (y > 0) ? row - rowBytes : zeroRow.data();
+		filterRow(row, prev, rowBytes, bpp, out.data() + (size_t)(y - rowBegin) * (rowBytes + 1), scratch);
+	}
+}
+
+// One strip of the image stream, ready to go into an IDAT chunk
+struct PNGStrip {
+	vector<unsigned char> data;		// Deflate blocks (the first strip starts with the zlib header)
+	uLong adler = 1;				// Of the filtered bytes
+	size_t filteredBytes = 0;
+	uLong crc = 0;					// Of "IDAT" + data
+	bool ok = false;
+};
+
+// Filter and deflate rows [rowBegin, rowEnd). Every strip but the last ends with a sync flush
+// (an empty stored block, byte-aligned, not final), so the strips concatenate into one stream.
+static void encodePNGStrip(const unsigned char *pixels, int height, int rowBytes, int bpp, int rowBegin, int rowEnd,
+						   int level, PNGStrip &strip) {
+	vector<unsigned char> filtered;
+	filterRows(pixels, rowBytes, bpp, rowBegin, rowEnd, filtered);
+	strip.filteredBytes = filtered.size();
+	strip.adler = adler32(adler32(0L, Z_NULL, 0), filtered.data(), (uInt)filtered.size());
+
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	if(deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return;
+
+	// Matches may reach back into the previous strip: give the compressor its last 32 KB
+	if(rowBegin > 0) {
+		int dictRows = min(rowBegin, 32768 / (rowBytes + 1) + 1);
+		vector<unsigned char> dict;
+		filterRows(pixels, rowBytes, bpp, rowBegin - dictRows, rowBegin, dict);
+		size_t dictBytes = min(dict.size(), (size_t)32768);
+		deflateSetDictionary(&zs, dict.data() + dict.size() - dictBytes, (uInt)dictBytes);
+	}
+
+	size_t headerBytes = 0;
+	strip.data.resize(deflateBound(&zs, (uLong)filtered.size()) + 64);
+	if(rowBegin == 0) {
+		// CMF: deflate, 32 KB window; FLG: level hint with the check bits for (CMF*256 + FLG) % 31 == 0
+		strip.data[0] = 0x78;
+		strip.data[1] = (level >= 7) ? 0xda : (level == 6 || level < 0) ? 0x9c : (level >= 2) ? 0x5e : 0x01;
+		headerBytes = 2;
+	}
+
+	bool last = (rowEnd == height);
+	zs.next_in = filtered.data();
+	zs.avail_in = (uInt)filtered.size();
+	zs.next_out = strip.data.data() + headerBytes;
+	zs.avail_out = (uInt)(strip.data.size() - headerBytes);
+	while(true) {
+		int rc = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+		if(rc == Z_STREAM_ERROR) {
+			deflateEnd(&zs);
+			return;
+		}
+		if(last ? (rc == Z_STREAM_END) : (zs.avail_out > 0)) break;
+
+		// Out of room (should not happen with deflateBound): grow and continue
+		size_t used = strip.data.size() - zs.avail_out;
+		strip.data.resize(strip.data.size() * 2);
+		zs.next_out = strip.data.data() + used;
+		zs.avail_out = (uInt)(strip.data.size() - used);
+	}
+	strip.data.resize(strip.data.size() - zs.avail_out);
+	deflateEnd(&zs);
+
+	strip.crc = crc32(crc32(0L, (const Bytef*)"IDAT", 4), strip.data.data(), (uInt)strip.data.size());
+	strip.ok = true;
+}
+
+static void putChunk(vector<unsigned char> &out, const char *type, const unsigned char *data, size_t size) {
+	putU32(out, (unsigned long)size);
+	out.insert(out.end(), type, type + 4);
+	if(size > 0) out.insert(out.end(), data, data + size);
+	uLong crc = crc32(0L, (const Bytef*)type, 4);
+	if(size > 0) crc = crc32(crc, data, (uInt)size);		// (a null buffer would reset it)
+	putU32(out, crc);
+}
+
+// PNG of top-down 8-bit pixels (1-4 channels). Strips are encoded on pool (nullptr: one strip,
+// on the calling thread); one strip per thread, at least 16 rows each.
+void encodePNG(const unsigned char *pixels, int width, int height, int channels, vector<unsigned char> &out,
+			   ThreadPool *pool, int level) {
+	int rowBytes = width * channels;
+	int threadCnt = pool ? (int)pool->workers.size() + 1 : 1;
+	int stripCnt = max(1, min(threadCnt, height / 16));
+	vector<PNGStrip> strips(stripCnt);
+	auto encodeStrips = [&](int begin, int end) {
+		for(int s = begin; s < end; s++) {
+			int rowBegin = (int)((long long)height * s / stripCnt);
+			int rowEnd = (int)((long long)height * (s + 1) / stripCnt);
+			encodePNGStrip(pixels, height, rowBytes, channels, rowBegin, rowEnd, level, strips[s]);
+		}
+	};
+	if(pool && stripCnt > 1) parallelFor(*pool, stripCnt, encodeStrips);
+	else encodeStrips(0, stripCnt);
+
+	out.clear();
+	for(PNGStrip &strip : strips) {
+		if(!strip.ok) {
+			cerr << "ERROR: zlib failed while encoding a PNG strip" << endl;
+			return;
+		}
+	}
+
+	// Signature and header
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	const unsigned char colorTypes[5] = { 0, 0, 4, 2, 6 };
+	out.insert(out.end(), signature, signature + 8);
+	vector<unsigned char> header;
+	putU32(header, (unsigned long)width);
+	putU32(header, (unsigned long)height);
+	header.insert(header.end(), { 8, colorTypes[channels], 0, 0, 0 });
+	putChunk(out, "IHDR", header.data(), header.size());
+
+	// One IDAT per strip (their CRCs are already done); the zlib trailer is the Adler-32 of all
+	// filtered bytes, combined from the strips', and goes at the end of the last one
+	uLong adler = adler32(0L, Z_NULL, 0);
+	for(PNGStrip &strip : strips) adler = adler32_combine(adler, strip.adler, (z_off_t)strip.filteredBytes);
+	vector<unsigned char> trailer;
+	putU32(trailer, adler);
+	for(int s = 0; s < stripCnt; s++) {
+		PNGStrip &strip = strips[s];
+		bool last = (s == stripCnt - 1);
+		putU32(out, (unsigned long)(strip.data.size() + (last ? 4 : 0)));
+		out.insert(out.end(), { 'I', 'D', 'A', 'T' });
+		out.insert(out.end(), strip.data.begin(), strip.data.end());
+		uLong crc = strip.crc;
+		if(last) {
+			out.insert(out.end(), trailer.begin(), trailer.end());
+			crc = crc32(crc, trailer.data(), 4);
+		}
+		putU32(out, crc);
+	}
+	putChunk(out, "IEND", nullptr, 0);
+}
+
+static void appendBytes(void *context, void *data, int size) {
+	vector<unsigned char> *out = (vector<unsigned char>*)context;
+	out->insert(out->end(), (unsigned char*)data, (unsigned char*)data + size);
+}
+
+// Encode top-down pixels in format; false (nothing in out) on failure
+bool encodeCaptureImage(CaptureFormat format, const unsigned char *pixels, int width, int height, int channels,
+						vector<unsigned char> &out, ThreadPool *pool) {
+	out.clear();
+	if(width <= 0 || height <= 0 || channels < 1 || channels > 4) return false;
+	switch(format) {
+		case CAPTURE_PNG:
+			encodePNG(pixels, width, height, channels, out, pool);
+			break;
+		case CAPTURE_PNG_STB:
+			stbi_write_png_to_func(appendBytes, &out, width, height, channels, pixels, width * channels);
+			break;
+		case CAPTURE_QOI:
+			if(channels < 3) return false;
+			encodeQOI(pixels, width, height, channels, out);
+			break;
+		default:
+			return false;
+	}
+	return !out.empty();
+}
+
+bool writeCaptureFile(string filename, const vector<unsigned char> &bytes) {
+	FILE *file = fopen(filename.c_str(), "wb");
+	if(!file) return false;
+	bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	ok = (fclose(file) == 0) && ok;
+	return ok;
+}
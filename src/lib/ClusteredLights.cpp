@@ -0,0 +1,190 @@
+#include "ClusteredLights.hpp"
+#include "GLState.hpp"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+// Create the shader storage buffers
+void setupClusteredLights(ClusteredLights &cl, int tilesX, int tilesY, int slices) {
+	cl.tilesX = tilesX;
+	cl.tilesY = tilesY;
+	cl.slices = slices;
+	glGenBuffers(1, &(cl.lightSSBO));
+	glGenBuffers(1, &(cl.rangeSSBO));
+	glGenBuffers(1, &(cl.indexSSBO));
+}
+
+// View-space depth (positive) where slice begins
+static float getSliceDepth(ClusteredLights &cl, int slice) {
+	return cl.nearZ * pow(cl.farZ / cl.nearZ, (float)slice / (float)cl.slices);
+}
+
+// Slice containing view-space depth (clamped to the grid)
+static int getDepthSlice(ClusteredLights &cl, float depth) {
+	float s = log(max(depth, cl.nearZ) / cl.nearZ) / log(cl.farZ / cl.nearZ) * cl.slices;
+	return glm::clamp((int)s, 0, cl.slices - 1);
+}
+
+// Recompute froxel bounds for a (symmetric) perspective projection; call when it changes
+void setClusterProjection(ClusteredLights &cl, glm::mat4 projection, float nearZ, float farZ) {
+	cl.projection = projection;
+	cl.nearZ = nearZ;
+	cl.farZ = farZ;
+
+	int clusterCnt = cl.tilesX * cl.tilesY * cl.slices;
+	cl.clusterMin.resize(clusterCnt);
+	cl.clusterMax.resize(clusterCnt);
+	float sx = 1.0f / projection[0][0];
+	float sy = 1.0f / projection[1][1];
+
+	for(int s = 0; s < cl.slices; s++) {
+		float d0 = getSliceDepth(cl, s);
+		float d1 = getSliceDepth(cl, s + 1);
+		for(int y = 0; y < cl.tilesY; y++) {
+			float y0 = -1.0f + 2.0f * y / cl.tilesY;
+			float y1 = -1.0f + 2.0f * (y + 1) / cl.tilesY;
+			for(int x = 0; x < cl.tilesX; x++) {
+				float x0 = -1.0f + 2.0f * x / cl.tilesX;
+				float x1 = -1.0f + 2.0f * (x + 1) / cl.tilesX;
+
+				// Tile edges at both slice depths (view space looks down -Z)
+				int index = x + cl.tilesX * (y + cl.tilesY * s);
+				cl.clusterMin[index] = glm::vec3(min(x0 * d0, x0 * d1) * sx, min(y0 * d0, y0 * d1) * sy, -d1);
+				cl.clusterMax[index] = glm::vec3(max(x1 * d0, x1 * d1) * sx, max(y1 * d0, y1 * d1) * sy, -d0);
+			}
+		}
+	}
+}
+
+// Scale/offset that map gl_FragCoord and view depth to froxel coordinates:
+// (tilesX / width, tilesY / height, slices / log(far / near), log(near))
+glm::vec4 getClusterScale(ClusteredLights &cl, int width, int height) {
+	return glm::vec4((float)cl.tilesX / max(width, 1), (float)cl.tilesY / max(height, 1),
+		cl.slices / log(cl.farZ / cl.nearZ), log(cl.nearZ));
+}
+
+// Screen tile covered by view-space x (or y) range over a depth range (conservative)
+static void getTileRange(float lo, float hi, float d0, float d1, float scale, int tileCnt, int &t0, int &t1) {
+	float a = min(min(lo / d0, lo / d1), min(hi / d0, hi / d1)) * scale;
+	float b = max(max(lo / d0, lo / d1), max(hi / d0, hi / d1)) * scale;
+	t0 = glm::clamp((int)floor((a * 0.5f + 0.5f) * tileCnt), 0, tileCnt - 1);
+	t1 = glm::clamp((int)floor((b * 0.5f + 0.5f) * tileCnt), 0, tileCnt - 1);
+}
+
+// Does the sphere touch the box?
+static bool sphereTouchesBox(glm::vec3 center, float radius, glm::vec3 minB, glm::vec3 maxB) {
+	glm::vec3 closest = glm::clamp(center, minB, maxB);
+	glm::vec3 delta = closest - center;
+	return glm::dot(delta, delta) <= radius * radius;
+}
+
+// Transform lights to view space and build the per-froxel light lists.
+// Depth slices are split across the pool; each slice is written by one thread only.
+void assignClusterLights(ClusteredLights &cl, vector<ClusterLight> &worldLights, glm::mat4 viewMat, ThreadPool &pool) {
+	auto start = chrono::steady_clock::now();
+	int lightCnt = (int)worldLights.size();
+	int tilesPerSlice = cl.tilesX * cl.tilesY;
+
+	cl.viewLights.resize(lightCnt);
+	for(int i = 0; i < lightCnt; i++) {
+		glm::vec4 pos = viewMat * glm::vec4(glm::vec3(worldLights[i].posRadius), 1.0f);
+		cl.viewLights[i].posRadius = glm::vec4(glm::vec3(pos), worldLights[i].posRadius.w);
+		cl.viewLights[i].color = worldLights[i].color;
+	}
+
+	cl.clusterRanges.assign((size_t)tilesPerSlice * cl.slices * 2, 0);
+	cl.sliceIndices.resize(cl.slices);
+	float scaleX = cl.projection[0][0];
+	float scaleY = cl.projection[1][1];
+
+	parallelFor(pool, cl.slices, [&](int begin, int end) {
+		for(int s = begin; s < end; s++) {
+			vector<uint32_t> &indices = cl.sliceIndices[s];
+			indices.clear();
+			float s0 = getSliceDepth(cl, s);
+			float s1 = getSliceDepth(cl, s + 1);
+
+			// Lights overlapping this slice, with their tile rectangles
+			vector<int> candidates;
+			vector<int> rects;
+			for(int i = 0; i < lightCnt; i++) {
+				glm::vec4 pr = cl.viewLights[i].posRadius;
+				float depth = -pr.z;
+				float d0 = max(depth - pr.w, s0);
+				float d1 = min(depth + pr.w, s1);
+				if(d0 > d1) continue;
+
+				int x0, x1, y0, y1;
+				getTileRange(pr.x - pr.w, pr.x + pr.w, d0, d1, scaleX, cl.tilesX, x0, x1);
+				getTileRange(pr.y - pr.w, pr.y + pr.w, d0, d1, scaleY, cl.tilesY, y0, y1);
+				candidates.push_back(i);
+				rects.insert(rects.end(), { x0, x1, y0, y1 });
+			}
+
+			// Froxel lists (local offsets; made global after all slices are done)
+			for(int y = 0; y < cl.tilesY; y++) {
+				for(int x = 0; x < cl.tilesX; x++) {
+					int index = x + cl.tilesX * (y + cl.tilesY * s);
+					uint32_t offset = (uint32_t)indices.size();
+					for(size_t c = 0; c < candidates.size(); c++) {
+						const int *r = &rects[c * 4];
+						if(x < r[0] || x > r[1] || y < r[2] || y > r[3]) continue;
+						glm::vec4 pr = cl.viewLights[candidates[c]].posRadius;
+						if(sphereTouchesBox(glm::vec3(pr), pr.w, cl.clusterMin[index], cl.clusterMax[index])) {
+							indices.push_back((uint32_t)candidates[c]);
+						}
+					}
+					cl.clusterRanges[index * 2] = offset;
+					cl.clusterRanges[index * 2 + 1] = (uint32_t)indices.size() - offset;
+				}
+			}
+		}
+	});
+
+	// Concatenate slices
+	cl.lightIndices.clear();
+	cl.maxLightsPerCluster = 0;
+	long long refCnt = 0;
+	int usedCnt = 0;
+	for(int s = 0; s < cl.slices; s++) {
+		uint32_t base = (uint32_t)cl.lightIndices.size();
+		for(int t = 0; t < tilesPerSlice; t++) {
+			int index = t + tilesPerSlice * s;
+			uint32_t count = cl.clusterRanges[index * 2 + 1];
+			cl.clusterRanges[index * 2] += base;
+			cl.maxLightsPerCluster = max(cl.maxLightsPerCluster, (int)count);
+			refCnt += count;
+			if(count > 0) usedCnt++;
+		}
+		cl.lightIndices.insert(cl.lightIndices.end(), cl.sliceIndices[s].begin(), cl.sliceIndices[s].end());
+	}
+	cl.meanLightsPerCluster = usedCnt > 0 ? (double)refCnt / usedCnt : 0.0;
+	cl.assignMS = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Replace buffer contents (orphaning the old storage) and bind it to its SSBO slot
+static void uploadStorage(GLuint buffer, GLuint binding, const void *data, size_t bytes, size_t &capacity) {
+	bindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	if(bytes > capacity) capacity = max(bytes, capacity * 2);
+	capacity = max(capacity, (size_t)16);	// Never empty (a zero-sized binding is an error)
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+	if(data && bytes > 0) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, data);
+	bindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+}
+
+// Upload this frame's lights and froxel lists
+void uploadClusterLights(ClusteredLights &cl) {
+	uploadStorage(cl.lightSSBO, CLUSTER_LIGHT_BINDING, cl.viewLights.empty() ? NULL : cl.viewLights.data(),
+		cl.viewLights.size() * sizeof(ClusterLight), cl.lightBytes);
+	uploadStorage(cl.rangeSSBO, CLUSTER_RANGE_BINDING, cl.clusterRanges.data(),
+		cl.clusterRanges.size() * sizeof(uint32_t), cl.rangeBytes);
+	uploadStorage(cl.indexSSBO, CLUSTER_INDEX_BINDING, cl.lightIndices.empty() ? NULL : cl.lightIndices.data(),
+		cl.lightIndices.size() * sizeof(uint32_t), cl.indexBytes);
+	bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void cleanupClusteredLights(ClusteredLights &cl) {
+	deleteBuffer(cl.lightSSBO);
+	deleteBuffer(cl.rangeSSBO);
+	deleteBuffer(cl.indexSSBO);
+}
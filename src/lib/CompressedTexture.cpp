@@ -0,0 +1,376 @@
+#include "CompressedTexture.hpp"
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+// KTX2: identifier, header, index, one (offset, length, uncompressed length) entry per level
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const size_t KTX2_HEADER_SIZE = 80;
+
+// Vulkan format numbers used by KTX2
+static const uint32_t VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+static const uint32_t VK_FORMAT_BC1_RGBA_UNORM_BLOCK = 133;
+static const uint32_t VK_FORMAT_BC3_UNORM_BLOCK = 137;
+static const uint32_t VK_FORMAT_BC5_UNORM_BLOCK = 141;
+static const uint32_t VK_FORMAT_BC7_UNORM_BLOCK = 145;
+
+// Khronos data format descriptor color models for the block formats
+static const uint8_t KHR_DF_MODEL_BC1A = 128;
+static const uint8_t KHR_DF_MODEL_BC3 = 130;
+static const uint8_t KHR_DF_MODEL_BC5 = 132;
+static const uint8_t KHR_DF_MODEL_BC7 = 134;
+
+// DDS: "DDS " + 124-byte header (+ 20-byte DX10 header when the FourCC is "DX10")
+static const size_t DDS_HEADER_SIZE = 128;
+static const size_t DDS_DX10_HEADER_SIZE = 20;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DXGI_FORMAT_BC1_UNORM = 71;
+static const uint32_t DXGI_FORMAT_BC3_UNORM = 77;
+static const uint32_t DXGI_FORMAT_BC5_UNORM = 83;
+static const uint32_t DXGI_FORMAT_BC7_UNORM = 98;
+
+static uint32_t makeFourCC(const char *s) {
+	return (uint32_t)s[0] | ((uint32_t)s[1] << 8) | ((uint32_t)s[2] << 16) | ((uint32_t)s[3] << 24);
+}
+
+// Little-endian fields (the formats are little-endian, as are the platforms we build for)
+static uint32_t readU32(const vector<unsigned char> &bytes, size_t offset) {
+	uint32_t v;
+	memcpy(&v, bytes.data() + offset, 4);
+	return v;
+}
+
+static uint64_t readU64(const vector<unsigned char> &bytes, size_t offset) {
+	uint64_t v;
+	memcpy(&v, bytes.data() + offset, 8);
+	return v;
+}
+
+static void putU32(vector<unsigned char> &bytes, size_t offset, uint32_t v) {
+	memcpy(bytes.data() + offset, &v, 4);
+}
+
+static void putU64(vector<unsigned char> &bytes, size_t offset, uint64_t v) {
+	memcpy(bytes.data() + offset, &v, 8);
+}
+
+bool isKTX2File(const vector<unsigned char> &bytes) {
+	return bytes.size() >= sizeof(KTX2_IDENTIFIER) && memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+bool isDDSFile(const vector<unsigned char> &bytes) {
+	return bytes.size() >= 4 && memcmp(bytes.data(), "DDS ", 4) == 0;
+}
+
+// Levels in a full chain down to 1x1
+static int getFullMipCount(int width, int height) {
+	int levelCnt = 1;
+	for(int size = max(width, height); size > 1; size /= 2) levelCnt++;
+	return levelCnt;
+}
+
+// Fill in the level layout of a tightly packed chain and check it fits in dataSize
+// (levelCnt comes from the file, so stop at the first level that does not fit)
+static bool layoutMipChain(CompressedImage &image, int width, int height, int levelCnt, size_t dataSize) {
+	image.mipOffsets.clear();
+	image.mipWidths.clear();
+	image.mipHeights.clear();
+	if(levelCnt > getFullMipCount(width, height)) return false;
+	size_t offset = 0;
+	for(int level = 0; level < levelCnt; level++) {
+		image.mipOffsets.push_back(offset);
+		image.mipWidths.push_back(width);
+		image.mipHeights.push_back(height);
+		offset += getCompressedLevelSize(image.format, width, height);
+		if(offset > dataSize) return false;
+		width = max(1, width / 2);
+		height = max(1, height / 2);
+	}
+	return true;
+}
+
+static bool parseKTX2(const vector<unsigned char> &bytes, CompressedImage &image, string &error) {
+	if(bytes.size() < KTX2_HEADER_SIZE) {
+		error = "truncated KTX2 header";
+		return false;
+	}
+	uint32_t vkFormat = readU32(bytes, 12);
+	int width = (int)readU32(bytes, 20);
+	int height = (int)readU32(bytes, 24);
+	uint32_t depth = readU32(bytes, 28);
+	uint32_t layerCnt = readU32(bytes, 32);
+	uint32_t faceCnt = readU32(bytes, 36);
+	int levelCnt = max(1, (int)readU32(bytes, 40));
+	uint32_t supercompression = readU32(bytes, 44);
+
+	image.hasAlpha = true;
+	if(vkFormat == VK_FORMAT_BC1_RGB_UNORM_BLOCK || vkFormat == VK_FORMAT_BC1_RGBA_UNORM_BLOCK) {
+		image.format = BLOCK_BC1;
+		image.hasAlpha = (vkFormat == VK_FORMAT_BC1_RGBA_UNORM_BLOCK);
+	}
+	else if(vkFormat == VK_FORMAT_BC3_UNORM_BLOCK) image.format = BLOCK_BC3;
+	else if(vkFormat == VK_FORMAT_BC5_UNORM_BLOCK) image.format = BLOCK_BC5;
+	else if(vkFormat == VK_FORMAT_BC7_UNORM_BLOCK) image.format = BLOCK_BC7;
+	else {
+		error = "unsupported KTX2 format " + to_string(vkFormat);
+		return false;
+	}
+	if(supercompression != 0) {
+		error = "supercompressed KTX2 is not supported";
+		return false;
+	}
+	if(depth > 1 || layerCnt > 1 || faceCnt != 1 || width <= 0 || height <= 0) {
+		error = "only single 2D KTX2 images are supported";
+		return false;
+	}
+	if(bytes.size() < KTX2_HEADER_SIZE + (size_t)levelCnt * 24) {
+		error = "truncated KTX2 level index";
+		return false;
+	}
+
+	// Check every level lies inside the file before allocating anything
+	if(!layoutMipChain(image, width, height, levelCnt, SIZE_MAX)) {
+		error = "too many KTX2 levels";
+		return false;
+	}
+	for(int level = 0; level < levelCnt; level++) {
+		uint64_t offset = readU64(bytes, KTX2_HEADER_SIZE + level * 24);
+		uint64_t length = readU64(bytes, KTX2_HEADER_SIZE + level * 24 + 8);
+		size_t expected = getCompressedLevelSize(image.format, image.mipWidths[level], image.mipHeights[level]);
+		if(length != expected || offset > bytes.size() || length > bytes.size() - offset) {
+			error = "bad KTX2 level " + to_string(level);
+			return false;
+		}
+	}
+
+	// Levels may be stored in any order (usually smallest first); copy them into level order
+	size_t total = getCompressedLevelSize(image.format, image.mipWidths.back(), image.mipHeights.back()) + image.mipOffsets.back();
+	image.data.resize(total);
+	for(int level = 0; level < levelCnt; level++) {
+		uint64_t offset = readU64(bytes, KTX2_HEADER_SIZE + level * 24);
+		size_t length = getCompressedLevelSize(image.format, image.mipWidths[level], image.mipHeights[level]);
+		memcpy(image.data.data() + image.mipOffsets[level], bytes.data() + offset, length);
+	}
+	return true;
+}
+
+static bool parseDDS(const vector<unsigned char> &bytes, CompressedImage &image, string &error) {
+	if(bytes.size() < DDS_HEADER_SIZE) {
+		error = "truncated DDS header";
+		return false;
+	}
+	int height = (int)readU32(bytes, 12);
+	int width = (int)readU32(bytes, 16);
+	int levelCnt = max(1, (int)readU32(bytes, 28));
+	uint32_t pfFlags = readU32(bytes, 80);
+	uint32_t fourCC = readU32(bytes, 84);
+	size_t dataOffset = DDS_HEADER_SIZE;
+
+	if(!(pfFlags & DDPF_FOURCC)) {
+		error = "uncompressed DDS is not supported";
+		return false;
+	}
+	image.hasAlpha = true;
+	if(fourCC == makeFourCC("DXT1")) image.format = BLOCK_BC1;
+	else if(fourCC == makeFourCC("DXT5")) image.format = BLOCK_BC3;
+	else if(fourCC == makeFourCC("ATI2") || fourCC == makeFourCC("BC5U")) image.format = BLOCK_BC5;
+	else if(fourCC == makeFourCC("DX10")) {
+		if(bytes.size() < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE) {
+			error = "truncated DDS DX10 header";
+			return false;
+		}
+		uint32_t dxgiFormat = readU32(bytes, 128);
+		uint32_t arraySize = readU32(bytes, 140);
+		dataOffset += DDS_DX10_HEADER_SIZE;
+		if(dxgiFormat == DXGI_FORMAT_BC1_UNORM) image.format = BLOCK_BC1;
+		else if(dxgiFormat == DXGI_FORMAT_BC3_UNORM) image.format = BLOCK_BC3;
+		else if(dxgiFormat == DXGI_FORMAT_BC5_UNORM) image.format = BLOCK_BC5;
+		else if(dxgiFormat == DXGI_FORMAT_BC7_UNORM) image.format = BLOCK_BC7;
+		else {
+			error = "unsupported DXGI format " + to_string(dxgiFormat);
+			return false;
+		}
+		if(arraySize > 1) {
+			error = "DDS texture arrays are not supported";
+			return false;
+		}
+	}
+	else {
+		error = "unsupported DDS FourCC";
+		return false;
+	}
+	if(width <= 0 || height <= 0) {
+		error = "bad DDS size";
+		return false;
+	}
+
+	if(levelCnt > getFullMipCount(width, height)) {
+		error = "bad DDS level count";
+		return false;
+	}
+
+	// Levels follow the header in order, tightly packed
+	if(!layoutMipChain(image, width, height, levelCnt, bytes.size() - dataOffset)) {
+		error = "truncated DDS data";
+		return false;
+	}
+	size_t total = image.mipOffsets.back() + getCompressedLevelSize(image.format, image.mipWidths.back(), image.mipHeights.back());
+	image.data.assign(bytes.begin() + dataOffset, bytes.begin() + dataOffset + total);
+	return true;
+}
+
+bool parseCompressedTexture(const vector<unsigned char> &bytes, CompressedImage &image, string &error) {
+	if(isKTX2File(bytes)) return parseKTX2(bytes, image, error);
+	if(isDDSFile(bytes)) return parseDDS(bytes, image, error);
+	error = "not a KTX2 or DDS file";
+	return false;
+}
+
+static void writeFile(string filename, vector<unsigned char> &bytes) {
+	ofstream file(filename, ios::binary);
+	file.write((const char*)bytes.data(), bytes.size());
+	if(!file) {
+		cerr << "ERROR: Could not write " << filename << endl;
+		throw runtime_error("Could not write " + filename);
+	}
+}
+
+// Data format descriptor: one basic block describing the format's channels
+static vector<unsigned char> makeKTX2Descriptor(CompressedImage &image) {
+	struct Sample {
+		uint8_t channel;
+		uint16_t bitOffset;
+		uint8_t bitLength;
+	};
+	uint8_t model = KHR_DF_MODEL_BC7;
+	vector<Sample> samples;
+	if(image.format == BLOCK_BC1) {
+		model = KHR_DF_MODEL_BC1A;
+		samples.push_back({ (uint8_t)(image.hasAlpha ? 1 : 0), 0, 63 });
+	}
+	else if(image.format == BLOCK_BC3) {
+		model = KHR_DF_MODEL_BC3;
+		samples.push_back({ 15, 0, 63 });		// Alpha
+		samples.push_back({ 0, 64, 63 });		// Color
+	}
+	else if(image.format == BLOCK_BC5) {
+		model = KHR_DF_MODEL_BC5;
+		samples.push_back({ 0, 0, 63 });		// Red
+		samples.push_back({ 1, 64, 63 });		// Green
+	}
+	else {
+		samples.push_back({ 0, 0, 127 });
+	}
+
+	uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+	vector<unsigned char> dfd(4 + blockSize, 0);
+	putU32(dfd, 0, (uint32_t)dfd.size());
+	putU32(dfd, 4, 0);								// Khronos vendor, basic descriptor type
+	putU32(dfd, 8, 2 | (blockSize << 16));			// Version 2, block size
+	dfd[12] = model;
+	dfd[13] = 1;									// BT.709 primaries
+	dfd[14] = 1;									// Linear transfer
+	dfd[15] = 0;									// Straight alpha
+	dfd[16] = 3;									// 4x4 texel blocks (dimension - 1)
+	dfd[17] = 3;
+	dfd[20] = (unsigned char)getBlockBytes(image.format);
+	for(size_t s = 0; s < samples.size(); s++) {
+		size_t base = 28 + 16 * s;
+		dfd[base] = samples[s].bitOffset & 0xFF;
+		dfd[base + 1] = samples[s].bitOffset >> 8;
+		dfd[base + 2] = samples[s].bitLength;
+		dfd[base + 3] = samples[s].channel;
+		putU32(dfd, base + 12, 0xFFFFFFFFu);		// sampleUpper (sampleLower stays 0)
+	}
+	return dfd;
+}
+
+// KTX2 with the levels stored smallest first (as the specification recommends for streaming)
+void writeKTX2(string filename, CompressedImage &image) {
+	int levelCnt = (int)image.mipOffsets.size();
+	vector<unsigned char> dfd = makeKTX2Descriptor(image);
+	size_t indexEnd = KTX2_HEADER_SIZE + (size_t)levelCnt * 24;
+	size_t dfdOffset = indexEnd;
+	size_t align = (size_t)getBlockBytes(image.format);
+	size_t dataOffset = (dfdOffset + dfd.size() + align - 1) / align * align;
+
+	vector<unsigned char> bytes(dataOffset, 0);
+	memcpy(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	uint32_t vkFormat = VK_FORMAT_BC7_UNORM_BLOCK;
+	if(image.format == BLOCK_BC1) vkFormat = image.hasAlpha ? VK_FORMAT_BC1_RGBA_UNORM_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	else if(image.format == BLOCK_BC3) vkFormat = VK_FORMAT_BC3_UNORM_BLOCK;
+	else if(image.format == BLOCK_BC5) vkFormat = VK_FORMAT_BC5_UNORM_BLOCK;
+	putU32(bytes, 12, vkFormat);
+	putU32(bytes, 16, 1);							// typeSize
+	putU32(bytes, 20, image.mipWidths[0]);
+	putU32(bytes, 24, image.mipHeights[0]);
+	putU32(bytes, 28, 0);							// pixelDepth
+	putU32(bytes, 32, 0);							// layerCount
+	putU32(bytes, 36, 1);							// faceCount
+	putU32(bytes, 40, levelCnt);
+	putU32(bytes, 44, 0);							// No supercompression
+	putU32(bytes, 48, (uint32_t)dfdOffset);
+	putU32(bytes, 52, (uint32_t)dfd.size());
+	memcpy(bytes.data() + dfdOffset, dfd.data(), dfd.size());
+
+	for(int level = levelCnt - 1; level >= 0; level--) {
+		size_t size = getCompressedLevelSize(image.format, image.mipWidths[level], image.mipHeights[level]);
+		size_t offset = (bytes.size() + align - 1) / align * align;
+		bytes.resize(offset + size, 0);
+		memcpy(bytes.data() + offset, image.data.data() + image.mipOffsets[level], size);
+		putU64(bytes, KTX2_HEADER_SIZE + level * 24, offset);
+		putU64(bytes, KTX2_HEADER_SIZE + level * 24 + 8, size);
+		putU64(bytes, KTX2_HEADER_SIZE + level * 24 + 16, size);
+	}
+	writeFile(filename, bytes);
+}
+
+// DDS: legacy FourCC for BC1/BC3 (read by every tool), DX10 header for BC5/BC7
+void writeDDS(string filename, CompressedImage &image) {
+	bool dx10 = (image.format == BLOCK_BC5 || image.format == BLOCK_BC7);
+	size_t dataOffset = DDS_HEADER_SIZE + (dx10 ? DDS_DX10_HEADER_SIZE : 0);
+	int levelCnt = (int)image.mipOffsets.size();
+
+	vector<unsigned char> bytes(dataOffset, 0);
+	memcpy(bytes.data(), "DDS ", 4);
+	putU32(bytes, 4, 124);
+	putU32(bytes, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000);		// CAPS, HEIGHT, WIDTH, PIXELFORMAT, MIPMAPCOUNT, LINEARSIZE
+	putU32(bytes, 12, image.mipHeights[0]);
+	putU32(bytes, 16, image.mipWidths[0]);
+	putU32(bytes, 20, (uint32_t)getCompressedLevelSize(image.format, image.mipWidths[0], image.mipHeights[0]));
+	putU32(bytes, 28, levelCnt);
+	putU32(bytes, 76, 32);
+	putU32(bytes, 80, DDPF_FOURCC);
+	uint32_t fourCC = dx10 ? makeFourCC("DX10") : makeFourCC(image.format == BLOCK_BC1 ? "DXT1" : "DXT5");
+	putU32(bytes, 84, fourCC);
+	putU32(bytes, 108, 0x1000 | (levelCnt > 1 ? 0x400008 : 0));		// TEXTURE (+ MIPMAP, COMPLEX)
+	if(dx10) {
+		putU32(bytes, 128, image.format == BLOCK_BC5 ? DXGI_FORMAT_BC5_UNORM : DXGI_FORMAT_BC7_UNORM);
+		putU32(bytes, 132, 3);						// Texture2D
+		putU32(bytes, 140, 1);						// Array size
+	}
+	bytes.insert(bytes.end(), image.data.begin(), image.data.end());
+	writeFile(filename, bytes);
+}
+
+GLenum getCompressedGLFormat(CompressedImage &image) {
+	switch(image.format) {
+	case BLOCK_BC1:
+		return image.hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BLOCK_BC3:
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BLOCK_BC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	default:
+		return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+}
+
+// BC1/BC3 need S3TC (an extension, though universal on desktop), BC7 needs BPTC
+// (core since 4.2, still advertised as the extension); BC5 (RGTC) is core since 3.0
+bool isBlockFormatSupported(BlockFormat format) {
+	if(format == BLOCK_BC1 || format == BLOCK_BC3) return GLEW_EXT_texture_compression_s3tc;
+	if(format == BLOCK_BC7) return GLEW_ARB_texture_compression_bptc;
+	return true;
+}
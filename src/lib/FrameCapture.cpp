@@ -0,0 +1,197 @@
+#include "FrameCapture.hpp"
+#include "GLState.hpp"
+#include <filesystem>
+#include <ctime>
+#include <cstring>
+#include <algorithm>
+
+void setupFrameCapture(FrameCapture &fc, ThreadPool &pool, string directory, string prefix, int slotCnt) {
+	fc.pool = &pool;
+	fc.directory = directory;
+	fc.prefix = prefix;
+	fc.slots = vector<CaptureSlot>(max(1, slotCnt));
+	for(CaptureSlot &slot : fc.slots) glGenBuffers(1, &(slot.pbo));
+
+	error_code ec;
+	if(!directory.empty()) filesystem::create_directories(directory, ec);
+	if(ec) cerr << "WARNING: Could not create capture directory " << directory << ": " << ec.message() << endl;
+}
+
+// directory/prefix_YYYYMMDD-HHMMSS_N.png (or .qoi)
+static string makeCaptureFilename(FrameCapture &fc) {
+	time_t now = time(nullptr);
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+	string name = fc.prefix + "_" + stamp + "_" + to_string(fc.sequence++) + getCaptureFormatExtension(fc.format);
+	return fc.directory.empty() ? name : (filesystem::path(fc.directory) / name).string();
+}
+
+// Queue a read of the given framebuffer into the next free buffer (nothing waits for it).
+// False if every buffer is still busy with an earlier capture (the request is dropped).
+bool requestFrameCapture(FrameCapture &fc, GLuint readFBO, GLenum readBuffer, int width, int height, string filename) {
+	if(width <= 0 || height <= 0) {
+		cerr << "WARNING: Frame capture ignored (invalid size " << width << "x" << height << ")" << endl;
+		return false;
+	}
+	auto start = chrono::steady_clock::now();
+	fc.requestCnt++;
+	CaptureSlot &slot = fc.slots[fc.nextSlot];
+	if(slot.state != CAPTURE_FREE) {
+		cerr << "WARNING: Frame capture dropped (all " << fc.slots.size() << " readback buffers busy)" << endl;
+		fc.droppedCnt++;
+		return false;
+	}
+	fc.nextSlot = (fc.nextSlot + 1) % (int)fc.slots.size();
+
+	size_t bytes = (size_t)width * height * 4;
+	bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	if(bytes > slot.capacity) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+		slot.capacity = bytes;
+	}
+
+	GLint prevReadFBO = 0;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFBO);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+	glReadBuffer(readBuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFBO);
+	bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.state = CAPTURE_READING;
+	slot.width = width;
+	slot.height = height;
+	slot.filename = filename.empty() ? makeCaptureFilename(fc) : filename;
+	slot.requestTime = start;
+
+	fc.issueMS += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+// Worker: copy the mapped rows out bottom-up (GL's origin is the lower left), release the
+// mapping, then encode and write the file from the copy
+static void encodeCapture(FrameCapture *fc, CaptureSlot *slot, const unsigned char *mapped, int width, int height,
+						  string filename, chrono::steady_clock::time_point requestTime) {
+	auto start = chrono::steady_clock::now();
+	size_t stride = (size_t)width * 4;
+	vector<unsigned char> pixels(stride * height);
+	for(int y = 0; y < height; y++) {
+		memcpy(pixels.data() + y * stride, mapped + (size_t)(height - 1 - y) * stride, stride);
+	}
+	slot->copied.store(true, memory_order_release);
+	fc->wake.notify_all();
+
+	vector<unsigned char> encoded;
+	bool ok = encodeCaptureImage(fc->format, pixels.data(), width, height, 4, encoded, fc->pool) &&
+			  writeCaptureFile(filename, encoded);
+	if(!ok) cerr << "ERROR: Could not write capture " << filename << endl;
+
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	double latencyMS = chrono::duration<double, milli>(chrono::steady_clock::now() - requestTime).count();
+	{
+		lock_guard<mutex> guard(fc->lock);
+		fc->encodeMS += ms;
+		fc->maxLatencyMS = max(fc->maxLatencyMS, latencyMS);
+		if(ok) fc->savedCnt++;
+		else fc->failedCnt++;
+		fc->encodingCnt--;
+	}
+	fc->wake.notify_all();
+}
+
+// Once per frame on the GL thread: unmap buffers the workers are done with, and map
+// (without waiting) those whose reads have finished. Returns how many went to workers.
+int updateFrameCapture(FrameCapture &fc) {
+	auto start = chrono::steady_clock::now();
+	int handedCnt = 0;
+	bool touched = false;
+	for(CaptureSlot &slot : fc.slots) {
+		if(slot.state == CAPTURE_COPYING && slot.copied.load(memory_order_acquire)) {
+			bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			slot.state = CAPTURE_FREE;
+			touched = true;
+		}
+		else if(slot.state == CAPTURE_READING) {
+			GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if(status == GL_TIMEOUT_EXPIRED) continue;
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+			touched = true;
+
+			bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			void *mapped = (status == GL_WAIT_FAILED) ? nullptr
+				: glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)slot.width * slot.height * 4, GL_MAP_READ_BIT);
+			if(!mapped) {
+				cerr << "ERROR: Could not map capture buffer for " << slot.filename << endl;
+				lock_guard<mutex> guard(fc.lock);
+				fc.failedCnt++;
+				slot.state = CAPTURE_FREE;
+				continue;
+			}
+
+			slot.state = CAPTURE_COPYING;
+			slot.copied.store(false, memory_order_relaxed);
+			{
+				lock_guard<mutex> guard(fc.lock);
+				fc.encodingCnt++;
+			}
+			FrameCapture *fcPtr = &fc;
+			CaptureSlot *slotPtr = &slot;
+			const unsigned char *pixels = (const unsigned char*)mapped;
+			int width = slot.width, height = slot.height;
+			string filename = slot.filename;
+			auto requestTime = slot.requestTime;
+			submitJob(*fc.pool, [fcPtr, slotPtr, pixels, width, height, filename, requestTime]() {
+				encodeCapture(fcPtr, slotPtr, pixels, width, height, filename, requestTime);
+			});
+			handedCnt++;
+		}
+	}
+	if(touched) {
+		bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		fc.mapMS += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+	return handedCnt;
+}
+
+// True when no readback is pending or mapped (workers may still be encoding)
+bool isFrameCaptureIdle(FrameCapture &fc) {
+	for(CaptureSlot &slot : fc.slots) {
+		if(slot.state != CAPTURE_FREE) return false;
+	}
+	return true;
+}
+
+// Block until every requested capture is on disk (before exiting)
+void waitFrameCapture(FrameCapture &fc) {
+	while(true) {
+		updateFrameCapture(fc);
+		if(isFrameCaptureIdle(fc)) break;
+		for(CaptureSlot &slot : fc.slots) {
+			if(slot.state == CAPTURE_READING) glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		}
+		unique_lock<mutex> guard(fc.lock);
+		fc.wake.wait_for(guard, chrono::milliseconds(1));
+	}
+	unique_lock<mutex> guard(fc.lock);
+	fc.wake.wait(guard, [&fc]() { return fc.encodingCnt == 0; });
+}
+
+void cleanupFrameCapture(FrameCapture &fc) {
+	waitFrameCapture(fc);
+	for(CaptureSlot &slot : fc.slots) deleteBuffer(slot.pbo);
+	fc.slots.clear();
+}
+
+// Print saved/dropped captures and where the time went
+void printFrameCaptureStats(FrameCapture &fc) {
+	if(fc.requestCnt == 0) return;
+	cout << "Frame capture: " << fc.savedCnt << " saved";
+	if(fc.droppedCnt > 0) cout << ", " << fc.droppedCnt << " dropped";
+	if(fc.failedCnt > 0) cout << ", " << fc.failedCnt << " failed";
+	cout << "; render thread " << fc.issueMS + fc.mapMS << " ms total, workers " << fc.encodeMS << " ms";
+	cout << ", max latency " << fc.maxLatencyMS << " ms" << endl;
+}
@@ -0,0 +1,326 @@
+#include "FramePacing.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+// How long before a deadline we stop sleeping and start spinning.
+// OS sleeps routinely overshoot by ~1 ms, so sleep short and spin the rest.
+static const chrono::microseconds SPIN_MARGIN(2000);
+
+// Longest we block while idle in on-demand mode (so close requests etc. are still seen)
+static const double IDLE_WAIT_SEC = 0.5;
+
+// Assumed refresh rate when estimating what a continuous vsync loop would have drawn
+static const double ASSUMED_REFRESH_HZ = 60.0;
+
+// Package energy counter in joules (Linux RAPL); -1 if unavailable
+static double readPackageEnergyJ() {
+	ifstream file("/sys/class/powercap/intel-rapl:0/energy_uj");
+	long long microJoules = -1;
+	if(!(file >> microJoules)) return -1.0;
+	return microJoules / 1.0e6;
+}
+
+// Read pacing options from the command line:
+// --vsync (default), --uncapped, or --fps <N>; --on-demand to only redraw on changes
+void parseFramePacingArgs(int &argc, char **argv, FramePacer &pacer) {
+	string fpsValue;
+	if(consumeOption(argc, argv, "--fps", fpsValue)) {
+		double fps = atof(fpsValue.c_str());
+		if(fps > 0.0) {
+			pacer.mode = PACING_TARGET_FPS;
+			pacer.targetFPS = fps;
+		}
+		else {
+			cerr << "WARNING: Invalid --fps value: " << fpsValue << "; using vsync." << endl;
+		}
+	}
+	if(consumeFlag(argc, argv, "--uncapped")) pacer.mode = PACING_UNCAPPED;
+	if(consumeFlag(argc, argv, "--vsync")) pacer.mode = PACING_VSYNC;
+	if(consumeFlag(argc, argv, "--on-demand")) pacer.onDemand = true;
+}
+
+// Human-readable name of the current mode
+string framePacingModeName(FramePacer &pacer) {
+	switch(pacer.mode) {
+		case PACING_VSYNC:		return "vsync";
+		case PACING_UNCAPPED:	return "uncapped";
+		case PACING_TARGET_FPS:	return "target " + to_string((int)pacer.targetFPS) + " FPS";
+	}
+	return "unknown";
+}
+
+// Apply the swap interval for the chosen mode (needs a current context)
+void setupFramePacing(FramePacer &pacer) {
+	glfwSwapInterval(pacer.mode == PACING_VSYNC ? 1 : 0);
+	pacer.frameTimesMS.clear();
+	pacer.frameTimesMS.reserve(1 << 16);
+	pacer.started = false;
+	cout << "Frame pacing: " << framePacingModeName(pacer);
+	if(pacer.onDemand) cout << " (render on demand)";
+	cout << endl;
+
+	// Starting point for CPU/energy accounting
+	pacer.framesRendered = 0;
+	pacer.idleWakeups = 0;
+	pacer.runStart = chrono::steady_clock::now();
+	pacer.cpuStart = clock();
+	pacer.energyStartJ = readPackageEnergyJ();
+}
+
+// Call once per frame, right after swapping buffers.
+// Waits for the next deadline (target FPS mode) and records the frame time.
+void endFrame(FramePacer &pacer) {
+	auto now = chrono::steady_clock::now();
+
+	if(pacer.mode == PACING_TARGET_FPS) {
+		auto period = chrono::duration_cast<chrono::steady_clock::duration>(
+							chrono::duration<double>(1.0 / pacer.targetFPS));
+
+		if(!pacer.started) {
+			pacer.nextDeadline = now + period;
+		}
+		else {
+			// Coarse sleep first, then spin for the last stretch
+			if(now < pacer.nextDeadline - SPIN_MARGIN) {
+				this_thread::sleep_until(pacer.nextDeadline - SPIN_MARGIN);
+			}
+			while(chrono::steady_clock::now() < pacer.nextDeadline) {
+				this_thread::yield();
+			}
+			now = chrono::steady_clock::now();
+
+			// Advance by whole periods so we do not drift; if we fell badly behind
+			// (e.g., window was dragged), restart from now rather than bursting to catch up
+			pacer.nextDeadline += period;
+			if(now > pacer.nextDeadline + period) {
+				pacer.nextDeadline = now + period;
+			}
+		}
+	}
+
+	if(pacer.started) {
+		chrono::duration<float, milli> frameTime = now - pacer.lastFrameEnd;
+		pacer.frameTimesMS.push_back(frameTime.count());
+	}
+	pacer.lastFrameEnd = now;
+	pacer.started = true;
+}
+
+// Remember the refresh rate of the window's monitor (or the primary one); main thread only
+void queryDisplayRefresh(FramePacer &pacer, GLFWwindow *window) {
+	GLFWmonitor *monitor = glfwGetWindowMonitor(window);
+	if(!monitor) monitor = glfwGetPrimaryMonitor();
+	const GLFWvidmode *mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+	pacer.refreshHz = (mode && mode->refreshRate > 0) ? mode->refreshRate : 0.0;
+}
+
+// Rate frames actually arrive at (for clip timestamps): the target in target FPS mode,
+// the display's refresh under vsync, and the recent average when uncapped.
+// Call from the thread that calls endFrame().
+double getPacedFPS(FramePacer &pacer) {
+	if(pacer.mode == PACING_TARGET_FPS) return pacer.targetFPS;
+	if(pacer.mode == PACING_VSYNC) return pacer.refreshHz > 0.0 ? pacer.refreshHz : ASSUMED_REFRESH_HZ;
+
+	size_t cnt = min(pacer.frameTimesMS.size(), (size_t)120);
+	double sumMS = 0.0;
+	for(size_t i = pacer.frameTimesMS.size() - cnt; i < pacer.frameTimesMS.size(); i++) sumMS += pacer.frameTimesMS[i];
+	return sumMS > 0.0 ? 1000.0 * cnt / sumMS : ASSUMED_REFRESH_HZ;
+}
+
+// Compute mean/percentiles/max of a list of frame times
+FrameStats computeFrameStats(vector<float> frameTimesMS) {
+	FrameStats stats;
+	stats.frameCnt = (int)frameTimesMS.size();
+	if(frameTimesMS.empty()) return stats;
+
+	sort(frameTimesMS.begin(), frameTimesMS.end());
+
+	double sum = 0.0;
+	for(float t : frameTimesMS) sum += t;
+	stats.meanMS = sum / frameTimesMS.size();
+
+	// Nearest-rank percentiles
+	auto percentile = [&](double p) {
+		size_t rank = (size_t)(p * (frameTimesMS.size() - 1) + 0.5);
+		return (double)frameTimesMS.at(rank);
+	};
+	stats.p50MS = percentile(0.50);
+	stats.p99MS = percentile(0.99);
+	stats.maxMS = frameTimesMS.back();
+	return stats;
+}
+
+// Print frame time summary
+void printFrameStats(FramePacer &pacer) {
+	FrameStats stats = computeFrameStats(pacer.frameTimesMS);
+	cout << "Frame times (" << framePacingModeName(pacer) << ", " << stats.frameCnt << " frames): ";
+	if(stats.frameCnt == 0) {
+		cout << "none recorded" << endl;
+	}
+	else {
+		cout << "mean " << stats.meanMS << " ms";
+		cout << " (" << (stats.meanMS > 0.0 ? 1000.0 / stats.meanMS : 0.0) << " FPS)";
+		cout << ", p50 " << stats.p50MS << " ms";
+		cout << ", p99 " << stats.p99MS << " ms";
+		cout << ", max " << stats.maxMS << " ms" << endl;
+	}
+	printIdleStats(pacer);
+}
+
+// Callbacks that were installed before setupOnDemandRedraw() (forwarded to)
+static FramePacer *onDemandPacer = nullptr;
+static GLFWkeyfun prevKeyCallback = nullptr;
+static GLFWcursorposfun prevCursorPosCallback = nullptr;
+static GLFWmousebuttonfun prevMouseButtonCallback = nullptr;
+static GLFWscrollfun prevScrollCallback = nullptr;
+static GLFWframebuffersizefun prevFramebufferSizeCallback = nullptr;
+static GLFWwindowrefreshfun prevWindowRefreshCallback = nullptr;
+
+static void onDemandKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	onDemandPacer->inputPending = true;
+	if(prevKeyCallback) prevKeyCallback(window, key, scancode, action, mods);
+}
+
+static void onDemandCursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
+	onDemandPacer->inputPending = true;
+	if(prevCursorPosCallback) prevCursorPosCallback(window, xpos, ypos);
+}
+
+static void onDemandMouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+	onDemandPacer->inputPending = true;
+	if(prevMouseButtonCallback) prevMouseButtonCallback(window, button, action, mods);
+}
+
+static void onDemandScrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
+	onDemandPacer->inputPending = true;
+	if(prevScrollCallback) prevScrollCallback(window, xoffset, yoffset);
+}
+
+static void onDemandFramebufferSizeCallback(GLFWwindow* window, int width, int height) {
+	onDemandPacer->inputPending = true;
+	if(prevFramebufferSizeCallback) prevFramebufferSizeCallback(window, width, height);
+}
+
+static void onDemandWindowRefreshCallback(GLFWwindow* window) {
+	onDemandPacer->inputPending = true;
+	if(prevWindowRefreshCallback) prevWindowRefreshCallback(window);
+}
+
+// Wrap the window's input/resize/refresh callbacks so they mark the frame dirty.
+// Call after the app has installed its own callbacks (they keep working).
+void setupOnDemandRedraw(GLFWwindow *window, FramePacer &pacer) {
+	if(!pacer.onDemand) return;
+	onDemandPacer = &pacer;
+	prevKeyCallback = glfwSetKeyCallback(window, onDemandKeyCallback);
+	prevCursorPosCallback = glfwSetCursorPosCallback(window, onDemandCursorPosCallback);
+	prevMouseButtonCallback = glfwSetMouseButtonCallback(window, onDemandMouseButtonCallback);
+	prevScrollCallback = glfwSetScrollCallback(window, onDemandScrollCallback);
+	prevFramebufferSizeCallback = glfwSetFramebufferSizeCallback(window, onDemandFramebufferSizeCallback);
+	prevWindowRefreshCallback = glfwSetWindowRefreshCallback(window, onDemandWindowRefreshCallback);
+}
+
+// Request a redraw (thread-safe; e.g., async loads, hot reloads, new snapshots)
+void markFrameDirty(FramePacer &pacer) {
+	{
+		lock_guard<mutex> lock(pacer.wakeMutex);
+		pacer.dirty.store(true);
+	}
+	pacer.wakeCondition.notify_one();
+
+	// Wake a main thread blocked in glfwWaitEventsTimeout()
+	if(pacer.onDemand) glfwPostEmptyEvent();
+}
+
+// Main thread: were there input/window events since the last call?
+bool takeInputPending(FramePacer &pacer) {
+	bool pending = pacer.inputPending;
+	pacer.inputPending = false;
+	return pending;
+}
+
+// Update counters after deciding whether to draw
+static bool finishRedrawWait(FramePacer &pacer, bool draw) {
+	if(!draw) {
+		pacer.idleWakeups++;
+		return false;
+	}
+	pacer.framesRendered++;
+
+	// Do not count idle time as frame time
+	if(pacer.started) pacer.lastFrameEnd = chrono::steady_clock::now();
+	return true;
+}
+
+// For loops that render on the main thread: blocks in glfwWaitEventsTimeout()
+// until something is dirty. Returns true if a frame should be drawn.
+// (Always true when not in on-demand mode.)
+bool waitForRedraw(FramePacer &pacer) {
+	if(!pacer.onDemand) return true;
+
+	if(!pacer.inputPending && !pacer.dirty.load() && !pacer.animating.load()) {
+		glfwWaitEventsTimeout(IDLE_WAIT_SEC);
+	}
+	bool draw = takeInputPending(pacer);
+	draw = pacer.dirty.exchange(false) || draw;
+	draw = draw || pacer.animating.load();
+	return finishRedrawWait(pacer, draw);
+}
+
+// For a dedicated render thread: blocks until markFrameDirty() is called.
+// Returns true if a frame should be drawn.
+bool waitForRedrawSignal(FramePacer &pacer) {
+	if(!pacer.onDemand) return true;
+
+	{
+		unique_lock<mutex> lock(pacer.wakeMutex);
+		pacer.wakeCondition.wait_for(lock, chrono::duration<double>(IDLE_WAIT_SEC), [&]() {
+			return pacer.dirty.load() || pacer.animating.load();
+		});
+	}
+	bool draw = pacer.dirty.exchange(false) || pacer.animating.load();
+	return finishRedrawWait(pacer, draw);
+}
+
+// Report how much CPU (and, where measurable, energy) on-demand mode used,
+// compared with an estimate for redrawing continuously
+void printIdleStats(FramePacer &pacer) {
+	if(!pacer.onDemand) return;
+
+	double wallSec = chrono::duration<double>(chrono::steady_clock::now() - pacer.runStart).count();
+	double cpuSec = (double)(clock() - pacer.cpuStart) / CLOCKS_PER_SEC;
+
+	// Frames a continuous loop would have drawn in the same time
+	double continuousHz = ASSUMED_REFRESH_HZ;
+	if(pacer.mode == PACING_TARGET_FPS) continuousHz = pacer.targetFPS;
+	if(pacer.mode == PACING_UNCAPPED) {
+		FrameStats stats = computeFrameStats(pacer.frameTimesMS);
+		if(stats.meanMS > 0.0) continuousHz = 1000.0 / stats.meanMS;
+	}
+	double continuousFrames = wallSec * continuousHz;
+
+	cout << "On-demand: drew " << pacer.framesRendered << " frames in " << wallSec << " s";
+	cout << " (continuous would be ~" << (long long)continuousFrames << "), ";
+	cout << pacer.idleWakeups << " idle wakeups" << endl;
+	cout << "On-demand: process CPU time " << cpuSec << " s";
+	cout << " (" << (wallSec > 0.0 ? 100.0 * cpuSec / wallSec : 0.0) << "% of one core)" << endl;
+
+	// Rough estimate: scale CPU per drawn frame up to the continuous frame count
+	if(pacer.framesRendered > 0) {
+		double cpuPerFrame = cpuSec / pacer.framesRendered;
+		double continuousCPU = cpuPerFrame * continuousFrames;
+		cout << "On-demand: estimated CPU time saved " << max(0.0, continuousCPU - cpuSec) << " s";
+		cout << " (continuous estimate " << continuousCPU << " s)" << endl;
+	}
+
+	// Package power (only where RAPL counters are readable); compare against a run without --on-demand
+	double energyEndJ = readPackageEnergyJ();
+	if(pacer.energyStartJ >= 0.0 && energyEndJ >= pacer.energyStartJ && wallSec > 0.0) {
+		cout << "On-demand: average package power " << (energyEndJ - pacer.energyStartJ) / wallSec << " W" << endl;
+	}
+	else {
+		cout << "On-demand: package power not available (no readable RAPL counter)" << endl;
+	}
+}
@@ -0,0 +1,387 @@
+#include "FrameStream.hpp"
+#include "GLState.hpp"
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#else
+#include <csignal>
+#endif
+
+// Full-range BT.601 (JFIF) in fixed point: luma weights scaled by 2^14, chroma weights
+// by 2^12 (they are applied to the sum of a 2x2 block), so both end with >> 14
+static const int Y_R = 4899, Y_G = 9617, Y_B = 1868;
+static const int CB_R = -691, CB_G = -1357, CB_B = 2048;
+static const int CR_R = 2048, CR_G = -1715, CR_B = -333;
+static const int YUV_ROUND = 1 << 13;
+static const int CHROMA_OFFSET = (128 << 14) + YUV_ROUND;
+
+static inline unsigned char clampByte(int v) {
+	return (unsigned char)min(255, max(0, v));
+}
+
+// Chroma of one 2x2 block given its summed channels
+static inline void chromaFromSums(int r, int g, int b, unsigned char &u, unsigned char &v) {
+	u = clampByte((CB_R * r + CB_G * g + CB_B * b + CHROMA_OFFSET) >> 14);
+	v = clampByte((CR_R * r + CR_G * g + CR_B * b + CHROMA_OFFSET) >> 14);
+}
+
+// One output row pair: luma of row0 (and row1 if hasRow1) plus a row of 4:2:0 chroma
+static void convertRowPair(const unsigned char *row0, const unsigned char *row1, bool hasRow1, int width,
+						   unsigned char *y0, unsigned char *y1, unsigned char *u, unsigned char *v) {
+	int x = 0;
+#ifdef __SSE2__
+	// 4 pixels (2 chroma samples) per step. Channels are widened to 16 bits so that
+	// _mm_madd_epi16 does R*wR + G*wG and B*wB + A*0 per pixel; the two halves are then
+	// gathered with shuffles and added.
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i lumaWeights = _mm_set_epi16(0, Y_B, Y_G, Y_R, 0, Y_B, Y_G, Y_R);
+	const __m128i cbWeights = _mm_set_epi16(0, CB_B, CB_G, CB_R, 0, CB_B, CB_G, CB_R);
+	const __m128i crWeights = _mm_set_epi16(0, CR_B, CR_G, CR_R, 0, CR_B, CR_G, CR_R);
+	const __m128i lumaRound = _mm_set1_epi32(YUV_ROUND);
+	const __m128i chromaOffset = _mm_set1_epi32(CHROMA_OFFSET);
+
+	auto sumPairs = [](__m128i a, __m128i b) {
+		__m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b);
+		__m128i even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i odd = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+		return _mm_add_epi32(even, odd);
+	};
+	auto storeLuma = [&](__m128i p01, __m128i p23, unsigned char *dst) {
+		__m128i sum = sumPairs(_mm_madd_epi16(p01, lumaWeights), _mm_madd_epi16(p23, lumaWeights));
+		__m128i luma = _mm_srai_epi32(_mm_add_epi32(sum, lumaRound), 14);
+		luma = _mm_packs_epi32(luma, luma);
+		int packed = _mm_cvtsi128_si32(_mm_packus_epi16(luma, luma));
+		memcpy(dst, &packed, 4);
+	};
+
+	for(; x + 4 <= width; x += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 4));
+		__m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 4));
+		__m128i a01 = _mm_unpacklo_epi8(a, zero), a23 = _mm_unpackhi_epi8(a, zero);
+		__m128i b01 = _mm_unpacklo_epi8(b, zero), b23 = _mm_unpackhi_epi8(b, zero);
+		storeLuma(a01, a23, y0 + x);
+		if(hasRow1) storeLuma(b01, b23, y1 + x);
+
+		// 2x2 sums: add the rows, then each pixel to its horizontal neighbour
+		__m128i s01 = _mm_add_epi16(a01, b01);
+		__m128i s23 = _mm_add_epi16(a23, b23);
+		__m128i blocks = _mm_unpacklo_epi64(_mm_add_epi16(s01, _mm_srli_si128(s01, 8)),
+											_mm_add_epi16(s23, _mm_srli_si128(s23, 8)));
+		__m128i chroma = sumPairs(_mm_madd_epi16(blocks, cbWeights), _mm_madd_epi16(blocks, crWeights));
+		chroma = _mm_srai_epi32(_mm_add_epi32(chroma, chromaOffset), 14);
+		chroma = _mm_packs_epi32(chroma, chroma);
+		unsigned int packed = (unsigned int)_mm_cvtsi128_si32(_mm_packus_epi16(chroma, chroma));
+		u[x / 2] = (unsigned char)packed;
+		u[x / 2 + 1] = (unsigned char)(packed >> 8);
+		v[x / 2] = (unsigned char)(packed >> 16);
+		v[x / 2 + 1] = (unsigned char)(packed >> 24);
+	}
+#endif
+	// Remaining pixels (an odd last column is paired with itself)
+	for(; x < width; x += 2) {
+		int x1 = min(x + 1, width - 1);
+		const unsigned char *p[4] = { row0 + x * 4, row0 + x1 * 4, row1 + x * 4, row1 + x1 * 4 };
+		y0[x] = (unsigned char)((Y_R * p[0][0] + Y_G * p[0][1] + Y_B * p[0][2] + YUV_ROUND) >> 14);
+		if(x1 != x) y0[x1] = (unsigned char)((Y_R * p[1][0] + Y_G * p[1][1] + Y_B * p[1][2] + YUV_ROUND) >> 14);
+		if(hasRow1) {
+			y1[x] = (unsigned char)((Y_R * p[2][0] + Y_G * p[2][1] + Y_B * p[2][2] + YUV_ROUND) >> 14);
+			if(x1 != x) y1[x1] = (unsigned char)((Y_R * p[3][0] + Y_G * p[3][1] + Y_B * p[3][2] + YUV_ROUND) >> 14);
+		}
+		int r = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+		int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+		int b = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+		chromaFromSums(r, g, b, u[x / 2], v[x / 2]);
+	}
+}
+
+// Bottom-up RGBA8 (as read back) to top-down planar Y, U, V (4:2:0, chroma sited between
+// the 2x2 luma samples). An odd last row is paired with itself.
+void convertRGBAToYUV420(const unsigned char *rgba, int width, int height, unsigned char *yuv) {
+	size_t stride = (size_t)width * 4;
+	int chromaWidth = (width + 1) / 2;
+	int chromaHeight = (height + 1) / 2;
+	unsigned char *yPlane = yuv;
+	unsigned char *uPlane = yPlane + (size_t)width * height;
+	unsigned char *vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+	for(int cy = 0; cy < chromaHeight; cy++) {
+		int y0 = cy * 2;
+		int y1 = min(y0 + 1, height - 1);
+		convertRowPair(rgba + (size_t)(height - 1 - y0) * stride, rgba + (size_t)(height - 1 - y1) * stride, y1 != y0, width,
+					   yPlane + (size_t)y0 * width, yPlane + (size_t)y1 * width,
+					   uPlane + (size_t)cy * chromaWidth, vPlane + (size_t)cy * chromaWidth);
+	}
+}
+
+// Bottom-up RGBA8 to top-down packed RGB24
+void convertRGBAToRGB(const unsigned char *rgba, int width, int height, unsigned char *rgb) {
+	for(int y = 0; y < height; y++) {
+		const unsigned char *src = rgba + (size_t)(height - 1 - y) * width * 4;
+		unsigned char *dst = rgb + (size_t)y * width * 3;
+		for(int x = 0; x < width; x++) {
+			dst[x * 3 + 0] = src[x * 4 + 0];
+			dst[x * 3 + 1] = src[x * 4 + 1];
+			dst[x * 3 + 2] = src[x * 4 + 2];
+		}
+	}
+}
+
+// Payload of one frame (without the Y4M "FRAME" line)
+size_t getStreamFrameBytes(StreamFormat format, int width, int height) {
+	if(format == STREAM_RAW_RGB) return (size_t)width * height * 3;
+	return (size_t)width * height + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+}
+
+// Writer thread: write one converted frame (error reported once; later frames are
+// still consumed so the render thread never stalls on a dead pipe)
+static void writeStreamFrame(FrameStream *fs) {
+	if(fs->writeFailed) return;
+	auto start = chrono::steady_clock::now();
+	bool ok = true;
+	if(fs->format == STREAM_Y4M) ok = fputs("FRAME\n", fs->out) >= 0;
+	ok = ok && fwrite(fs->frameBytes.data(), 1, fs->frameBytes.size(), fs->out) == fs->frameBytes.size();
+	if(!ok) {
+		cerr << "ERROR: Could not write to frame stream " << fs->target << "; further frames are discarded" << endl;
+		fs->writeFailed = true;
+		return;
+	}
+	fs->writtenCnt++;
+	fs->writtenBytes += fs->frameBytes.size() + (fs->format == STREAM_Y4M ? 6 : 0);
+	fs->writeMS += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Frames missing before frameIndex: note the gap and repeat the last frame over it
+static void fillStreamGap(FrameStream *fs, long long frameIndex) {
+	long long gap = frameIndex - fs->lastWrittenIndex - 1;
+	if(gap <= 0) return;
+	if(fs->gapStarts.size() < 16) fs->gapStarts.push_back(fs->lastWrittenIndex + 1);
+	if(fs->lastWrittenIndex < 0) return;		// Nothing to repeat yet
+	for(long long i = 0; i < gap; i++) writeStreamFrame(fs);
+	fs->repeatedCnt += gap;
+}
+
+static void runStreamWriter(FrameStream *fs) {
+	fs->frameBytes.resize(getStreamFrameBytes(fs->format, fs->width, fs->height));
+	while(true) {
+		StreamItem item;
+		if(!fs->queue.tryPop(item)) {
+			if(!fs->running.load(memory_order_acquire) && fs->queue.empty()) break;
+			unique_lock<mutex> guard(fs->wakeLock);
+			fs->wake.wait_for(guard, chrono::milliseconds(2));
+			continue;
+		}
+
+		fillStreamGap(fs, item.frameIndex);
+
+		auto start = chrono::steady_clock::now();
+		if(fs->format == STREAM_Y4M) convertRGBAToYUV420(item.pixels, fs->width, fs->height, fs->frameBytes.data());
+		else convertRGBAToRGB(item.pixels, fs->width, fs->height, fs->frameBytes.data());
+		item.slot->consumed.store(true, memory_order_release);
+		fs->convertedCnt++;
+		fs->convertMS += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		writeStreamFrame(fs);
+		fs->lastWrittenIndex = item.frameIndex;
+	}
+	// Frames dropped at the very end
+	fillStreamGap(fs, fs->frameCnt);
+}
+
+// Open target ("-": stdout, "|command": pipe into command, else a file) and start the writer
+bool openFrameStream(FrameStream &fs, string target, StreamFormat format, int width, int height, int fps, int slotCnt) {
+	if(width <= 0 || height <= 0) return false;
+	fs.target = target;
+	fs.format = format;
+	fs.width = width;
+	fs.height = height;
+	fs.fps = max(1, fps);
+	fs.isPipe = false;
+	if(target == "-") {
+		fs.out = stdout;
+	}
+	else if(!target.empty() && target[0] == '|') {
+#ifndef _WIN32
+		signal(SIGPIPE, SIG_IGN);		// A reader that exits early is a write error, not a crash
+#endif
+		fs.out = popen(target.substr(1).c_str(), "w");
+		fs.isPipe = true;
+	}
+	else {
+		filesystem::path parent = filesystem::path(target).parent_path();
+		error_code ec;
+		if(!parent.empty()) filesystem::create_directories(parent, ec);
+		fs.out = fopen(target.c_str(), "wb");
+	}
+	if(!fs.out) {
+		cerr << "ERROR: Could not open frame stream " << target << endl;
+		return false;
+	}
+	if(format == STREAM_Y4M) {
+		fprintf(fs.out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fs.fps);
+	}
+
+	// One frame in flight per buffer; all of them fit into the queue at once
+	fs.slots = vector<StreamSlot>(min(max(2, slotCnt), MAX_STREAM_SLOTS));
+	size_t bytes = (size_t)width * height * 4;
+	for(StreamSlot &slot : fs.slots) {
+		glGenBuffers(1, &(slot.pbo));
+		bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+	}
+	bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// (a stream can be reopened after closeFrameStream)
+	fs.nextSlot = 0;
+	fs.frameCnt = 0;
+	fs.droppedCnt = 0;
+	fs.dropping = false;
+	fs.renderThreadMS = 0.0;
+	fs.convertedCnt = 0;
+	fs.writtenCnt = 0;
+	fs.repeatedCnt = 0;
+	fs.lastWrittenIndex = -1;
+	fs.gapStarts.clear();
+	fs.convertMS = 0.0;
+	fs.writeMS = 0.0;
+	fs.writtenBytes = 0;
+	fs.writeFailed = false;
+	fs.running.store(true, memory_order_release);
+	fs.writer = thread(runStreamWriter, &fs);
+	return true;
+}
+
+// Render thread, once per frame (streamFrame does it too): unmap buffers the writer has
+// converted, and hand finished reads to the writer in frame order without waiting
+void updateFrameStream(FrameStream &fs) {
+	if(fs.slots.empty()) return;
+	auto start = chrono::steady_clock::now();
+	int slotCnt = (int)fs.slots.size();
+	bool touched = false;
+	bool blocked = false;		// An older read is unfinished; later ones must wait their turn
+	for(int i = 0; i < slotCnt; i++) {
+		StreamSlot &slot = fs.slots[(fs.nextSlot + i) % slotCnt];
+		if(slot.state == STREAM_QUEUED && slot.consumed.load(memory_order_acquire)) {
+			bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			slot.state = STREAM_FREE;
+			touched = true;
+		}
+		else if(slot.state == STREAM_READING && !blocked) {
+			GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if(status == GL_TIMEOUT_EXPIRED) {
+				blocked = true;
+				continue;
+			}
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+			touched = true;
+
+			bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			void *mapped = (status == GL_WAIT_FAILED) ? nullptr
+				: glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)fs.width * fs.height * 4, GL_MAP_READ_BIT);
+			if(!mapped) {
+				// Shows up as a gap for the writer, like any other drop
+				cerr << "ERROR: Could not map frame stream buffer for frame " << slot.frameIndex << endl;
+				fs.droppedCnt++;
+				slot.state = STREAM_FREE;
+				continue;
+			}
+
+			StreamItem item;
+			item.slot = &slot;
+			item.pixels = (const unsigned char*)mapped;
+			item.frameIndex = slot.frameIndex;
+			slot.consumed.store(false, memory_order_relaxed);
+			slot.state = STREAM_QUEUED;
+			fs.queue.tryPush(item);		// Cannot fail: one entry per buffer at most
+			fs.wake.notify_one();
+		}
+	}
+	if(touched) bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	fs.renderThreadMS += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Render thread, after drawing (before the swap): queue a read of the frame into the next
+// buffer. If that buffer is still waiting for the writer, the frame is dropped.
+void streamFrame(FrameStream &fs, GLuint readFBO, GLenum readBuffer) {
+	if(fs.slots.empty()) return;
+	updateFrameStream(fs);
+	auto start = chrono::steady_clock::now();
+	long long frameIndex = fs.frameCnt++;
+	StreamSlot &slot = fs.slots[fs.nextSlot];
+	if(slot.state != STREAM_FREE) {
+		if(!fs.dropping) {
+			cerr << "WARNING: Frame stream dropped frame " << frameIndex << " (writer " << fs.slots.size() << " frames behind)" << endl;
+		}
+		fs.dropping = true;
+		fs.droppedCnt++;
+		return;
+	}
+	fs.dropping = false;
+	fs.nextSlot = (fs.nextSlot + 1) % (int)fs.slots.size();
+
+	GLint prevReadFBO = 0;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFBO);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+	glReadBuffer(readBuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	glReadPixels(0, 0, fs.width, fs.height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFBO);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frameIndex = frameIndex;
+	slot.state = STREAM_READING;
+	fs.renderThreadMS += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Hand over every outstanding frame, let the writer finish, close the output
+void closeFrameStream(FrameStream &fs) {
+	if(fs.slots.empty()) return;
+	while(true) {
+		updateFrameStream(fs);
+		bool idle = true;
+		for(StreamSlot &slot : fs.slots) {
+			if(slot.state == STREAM_READING) glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			if(slot.state != STREAM_FREE) idle = false;
+		}
+		if(idle) break;
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+	fs.running.store(false, memory_order_release);
+	fs.wake.notify_one();
+	if(fs.writer.joinable()) fs.writer.join();
+
+	for(StreamSlot &slot : fs.slots) deleteBuffer(slot.pbo);
+	fs.slots.clear();
+
+	if(fs.out) {
+		if(fs.isPipe) pclose(fs.out);
+		else if(fs.out == stdout) fflush(stdout);
+		else fclose(fs.out);
+		fs.out = nullptr;
+	}
+}
+
+// Print frames written and dropped, and where the time went (after closeFrameStream)
+void printFrameStreamStats(FrameStream &fs) {
+	if(fs.frameCnt == 0) return;
+	cerr << "Frame stream " << fs.target << ": " << fs.frameCnt << " frames (" << fs.width << "x" << fs.height;
+	cerr << (fs.format == STREAM_Y4M ? ", y4m" : ", rgb24") << "), " << fs.writtenCnt << " written";
+	if(fs.droppedCnt > 0) {
+		cerr << ", " << fs.droppedCnt << " DROPPED (" << fs.repeatedCnt << " filled with the previous frame); gaps start at";
+		for(long long start : fs.gapStarts) cerr << " " << start;
+		if(fs.gapStarts.size() == 16) cerr << " ...";
+	}
+	cerr << endl;
+	cerr << "  render thread " << fs.renderThreadMS / fs.frameCnt << " ms/frame, writer convert " << fs.convertMS / max(1LL, fs.convertedCnt);
+	cerr << " ms/frame, write " << fs.writeMS / max(1.0, (double)fs.writtenCnt) << " ms/frame, " << fs.writtenBytes / (1024 * 1024) << " MB" << endl;
+}
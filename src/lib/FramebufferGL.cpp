@@ -0,0 +1,63 @@
+#include "FramebufferGL.hpp"
+
+// Create FBO with an RGBA8 color texture and a 24-bit depth texture
+void createFramebufferGL(FramebufferGL &fb, int width, int height) {
+	fb.width = width;
+	fb.height = height;
+
+	// Color attachment
+	glGenTextures(1, &(fb.colorTex));
+	glBindTexture(GL_TEXTURE_2D, fb.colorTex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	// Depth attachment (a texture, so later passes can sample it)
+	glGenTextures(1, &(fb.depthTex));
+	glBindTexture(GL_TEXTURE_2D, fb.depthTex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Framebuffer object
+	glGenFramebuffers(1, &(fb.FBO));
+	glBindFramebuffer(GL_FRAMEBUFFER, fb.FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fb.colorTex, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, fb.depthTex, 0);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		cleanupFramebufferGL(fb);
+		cout << "Error creating framebuffer (status " << status << ")." << endl;
+		throw runtime_error("Error creating framebuffer.");
+	}
+}
+
+// Cleanup FBO and attachments
+void cleanupFramebufferGL(FramebufferGL &fb) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &(fb.FBO));
+	fb.FBO = 0;
+
+	glDeleteTextures(1, &(fb.colorTex));
+	fb.colorTex = 0;
+
+	glDeleteTextures(1, &(fb.depthTex));
+	fb.depthTex = 0;
+
+	fb.width = 0;
+	fb.height = 0;
+}
+
+// Read back color attachment (blocking; for verification, not per-frame use)
+void readFramebufferRGBA(FramebufferGL &fb, vector<unsigned char> &pixels) {
+	pixels.resize((size_t)fb.width * fb.height * 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fb.FBO);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, fb.width, fb.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
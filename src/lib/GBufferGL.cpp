@@ -0,0 +1,97 @@
+#include "GBufferGL.hpp"
+#include "GLState.hpp"
+
+// Allocate one nearest-filtered render target texture
+static GLuint createTargetTexture(GLenum format, int width, int height) {
+	GLuint texID = 0;
+	glGenTextures(1, &texID);
+	glBindTexture(GL_TEXTURE_2D, texID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texID;
+}
+
+// Create FBO with the three G-buffer targets and a 24-bit depth texture
+void createGBufferGL(GBufferGL &gb, int width, int height) {
+	gb.width = width;
+	gb.height = height;
+
+	gb.albedoTex = createTargetTexture(GL_RGBA8, width, height);
+	gb.normalTex = createTargetTexture(GL_RG16, width, height);
+	gb.materialTex = createTargetTexture(GL_RG8, width, height);
+	gb.depthTex = createTargetTexture(GL_DEPTH_COMPONENT24, width, height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &(gb.FBO));
+	glBindFramebuffer(GL_FRAMEBUFFER, gb.FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gb.albedoTex, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gb.normalTex, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gb.materialTex, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gb.depthTex, 0);
+	GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, drawBuffers);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		cleanupGBufferGL(gb);
+		cout << "Error creating G-buffer (status " << status << ")." << endl;
+		throw runtime_error("Error creating G-buffer.");
+	}
+
+	glGenVertexArrays(1, &(gb.emptyVAO));
+}
+
+// Cleanup FBO, attachments, and VAO
+void cleanupGBufferGL(GBufferGL &gb) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &(gb.FBO));
+	gb.FBO = 0;
+
+	GLuint textures[] = { gb.albedoTex, gb.normalTex, gb.materialTex, gb.depthTex };
+	glDeleteTextures(4, textures);
+	gb.albedoTex = gb.normalTex = gb.materialTex = gb.depthTex = 0;
+
+	if(gb.emptyVAO) deleteVertexArray(gb.emptyVAO);
+
+	gb.width = 0;
+	gb.height = 0;
+}
+
+// Bind G-buffer textures to the units the DEFERRED_LIGHTING shader expects
+void bindGBufferTextures(GBufferGL &gb) {
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_ALBEDO_UNIT);
+	glBindTexture(GL_TEXTURE_2D, gb.albedoTex);
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_NORMAL_UNIT);
+	glBindTexture(GL_TEXTURE_2D, gb.normalTex);
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_MATERIAL_UNIT);
+	glBindTexture(GL_TEXTURE_2D, gb.materialTex);
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_DEPTH_UNIT);
+	glBindTexture(GL_TEXTURE_2D, gb.depthTex);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+// Full-screen lighting pass into targetFBO (lighting program must already be in use).
+// The scene depth is copied to the target first, so its depth attachment must be
+// DEPTH_COMPONENT24 and the same size (as in FramebufferGL); the far-plane triangle then
+// only passes the GL_GREATER test where geometry was drawn, and each such pixel is shaded once.
+void drawGBufferLighting(GBufferGL &gb, GLuint targetFBO) {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, gb.FBO);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFBO);
+	glBlitFramebuffer(0, 0, gb.width, gb.height, 0, 0, gb.width, gb.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+
+	bindGBufferTextures(gb);
+	setDepthTest(true);
+	setDepthFunc(GL_GREATER);
+	setDepthMask(false);
+	bindVertexArray(gb.emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	bindVertexArray(0);
+	setDepthMask(true);
+	setDepthFunc(GL_LESS);
+}
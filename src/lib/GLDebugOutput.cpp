@@ -0,0 +1,290 @@
+#include "GLDebugOutput.hpp"
+#include "MPSCQueue.hpp"
+#include "Utility.hpp"
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+
+// Current mode and filters (read by the callback on driver threads)
+static GLDebugMode debugMode = DEBUG_OUTPUT_ASYNC;
+static atomic<int> minSeverityRank{0};			// 0 = notification ... 3 = high
+static atomic<unsigned int> sourceMask{~0u};	// Bit per GL_DEBUG_SOURCE_*
+static atomic<int> rateLimit{20};				// Printed messages per second
+
+// Callback -> logger
+static MPSCQueue<GLDebugRecord, GL_DEBUG_QUEUE_SIZE> debugQueue;
+static GLDebugCounters counters;
+static atomic<bool> loggerRunning{false};
+static thread loggerThread;
+
+// Rank severities so they can be compared
+static int getSeverityRank(GLenum severity) {
+	switch(severity) {
+		case GL_DEBUG_SEVERITY_HIGH: return 3;
+		case GL_DEBUG_SEVERITY_MEDIUM: return 2;
+		case GL_DEBUG_SEVERITY_LOW: return 1;
+		default: return 0;
+	}
+}
+
+// Bit for source in sourceMask
+static unsigned int getSourceBit(GLenum source) {
+	if(source < GL_DEBUG_SOURCE_API || source > GL_DEBUG_SOURCE_OTHER) return 1u << 31;
+	return 1u << (source - GL_DEBUG_SOURCE_API);
+}
+
+// Parse severity name (high, medium, low, notification)
+static bool parseSeverity(string name, GLenum &severity) {
+	if(name == "high") severity = GL_DEBUG_SEVERITY_HIGH;
+	else if(name == "medium") severity = GL_DEBUG_SEVERITY_MEDIUM;
+	else if(name == "low") severity = GL_DEBUG_SEVERITY_LOW;
+	else if(name == "notification") severity = GL_DEBUG_SEVERITY_NOTIFICATION;
+	else return false;
+	return true;
+}
+
+// Parse source name (api, window, shader, thirdparty, app, other)
+static bool parseSource(string name, GLenum &source) {
+	if(name == "api") source = GL_DEBUG_SOURCE_API;
+	else if(name == "window") source = GL_DEBUG_SOURCE_WINDOW_SYSTEM;
+	else if(name == "shader") source = GL_DEBUG_SOURCE_SHADER_COMPILER;
+	else if(name == "thirdparty") source = GL_DEBUG_SOURCE_THIRD_PARTY;
+	else if(name == "app") source = GL_DEBUG_SOURCE_APPLICATION;
+	else if(name == "other") source = GL_DEBUG_SOURCE_OTHER;
+	else return false;
+	return true;
+}
+
+// Read debug output options from the command line:
+// --gl-debug off|sync|async, --gl-debug-severity <min>, --gl-debug-sources a,b,c, --gl-debug-rate <N/s>
+void parseGLDebugArgs(int &argc, char **argv) {
+	string value;
+	if(consumeOption(argc, argv, "--gl-debug", value)) {
+		if(value == "off") setGLDebugMode(DEBUG_OUTPUT_OFF);
+		else if(value == "sync") setGLDebugMode(DEBUG_OUTPUT_SYNC);
+		else if(value == "async") setGLDebugMode(DEBUG_OUTPUT_ASYNC);
+		else cerr << "WARNING: Unknown --gl-debug mode: " << value << endl;
+	}
+	if(consumeOption(argc, argv, "--gl-debug-severity", value)) {
+		GLenum severity;
+		if(parseSeverity(value, severity)) setGLDebugMinSeverity(severity);
+		else cerr << "WARNING: Unknown --gl-debug-severity: " << value << endl;
+	}
+	if(consumeOption(argc, argv, "--gl-debug-sources", value)) {
+		// Only the listed sources stay enabled
+		sourceMask.store(0);
+		stringstream list(value);
+		string name;
+		while(getline(list, name, ',')) {
+			GLenum source;
+			if(parseSource(name, source)) setGLDebugSourceEnabled(source, true);
+			else cerr << "WARNING: Unknown --gl-debug-sources entry: " << name << endl;
+		}
+	}
+	if(consumeOption(argc, argv, "--gl-debug-rate", value)) {
+		setGLDebugRateLimit(atoi(value.c_str()));
+	}
+}
+
+void setGLDebugMode(GLDebugMode mode) {
+	debugMode = mode;
+}
+
+GLDebugMode getGLDebugMode() {
+	return debugMode;
+}
+
+// Drop messages below this severity
+void setGLDebugMinSeverity(GLenum severity) {
+	minSeverityRank.store(getSeverityRank(severity));
+}
+
+// Is severity at or above the current minimum?
+bool isGLDebugSeverityEnabled(GLenum severity) {
+	return getSeverityRank(severity) >= minSeverityRank.load();
+}
+
+// Enable/disable one message source
+void setGLDebugSourceEnabled(GLenum source, bool enabled) {
+	if(enabled) sourceMask.fetch_or(getSourceBit(source));
+	else sourceMask.fetch_and(~getSourceBit(source));
+}
+
+// Maximum messages printed per second (the rest are counted)
+void setGLDebugRateLimit(int messagesPerSecond) {
+	rateLimit.store(max(messagesPerSecond, 1));
+}
+
+// Debug callback for async mode: filter, copy into a fixed-size record, and queue.
+// May run on driver threads (no GL_DEBUG_OUTPUT_SYNCHRONOUS), so it never blocks or prints.
+void APIENTRY asyncGLDebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+									GLsizei length, const GLchar *message, const void * /*userParam*/) {
+	counters.received.fetch_add(1, memory_order_relaxed);
+
+	// Ignore non-significant error/warning codes (as in openGLDebugCallback)
+	if(id == 131169 || id == 131185 || id == 131218 || id == 131204) {
+		counters.filtered.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+	if(getSeverityRank(severity) < minSeverityRank.load(memory_order_relaxed) ||
+		!(sourceMask.load(memory_order_relaxed) & getSourceBit(source))) {
+		counters.filtered.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+
+	GLDebugRecord record;
+	record.source = source;
+	record.type = type;
+	record.severity = severity;
+	record.id = id;
+	record.timeNS = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+		chrono::steady_clock::now().time_since_epoch()).count();
+	size_t len = (length >= 0) ? (size_t)length : strlen(message);
+	len = min(len, (size_t)GL_DEBUG_MESSAGE_MAX - 1);
+	memcpy(record.message, message, len);
+	record.message[len] = '\0';
+
+	if(!debugQueue.tryPush(record)) counters.dropped.fetch_add(1, memory_order_relaxed);
+}
+
+// Repeat count for one source/type/id
+struct DuplicateInfo {
+	long long total = 0;
+	long long sinceReport = 0;
+};
+
+// Logger thread: drain queue, drop duplicates, enforce rate limit, print in batches
+static void runGLDebugLogger() {
+	unordered_map<uint64_t, DuplicateInfo> seen;
+	double tokens = rateLimit.load();
+	auto lastRefill = chrono::steady_clock::now();
+	auto lastRepeatReport = lastRefill;
+	ostringstream out;
+
+	// Process everything queued; returns true if anything was printed
+	auto drain = [&]() {
+		GLDebugRecord record;
+		bool wrote = false;
+		while(debugQueue.tryPop(record)) {
+			uint64_t key = ((uint64_t)(record.type & 0xffff) << 40) | ((uint64_t)(record.source & 0xff) << 32) | record.id;
+			DuplicateInfo &info = seen[key];
+			info.total++;
+			if(info.total > 1) {
+				info.sinceReport++;
+				counters.duplicates++;
+				continue;
+			}
+			if(tokens < 1.0) {
+				// Not shown yet, so a later repeat may still be printed
+				info.total--;
+				counters.rateLimited++;
+				continue;
+			}
+			tokens -= 1.0;
+			counters.printed++;
+			out << "GL debug [" << getGLDebugSeverityName(record.severity) << "] ";
+			out << getGLDebugSourceName(record.source) << "/" << getGLDebugTypeName(record.type);
+			out << " (" << record.id << "): " << record.message << "\n";
+			wrote = true;
+		}
+		return wrote;
+	};
+
+	// Print repeat counts since the last report; returns true if anything was printed
+	auto reportRepeats = [&]() {
+		bool wrote = false;
+		for(auto &entry : seen) {
+			if(entry.second.sinceReport == 0) continue;
+			out << "GL debug: id " << (entry.first & 0xffffffffu) << " repeated ";
+			out << entry.second.sinceReport << " more times\n";
+			entry.second.sinceReport = 0;
+			wrote = true;
+		}
+		return wrote;
+	};
+
+	while(loggerRunning.load()) {
+		// Refill rate-limit budget (at most one second's worth)
+		auto now = chrono::steady_clock::now();
+		double elapsed = chrono::duration<double>(now - lastRefill).count();
+		lastRefill = now;
+		double limit = rateLimit.load();
+		tokens = min(limit, tokens + elapsed * limit);
+
+		bool wrote = drain();
+
+		// Once per second, summarize repeats of messages already shown
+		if(now - lastRepeatReport > chrono::seconds(1)) {
+			lastRepeatReport = now;
+			wrote = reportRepeats() || wrote;
+		}
+
+		// One write + flush per batch instead of per line
+		if(wrote) {
+			cout << out.str() << flush;
+			out.str("");
+		}
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+
+	// Final drain (ignores the rate limit so nothing new is lost at exit)
+	tokens = 1e9;
+	drain();
+	reportRepeats();
+	cout << out.str();
+}
+
+// Start logger thread (async mode)
+void startGLDebugLogger() {
+	if(loggerRunning.load()) return;
+	loggerRunning.store(true);
+	loggerThread = thread(runGLDebugLogger);
+}
+
+// Stop logger thread and print summary (safe to call if it never started)
+void stopGLDebugLogger() {
+	if(!loggerRunning.load()) return;
+	loggerRunning.store(false);
+	loggerThread.join();
+
+	cout << "GL debug output: " << counters.received.load() << " messages, ";
+	cout << counters.printed << " printed, " << counters.duplicates << " duplicates, ";
+	cout << counters.rateLimited << " rate-limited, " << counters.filtered.load() << " filtered, ";
+	cout << counters.dropped.load() << " dropped (queue full)" << endl;
+}
+
+string getGLDebugSourceName(GLenum source) {
+	switch(source) {
+		case GL_DEBUG_SOURCE_API: return "API";
+		case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "Window System";
+		case GL_DEBUG_SOURCE_SHADER_COMPILER: return "Shader Compiler";
+		case GL_DEBUG_SOURCE_THIRD_PARTY: return "Third Party";
+		case GL_DEBUG_SOURCE_APPLICATION: return "Application";
+		default: return "Other";
+	}
+}
+
+string getGLDebugTypeName(GLenum type) {
+	switch(type) {
+		case GL_DEBUG_TYPE_ERROR: return "Error";
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "Deprecated Behaviour";
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "Undefined Behaviour";
+		case GL_DEBUG_TYPE_PORTABILITY: return "Portability";
+		case GL_DEBUG_TYPE_PERFORMANCE: return "Performance";
+		case GL_DEBUG_TYPE_MARKER: return "Marker";
+		case GL_DEBUG_TYPE_PUSH_GROUP: return "Push Group";
+		case GL_DEBUG_TYPE_POP_GROUP: return "Pop Group";
+		default: return "Other";
+	}
+}
+
+string getGLDebugSeverityName(GLenum severity) {
+	switch(severity) {
+		case GL_DEBUG_SEVERITY_HIGH: return "high";
+		case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+		case GL_DEBUG_SEVERITY_LOW: return "low";
+		default: return "notification";
+	}
+}
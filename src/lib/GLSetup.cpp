@@ -1,4 +1,10 @@
 #include "GLSetup.hpp"
+#include "GLDebugOutput.hpp"
+
+#ifdef USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 // GLFW error callback
 static void error_callback(int error, const char* description) {
@@ -49,6 +55,7 @@ GLFWwindow* setupGLFW(string windowTitle, int major, int minor, int windowWidth,
 
 // Cleanup GLFW
 void cleanupGLFW(GLFWwindow* window) {
+	stopGLDebugLogger();
 	glfwDestroyWindow(window);
 	glfwTerminate();
 }
@@ -134,21 +141,184 @@ void APIENTRY openGLDebugCallback(	GLenum source,
 }
 
 // Check and setup debugging
+// (mode set with setGLDebugMode()/--gl-debug; async by default)
 void checkAndSetupOpenGLDebugging() {
 	// If we have a debug context, we can connect a callback function for OpenGL errors...
 	int flags; 
 	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
-	if(flags & GL_CONTEXT_FLAG_DEBUG_BIT) {
-		// Enable debug output
-		glEnable(GL_DEBUG_OUTPUT);
-		// Call debug output function when error occurs
-    	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS); 
+	if(!(flags & GL_CONTEXT_FLAG_DEBUG_BIT) || getGLDebugMode() == DEBUG_OUTPUT_OFF) return;
+
+	// Enable debug output
+	glEnable(GL_DEBUG_OUTPUT);
+
+	if(getGLDebugMode() == DEBUG_OUTPUT_SYNC) {
+		// Call debug output function when error occurs (stalls the driver, but the
+		// callback runs inside the offending GL call, which is handy in a debugger)
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS); 
 		// Attach error callback
-    	glDebugMessageCallback(openGLDebugCallback, nullptr);
-		// Control output
-		// * ALL messages...
-    	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
-		// * Only high severity errors from the OpenGL API...
-		// glDebugMessageControl(GL_DEBUG_SOURCE_API, GL_DEBUG_TYPE_ERROR, GL_DEBUG_SEVERITY_HIGH, 0, nullptr, GL_TRUE); 
+		glDebugMessageCallback(openGLDebugCallback, nullptr);
+	}
+	else {
+		// Driver may call back from its own threads; records are queued for the logger thread
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		glDebugMessageCallback(asyncGLDebugCallback, nullptr);
+		startGLDebugLogger();
+	}
+
+	// Control output
+	// * ALL messages...
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+	// * ...except severities filtered out at startup (no point in generating them)
+	const GLenum severities[] = { GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW, GL_DEBUG_SEVERITY_MEDIUM };
+	for(GLenum severity : severities) {
+		if(!isGLDebugSeverityEnabled(severity)) {
+			glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr, GL_FALSE);
+		}
+	}
+	// * Only high severity errors from the OpenGL API...
+	// glDebugMessageControl(GL_DEBUG_SOURCE_API, GL_DEBUG_TYPE_ERROR, GL_DEBUG_SEVERITY_HIGH, 0, nullptr, GL_TRUE); 
+}
+
+
+// GLEW setup for headless contexts (reports failure instead of exiting)
+static bool setupGLEWHeadless() {
+	glewExperimental = true;
+	GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// A GLX build of GLEW complains about the missing X display under EGL,
+	// but the GL entry points are loaded by then
+	if(err == GLEW_ERROR_NO_GLX_DISPLAY) err = GLEW_OK;
+#endif
+	if(GLEW_OK != err) {
+		cout << "ERROR: GLEW could not start: " << glewGetErrorString(err) << endl;
+		return false;
+	}
+	return true;
+}
+
+#ifdef USE_EGL
+// Try to create an EGL context without any window system (works with Mesa llvmpipe)
+static bool setupEGLContext(HeadlessGL &ctx, int major, int minor, bool debugging) {
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	// Prefer Mesa's surfaceless platform; fall back to the default display
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if(getPlatformDisplay) {
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	}
+	if(display == EGL_NO_DISPLAY) {
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	if(display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+		return false;
+	}
+	if(!eglBindAPI(EGL_OPENGL_API)) {
+		eglTerminate(display);
+		return false;
+	}
+
+	// Pick a pbuffer-capable config (also used if surfaceless contexts are unsupported)
+	EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint configCnt = 0;
+	eglChooseConfig(display, configAttribs, &config, 1, &configCnt);
+
+	EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, major,
+		EGL_CONTEXT_MINOR_VERSION, minor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_CONTEXT_OPENGL_DEBUG, debugging ? EGL_TRUE : EGL_FALSE,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, (configCnt > 0) ? config : EGL_NO_CONFIG_KHR,
+											EGL_NO_CONTEXT, contextAttribs);
+	if(context == EGL_NO_CONTEXT) {
+		eglTerminate(display);
+		return false;
+	}
+
+	// Surfaceless if possible; otherwise a tiny pbuffer
+	EGLSurface surface = EGL_NO_SURFACE;
+	if(!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		if(configCnt > 0) surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+		if(surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context)) {
+			if(surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+			eglDestroyContext(display, context);
+			eglTerminate(display);
+			return false;
+		}
+	}
+
+	ctx.eglDisplay = display;
+	ctx.eglContext = context;
+	ctx.eglSurface = surface;
+	return true;
+}
+#endif
+
+// Headless setup: returns false if no context could be created
+bool setupHeadlessGL(HeadlessGL &ctx, int major, int minor, bool debugging) {
+#ifdef USE_EGL
+	if(setupEGLContext(ctx, major, minor, debugging)) {
+		cout << "Headless context: EGL" << endl;
+		if(setupGLEWHeadless()) return true;
+		cleanupHeadlessGL(ctx);
+		return false;
+	}
+	cout << "EGL context unavailable; trying a hidden GLFW window." << endl;
+#endif
+
+	glfwSetErrorCallback(error_callback);
+	if (!glfwInit()) {
+		return false;
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debugging);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	ctx.window = glfwCreateWindow(16, 16, "Headless", NULL, NULL);
+	if (!ctx.window) {
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(ctx.window);
+	glfwSwapInterval(0);
+	cout << "Headless context: hidden GLFW window" << endl;
+
+	if(setupGLEWHeadless()) return true;
+	cleanupHeadlessGL(ctx);
+	return false;
+}
+
+// Cleanup headless context
+void cleanupHeadlessGL(HeadlessGL &ctx) {
+	stopGLDebugLogger();
+#ifdef USE_EGL
+	if(ctx.eglDisplay) {
+		EGLDisplay display = (EGLDisplay)ctx.eglDisplay;
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if(ctx.eglSurface) eglDestroySurface(display, (EGLSurface)ctx.eglSurface);
+		if(ctx.eglContext) eglDestroyContext(display, (EGLContext)ctx.eglContext);
+		eglTerminate(display);
+		ctx.eglDisplay = nullptr;
+		ctx.eglContext = nullptr;
+		ctx.eglSurface = nullptr;
+	}
+#endif
+	if(ctx.window) {
+		cleanupGLFW(ctx.window);
+		ctx.window = nullptr;
 	}
 }
@@ -0,0 +1,226 @@
+#include "GLState.hpp"
+
+// Cached state of the (single) current context
+static GLStateCache state;
+
+// Counts for the frame in progress, the last finished frame, and the whole run
+static GLStateCounters frameCounters;
+static GLStateCounters lastFrameCounters;
+static GLStateCounters totalCounters;
+static long long frameCnt = 0;
+
+// Returns true (and counts) if the call must reach GL
+static bool countCall(bool changed) {
+	if(changed) frameCounters.issued++;
+	else frameCounters.elided++;
+	return changed;
+}
+
+// Map buffer target to tracked slot (-1 if untracked)
+static int getBufferSlot(GLenum target) {
+	switch(target) {
+		case GL_ARRAY_BUFFER: return BUFFER_SLOT_ARRAY;
+		case GL_ELEMENT_ARRAY_BUFFER: return BUFFER_SLOT_ELEMENT_ARRAY;
+		case GL_UNIFORM_BUFFER: return BUFFER_SLOT_UNIFORM;
+		case GL_SHADER_STORAGE_BUFFER: return BUFFER_SLOT_SHADER_STORAGE;
+		case GL_PIXEL_PACK_BUFFER: return BUFFER_SLOT_PIXEL_PACK;
+		case GL_PIXEL_UNPACK_BUFFER: return BUFFER_SLOT_PIXEL_UNPACK;
+		default: return -1;
+	}
+}
+
+// Forget everything (next call of each kind goes to GL)
+void invalidateGLState() {
+	state = GLStateCache();
+}
+
+// Make sure the cache has values to compare against
+static void ensureKnown() {
+	if(state.known) return;
+
+	// Start with GL's defaults for a fresh context; the program/VAO/viewport
+	// are then forced through by marking them with impossible values
+	state = GLStateCache();
+	state.known = true;
+	state.program = (GLuint)-1;
+	state.vertexArray = (GLuint)-1;
+	state.viewport[2] = -1;
+
+	// Enable flags are cheap to query once and avoid assuming a default
+	state.depthTest = glIsEnabled(GL_DEPTH_TEST);
+	state.blend = glIsEnabled(GL_BLEND);
+	GLboolean depthMask = GL_TRUE;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+	state.depthMask = depthMask;
+	GLint depthFunc = GL_LESS;
+	glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+	state.depthFunc = depthFunc;
+	GLint blendSrc = GL_ONE, blendDst = GL_ZERO;
+	glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrc);
+	glGetIntegerv(GL_BLEND_DST_RGB, &blendDst);
+	state.blendSrc = blendSrc;
+	state.blendDst = blendDst;
+}
+
+// Set current shader program
+void useProgram(GLuint program) {
+	ensureKnown();
+	if(!countCall(state.program != program)) return;
+	glUseProgram(program);
+	state.program = program;
+}
+
+// Bind vertex array object
+void bindVertexArray(GLuint vao) {
+	ensureKnown();
+	if(!countCall(state.vertexArray != vao)) return;
+	glBindVertexArray(vao);
+	state.vertexArray = vao;
+
+	// Element array binding belongs to the VAO
+	state.bufferKnown[BUFFER_SLOT_ELEMENT_ARRAY] = false;
+}
+
+// Bind buffer to target
+void bindBuffer(GLenum target, GLuint buffer) {
+	ensureKnown();
+	int slot = getBufferSlot(target);
+	if(slot < 0) {
+		countCall(true);
+		glBindBuffer(target, buffer);
+		return;
+	}
+
+	if(!countCall(!state.bufferKnown[slot] || state.buffers[slot] != buffer)) return;
+	glBindBuffer(target, buffer);
+	state.buffers[slot] = buffer;
+	state.bufferKnown[slot] = true;
+}
+
+// Bind buffer to an indexed binding point (uniform / shader storage). The indexed
+// bindings are not cached, but GL also binds the buffer to the generic target.
+void bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+	ensureKnown();
+	countCall(true);
+	glBindBufferBase(target, index, buffer);
+	int slot = getBufferSlot(target);
+	if(slot >= 0) {
+		state.buffers[slot] = buffer;
+		state.bufferKnown[slot] = true;
+	}
+}
+
+// Bind texture to a unit, leaving unit 0 active (as the rest of the code expects).
+// Texture bindings are only counted, not cached: other code still binds textures directly.
+void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+	countCall(true);
+	if(unit != 0) glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(target, texture);
+	if(unit != 0) glActiveTexture(GL_TEXTURE0);
+}
+
+// Enable/disable depth testing
+void setDepthTest(bool enabled) {
+	ensureKnown();
+	if(!countCall(state.depthTest != enabled)) return;
+	if(enabled) glEnable(GL_DEPTH_TEST);
+	else glDisable(GL_DEPTH_TEST);
+	state.depthTest = enabled;
+}
+
+// Enable/disable depth writes
+void setDepthMask(bool enabled) {
+	ensureKnown();
+	if(!countCall(state.depthMask != enabled)) return;
+	glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	state.depthMask = enabled;
+}
+
+// Set depth comparison function
+void setDepthFunc(GLenum func) {
+	ensureKnown();
+	if(!countCall(state.depthFunc != func)) return;
+	glDepthFunc(func);
+	state.depthFunc = func;
+}
+
+// Enable/disable blending
+void setBlend(bool enabled) {
+	ensureKnown();
+	if(!countCall(state.blend != enabled)) return;
+	if(enabled) glEnable(GL_BLEND);
+	else glDisable(GL_BLEND);
+	state.blend = enabled;
+}
+
+// Set blend factors (same for color and alpha)
+void setBlendFunc(GLenum src, GLenum dst) {
+	ensureKnown();
+	if(!countCall(state.blendSrc != src || state.blendDst != dst)) return;
+	glBlendFunc(src, dst);
+	state.blendSrc = src;
+	state.blendDst = dst;
+}
+
+// Set viewport rectangle
+void setViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	ensureKnown();
+	GLint *v = state.viewport;
+	if(!countCall(v[0] != x || v[1] != y || v[2] != width || v[3] != height)) return;
+	glViewport(x, y, width, height);
+	v[0] = x;
+	v[1] = y;
+	v[2] = width;
+	v[3] = height;
+}
+
+// Delete shader program (stop using it first so GL can actually free it)
+void deleteProgram(GLuint &program) {
+	if(state.known && state.program == program) useProgram(0);
+	glDeleteProgram(program);
+	program = 0;
+}
+
+// Delete vertex array object (deleting the bound VAO reverts to 0)
+void deleteVertexArray(GLuint &vao) {
+	if(state.known && state.vertexArray == vao) {
+		state.vertexArray = 0;
+		state.bufferKnown[BUFFER_SLOT_ELEMENT_ARRAY] = false;
+	}
+	glDeleteVertexArrays(1, &vao);
+	vao = 0;
+}
+
+// Delete buffer (deleting a bound buffer reverts that binding to 0)
+void deleteBuffer(GLuint &buffer) {
+	if(state.known) {
+		for(int i = 0; i < BUFFER_SLOT_CNT; i++) {
+			if(state.bufferKnown[i] && state.buffers[i] == buffer) state.buffers[i] = 0;
+		}
+	}
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+// Close out this frame's counts
+void endGLStateFrame() {
+	lastFrameCounters = frameCounters;
+	totalCounters.issued += frameCounters.issued;
+	totalCounters.elided += frameCounters.elided;
+	frameCounters = GLStateCounters();
+	frameCnt++;
+}
+
+// Counts from the last finished frame
+GLStateCounters getGLStateFrameCounters() {
+	return lastFrameCounters;
+}
+
+// Print average issued/elided state changes per frame
+void printGLStateStats() {
+	if(frameCnt == 0) return;
+	long long all = totalCounters.issued + totalCounters.elided;
+	cout << "GL state calls per frame: " << (double)totalCounters.issued / frameCnt << " issued, ";
+	cout << (double)totalCounters.elided / frameCnt << " elided";
+	cout << " (" << (all > 0 ? 100.0 * totalCounters.elided / all : 0.0) << "% redundant)" << endl;
+}
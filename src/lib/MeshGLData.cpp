@@ -1,28 +1,29 @@
 #include "MeshGLData.hpp"
+#include "GLState.hpp"
 
 // Create OpenGL mesh (VAO) from mesh data
 void createMeshGL(Mesh &m, MeshGL &mgl) {
 	// Create Vertex Buffer Object (VBO)
 	glGenBuffers(1, &(mgl.VBO));
-	glBindBuffer(GL_ARRAY_BUFFER, mgl.VBO);
+	bindBuffer(GL_ARRAY_BUFFER, mgl.VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*m.vertices.size(), m.vertices.data(), GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	
 	// Create Vertex Array Object (VAO)
 	glGenVertexArrays(1, &(mgl.VAO));
 
 	// Enable VAO
-	glBindVertexArray(mgl.VAO);
+	bindVertexArray(mgl.VAO);
 
 	// Enable the first two vertex attribute arrays
 	glEnableVertexAttribArray(0);	// position
 	glEnableVertexAttribArray(1);	// color
 	glEnableVertexAttribArray(2);    // normal
+	glEnableVertexAttribArray(3);	// texcoord
 	
 	// Bind the VBO and set up data mappings so that VAO knows how to read it
 	// 0 = pos (3 elements)
 	// 1 = color (4 elements)
-	glBindBuffer(GL_ARRAY_BUFFER, mgl.VBO);	
+	bindBuffer(GL_ARRAY_BUFFER, mgl.VBO);
 
 	// Attribute, # of components, type, normalized?, stride, array buffer offset
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 
@@ -31,10 +32,12 @@ void createMeshGL(Mesh &m, MeshGL &mgl) {
 							(void*)offsetof(Vertex, color));
 	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
 							(void*)offsetof(Vertex, normal));
+	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+							(void*)offsetof(Vertex, texcoord));
 	
 	// Create Element Buffer Object (EBO)
 	glGenBuffers(1, &(mgl.EBO));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mgl.EBO);
+	bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mgl.EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
 		m.indices.size() * sizeof(GLuint),
 		m.indices.data(),
@@ -43,31 +46,46 @@ void createMeshGL(Mesh &m, MeshGL &mgl) {
 	// Set index count
 	mgl.indexCnt = (int)m.indices.size();
 
+	// Position-only stream: a depth pass fetches 12 instead of 48 bytes per vertex
+	vector<glm::vec3> positions(m.vertices.size());
+	for(size_t i = 0; i < m.vertices.size(); i++) {
+		positions[i] = m.vertices[i].position;
+	}
+	glGenBuffers(1, &(mgl.positionVBO));
+	bindBuffer(GL_ARRAY_BUFFER, mgl.positionVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3)*positions.size(), positions.data(), GL_STATIC_DRAW);
+
+	glGenVertexArrays(1, &(mgl.depthVAO));
+	bindVertexArray(mgl.depthVAO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+	bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mgl.EBO);
+
 	// Unbind vertex array for now
-	glBindVertexArray(0);
+	bindVertexArray(0);
 }
 
 // Draw OpenGL mesh
 void drawMesh(MeshGL &mgl) {
-	glBindVertexArray(mgl.VAO);
+	// Left bound afterwards; drawing the same mesh again skips the rebind
+	bindVertexArray(mgl.VAO);
+	glDrawElements(GL_TRIANGLES, mgl.indexCnt, GL_UNSIGNED_INT, (void*)0);
+}
+
+// Draw positions only (for depth-only passes; shader must only read location 0)
+void drawMeshDepth(MeshGL &mgl) {
+	bindVertexArray(mgl.depthVAO);
 	glDrawElements(GL_TRIANGLES, mgl.indexCnt, GL_UNSIGNED_INT, (void*)0);
-	glBindVertexArray(0);		
 }
 
 // Cleanup OpenGL mesh
 void cleanupMesh(MeshGL &mgl) {
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glDeleteBuffers(1, &(mgl.VBO));
-	mgl.VBO = 0;
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glDeleteBuffers(1, &(mgl.EBO));
-	mgl.EBO = 0;
-
-	glBindVertexArray(0);
-	glDeleteVertexArrays(1, &(mgl.VAO));
-	mgl.VAO = 0;
+	// No need to unbind first: deleting a bound object unbinds it
+	deleteBuffer(mgl.VBO);
+	deleteBuffer(mgl.EBO);
+	deleteVertexArray(mgl.VAO);
+	deleteBuffer(mgl.positionVBO);
+	deleteVertexArray(mgl.depthVAO);
 
 	mgl.indexCnt = 0;
 }
@@ -0,0 +1,294 @@
+#include "Profiler.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+// Global profiler state
+static atomic<bool> profilingEnabled{false};
+static string profileCSVPath;
+
+// Zone registry (only locked when a call site registers its zone)
+static mutex zoneRegistryMutex;
+static string zoneNames[MAX_PROFILE_ZONES];
+static bool zoneIsGPU[MAX_PROFILE_ZONES];
+static atomic<int> zoneCnt{0};
+
+// Per-thread CPU record buffers (registered once per thread, never freed)
+static atomic<ProfileThreadBuffer*> threadBuffers[MAX_PROFILE_THREADS];
+static atomic<int> threadBufferCnt{0};
+static thread_local ProfileThreadBuffer* localBuffer = nullptr;
+static thread_local bool localBufferUnavailable = false;
+
+// Per-zone accumulation for the current frame plus rolling history
+static double frameSumMS[MAX_PROFILE_ZONES];
+static bool frameHit[MAX_PROFILE_ZONES];
+static float historyMS[MAX_PROFILE_ZONES][PROFILE_ROLLING_FRAMES];
+static int historyCnt[MAX_PROFILE_ZONES];
+static int historyNext[MAX_PROFILE_ZONES];
+
+// GPU timestamp queries, one set per in-flight frame.
+// Timestamps (rather than GL_TIME_ELAPSED) are used so GPU zones may nest.
+struct GPUFrameQueries {
+	GLuint startQueries[MAX_GPU_ZONES_PER_FRAME];
+	GLuint endQueries[MAX_GPU_ZONES_PER_FRAME];
+	int zoneIDs[MAX_GPU_ZONES_PER_FRAME];
+	int zoneCnt = 0;
+};
+static GPUFrameQueries gpuFrames[GPU_PROFILE_LATENCY];
+static int gpuFrameIndex = 0;
+static bool gpuReady = false;
+static int gpuDroppedFrames = 0;
+
+// Read --profile / --profile-csv <file> from the command line
+void parseProfilerArgs(int &argc, char **argv) {
+	if(consumeFlag(argc, argv, "--profile")) setProfilingEnabled(true);
+	if(consumeOption(argc, argv, "--profile-csv", profileCSVPath)) setProfilingEnabled(true);
+}
+
+void setProfilingEnabled(bool enabled) {
+	profilingEnabled.store(enabled, memory_order_relaxed);
+}
+
+bool isProfilingEnabled() {
+	return profilingEnabled.load(memory_order_relaxed);
+}
+
+// Monotonic time in nanoseconds
+uint64_t profileNowNS() {
+	return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+				chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Get (or create) the zone ID for a name
+int registerProfileZone(string name, bool isGPU) {
+	lock_guard<mutex> lock(zoneRegistryMutex);
+	int cnt = zoneCnt.load();
+	for(int i = 0; i < cnt; i++) {
+		if(zoneNames[i] == name && zoneIsGPU[i] == isGPU) return i;
+	}
+	if(cnt >= MAX_PROFILE_ZONES) {
+		cerr << "WARNING: Too many profile zones; ignoring " << name << endl;
+		return -1;
+	}
+	zoneNames[cnt] = name;
+	zoneIsGPU[cnt] = isGPU;
+	zoneCnt.store(cnt + 1);
+	return cnt;
+}
+
+// Get this thread's record buffer, registering it on first use
+static ProfileThreadBuffer* getThreadBuffer() {
+	if(localBuffer || localBufferUnavailable) return localBuffer;
+
+	int index = threadBufferCnt.fetch_add(1);
+	if(index >= MAX_PROFILE_THREADS) {
+		cerr << "WARNING: Too many profiled threads; zones on this thread are ignored." << endl;
+		localBufferUnavailable = true;
+		return nullptr;
+	}
+	localBuffer = new ProfileThreadBuffer();
+	threadBuffers[index].store(localBuffer, memory_order_release);
+	return localBuffer;
+}
+
+// Push a finished CPU zone into this thread's ring (never blocks)
+void recordProfileZone(int zoneID, uint64_t startNS, uint64_t endNS) {
+	if(zoneID < 0 || !isProfilingEnabled()) return;
+	ProfileThreadBuffer *buffer = getThreadBuffer();
+	if(!buffer) return;
+
+	uint32_t head = buffer->head.load(memory_order_relaxed);
+	uint32_t tail = buffer->tail.load(memory_order_acquire);
+	if(head - tail >= (uint32_t)PROFILE_THREAD_RING_SIZE) {
+		buffer->dropped.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+	buffer->records[head % PROFILE_THREAD_RING_SIZE] = { zoneID, startNS, endNS - startNS };
+	buffer->head.store(head + 1, memory_order_release);
+}
+
+CPUProfileScope::CPUProfileScope(int id) : zoneID(id) {
+	startNS = isProfilingEnabled() ? profileNowNS() : 0;
+}
+
+CPUProfileScope::~CPUProfileScope() {
+	if(startNS) recordProfileZone(zoneID, startNS, profileNowNS());
+}
+
+// Create GPU query objects (needs a current context)
+void setupGPUProfiler() {
+	for(int i = 0; i < GPU_PROFILE_LATENCY; i++) {
+		glGenQueries(MAX_GPU_ZONES_PER_FRAME, gpuFrames[i].startQueries);
+		glGenQueries(MAX_GPU_ZONES_PER_FRAME, gpuFrames[i].endQueries);
+		gpuFrames[i].zoneCnt = 0;
+	}
+	gpuFrameIndex = 0;
+	gpuReady = true;
+}
+
+void cleanupGPUProfiler() {
+	if(!gpuReady) return;
+	for(int i = 0; i < GPU_PROFILE_LATENCY; i++) {
+		glDeleteQueries(MAX_GPU_ZONES_PER_FRAME, gpuFrames[i].startQueries);
+		glDeleteQueries(MAX_GPU_ZONES_PER_FRAME, gpuFrames[i].endQueries);
+	}
+	gpuReady = false;
+}
+
+// Issue start timestamp for a GPU zone; returns slot (or -1 if not recording)
+int beginGPUZone(int zoneID) {
+	if(zoneID < 0 || !gpuReady || !isProfilingEnabled()) return -1;
+	GPUFrameQueries &frame = gpuFrames[gpuFrameIndex];
+	if(frame.zoneCnt >= MAX_GPU_ZONES_PER_FRAME) return -1;
+	int slot = frame.zoneCnt++;
+	frame.zoneIDs[slot] = zoneID;
+	glQueryCounter(frame.startQueries[slot], GL_TIMESTAMP);
+	return slot;
+}
+
+void endGPUZone(int slot) {
+	if(slot < 0) return;
+	glQueryCounter(gpuFrames[gpuFrameIndex].endQueries[slot], GL_TIMESTAMP);
+}
+
+GPUProfileScope::GPUProfileScope(int zoneID) {
+	slot = beginGPUZone(zoneID);
+}
+
+GPUProfileScope::~GPUProfileScope() {
+	endGPUZone(slot);
+}
+
+// Read back a frame's GPU queries if (and only if) they are already done
+static void readGPUFrame(GPUFrameQueries &frame) {
+	if(frame.zoneCnt == 0) return;
+
+	GLint available = 0;
+	glGetQueryObjectiv(frame.endQueries[frame.zoneCnt - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if(!available) {
+		// Never wait on the GPU; just lose this frame's GPU samples
+		gpuDroppedFrames++;
+		frame.zoneCnt = 0;
+		return;
+	}
+
+	for(int i = 0; i < frame.zoneCnt; i++) {
+		GLuint64 startT = 0, endT = 0;
+		glGetQueryObjectui64v(frame.startQueries[i], GL_QUERY_RESULT, &startT);
+		glGetQueryObjectui64v(frame.endQueries[i], GL_QUERY_RESULT, &endT);
+		int zoneID = frame.zoneIDs[i];
+		frameSumMS[zoneID] += (endT - startT) / 1.0e6;
+		frameHit[zoneID] = true;
+	}
+	frame.zoneCnt = 0;
+}
+
+// Call at the start of each frame (before any GPU zones)
+void beginProfileFrame() {
+	if(!gpuReady || !isProfilingEnabled()) return;
+	// The slot we are about to reuse was issued GPU_PROFILE_LATENCY frames ago
+	gpuFrameIndex = (gpuFrameIndex + 1) % GPU_PROFILE_LATENCY;
+	readGPUFrame(gpuFrames[gpuFrameIndex]);
+}
+
+// Call at the end of each frame: drains CPU records and updates rolling stats
+void endProfileFrame() {
+	if(!isProfilingEnabled()) return;
+
+	int bufferCnt = min(threadBufferCnt.load(), MAX_PROFILE_THREADS);
+	for(int b = 0; b < bufferCnt; b++) {
+		ProfileThreadBuffer *buffer = threadBuffers[b].load(memory_order_acquire);
+		if(!buffer) continue;
+
+		uint32_t tail = buffer->tail.load(memory_order_relaxed);
+		uint32_t head = buffer->head.load(memory_order_acquire);
+		for(; tail != head; tail++) {
+			ProfileRecord &r = buffer->records[tail % PROFILE_THREAD_RING_SIZE];
+			frameSumMS[r.zoneID] += r.durationNS / 1.0e6;
+			frameHit[r.zoneID] = true;
+		}
+		buffer->tail.store(tail, memory_order_release);
+	}
+
+	// Zones hit more than once per frame (e.g., draw) report the frame total
+	int cnt = zoneCnt.load();
+	for(int z = 0; z < cnt; z++) {
+		if(!frameHit[z]) continue;
+		historyMS[z][historyNext[z]] = (float)frameSumMS[z];
+		historyNext[z] = (historyNext[z] + 1) % PROFILE_ROLLING_FRAMES;
+		historyCnt[z] = min(historyCnt[z] + 1, PROFILE_ROLLING_FRAMES);
+		frameSumMS[z] = 0.0;
+		frameHit[z] = false;
+	}
+}
+
+// Compute rolling statistics for every zone that has samples
+vector<ProfileZoneStats> getProfileStats() {
+	vector<ProfileZoneStats> allStats;
+	int cnt = zoneCnt.load();
+	for(int z = 0; z < cnt; z++) {
+		if(historyCnt[z] == 0) continue;
+
+		vector<float> samples(historyMS[z], historyMS[z] + historyCnt[z]);
+		sort(samples.begin(), samples.end());
+
+		ProfileZoneStats stats;
+		stats.name = zoneNames[z];
+		stats.isGPU = zoneIsGPU[z];
+		stats.sampleCnt = (int)samples.size();
+		double sum = 0.0;
+		for(float s : samples) sum += s;
+		stats.meanMS = sum / samples.size();
+		stats.minMS = samples.front();
+		stats.maxMS = samples.back();
+		stats.p95MS = samples.at((size_t)(0.95 * (samples.size() - 1) + 0.5));
+		int last = (historyNext[z] + PROFILE_ROLLING_FRAMES - 1) % PROFILE_ROLLING_FRAMES;
+		stats.lastMS = historyMS[z][last];
+		allStats.push_back(stats);
+	}
+	return allStats;
+}
+
+// Print per-zone statistics
+void printProfileStats() {
+	cout << "Profile zones (last " << PROFILE_ROLLING_FRAMES << " frames, ms):" << endl;
+	for(ProfileZoneStats &s : getProfileStats()) {
+		cout << "\t" << (s.isGPU ? "GPU " : "CPU ") << s.name;
+		cout << ": mean " << s.meanMS << ", min " << s.minMS << ", max " << s.maxMS;
+		cout << ", p95 " << s.p95MS << " (" << s.sampleCnt << " samples)" << endl;
+	}
+
+	uint32_t dropped = 0;
+	int bufferCnt = min(threadBufferCnt.load(), MAX_PROFILE_THREADS);
+	for(int b = 0; b < bufferCnt; b++) {
+		ProfileThreadBuffer *buffer = threadBuffers[b].load(memory_order_acquire);
+		if(buffer) dropped += buffer->dropped.load();
+	}
+	if(dropped > 0) cout << "\tDropped CPU records: " << dropped << endl;
+	if(gpuDroppedFrames > 0) cout << "\tGPU frames not ready in time: " << gpuDroppedFrames << endl;
+}
+
+// Dump per-zone statistics as CSV
+bool writeProfileCSV(string filename) {
+	ofstream file(filename);
+	if(!file) {
+		cerr << "ERROR: Could not open file: " << filename << endl;
+		return false;
+	}
+	file << "zone,type,samples,mean_ms,min_ms,max_ms,p95_ms,last_ms" << endl;
+	for(ProfileZoneStats &s : getProfileStats()) {
+		file << s.name << "," << (s.isGPU ? "gpu" : "cpu") << "," << s.sampleCnt << ",";
+		file << s.meanMS << "," << s.minMS << "," << s.maxMS << "," << s.p95MS << "," << s.lastMS << endl;
+	}
+	cout << "Profile written to " << filename << endl;
+	return true;
+}
+
+// Print and (if requested) save results
+void finishProfiling() {
+	if(!isProfilingEnabled()) return;
+	printProfileStats();
+	if(!profileCSVPath.empty()) writeProfileCSV(profileCSVPath);
+}
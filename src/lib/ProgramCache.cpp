@@ -0,0 +1,209 @@
+#include "ProgramCache.hpp"
+#include "Shader.hpp"
+#include "Utility.hpp"
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+// Cache file layout: header followed by the raw program binary
+static const uint32_t PROGRAM_CACHE_MAGIC = 0x42504C47;	// "GLPB"
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;				// Full key hash (guards against file name collisions)
+	uint32_t binaryFormat;
+	uint32_t binaryLength;
+	double compileMS;			// Source compile + link time when the entry was created
+};
+
+static string cacheDir = ".shadercache";
+static bool cacheEnabled = true;
+static ProgramCacheStats stats;
+
+// Where cache files go ("" disables the cache)
+void setProgramCacheDir(string dir) {
+	cacheDir = dir;
+}
+
+void setProgramCacheEnabled(bool enabled) {
+	cacheEnabled = enabled;
+}
+
+// Read cache options from the command line: --no-shader-cache, --shader-cache-dir <dir>
+void parseProgramCacheArgs(int &argc, char **argv) {
+	if(consumeFlag(argc, argv, "--no-shader-cache")) setProgramCacheEnabled(false);
+	string dir;
+	if(consumeOption(argc, argv, "--shader-cache-dir", dir)) setProgramCacheDir(dir);
+}
+
+// 64-bit FNV-1a over a string (continuing from hash)
+static uint64_t hashString(uint64_t hash, const string &s) {
+	for(unsigned char c : s) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	// Separator so ("ab", "c") and ("a", "bc") differ
+	hash ^= 0xff;
+	hash *= 1099511628211ull;
+	return hash;
+}
+
+// Driver string (empty if unavailable)
+static string getGLString(GLenum name) {
+	const GLubyte *s = glGetString(name);
+	return s ? string((const char*)s) : string();
+}
+
+// Cache key: sources + defines + driver identity (a driver update invalidates all entries)
+uint64_t hashProgramKey(string vertexShaderCode, string fragmentShaderCode, string defines) {
+	uint64_t hash = 14695981039346656037ull;
+	hash = hashString(hash, vertexShaderCode);
+	hash = hashString(hash, fragmentShaderCode);
+	hash = hashString(hash, defines);
+	hash = hashString(hash, getGLString(GL_VENDOR));
+	hash = hashString(hash, getGLString(GL_RENDERER));
+	hash = hashString(hash, getGLString(GL_VERSION));
+	return hash;
+}
+
+// Path of cache file for key
+static string getCachePath(uint64_t key) {
+	ostringstream name;
+	name << cacheDir << "/" << hex << key << ".bin";
+	return name.str();
+}
+
+// Does the driver support any program binary format?
+static bool hasProgramBinarySupport() {
+	GLint formatCnt = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCnt);
+	return formatCnt > 0;
+}
+
+// Try to create program from cache file; returns 0 on miss or rejection
+static GLuint loadCachedProgram(uint64_t key, double &compileMS) {
+	ifstream file(getCachePath(key), ios::binary);
+	if(!file) return 0;
+
+	ProgramCacheHeader header;
+	if(!file.read((char*)&header, sizeof(header)) ||
+		header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION || header.key != key) {
+		stats.rejected++;
+		return 0;
+	}
+	vector<char> binary(header.binaryLength);
+	if(!file.read(binary.data(), binary.size())) {
+		stats.rejected++;
+		return 0;
+	}
+
+	// The driver may still refuse it (e.g., a different build with identical version strings)
+	GLuint programID = glCreateProgram();
+	glProgramBinary(programID, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+	GLint linkOK = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linkOK);
+	if(!linkOK) {
+		glDeleteProgram(programID);
+		stats.rejected++;
+		return 0;
+	}
+	compileMS = header.compileMS;
+	return programID;
+}
+
+// Write program binary to the cache (failures only cost the next startup)
+static void storeCachedProgram(uint64_t key, GLuint programID, double compileMS) {
+	GLint length = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0) return;
+
+	vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(programID, length, &length, &format, binary.data());
+
+	error_code ec;
+	filesystem::create_directories(cacheDir, ec);
+
+	// Write to a temporary name first so a crash never leaves a truncated entry
+	string path = getCachePath(key);
+	string tmpPath = path + ".tmp";
+	{
+		ofstream file(tmpPath, ios::binary);
+		if(!file) return;
+		ProgramCacheHeader header;
+		header.magic = PROGRAM_CACHE_MAGIC;
+		header.version = PROGRAM_CACHE_VERSION;
+		header.key = key;
+		header.binaryFormat = format;
+		header.binaryLength = (uint32_t)length;
+		header.compileMS = compileMS;
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), length);
+		if(!file) return;
+	}
+	filesystem::rename(tmpPath, path, ec);
+	if(!ec) stats.stores++;
+}
+
+// Is the cache usable right now? (enabled, has a directory, driver supports binaries)
+bool isProgramCacheActive() {
+	return cacheEnabled && !cacheDir.empty() && hasProgramBinarySupport();
+}
+
+// Look up linked program for these sources; returns 0 on a miss or rejected binary
+GLuint findCachedProgram(string vertexShaderCode, string fragmentShaderCode, string defines) {
+	if(!isProgramCacheActive()) return 0;
+	auto start = chrono::steady_clock::now();
+	double compileMS = 0.0;
+	GLuint programID = loadCachedProgram(hashProgramKey(vertexShaderCode, fragmentShaderCode, defines), compileMS);
+	if(!programID) return 0;
+
+	double loadMS = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	stats.hits++;
+	stats.loadMS += loadMS;
+	stats.savedMS += max(0.0, compileMS - loadMS);
+	cout << "Program loaded from cache in " << loadMS << " ms";
+	cout << " (source compile took " << compileMS << " ms)" << endl;
+	return programID;
+}
+
+// Record a program compiled from source (and save its binary if the cache is active).
+// The program should have been linked with the retrievable hint.
+void storeProgramBinary(string vertexShaderCode, string fragmentShaderCode, string defines, GLuint programID, double compileMS) {
+	stats.misses++;
+	stats.loadMS += compileMS;
+	if(!isProgramCacheActive()) return;
+	storeCachedProgram(hashProgramKey(vertexShaderCode, fragmentShaderCode, defines), programID, compileMS);
+}
+
+// Like initShaderProgramFromSource, but reuses a linked binary from an earlier run when possible.
+// Falls back to compiling from source on a miss or when the driver rejects the binary.
+GLuint initShaderProgramCached(string vertexShaderCode, string fragmentShaderCode, string defines) {
+	GLuint programID = findCachedProgram(vertexShaderCode, fragmentShaderCode, defines);
+	if(programID) return programID;
+
+	// Miss: compile from source (throws on errors, as before)
+	auto start = chrono::steady_clock::now();
+	programID = initShaderProgramFromSource(vertexShaderCode, fragmentShaderCode, isProgramCacheActive());
+	double compileMS = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	cout << "Program compiled from source in " << compileMS << " ms" << endl;
+
+	storeProgramBinary(vertexShaderCode, fragmentShaderCode, defines, programID, compileMS);
+	return programID;
+}
+
+ProgramCacheStats getProgramCacheStats() {
+	return stats;
+}
+
+// Print hits/misses and time spent (vs. compiling everything from source)
+void printProgramCacheStats() {
+	cout << "Program cache: " << stats.hits << " hits, " << stats.misses << " misses, ";
+	cout << stats.rejected << " rejected, " << stats.stores << " stored; ";
+	cout << stats.loadMS << " ms total, ~" << stats.savedMS << " ms saved" << endl;
+}
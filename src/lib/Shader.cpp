@@ -1,4 +1,8 @@
 #include "Shader.hpp"
+#include <algorithm>
+
+// Every file read by readFileToString (so shader files can be watched for changes)
+static vector<string> loadedShaderFiles;
 
 // Read from file and dump in string
 string readFileToString(string filename) {
@@ -18,10 +22,19 @@ string readFileToString(string filename) {
 	string allS = outS.str();
 	// Close file
 	file.close();
+	// Remember it
+	if(find(loadedShaderFiles.begin(), loadedShaderFiles.end(), filename) == loadedShaderFiles.end()) {
+		loadedShaderFiles.push_back(filename);
+	}
 	// Return string
 	return allS;
 }
 
+// Files loaded so far with readFileToString (in load order)
+vector<string> getLoadedShaderFiles() {
+	return loadedShaderFiles;
+}
+
 // Print out shader code
 void printShaderCode(string &vertexCode, string &fragCode) {
 	cout << "***********************" << endl;
@@ -98,7 +111,8 @@ GLuint createAndCompileShader(const char *shaderCode, GLenum shaderType) {
 }
 
 // Given a list of compiled shaders, create and link a shader program (ID returned).
-GLuint createAndLinkShaderProgram(std::vector<GLuint> allShaderIDs) {
+// If retrievable, the driver is asked to keep the binary for glGetProgramBinary.
+GLuint createAndLinkShaderProgram(std::vector<GLuint> allShaderIDs, bool retrievable) {
 
 	// Create program ID and attach shaders
 	cout << "Linking program..." << endl;
@@ -106,6 +120,7 @@ GLuint createAndLinkShaderProgram(std::vector<GLuint> allShaderIDs) {
 	for (GLuint &shaderID : allShaderIDs) {
 		glAttachShader(programID, shaderID);
 	}
+	if (retrievable) glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
 	// Actually link the program
 	glLinkProgram(programID);
@@ -131,7 +146,8 @@ GLuint createAndLinkShaderProgram(std::vector<GLuint> allShaderIDs) {
 // - Creates and compiles vertex and fragment shaders (from provided code strings)
 // - Creates and links shader program
 // - Deletes vertex and fragment shaders
-GLuint initShaderProgramFromSource(string vertexShaderCode, string fragmentShaderCode) {
+// (retrievable: keep the program binary available for the program cache)
+GLuint initShaderProgramFromSource(string vertexShaderCode, string fragmentShaderCode, bool retrievable) {
 	GLuint vertID = 0;
 	GLuint fragID = 0;
 	GLuint programID = 0;
@@ -144,7 +160,7 @@ GLuint initShaderProgramFromSource(string vertexShaderCode, string fragmentShade
 		fragID = createAndCompileShader(fragmentShaderCode.c_str(), GL_FRAGMENT_SHADER);
 
 		// Create and link program
-		programID = createAndLinkShaderProgram({ vertID, fragID });
+		programID = createAndLinkShaderProgram({ vertID, fragID }, retrievable);
 
 		// Delete individual shaders
 		glDeleteShader(vertID);
@@ -163,3 +179,318 @@ GLuint initShaderProgramFromSource(string vertexShaderCode, string fragmentShade
 
 	return programID;
 }
+
+// Insert a generated header with the defines right after #version (which must stay first).
+// A #line directive follows it, so compiler errors still report the file's own line numbers.
+string applyShaderDefines(string code, vector<string> defines) {
+	if(defines.empty()) return code;
+
+	// Find the #version line (if any)
+	size_t insertPos = 0;
+	int nextLine = 1;
+	size_t lineStart = 0;
+	for(int line = 1; lineStart < code.size(); line++) {
+		size_t lineEnd = code.find('\n', lineStart);
+		if(lineEnd == string::npos) lineEnd = code.size();
+		size_t first = code.find_first_not_of(" \t", lineStart);
+		if(first < lineEnd && code.compare(first, 8, "#version") == 0) {
+			insertPos = min(lineEnd + 1, code.size());
+			nextLine = line + 1;
+			break;
+		}
+		lineStart = lineEnd + 1;
+	}
+
+	ostringstream header;
+	if(insertPos == code.size() && (code.empty() || code.back() != '\n')) header << "\n";
+	header << "// Permutation: " << getShaderDefinesKey(defines) << "\n";
+	for(string &define : defines) {
+		size_t eq = define.find('=');
+		if(eq == string::npos) header << "#define " << define << " 1\n";
+		else header << "#define " << define.substr(0, eq) << " " << define.substr(eq + 1) << "\n";
+	}
+	header << "#line " << nextLine << "\n";
+
+	return code.substr(0, insertPos) + header.str() + code.substr(insertPos);
+}
+
+// Canonical name of a define set (order-independent; "" when empty)
+string getShaderDefinesKey(vector<string> defines) {
+	sort(defines.begin(), defines.end());
+	defines.erase(unique(defines.begin(), defines.end()), defines.end());
+	string key;
+	for(string &define : defines) {
+		if(!key.empty()) key += " ";
+		key += define;
+	}
+	return key;
+}
+
+// Name of resource (index) in program interface
+static string getResourceName(GLuint programID, GLenum interface, GLuint index, GLint nameLength) {
+	vector<char> name(max(nameLength, 1));
+	glGetProgramResourceName(programID, interface, index, (GLsizei)name.size(), NULL, name.data());
+	return string(name.data());
+}
+
+// Enumerate active uniforms, uniform blocks, and vertex attributes of a linked program
+void reflectShaderProgram(GLuint programID, ShaderReflection &refl) {
+	refl = ShaderReflection();
+	refl.programID = programID;
+
+	// Uniforms
+	GLint uniformCnt = 0;
+	glGetProgramInterfaceiv(programID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCnt);
+	const GLenum uniformProps[] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX };
+	for(GLint i = 0; i < uniformCnt; i++) {
+		GLint values[5];
+		glGetProgramResourceiv(programID, GL_UNIFORM, i, 5, uniformProps, 5, NULL, values);
+
+		ShaderVariable var;
+		var.name = getResourceName(programID, GL_UNIFORM, i, values[0]);
+		var.type = values[1];
+		var.location = values[2];
+		var.arraySize = values[3];
+		var.blockIndex = values[4];
+
+		// Arrays are reported as "name[0]"; allow lookups by the base name too
+		string key = var.name;
+		if(key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0) {
+			key = key.substr(0, key.size() - 3);
+		}
+
+		// Default-block uniforms get a staging slot
+		if(var.blockIndex < 0 && var.location >= 0) {
+			var.slot = (int)refl.values.size();
+			UniformValue value;
+			value.location = var.location;
+			value.type = var.type;
+			refl.values.push_back(value);
+		}
+		refl.uniforms[key] = var;
+	}
+
+	// Uniform blocks
+	GLint blockCnt = 0;
+	glGetProgramInterfaceiv(programID, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &blockCnt);
+	const GLenum blockProps[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES };
+	for(GLint i = 0; i < blockCnt; i++) {
+		GLint values[4];
+		glGetProgramResourceiv(programID, GL_UNIFORM_BLOCK, i, 4, blockProps, 4, NULL, values);
+
+		ShaderBlock block;
+		block.name = getResourceName(programID, GL_UNIFORM_BLOCK, i, values[0]);
+		block.binding = values[1];
+		block.dataSize = values[2];
+		block.variableCnt = values[3];
+		refl.uniformBlocks[block.name] = block;
+	}
+
+	// Vertex attributes
+	GLint attribCnt = 0;
+	glGetProgramInterfaceiv(programID, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &attribCnt);
+	const GLenum attribProps[] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE };
+	for(GLint i = 0; i < attribCnt; i++) {
+		GLint values[4];
+		glGetProgramResourceiv(programID, GL_PROGRAM_INPUT, i, 4, attribProps, 4, NULL, values);
+
+		ShaderVariable var;
+		var.name = getResourceName(programID, GL_PROGRAM_INPUT, i, values[0]);
+		var.type = values[1];
+		var.location = values[2];
+		var.arraySize = values[3];
+		refl.attributes[var.name] = var;
+	}
+}
+
+// Find uniform by name and check its type; returns staging slot (or -1).
+// Problems are printed once and kept for printShaderReflection().
+int resolveUniform(ShaderReflection &refl, string name, GLenum expectedType, GLint &location) {
+	location = -1;
+	auto it = refl.uniforms.find(name);
+	if(it == refl.uniforms.end()) {
+		cerr << "WARNING: Uniform \"" << name << "\" is not active in program " << refl.programID;
+		cerr << " (misspelled or optimized out)" << endl;
+		refl.missingUniforms.push_back(name);
+		return -1;
+	}
+
+	ShaderVariable &var = it->second;
+	var.requested = true;
+	if(var.type != expectedType) {
+		cerr << "WARNING: Uniform \"" << name << "\" is " << getGLTypeName(var.type);
+		cerr << " in the shader but set as " << getGLTypeName(expectedType) << endl;
+		refl.mismatchedUniforms.push_back(name);
+		return -1;
+	}
+
+	location = var.location;
+	return var.slot;
+}
+
+// Copy value into staging slot; only marked dirty if it differs from the last upload
+void stageUniform(ShaderReflection &refl, int slot, const void *data, int size) {
+	UniformValue &value = refl.values[slot];
+	if(value.everSet && value.size == size && memcmp(value.data, data, size) == 0) {
+		if(!value.dirty) refl.skippedCnt++;
+		return;
+	}
+	memcpy(value.data, data, size);
+	value.size = size;
+	value.dirty = true;
+	value.everSet = true;
+}
+
+// Upload all dirty staged uniforms in one pass
+// (glProgramUniform*, so the program does not have to be bound)
+void flushUniforms(ShaderReflection &refl) {
+	GLuint programID = refl.programID;
+	for(UniformValue &value : refl.values) {
+		if(!value.dirty) continue;
+		const GLfloat *f = (const GLfloat*)value.data;
+		switch(value.type) {
+			case GL_FLOAT: glProgramUniform1fv(programID, value.location, 1, f); break;
+			case GL_FLOAT_VEC2: glProgramUniform2fv(programID, value.location, 1, f); break;
+			case GL_FLOAT_VEC3: glProgramUniform3fv(programID, value.location, 1, f); break;
+			case GL_FLOAT_VEC4: glProgramUniform4fv(programID, value.location, 1, f); break;
+			case GL_FLOAT_MAT3: glProgramUniformMatrix3fv(programID, value.location, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT4: glProgramUniformMatrix4fv(programID, value.location, 1, GL_FALSE, f); break;
+			case GL_INT: glProgramUniform1iv(programID, value.location, 1, (const GLint*)value.data); break;
+			case GL_INT_VEC3: glProgramUniform3iv(programID, value.location, 1, (const GLint*)value.data); break;
+			default: break;
+		}
+		value.dirty = false;
+		refl.uploadCnt++;
+	}
+}
+
+// Readable name for common GLSL types
+string getGLTypeName(GLenum type) {
+	switch(type) {
+		case GL_FLOAT: return "float";
+		case GL_FLOAT_VEC2: return "vec2";
+		case GL_FLOAT_VEC3: return "vec3";
+		case GL_FLOAT_VEC4: return "vec4";
+		case GL_INT: return "int";
+		case GL_INT_VEC2: return "ivec2";
+		case GL_INT_VEC3: return "ivec3";
+		case GL_INT_VEC4: return "ivec4";
+		case GL_UNSIGNED_INT: return "uint";
+		case GL_BOOL: return "bool";
+		case GL_FLOAT_MAT2: return "mat2";
+		case GL_FLOAT_MAT3: return "mat3";
+		case GL_FLOAT_MAT4: return "mat4";
+		case GL_SAMPLER_2D: return "sampler2D";
+		case GL_SAMPLER_2D_ARRAY: return "sampler2DArray";
+		case GL_SAMPLER_CUBE: return "samplerCube";
+		case GL_SAMPLER_2D_SHADOW: return "sampler2DShadow";
+		default: return "type 0x" + to_string(type);
+	}
+}
+
+// Print everything the program exposes and flag:
+// - uniforms the app asked for that are not active (typos / optimized out)
+// - uniforms requested with the wrong type
+// - active uniforms the app never resolved (left at their defaults)
+void printShaderReflection(ShaderReflection &refl) {
+	cout << "Program " << refl.programID << ": " << refl.uniforms.size() << " uniforms, ";
+	cout << refl.uniformBlocks.size() << " uniform blocks, " << refl.attributes.size() << " attributes" << endl;
+
+	for(auto &entry : refl.attributes) {
+		ShaderVariable &var = entry.second;
+		cout << "  in " << getGLTypeName(var.type) << " " << var.name << " (location " << var.location << ")" << endl;
+	}
+	for(auto &entry : refl.uniformBlocks) {
+		ShaderBlock &block = entry.second;
+		cout << "  uniform block " << block.name << " (binding " << block.binding << ", ";
+		cout << block.dataSize << " bytes, " << block.variableCnt << " members)" << endl;
+	}
+	for(auto &entry : refl.uniforms) {
+		ShaderVariable &var = entry.second;
+		cout << "  uniform " << getGLTypeName(var.type) << " " << var.name;
+		if(var.arraySize > 1) cout << " [" << var.arraySize << "]";
+		if(var.blockIndex >= 0) cout << " (in block)";
+		else cout << " (location " << var.location << ")";
+		if(var.blockIndex < 0 && !var.requested) cout << "  <-- UNUSED by application";
+		cout << endl;
+	}
+
+	for(string &name : refl.missingUniforms) {
+		cout << "  MISSING: \"" << name << "\" requested but not active" << endl;
+	}
+	for(string &name : refl.mismatchedUniforms) {
+		cout << "  MISMATCH: \"" << name << "\" requested with the wrong type" << endl;
+	}
+	cout << "  Uniform uploads: " << refl.uploadCnt << " (" << refl.skippedCnt << " unchanged values skipped)" << endl;
+}
+
+// Does the driver compile shaders in the background? (asks for as many threads as it likes)
+bool setupParallelShaderCompile() {
+	if(GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		return true;
+	}
+	if(GLEW_ARB_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		return true;
+	}
+	return false;
+}
+
+// Submit compile + link without querying any status (queries would force a synchronous compile)
+void beginProgramCompile(PendingProgram &pending, string vertexShaderCode, string fragmentShaderCode, bool retrievable) {
+	const char *vertexCode = vertexShaderCode.c_str();
+	const char *fragCode = fragmentShaderCode.c_str();
+
+	pending.vertID = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(pending.vertID, 1, &vertexCode, NULL);
+	glCompileShader(pending.vertID);
+
+	pending.fragID = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(pending.fragID, 1, &fragCode, NULL);
+	glCompileShader(pending.fragID);
+
+	pending.programID = glCreateProgram();
+	glAttachShader(pending.programID, pending.vertID);
+	glAttachShader(pending.programID, pending.fragID);
+	if(retrievable) glProgramParameteri(pending.programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(pending.programID);
+}
+
+// Non-blocking check whether the driver has finished (always true without the extension)
+bool isProgramCompileDone(PendingProgram &pending) {
+	if(!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile) return true;
+	GLint done = GL_TRUE;
+	glGetProgramiv(pending.programID, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+// Check results and return linked program; prints the logs and throws on errors
+// (pending is reset either way)
+GLuint finishProgramCompile(PendingProgram &pending) {
+	GLint vertOK = checkGLSLError(pending.vertID, true);
+	GLint fragOK = checkGLSLError(pending.fragID, true);
+	GLint linkOK = (vertOK && fragOK) ? checkGLSLError(pending.programID, false) : GL_FALSE;
+
+	GLuint programID = pending.programID;
+	glDetachShader(programID, pending.vertID);
+	glDetachShader(programID, pending.fragID);
+	glDeleteShader(pending.vertID);
+	glDeleteShader(pending.fragID);
+	pending = PendingProgram();
+
+	if(!linkOK) {
+		glDeleteProgram(programID);
+		cout << "Error compiling/linking shaders." << endl;
+		throw runtime_error("Error compiling/linking shaders.");
+	}
+	return programID;
+}
+
+// Throw away a compile that is no longer needed
+void cancelProgramCompile(PendingProgram &pending) {
+	if(pending.vertID) glDeleteShader(pending.vertID);
+	if(pending.fragID) glDeleteShader(pending.fragID);
+	if(pending.programID) glDeleteProgram(pending.programID);
+	pending = PendingProgram();
+}
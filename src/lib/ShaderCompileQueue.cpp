@@ -0,0 +1,97 @@
+#include "ShaderCompileQueue.hpp"
+#include "ProgramCache.hpp"
+#include <thread>
+
+// Milliseconds since the queue's first submit
+static double getQueueMS(ShaderCompileQueue &queue) {
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - queue.start).count();
+}
+
+// Submit program for compilation (returns its index). Never waits on the driver;
+// cached binaries are loaded right away and count as finished.
+int queueProgramCompile(ShaderCompileQueue &queue, string name, string vertexShaderCode, string fragmentShaderCode, string defines) {
+	if(!queue.started) {
+		queue.started = true;
+		queue.start = chrono::steady_clock::now();
+		setupParallelShaderCompile();
+	}
+
+	ShaderCompileJob job;
+	job.name = name;
+	job.vertexCode = vertexShaderCode;
+	job.fragCode = fragmentShaderCode;
+	job.defines = defines;
+	job.submitMS = getQueueMS(queue);
+
+	job.programID = findCachedProgram(vertexShaderCode, fragmentShaderCode, defines);
+	if(job.programID) {
+		job.done = true;
+		job.fromCache = true;
+		job.finishMS = getQueueMS(queue);
+	}
+	else {
+		beginProgramCompile(job.pending, vertexShaderCode, fragmentShaderCode, isProgramCacheActive());
+	}
+
+	queue.jobs.push_back(job);
+	return (int)queue.jobs.size() - 1;
+}
+
+// Finish every job the driver is done with; returns the number still compiling.
+// Errors are printed and the job is marked failed (getCompiledProgram throws for it).
+int pollShaderCompileQueue(ShaderCompileQueue &queue) {
+	int remaining = 0;
+	for(ShaderCompileJob &job : queue.jobs) {
+		if(job.done) continue;
+		if(!isProgramCompileDone(job.pending)) {
+			remaining++;
+			continue;
+		}
+
+		job.done = true;
+		try {
+			job.programID = finishProgramCompile(job.pending);
+		}
+		catch(exception &e) {
+			cout << "Program \"" << job.name << "\" failed to build." << endl;
+			job.failed = true;
+		}
+
+		// Stamped after finishing: without KHR_parallel_shader_compile, the link status query
+		// in finishProgramCompile is where the compile actually happens
+		job.finishMS = getQueueMS(queue);
+
+		// This program's own compile time (not the queue's), for the cache's saved-time statistics
+		if(!job.failed) storeProgramBinary(job.vertexCode, job.fragCode, job.defines, job.programID, job.finishMS - job.submitMS);
+	}
+
+	for(ShaderCompileJob &job : queue.jobs) queue.wallMS = max(queue.wallMS, job.finishMS);
+	return remaining;
+}
+
+// Block until everything is finished
+void waitShaderCompileQueue(ShaderCompileQueue &queue) {
+	auto start = chrono::steady_clock::now();
+	while(pollShaderCompileQueue(queue) > 0) {
+		this_thread::yield();
+	}
+	queue.blockedMS += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Linked program for job (waits for the queue if needed); throws if it failed
+GLuint getCompiledProgram(ShaderCompileQueue &queue, int index) {
+	ShaderCompileJob &job = queue.jobs.at(index);
+	if(!job.done) waitShaderCompileQueue(queue);
+	if(job.failed) throw runtime_error("Error building program \"" + job.name + "\".");
+	return job.programID;
+}
+
+// Report wall time of the whole queue and when each job finished
+void printShaderCompileStats(ShaderCompileQueue &queue) {
+	cout << "Shader compile queue: " << queue.jobs.size() << " programs in " << queue.wallMS << " ms wall";
+	cout << " (" << queue.blockedMS << " ms spent waiting)" << endl;
+	for(ShaderCompileJob &job : queue.jobs) {
+		cout << "  " << job.name << ": " << (job.failed ? "FAILED" : (job.fromCache ? "cache" : "compiled"));
+		cout << " at " << job.finishMS << " ms" << endl;
+	}
+}
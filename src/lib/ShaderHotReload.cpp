@@ -0,0 +1,162 @@
+#include "ShaderHotReload.hpp"
+#include "GLState.hpp"
+#include <filesystem>
+#include <unordered_map>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Wait this long after the last change before compiling (editors often write in several steps)
+static const chrono::milliseconds RELOAD_DEBOUNCE(100);
+
+static int inotifyFD = -1;
+static unordered_map<int, string> watchedDirs;			// Watch descriptor -> directory
+static vector<ReloadableProgram*> watchedPrograms;
+
+// Normalized absolute path (so "./shaders/x" and "shaders/x" compare equal)
+static string getNormalizedPath(string path) {
+	error_code ec;
+	filesystem::path p = filesystem::weakly_canonical(filesystem::absolute(path, ec), ec);
+	return p.string();
+}
+
+// Start watching the directories of every file loaded with readFileToString so far
+bool setupShaderHotReload() {
+#ifdef __linux__
+	if(inotifyFD < 0) {
+		inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(inotifyFD < 0) {
+			cerr << "WARNING: Shader hot reload unavailable (inotify_init1 failed)" << endl;
+			return false;
+		}
+	}
+
+	// Watch directories rather than files: many editors save by writing a new file and renaming it
+	for(string &file : getLoadedShaderFiles()) {
+		string dir = filesystem::path(getNormalizedPath(file)).parent_path().string();
+		bool known = false;
+		for(auto &entry : watchedDirs) known = known || (entry.second == dir);
+		if(known) continue;
+
+		int wd = inotify_add_watch(inotifyFD, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if(wd < 0) {
+			cerr << "WARNING: Cannot watch " << dir << " for shader changes" << endl;
+			continue;
+		}
+		watchedDirs[wd] = dir;
+	}
+	cout << "Shader hot reload: watching " << watchedDirs.size() << " directories";
+	cout << (setupParallelShaderCompile() ? " (parallel compile)" : " (blocking compile)") << endl;
+	return true;
+#else
+	cerr << "WARNING: Shader hot reload is only supported on Linux (inotify)" << endl;
+	return false;
+#endif
+}
+
+// Stop watching (and drop unfinished rebuilds; needs the GL context)
+void cleanupShaderHotReload() {
+	for(ReloadableProgram *prog : watchedPrograms) {
+		if(prog->compiling) cancelProgramCompile(prog->pending);
+		prog->compiling = false;
+	}
+#ifdef __linux__
+	if(inotifyFD >= 0) close(inotifyFD);
+#endif
+	inotifyFD = -1;
+	watchedDirs.clear();
+	watchedPrograms.clear();
+}
+
+// Register program (already created from these files) for reloading
+void watchShaderProgram(ReloadableProgram &prog, string vertexPath, string fragPath, GLuint programID, vector<string> defines) {
+	prog.vertexPath = vertexPath;
+	prog.fragPath = fragPath;
+	prog.defines = defines;
+	prog.programID = programID;
+	if(find(watchedPrograms.begin(), watchedPrograms.end(), &prog) == watchedPrograms.end()) {
+		watchedPrograms.push_back(&prog);
+	}
+}
+
+// Stop reloading program (call before it is destroyed)
+void unwatchShaderProgram(ReloadableProgram &prog) {
+	watchedPrograms.erase(remove(watchedPrograms.begin(), watchedPrograms.end(), &prog), watchedPrograms.end());
+}
+
+// Drain pending inotify events and flag programs whose files changed (non-blocking)
+static void pollShaderChanges() {
+#ifdef __linux__
+	if(inotifyFD < 0) return;
+
+	alignas(inotify_event) char buffer[4096];
+	while(true) {
+		ssize_t len = read(inotifyFD, buffer, sizeof(buffer));
+		if(len <= 0) break;
+
+		for(char *ptr = buffer; ptr < buffer + len; ) {
+			inotify_event *event = (inotify_event*)ptr;
+			ptr += sizeof(inotify_event) + event->len;
+			if(event->len == 0 || watchedDirs.count(event->wd) == 0) continue;
+
+			string path = watchedDirs[event->wd] + "/" + event->name;
+			for(ReloadableProgram *prog : watchedPrograms) {
+				if(path == getNormalizedPath(prog->vertexPath) || path == getNormalizedPath(prog->fragPath)) {
+					prog->changed = true;
+					prog->lastChange = chrono::steady_clock::now();
+				}
+			}
+		}
+	}
+#endif
+}
+
+// Call once per frame on the thread that owns the GL context.
+// Starts a background rebuild after the files change and swaps it in once it links.
+// Returns true if prog.programID changed (re-resolve uniform handles then).
+bool updateReloadableProgram(ReloadableProgram &prog) {
+	pollShaderChanges();
+	auto now = chrono::steady_clock::now();
+
+	// Start rebuild (after the files have settled; one at a time)
+	if(prog.changed && !prog.compiling && now - prog.lastChange > RELOAD_DEBOUNCE) {
+		prog.changed = false;
+		try {
+			string vertexCode = applyShaderDefines(readFileToString(prog.vertexPath), prog.defines);
+			string fragCode = applyShaderDefines(readFileToString(prog.fragPath), prog.defines);
+			beginProgramCompile(prog.pending, vertexCode, fragCode);
+			prog.compiling = true;
+			prog.compileStart = now;
+			cout << "Shader change detected; recompiling " << prog.fragPath << "..." << endl;
+		}
+		catch(exception &e) {
+			// File briefly missing mid-save; try again on the next change
+			prog.failedCnt++;
+		}
+	}
+
+	// Finished compiling? (never blocks with GL_KHR_parallel_shader_compile)
+	if(!prog.compiling || !isProgramCompileDone(prog.pending)) return false;
+	prog.compiling = false;
+
+	GLuint newProgramID = 0;
+	try {
+		newProgramID = finishProgramCompile(prog.pending);
+	}
+	catch(exception &e) {
+		prog.failedCnt++;
+		cout << "Shader reload failed; keeping the last good program." << endl;
+		return false;
+	}
+
+	// Atomic from the render loop's point of view: the old program is used up to here
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - prog.compileStart).count();
+	deleteProgram(prog.programID);
+	prog.programID = newProgramID;
+	prog.reloadCnt++;
+	cout << "Shader reloaded in " << ms << " ms (reload " << prog.reloadCnt << ")" << endl;
+	return true;
+}
@@ -0,0 +1,112 @@
+#include "ShaderPermutation.hpp"
+#include "ProgramCache.hpp"
+#include "GLState.hpp"
+#include <chrono>
+
+// Read the base sources (throws if a file is missing)
+void loadShaderPermutations(ShaderPermutationSet &perms, string vertexPath, string fragPath) {
+	perms.vertexPath = vertexPath;
+	perms.fragPath = fragPath;
+	perms.vertexCode = readFileToString(vertexPath);
+	perms.fragCode = readFileToString(fragPath);
+}
+
+// Sources of one variant (base sources with the defines injected)
+void getShaderVariantSource(ShaderPermutationSet &perms, vector<string> defines, string &vertexCode, string &fragCode) {
+	vertexCode = applyShaderDefines(perms.vertexCode, defines);
+	fragCode = applyShaderDefines(perms.fragCode, defines);
+}
+
+// Register a program built elsewhere (e.g., through a ShaderCompileQueue) as a variant
+void addShaderVariant(ShaderPermutationSet &perms, vector<string> defines, GLuint programID) {
+	ShaderVariant &variant = perms.variants[getShaderDefinesKey(defines)];
+	variant.defines = defines;
+	variant.program.vertexPath = perms.vertexPath;
+	variant.program.fragPath = perms.fragPath;
+	variant.program.defines = defines;
+	variant.program.programID = programID;
+	if(perms.watched) watchShaderProgram(variant.program, perms.vertexPath, perms.fragPath, programID, defines);
+}
+
+// Linked program for this define set; built on first use (throws if it does not compile)
+GLuint getShaderVariant(ShaderPermutationSet &perms, vector<string> defines) {
+	string key = getShaderDefinesKey(defines);
+	auto it = perms.variants.find(key);
+	if(it != perms.variants.end()) {
+		if(it->second.failed) throw runtime_error("Shader variant \"" + key + "\" failed to build.");
+		if(it->second.program.programID) return it->second.program.programID;
+	}
+
+	auto start = chrono::steady_clock::now();
+	string vertexCode, fragCode;
+	getShaderVariantSource(perms, defines, vertexCode, fragCode);
+	GLuint programID = 0;
+	try {
+		programID = initShaderProgramCached(vertexCode, fragCode, key);
+	}
+	catch(exception &e) {
+		cout << "Shader variant \"" << key << "\" failed to build." << endl;
+		perms.variants[key].failed = true;
+		throw;
+	}
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	perms.buildCnt++;
+	perms.buildMS += ms;
+	cout << "Shader variant \"" << key << "\" ready in " << ms << " ms" << endl;
+
+	addShaderVariant(perms, defines, programID);
+	return programID;
+}
+
+// Rebuild variants (existing and future ones) when the base files change
+void watchShaderPermutations(ShaderPermutationSet &perms) {
+	perms.watched = true;
+	for(auto &entry : perms.variants) {
+		ShaderVariant &variant = entry.second;
+		watchShaderProgram(variant.program, perms.vertexPath, perms.fragPath, variant.program.programID, variant.defines);
+	}
+}
+
+// Call once per frame on the GL thread (after watchShaderPermutations).
+// Returns true if any variant's program changed (re-resolve uniform handles then).
+bool updateShaderPermutations(ShaderPermutationSet &perms) {
+	bool swapped = false;
+	for(auto &entry : perms.variants) {
+		swapped = updateReloadableProgram(entry.second.program) || swapped;
+	}
+
+	// Variants built from now on should use the edited files too (and failed ones get another try)
+	if(swapped) {
+		try {
+			perms.vertexCode = readFileToString(perms.vertexPath);
+			perms.fragCode = readFileToString(perms.fragPath);
+		}
+		catch(exception &e) {}
+		for(auto it = perms.variants.begin(); it != perms.variants.end(); ) {
+			if(it->second.failed) it = perms.variants.erase(it);
+			else ++it;
+		}
+	}
+	return swapped;
+}
+
+// Delete every variant (needs the GL context)
+void cleanupShaderPermutations(ShaderPermutationSet &perms) {
+	for(auto &entry : perms.variants) {
+		ReloadableProgram &prog = entry.second.program;
+		unwatchShaderProgram(prog);
+		if(prog.compiling) cancelProgramCompile(prog.pending);
+		deleteProgram(prog.programID);
+	}
+	perms.variants.clear();
+}
+
+// Which variants were used and what building them cost
+void printShaderPermutationStats(ShaderPermutationSet &perms) {
+	cout << "Shader variants of " << perms.fragPath << ": " << perms.variants.size() << " in use, ";
+	cout << perms.buildCnt << " built lazily in " << perms.buildMS << " ms" << endl;
+	for(auto &entry : perms.variants) {
+		cout << "  \"" << entry.first << "\"" << endl;
+	}
+}
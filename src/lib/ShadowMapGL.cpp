@@ -0,0 +1,118 @@
+#include "ShadowMapGL.hpp"
+#include "GLState.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+// Create depth cube map and the FBO its faces are rendered through
+void createShadowMapGL(ShadowMapGL &sm, int size, float nearZ, float farZ) {
+	sm.size = size;
+	sm.nearZ = nearZ;
+	sm.farZ = farZ;
+	sm.valid = false;
+
+	glGenTextures(1, &(sm.cubeTex));
+	glBindTexture(GL_TEXTURE_CUBE_MAP, sm.cubeTex);
+	glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, GL_DEPTH_COMPONENT24, size, size);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	// Linear filtering + comparison = 2x2 PCF in hardware
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	glGenFramebuffers(1, &(sm.FBO));
+	glBindFramebuffer(GL_FRAMEBUFFER, sm.FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, sm.cubeTex, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		cleanupShadowMapGL(sm);
+		cout << "Error creating shadow map (status " << status << ")." << endl;
+		throw runtime_error("Error creating shadow map.");
+	}
+}
+
+// Does the map need re-rendering for this light position and caster version?
+// Counts a reuse when it does not.
+bool isShadowMapStale(ShadowMapGL &sm, glm::vec3 lightPos, uint64_t casterVersion) {
+	bool stale = !sm.valid || sm.lightPos != lightPos || sm.casterVersion != casterVersion;
+	if(!stale) sm.reuseCnt++;
+	return stale;
+}
+
+// 90 degree square frustum shared by all six faces
+glm::mat4 getShadowProjection(ShadowMapGL &sm) {
+	return glm::perspective(glm::radians(90.0f), 1.0f, sm.nearZ, sm.farZ);
+}
+
+// View matrix for cube face (GL_TEXTURE_CUBE_MAP_POSITIVE_X + face order).
+// The up vectors follow the cube map face orientation, so a world-space
+// direction from the light looks up the texel that was rendered there.
+glm::mat4 getShadowFaceView(glm::vec3 lightPos, int face) {
+	static const glm::vec3 dirs[6] = {
+		glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+		glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+	};
+	static const glm::vec3 ups[6] = {
+		glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),
+		glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0)
+	};
+	return glm::lookAt(lightPos, lightPos + dirs[face], ups[face]);
+}
+
+// Bind face as the render target and clear it (caller restores its framebuffer and viewport)
+void beginShadowFace(ShadowMapGL &sm, int face) {
+	glBindFramebuffer(GL_FRAMEBUFFER, sm.FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, sm.cubeTex, 0);
+	setViewport(0, 0, sm.size, sm.size);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+// Record what the map now holds
+void finishShadowUpdate(ShadowMapGL &sm, glm::vec3 lightPos, uint64_t casterVersion, double ms) {
+	sm.valid = true;
+	sm.lightPos = lightPos;
+	sm.casterVersion = casterVersion;
+	sm.updateCnt++;
+	sm.updateMS += ms;
+}
+
+// Force a re-render on the next check (e.g., after the shadow program was rebuilt)
+void invalidateShadowMap(ShadowMapGL &sm) {
+	sm.valid = false;
+}
+
+// Bind cube map to texture unit (Lit.fs expects SHADOW_MAP_UNIT)
+void bindShadowMap(ShadowMapGL &sm, GLuint unit) {
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, sm.cubeTex);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+// Cleanup FBO and cube map
+void cleanupShadowMapGL(ShadowMapGL &sm) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &(sm.FBO));
+	sm.FBO = 0;
+
+	glDeleteTextures(1, &(sm.cubeTex));
+	sm.cubeTex = 0;
+
+	sm.size = 0;
+	sm.valid = false;
+}
+
+// Print how often the cached map was reused
+void printShadowMapStats(ShadowMapGL &sm) {
+	cout << "Shadow map: " << sm.size << "x" << sm.size << " cube, " << sm.updateCnt << " updates, ";
+	cout << sm.reuseCnt << " frames reused the cached map";
+	if(sm.updateCnt > 0) cout << " (" << sm.updateMS / sm.updateCnt << " ms per update)";
+	cout << endl;
+}
@@ -0,0 +1,679 @@
+#include "SoftwareRasterizer.hpp"
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+#include "stb_image_write.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const float SWR_PI = 3.14159265359f;
+static const int SWR_SUBPIXEL = 1 << SWR_SUBPIXEL_BITS;
+static const int SWR_TILE_BLOCKS = SWR_TILE_SIZE / SWR_BLOCK_SIZE;
+
+// After clipping, screen coordinates stay within +-this many pixels. With SWR_MAX_SIZE and
+// 4 subpixel bits, edge steps stay below 2^19 and edge values within a tile below 2^29.
+static const float SWR_GUARD_BAND = 8192.0f;
+
+// Clip planes (one bit each in the outcodes)
+enum SoftwareClipPlane {
+	CLIP_NEAR,
+	CLIP_FAR,
+	CLIP_LEFT,
+	CLIP_RIGHT,
+	CLIP_BOTTOM,
+	CLIP_TOP,
+	CLIP_PLANE_CNT
+};
+
+// Per-thread visibility buffer for one tile
+struct SoftwareTileScratch {
+	alignas(16) float depth[SWR_TILE_SIZE * SWR_TILE_SIZE];
+	alignas(16) float blockMaxZ[SWR_TILE_BLOCKS * SWR_TILE_BLOCKS];		// Farthest depth per block
+	const SoftwareTriangle *triangle[SWR_TILE_SIZE * SWR_TILE_SIZE];		// Nearest so far
+};
+
+static double getElapsedMS(chrono::steady_clock::time_point start) {
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Floor of v / SWR_SUBPIXEL (also for negative v)
+static long long floorSubpixel(long long v) {
+	return (v >= 0) ? (v / SWR_SUBPIXEL) : -((-v + SWR_SUBPIXEL - 1) / SWR_SUBPIXEL);
+}
+
+bool setupSoftwareRenderer(SoftwareRenderer &sr, int width, int height, ThreadPool &pool) {
+	if(width < 1 || height < 1 || width > SWR_MAX_SIZE || height > SWR_MAX_SIZE) {
+		cerr << "ERROR: Software renderer size " << width << "x" << height << " is not supported (1 to " << SWR_MAX_SIZE << " per side)" << endl;
+		return false;
+	}
+	sr.width = width;
+	sr.height = height;
+	sr.tilesX = (width + SWR_TILE_SIZE - 1) / SWR_TILE_SIZE;
+	sr.tilesY = (height + SWR_TILE_SIZE - 1) / SWR_TILE_SIZE;
+	sr.pool = &pool;
+	sr.color.assign((size_t)width * height * 4, 0);
+	sr.batches.clear();
+	sr.batchCnt = 0;
+	return true;
+}
+
+void beginSoftwareFrame(SoftwareRenderer &sr, glm::mat4 viewMat, glm::mat4 projMat, SoftwareLight light, glm::vec3 clearColor) {
+	sr.viewMat = viewMat;
+	sr.projMat = projMat;
+	sr.light = light;
+	sr.clearColor = clearColor;
+	sr.batchCnt = 0;
+	sr.stats = SoftwareFrameStats();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Clipping, setup and binning
+///////////////////////////////////////////////////////////////////////////////
+
+// Signed distance to a clip plane (inside when >= 0); guardX/Y are the guard band in NDC
+static float getClipDistance(const glm::vec4 &c, int plane, float guardX, float guardY) {
+	switch(plane) {
+		case CLIP_NEAR: return c.z + c.w;
+		case CLIP_FAR: return c.w - c.z;
+		case CLIP_LEFT: return c.x + guardX * c.w;
+		case CLIP_RIGHT: return guardX * c.w - c.x;
+		case CLIP_BOTTOM: return c.y + guardY * c.w;
+		default: return guardY * c.w - c.y;
+	}
+}
+
+static int getOutcode(const glm::vec4 &c, float guardX, float guardY) {
+	int code = 0;
+	for(int p = 0; p < CLIP_PLANE_CNT; p++) {
+		if(getClipDistance(c, p, guardX, guardY) < 0.0f) code |= 1 << p;
+	}
+	return code;
+}
+
+static SoftwareVertex lerpVertex(const SoftwareVertex &a, const SoftwareVertex &b, float t) {
+	SoftwareVertex v;
+	v.clip = a.clip + (b.clip - a.clip) * t;
+	v.viewPos = a.viewPos + (b.viewPos - a.viewPos) * t;
+	v.normal = a.normal + (b.normal - a.normal) * t;
+	v.color = a.color + (b.color - a.color) * t;
+	return v;
+}
+
+// Set up one clipped triangle and add it to the tiles its bounds touch; returns the tile count
+static int setupTriangle(SoftwareRenderer &sr, SoftwareBatch &batch, const SoftwareVertex &a, const SoftwareVertex &b,
+						 const SoftwareVertex &c, const SoftwareMaterial &material) {
+	SoftwareTriangle t;
+	t.v[0] = a;
+	t.v[1] = b;
+	t.v[2] = c;
+
+	// Viewport transform (top row first), snapped to subpixels
+	float sz[3];
+	long long X[3], Y[3];
+	for(int k = 0; k < 3; k++) {
+		t.invW[k] = 1.0f / t.v[k].clip.w;
+		glm::vec3 ndc = glm::vec3(t.v[k].clip) * t.invW[k];
+		X[k] = llround((ndc.x * 0.5f + 0.5f) * sr.width * SWR_SUBPIXEL);
+		Y[k] = llround((0.5f - ndc.y * 0.5f) * sr.height * SWR_SUBPIXEL);
+		sz[k] = ndc.z * 0.5f + 0.5f;
+	}
+
+	// No culling (Assign07 draws both sides); flip clockwise triangles so inside is positive
+	long long area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+	if(area == 0) return 0;
+	if(area < 0) {
+		swap(t.v[1], t.v[2]);
+		swap(t.invW[1], t.invW[2]);
+		swap(sz[1], sz[2]);
+		swap(X[1], X[2]);
+		swap(Y[1], Y[2]);
+		area = -area;
+	}
+
+	// Pixels whose centers fall inside the bounds
+	long long minXs = min(X[0], min(X[1], X[2])), maxXs = max(X[0], max(X[1], X[2]));
+	long long minYs = min(Y[0], min(Y[1], Y[2])), maxYs = max(Y[0], max(Y[1], Y[2]));
+	t.minX = (int)max(0LL, floorSubpixel(minXs - SWR_SUBPIXEL / 2 + SWR_SUBPIXEL - 1));
+	t.minY = (int)max(0LL, floorSubpixel(minYs - SWR_SUBPIXEL / 2 + SWR_SUBPIXEL - 1));
+	t.maxX = (int)min((long long)sr.width - 1, floorSubpixel(maxXs - SWR_SUBPIXEL / 2));
+	t.maxY = (int)min((long long)sr.height - 1, floorSubpixel(maxYs - SWR_SUBPIXEL / 2));
+	if(t.minX > t.maxX || t.minY > t.maxY) return 0;
+
+	// Edge k runs from vertex k+1 to k+2. Pixels exactly on an edge belong to it only
+	// if it is a top or left edge, so shared edges are drawn once.
+	for(int k = 0; k < 3; k++) {
+		int i = (k + 1) % 3;
+		int j = (k + 2) % 3;
+		t.edgeA[k] = (int)(Y[i] - Y[j]);
+		t.edgeB[k] = (int)(X[j] - X[i]);
+		t.edgeC[k] = -((long long)t.edgeA[k] * X[i] + (long long)t.edgeB[k] * Y[i]);
+		bool topLeft = (t.edgeA[k] > 0) || (t.edgeA[k] == 0 && t.edgeB[k] > 0);
+		if(!topLeft) t.edgeC[k] -= 1;
+	}
+	t.invArea = 1.0f / (float)area;
+
+	// Depth is linear in screen space
+	double x0 = (double)X[0] / SWR_SUBPIXEL, y0 = (double)Y[0] / SWR_SUBPIXEL;
+	double ax = (double)(X[1] - X[0]) / SWR_SUBPIXEL, ay = (double)(Y[1] - Y[0]) / SWR_SUBPIXEL;
+	double bx = (double)(X[2] - X[0]) / SWR_SUBPIXEL, by = (double)(Y[2] - Y[0]) / SWR_SUBPIXEL;
+	double det = ax * by - ay * bx;
+	double dz1 = sz[1] - sz[0], dz2 = sz[2] - sz[0];
+	double dzdx = (dz1 * by - dz2 * ay) / det;
+	double dzdy = (dz2 * ax - dz1 * bx) / det;
+	t.dzdx = (float)dzdx;
+	t.dzdy = (float)dzdy;
+	t.zOrigin = (float)(sz[0] + dzdx * (0.5 - x0) + dzdy * (0.5 - y0));
+	t.minZ = max(0.0f, min(sz[0], min(sz[1], sz[2])));
+
+	// Attributes over w, interpolated linearly in screen space
+	for(int k = 0; k < 3; k++) {
+		t.v[k].viewPos *= t.invW[k];
+		t.v[k].normal *= t.invW[k];
+		t.v[k].color *= t.invW[k];
+	}
+	t.material = material;
+
+	int index = (int)batch.triangles.size();
+	batch.triangles.push_back(t);
+	int tileCnt = 0;
+	for(int ty = t.minY / SWR_TILE_SIZE; ty <= t.maxY / SWR_TILE_SIZE; ty++) {
+		for(int tx = t.minX / SWR_TILE_SIZE; tx <= t.maxX / SWR_TILE_SIZE; tx++) {
+			batch.tileTriangles[ty * sr.tilesX + tx].push_back(index);
+			tileCnt++;
+		}
+	}
+	return tileCnt;
+}
+
+// Clip, set up and bin triangles [first, last) of the mesh into the batch
+static void setupBatch(SoftwareRenderer &sr, SoftwareBatch &batch, const Mesh &mesh, int first, int last,
+					   const SoftwareMaterial &material, long long &binnedCnt) {
+	batch.triangles.clear();
+	batch.tileTriangles.resize(sr.tilesX * sr.tilesY);
+	for(vector<int> &list : batch.tileTriangles) list.clear();
+
+	float guardX = 2.0f * SWR_GUARD_BAND / sr.width - 1.0f;
+	float guardY = 2.0f * SWR_GUARD_BAND / sr.height - 1.0f;
+	for(int i = first; i < last; i++) {
+		const SoftwareVertex &a = sr.vertices[mesh.indices[i * 3]];
+		const SoftwareVertex &b = sr.vertices[mesh.indices[i * 3 + 1]];
+		const SoftwareVertex &c = sr.vertices[mesh.indices[i * 3 + 2]];
+		int codeA = getOutcode(a.clip, guardX, guardY);
+		int codeB = getOutcode(b.clip, guardX, guardY);
+		int codeC = getOutcode(c.clip, guardX, guardY);
+		if(codeA & codeB & codeC) continue;
+		if((codeA | codeB | codeC) == 0) {
+			binnedCnt += setupTriangle(sr, batch, a, b, c, material);
+			continue;
+		}
+
+		// Sutherland-Hodgman against the planes that are crossed, then a fan
+		SoftwareVertex polygons[2][3 + CLIP_PLANE_CNT];
+		int cnt = 3;
+		polygons[0][0] = a;
+		polygons[0][1] = b;
+		polygons[0][2] = c;
+		int src = 0;
+		for(int p = 0; p < CLIP_PLANE_CNT && cnt >= 3; p++) {
+			if(!((codeA | codeB | codeC) & (1 << p))) continue;
+			SoftwareVertex *in = polygons[src];
+			SoftwareVertex *out = polygons[1 - src];
+			int outCnt = 0;
+			for(int v = 0; v < cnt; v++) {
+				const SoftwareVertex &cur = in[v];
+				const SoftwareVertex &next = in[(v + 1) % cnt];
+				float dCur = getClipDistance(cur.clip, p, guardX, guardY);
+				float dNext = getClipDistance(next.clip, p, guardX, guardY);
+				if(dCur >= 0.0f) out[outCnt++] = cur;
+				if((dCur >= 0.0f) != (dNext >= 0.0f)) out[outCnt++] = lerpVertex(cur, next, dCur / (dCur - dNext));
+			}
+			cnt = outCnt;
+			src = 1 - src;
+		}
+		for(int v = 1; v + 1 < cnt; v++) {
+			binnedCnt += setupTriangle(sr, batch, polygons[src][0], polygons[src][v], polygons[src][v + 1], material);
+		}
+	}
+}
+
+// Transform the mesh's vertices (Lit.vs), then set up and bin its triangles
+void drawSoftwareMesh(SoftwareRenderer &sr, const Mesh &mesh, glm::mat4 modelMat, SoftwareMaterial material) {
+	auto start = chrono::steady_clock::now();
+	glm::mat4 modelView = sr.viewMat * modelMat;
+	glm::mat3 normMat = glm::transpose(glm::inverse(glm::mat3(modelView)));
+	glm::mat4 projMat = sr.projMat;
+	sr.vertices.resize(mesh.vertices.size());
+	parallelFor(*sr.pool, (int)mesh.vertices.size(), [&](int begin, int end) {
+		for(int i = begin; i < end; i++) {
+			const Vertex &in = mesh.vertices[i];
+			SoftwareVertex &out = sr.vertices[i];
+			glm::vec4 viewPos = modelView * glm::vec4(in.position, 1.0f);
+			out.clip = projMat * viewPos;
+			out.viewPos = glm::vec3(viewPos);
+			out.normal = normMat * in.normal;
+			out.color = glm::vec3(in.color);
+		}
+	});
+	sr.stats.vertexMS += getElapsedMS(start);
+
+	start = chrono::steady_clock::now();
+	int triCnt = (int)(mesh.indices.size() / 3);
+	int batchCnt = (triCnt + SWR_BATCH_TRIS - 1) / SWR_BATCH_TRIS;
+	int firstBatch = sr.batchCnt;
+	if((int)sr.batches.size() < firstBatch + batchCnt) sr.batches.resize(firstBatch + batchCnt);
+	vector<long long> binnedCnts(batchCnt, 0);
+	parallelFor(*sr.pool, batchCnt, [&](int begin, int end) {
+		for(int b = begin; b < end; b++) {
+			setupBatch(sr, sr.batches[firstBatch + b], mesh, b * SWR_BATCH_TRIS, min(triCnt, (b + 1) * SWR_BATCH_TRIS),
+					   material, binnedCnts[b]);
+		}
+	});
+	sr.batchCnt += batchCnt;
+
+	sr.stats.inputTriangles += triCnt;
+	for(int b = 0; b < batchCnt; b++) {
+		sr.stats.setupTriangles += sr.batches[firstBatch + b].triangles.size();
+		sr.stats.binnedTriangles += binnedCnts[b];
+	}
+	sr.stats.setupMS += getElapsedMS(start);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Rasterization
+///////////////////////////////////////////////////////////////////////////////
+
+// Farthest of an 8x8 block's depths (rows SWR_TILE_SIZE apart)
+static float getBlockMaxDepth(const float *depth) {
+#ifdef __SSE2__
+	__m128 m = _mm_max_ps(_mm_load_ps(depth), _mm_load_ps(depth + 4));
+	for(int row = 1; row < SWR_BLOCK_SIZE; row++) {
+		const float *d = depth + row * SWR_TILE_SIZE;
+		m = _mm_max_ps(m, _mm_max_ps(_mm_load_ps(d), _mm_load_ps(d + 4)));
+	}
+	m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(m);
+#else
+	float m = depth[0];
+	for(int row = 0; row < SWR_BLOCK_SIZE; row++) {
+		for(int x = 0; x < SWR_BLOCK_SIZE; x++) m = max(m, depth[row * SWR_TILE_SIZE + x]);
+	}
+	return m;
+#endif
+}
+
+// Depth test one triangle against the tile at (tileX, tileY) (pixels), keeping the nearest per pixel
+static void rasterTriangle(const SoftwareTriangle &t, SoftwareTileScratch &s, int tileX, int tileY, SoftwareFrameStats &stats) {
+	int x0 = max(t.minX, tileX) - tileX, x1 = min(t.maxX, tileX + SWR_TILE_SIZE - 1) - tileX;
+	int y0 = max(t.minY, tileY) - tileY, y1 = min(t.maxY, tileY + SWR_TILE_SIZE - 1) - tileY;
+	if(x0 > x1 || y0 > y1) return;
+
+	// Edges at the center of the tile's first pixel. An edge the whole tile is inside of is
+	// dropped (all zero); the rest vary by less than 2^29 over the tile, so 32 bits are enough.
+	const long long tileSpan = (long long)(SWR_TILE_SIZE - 1) * SWR_SUBPIXEL;
+	int A[3], B[3], E[3];
+	for(int k = 0; k < 3; k++) {
+		long long e = (long long)t.edgeA[k] * (tileX * SWR_SUBPIXEL + SWR_SUBPIXEL / 2)
+					+ (long long)t.edgeB[k] * (tileY * SWR_SUBPIXEL + SWR_SUBPIXEL / 2) + t.edgeC[k];
+		long long hi = e + (max(t.edgeA[k], 0) + max(t.edgeB[k], 0)) * tileSpan;
+		long long lo = e + (min(t.edgeA[k], 0) + min(t.edgeB[k], 0)) * tileSpan;
+		if(hi < 0) return;
+		if(lo >= 0) {
+			A[k] = B[k] = E[k] = 0;
+		}
+		else {
+			A[k] = t.edgeA[k];
+			B[k] = t.edgeB[k];
+			E[k] = (int)e;
+		}
+	}
+
+	const int blockStep = SWR_BLOCK_SIZE * SWR_SUBPIXEL;
+	const int blockSpan = (SWR_BLOCK_SIZE - 1) * SWR_SUBPIXEL;
+	for(int by = y0 / SWR_BLOCK_SIZE; by <= y1 / SWR_BLOCK_SIZE; by++) {
+		for(int bx = x0 / SWR_BLOCK_SIZE; bx <= x1 / SWR_BLOCK_SIZE; bx++) {
+			stats.testedBlocks++;
+
+			// Block outside an edge
+			int eb[3];
+			bool outside = false;
+			for(int k = 0; k < 3; k++) {
+				eb[k] = E[k] + A[k] * bx * blockStep + B[k] * by * blockStep;
+				if(eb[k] + (max(A[k], 0) + max(B[k], 0)) * blockSpan < 0) outside = true;
+			}
+			if(outside) continue;
+
+			// Hierarchical depth: nothing in the block can be nearer than the triangle's nearest vertex
+			float &blockMaxZ = s.blockMaxZ[by * SWR_TILE_BLOCKS + bx];
+			if(t.minZ >= blockMaxZ) {
+				stats.depthRejectedBlocks++;
+				continue;
+			}
+
+			int px = bx * SWR_BLOCK_SIZE, py = by * SWR_BLOCK_SIZE;
+			float zBlock = t.zOrigin + t.dzdx * (tileX + px) + t.dzdy * (tileY + py);
+			float *depthBlock = &s.depth[py * SWR_TILE_SIZE + px];
+			const SoftwareTriangle **triangleBlock = &s.triangle[py * SWR_TILE_SIZE + px];
+			bool written = false;
+#ifdef __SSE2__
+			// Four pixels per step; a pixel is outside if any edge value is negative (sign bit)
+			__m128i rowE[3], stepY[3], half[3];
+			for(int k = 0; k < 3; k++) {
+				int ax = A[k] * SWR_SUBPIXEL;
+				rowE[k] = _mm_add_epi32(_mm_set1_epi32(eb[k]), _mm_set_epi32(3 * ax, 2 * ax, ax, 0));
+				stepY[k] = _mm_set1_epi32(B[k] * SWR_SUBPIXEL);
+				half[k] = _mm_set1_epi32(4 * ax);
+			}
+			__m128 rowZ = _mm_add_ps(_mm_set1_ps(zBlock), _mm_set_ps(3.0f * t.dzdx, 2.0f * t.dzdx, t.dzdx, 0.0f));
+			__m128 halfZ = _mm_set1_ps(4.0f * t.dzdx);
+			__m128 stepZ = _mm_set1_ps(t.dzdy);
+			for(int row = 0; row < SWR_BLOCK_SIZE; row++) {
+				for(int h = 0; h < 2; h++) {
+					__m128i e0 = h ? _mm_add_epi32(rowE[0], half[0]) : rowE[0];
+					__m128i e1 = h ? _mm_add_epi32(rowE[1], half[1]) : rowE[1];
+					__m128i e2 = h ? _mm_add_epi32(rowE[2], half[2]) : rowE[2];
+					__m128 outsideMask = _mm_castsi128_ps(_mm_srai_epi32(_mm_or_si128(_mm_or_si128(e0, e1), e2), 31));
+					if(_mm_movemask_ps(outsideMask) == 15) continue;
+
+					float *depth = depthBlock + row * SWR_TILE_SIZE + h * 4;
+					__m128 z = h ? _mm_add_ps(rowZ, halfZ) : rowZ;
+					__m128 d = _mm_load_ps(depth);
+					__m128 pass = _mm_andnot_ps(outsideMask, _mm_cmplt_ps(z, d));
+					int passBits = _mm_movemask_ps(pass);
+					if(!passBits) continue;
+					_mm_store_ps(depth, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, d)));
+					const SoftwareTriangle **triangles = triangleBlock + row * SWR_TILE_SIZE + h * 4;
+					for(int i = 0; i < 4; i++) {
+						if(passBits & (1 << i)) triangles[i] = &t;
+					}
+					written = true;
+				}
+				for(int k = 0; k < 3; k++) rowE[k] = _mm_add_epi32(rowE[k], stepY[k]);
+				rowZ = _mm_add_ps(rowZ, stepZ);
+			}
+#else
+			for(int row = 0; row < SWR_BLOCK_SIZE; row++) {
+				for(int x = 0; x < SWR_BLOCK_SIZE; x++) {
+					bool inside = true;
+					for(int k = 0; k < 3; k++) {
+						if(eb[k] + A[k] * x * SWR_SUBPIXEL + B[k] * row * SWR_SUBPIXEL < 0) inside = false;
+					}
+					float z = zBlock + t.dzdx * x + t.dzdy * row;
+					float &depth = depthBlock[row * SWR_TILE_SIZE + x];
+					if(inside && z < depth) {
+						depth = z;
+						triangleBlock[row * SWR_TILE_SIZE + x] = &t;
+						written = true;
+					}
+				}
+			}
+#endif
+			if(written) blockMaxZ = getBlockMaxDepth(depthBlock);
+		}
+	}
+}
+
+// GGX from shaders/Common/Lit.fs (getGGXColor without the BRDF lookup)
+static glm::vec3 getGGXColor(glm::vec3 N, glm::vec3 V, glm::vec3 L, glm::vec3 lightColor, glm::vec3 albedo, const SoftwareMaterial &material) {
+	float metallic = material.metallic;
+	float roughness = material.roughness;
+	glm::vec3 F0 = glm::mix(glm::vec3(0.04f), albedo, metallic);
+	glm::vec3 H = glm::normalize(L + V);
+
+	// Fresnel
+	float cosAngle = max(0.0f, glm::dot(L, H));
+	float m = 1.0f - cosAngle;
+	float m2 = m * m;
+	glm::vec3 F = F0 + (1.0f - F0) * (m2 * m2 * m);
+	glm::vec3 kD = (glm::vec3(1.0f) - F) * (1.0f - metallic) * albedo / SWR_PI;
+
+	// Normal distribution
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float NdotH = max(0.0f, glm::dot(N, H));
+	float denom = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+	float NDF = a2 / (SWR_PI * denom * denom);
+
+	// Geometry (Schlick-GGX for the light and the view direction)
+	float k = (roughness + 1.0f) * (roughness + 1.0f) / 8.0f;
+	float NdotL = glm::dot(N, L);
+	float NdotV = glm::dot(N, V);
+	float G = (NdotL / (NdotL * (1.0f - k) + k)) * (NdotV / (NdotV * (1.0f - k) + k));
+
+	glm::vec3 specular = F * NDF * G / (4.0f * max(0.0f, NdotL) * max(0.0f, NdotV) + 0.0001f);
+	return (kD + specular) * lightColor * max(0.0f, NdotL);
+}
+
+// Clamp to [0, 1] (NaN becomes 0, as normalize(0) can produce) and quantize
+static unsigned char toUnorm8(float v) {
+	v = (v > 0.0f) ? ((v < 1.0f) ? v : 1.0f) : 0.0f;
+	return (unsigned char)(v * 255.0f + 0.5f);
+}
+
+// What Lit.fs receives at one pixel center
+struct SoftwareFragment {
+	glm::vec3 viewPos;
+	glm::vec3 normal;
+	glm::vec3 albedo;
+};
+
+// Perspective-correct barycentrics from the edge functions (px, py in subpixels)
+static SoftwareFragment interpolateFragment(const SoftwareTriangle &t, long long px, long long py) {
+	float b[3];
+	for(int k = 0; k < 3; k++) b[k] = (float)(t.edgeA[k] * px + t.edgeB[k] * py + t.edgeC[k]) * t.invArea;
+	float w = 1.0f / (b[0] * t.invW[0] + b[1] * t.invW[1] + b[2] * t.invW[2]);
+	SoftwareFragment f;
+	f.viewPos = (b[0] * t.v[0].viewPos + b[1] * t.v[1].viewPos + b[2] * t.v[2].viewPos) * w;
+	f.normal = (b[0] * t.v[0].normal + b[1] * t.v[1].normal + b[2] * t.v[2].normal) * w;
+	f.albedo = (b[0] * t.v[0].color + b[1] * t.v[1].color + b[2] * t.v[2].color) * w;
+	return f;
+}
+
+static glm::vec3 shadeFragment(SoftwareRenderer &sr, const SoftwareFragment &f, const SoftwareMaterial &material) {
+	glm::vec3 N = glm::normalize(f.normal);
+	glm::vec3 V = glm::normalize(-f.viewPos);
+	glm::vec3 L = glm::normalize(sr.light.pos - f.viewPos);
+	return getGGXColor(N, V, L, sr.light.color, f.albedo, material);
+}
+
+#ifdef __SSE2__
+// 3-component vectors, one pixel per lane
+struct SoftwareVec4x3 {
+	__m128 x, y, z;
+};
+
+static __m128 dot4x3(const SoftwareVec4x3 &a, const SoftwareVec4x3 &b) {
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static SoftwareVec4x3 normalize4x3(const SoftwareVec4x3 &a) {
+	__m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(dot4x3(a, a)));
+	return { _mm_mul_ps(a.x, inv), _mm_mul_ps(a.y, inv), _mm_mul_ps(a.z, inv) };
+}
+
+// getGGXColor for four pixels; metallic/roughness per lane
+static SoftwareVec4x3 getGGXColor4(const SoftwareVec4x3 &N, const SoftwareVec4x3 &V, const SoftwareVec4x3 &L, const SoftwareVec4x3 &lightColor,
+								   const SoftwareVec4x3 &albedo, __m128 metallic, __m128 roughness) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 invPI = _mm_set1_ps(1.0f / SWR_PI);
+	SoftwareVec4x3 H = normalize4x3({ _mm_add_ps(L.x, V.x), _mm_add_ps(L.y, V.y), _mm_add_ps(L.z, V.z) });
+
+	// Fresnel (F0 = mix(0.04, albedo, metallic)) and the diffuse share
+	__m128 m = _mm_sub_ps(one, _mm_max_ps(dot4x3(L, H), zero));
+	__m128 m2 = _mm_mul_ps(m, m);
+	__m128 m5 = _mm_mul_ps(_mm_mul_ps(m2, m2), m);
+	__m128 diffuse = _mm_mul_ps(_mm_sub_ps(one, metallic), invPI);
+
+	// Normal distribution
+	__m128 a = _mm_mul_ps(roughness, roughness);
+	__m128 a2 = _mm_mul_ps(a, a);
+	__m128 NdotH = _mm_max_ps(dot4x3(N, H), zero);
+	__m128 denom = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(NdotH, NdotH), _mm_sub_ps(a2, one)), one);
+	__m128 NDF = _mm_div_ps(_mm_mul_ps(a2, invPI), _mm_mul_ps(denom, denom));
+
+	// Geometry
+	__m128 r1 = _mm_add_ps(roughness, one);
+	__m128 k = _mm_mul_ps(_mm_mul_ps(r1, r1), _mm_set1_ps(0.125f));
+	__m128 oneMinusK = _mm_sub_ps(one, k);
+	__m128 NdotL = dot4x3(N, L);
+	__m128 NdotV = dot4x3(N, V);
+	__m128 G = _mm_mul_ps(_mm_div_ps(NdotL, _mm_add_ps(_mm_mul_ps(NdotL, oneMinusK), k)),
+						  _mm_div_ps(NdotV, _mm_add_ps(_mm_mul_ps(NdotV, oneMinusK), k)));
+	NdotL = _mm_max_ps(NdotL, zero);
+	__m128 specScale = _mm_div_ps(_mm_mul_ps(NDF, G),
+								  _mm_add_ps(_mm_mul_ps(_mm_set1_ps(4.0f), _mm_mul_ps(NdotL, _mm_max_ps(NdotV, zero))), _mm_set1_ps(0.0001f)));
+
+	__m128 albedoC[3] = { albedo.x, albedo.y, albedo.z };
+	__m128 lightC[3] = { lightColor.x, lightColor.y, lightColor.z };
+	__m128 result[3];
+	for(int c = 0; c < 3; c++) {
+		__m128 F0 = _mm_add_ps(_mm_set1_ps(0.04f), _mm_mul_ps(_mm_sub_ps(albedoC[c], _mm_set1_ps(0.04f)), metallic));
+		__m128 F = _mm_add_ps(F0, _mm_mul_ps(_mm_sub_ps(one, F0), m5));
+		__m128 kD = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(one, F), diffuse), albedoC[c]);
+		__m128 specular = _mm_mul_ps(F, specScale);
+		result[c] = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(kD, specular), lightC[c]), NdotL);
+	}
+	return { result[0], result[1], result[2] };
+}
+
+// Clamp (NaN becomes 0), quantize and interleave four RGBA8 pixels
+static void storeColor4(const SoftwareVec4x3 &color, unsigned char *out) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(255.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	__m128i r = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(color.x, zero), one), scale), half));
+	__m128i g = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(color.y, zero), one), scale), half));
+	__m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(color.z, zero), one), scale), half));
+	__m128i rgba = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_set1_epi32((int)0xFF000000)));
+	_mm_storeu_si128((__m128i *)out, rgba);
+}
+#endif
+
+// Shade the nearest triangle of every pixel of the tile once
+static void shadeTile(SoftwareRenderer &sr, SoftwareTileScratch &s, int tileX, int tileY, SoftwareFrameStats &stats) {
+	int tileW = min(SWR_TILE_SIZE, sr.width - tileX);
+	int tileH = min(SWR_TILE_SIZE, sr.height - tileY);
+	for(int y = 0; y < tileH; y++) {
+		unsigned char *out = &sr.color[((size_t)(tileY + y) * sr.width + tileX) * 4];
+		long long py = (long long)(tileY + y) * SWR_SUBPIXEL + SWR_SUBPIXEL / 2;
+		const SoftwareTriangle **triangles = &s.triangle[y * SWR_TILE_SIZE];
+		int x = 0;
+#ifdef __SSE2__
+		// Four pixels at a time: interpolate per pixel, light in SIMD, then pick the clear color where empty
+		SoftwareVec4x3 lightColor = { _mm_set1_ps(sr.light.color.x), _mm_set1_ps(sr.light.color.y), _mm_set1_ps(sr.light.color.z) };
+		SoftwareVec4x3 lightPos = { _mm_set1_ps(sr.light.pos.x), _mm_set1_ps(sr.light.pos.y), _mm_set1_ps(sr.light.pos.z) };
+		SoftwareVec4x3 clearColor = { _mm_set1_ps(sr.clearColor.x), _mm_set1_ps(sr.clearColor.y), _mm_set1_ps(sr.clearColor.z) };
+		for(; x + 4 <= tileW; x += 4, out += 16) {
+			alignas(16) float lanes[11][4];		// viewPos, normal, albedo, metallic, roughness
+			alignas(16) int covered[4];
+			int coveredCnt = 0;
+			for(int i = 0; i < 4; i++) {
+				const SoftwareTriangle *t = triangles[x + i];
+				covered[i] = t ? -1 : 0;
+				SoftwareFragment f = { glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f) };
+				SoftwareMaterial material;
+				if(t) {
+					f = interpolateFragment(*t, (long long)(tileX + x + i) * SWR_SUBPIXEL + SWR_SUBPIXEL / 2, py);
+					material = t->material;
+					coveredCnt++;
+				}
+				for(int c = 0; c < 3; c++) {
+					lanes[c][i] = f.viewPos[c];
+					lanes[3 + c][i] = f.normal[c];
+					lanes[6 + c][i] = f.albedo[c];
+				}
+				lanes[9][i] = material.metallic;
+				lanes[10][i] = material.roughness;
+			}
+			if(coveredCnt == 0) {
+				storeColor4(clearColor, out);
+				continue;
+			}
+
+			SoftwareVec4x3 viewPos = { _mm_load_ps(lanes[0]), _mm_load_ps(lanes[1]), _mm_load_ps(lanes[2]) };
+			SoftwareVec4x3 normal = { _mm_load_ps(lanes[3]), _mm_load_ps(lanes[4]), _mm_load_ps(lanes[5]) };
+			SoftwareVec4x3 albedo = { _mm_load_ps(lanes[6]), _mm_load_ps(lanes[7]), _mm_load_ps(lanes[8]) };
+			SoftwareVec4x3 N = normalize4x3(normal);
+			SoftwareVec4x3 V = normalize4x3({ _mm_sub_ps(_mm_setzero_ps(), viewPos.x), _mm_sub_ps(_mm_setzero_ps(), viewPos.y), _mm_sub_ps(_mm_setzero_ps(), viewPos.z) });
+			SoftwareVec4x3 L = normalize4x3({ _mm_sub_ps(lightPos.x, viewPos.x), _mm_sub_ps(lightPos.y, viewPos.y), _mm_sub_ps(lightPos.z, viewPos.z) });
+			SoftwareVec4x3 color = getGGXColor4(N, V, L, lightColor, albedo, _mm_load_ps(lanes[9]), _mm_load_ps(lanes[10]));
+
+			__m128 mask = _mm_castsi128_ps(_mm_load_si128((const __m128i *)covered));
+			color.x = _mm_or_ps(_mm_and_ps(mask, color.x), _mm_andnot_ps(mask, clearColor.x));
+			color.y = _mm_or_ps(_mm_and_ps(mask, color.y), _mm_andnot_ps(mask, clearColor.y));
+			color.z = _mm_or_ps(_mm_and_ps(mask, color.z), _mm_andnot_ps(mask, clearColor.z));
+			storeColor4(color, out);
+			stats.shadedPixels += coveredCnt;
+		}
+#endif
+		for(; x < tileW; x++, out += 4) {
+			const SoftwareTriangle *t = triangles[x];
+			glm::vec3 color = sr.clearColor;
+			if(t) {
+				SoftwareFragment f = interpolateFragment(*t, (long long)(tileX + x) * SWR_SUBPIXEL + SWR_SUBPIXEL / 2, py);
+				color = shadeFragment(sr, f, t->material);
+				stats.shadedPixels++;
+			}
+			out[0] = toUnorm8(color.r);
+			out[1] = toUnorm8(color.g);
+			out[2] = toUnorm8(color.b);
+			out[3] = 255;
+		}
+	}
+}
+
+static void renderTile(SoftwareRenderer &sr, int tile, SoftwareTileScratch &s, SoftwareFrameStats &stats) {
+	int tileX = (tile % sr.tilesX) * SWR_TILE_SIZE;
+	int tileY = (tile / sr.tilesX) * SWR_TILE_SIZE;
+	fill(begin(s.depth), end(s.depth), 1.0f);
+	fill(begin(s.blockMaxZ), end(s.blockMaxZ), 1.0f);
+	fill(begin(s.triangle), end(s.triangle), nullptr);
+
+	// Batches in submission order, so equal depths keep the first triangle like GL_LESS
+	for(int b = 0; b < sr.batchCnt; b++) {
+		const SoftwareBatch &batch = sr.batches[b];
+		for(int index : batch.tileTriangles[tile]) rasterTriangle(batch.triangles[index], s, tileX, tileY, stats);
+	}
+	shadeTile(sr, s, tileX, tileY, stats);
+}
+
+// Rasterize and shade all tiles; threads take the next unclaimed tile, so busy tiles do not stall the rest
+void endSoftwareFrame(SoftwareRenderer &sr) {
+	auto start = chrono::steady_clock::now();
+	int tileCnt = sr.tilesX * sr.tilesY;
+	int slotCnt = (int)sr.pool->workers.size() + 1;
+	vector<SoftwareTileScratch> scratch(slotCnt);
+	vector<SoftwareFrameStats> slotStats(slotCnt);
+	atomic<int> nextTile{ 0 };
+	parallelFor(*sr.pool, slotCnt, [&](int begin, int end) {
+		for(int slot = begin; slot < end; slot++) {
+			while(true) {
+				int tile = nextTile.fetch_add(1);
+				if(tile >= tileCnt) break;
+				renderTile(sr, tile, scratch[slot], slotStats[slot]);
+			}
+		}
+	});
+	for(SoftwareFrameStats &s : slotStats) {
+		sr.stats.testedBlocks += s.testedBlocks;
+		sr.stats.depthRejectedBlocks += s.depthRejectedBlocks;
+		sr.stats.shadedPixels += s.shadedPixels;
+	}
+	sr.stats.rasterMS += getElapsedMS(start);
+}
+
+bool writeSoftwareImage(SoftwareRenderer &sr, string filename) {
+	filesystem::path parent = filesystem::path(filename).parent_path();
+	error_code ec;
+	if(!parent.empty()) filesystem::create_directories(parent, ec);
+	if(!stbi_write_png(filename.c_str(), sr.width, sr.height, 4, sr.color.data(), sr.width * 4)) {
+		cerr << "ERROR: Could not write " << filename << endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,5 @@
+// Single home of the stb_image / stb_image_write implementations (every app links src/lib)
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image.h"
+#include "stb_image_write.h"
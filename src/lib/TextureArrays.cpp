@@ -0,0 +1,172 @@
+#include "TextureArrays.hpp"
+#include "GLState.hpp"
+#include <chrono>
+#include <algorithm>
+
+void setupTextureArrays(TextureArrays &ta, TextureCache &cache) {
+	ta.cache = &cache;
+	glGenBuffers(1, &(ta.materialSSBO));
+}
+
+// New material for texture (nullptr: untextured); takes over the caller's reference.
+// Materials sharing a texture share an entry. Returns the value for the materialIndex uniform.
+int addTextureMaterial(TextureArrays &ta, Texture *texture) {
+	string key = texture ? texture->key : "";
+	for(size_t i = 0; i < ta.keys.size(); i++) {
+		if(ta.keys[i] == key) {
+			if(texture) releaseTexture(*(ta.cache), texture);
+			return (int)i;
+		}
+	}
+	ta.keys.push_back(key);
+	ta.pending.push_back(texture);
+	ta.materials.push_back(MaterialLayer());
+	ta.tableDirty = true;
+	return (int)ta.materials.size() - 1;
+}
+
+// Array that layers of texture go into (created if there is none yet), or -1 if all slots are taken
+static int findTextureArray(TextureArrays &ta, Texture *texture) {
+	for(size_t i = 0; i < ta.arrays.size(); i++) {
+		TextureArrayGL &arr = ta.arrays[i];
+		if(arr.width == texture->width && arr.height == texture->height &&
+		   arr.mipCnt == texture->mipCnt && arr.internalFormat == texture->internalFormat) {
+			return (int)i;
+		}
+	}
+	if((int)ta.arrays.size() >= MAX_TEXTURE_ARRAYS) return -1;
+
+	TextureArrayGL arr;
+	arr.width = texture->width;
+	arr.height = texture->height;
+	arr.mipCnt = texture->mipCnt;
+	arr.internalFormat = texture->internalFormat;
+	arr.layerBytes = texture->gpuBytes;
+	ta.arrays.push_back(arr);
+	return (int)ta.arrays.size() - 1;
+}
+
+// Copy layers [0, layerCnt) of every mip level from one texture to another (GPU-side, any format)
+static void copyLayers(GLuint src, GLenum srcTarget, int srcLayer, GLuint dst, int dstLayer, TextureArrayGL &arr, int layerCnt) {
+	for(int level = 0; level < arr.mipCnt; level++) {
+		int w = max(1, arr.width >> level);
+		int h = max(1, arr.height >> level);
+		glCopyImageSubData(src, srcTarget, level, 0, 0, srcLayer,
+						   dst, GL_TEXTURE_2D_ARRAY, level, 0, 0, dstLayer, w, h, layerCnt);
+	}
+}
+
+// Reallocate a full array with twice the layers (texture storage is immutable)
+static void growTextureArray(TextureArrayGL &arr) {
+	int capacity = max(4, arr.layerCapacity * 2);
+	GLuint texID = 0;
+	glGenTextures(1, &texID);
+	bindTexture(0, GL_TEXTURE_2D_ARRAY, texID);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, arr.mipCnt, arr.internalFormat, arr.width, arr.height, capacity);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, arr.mipCnt - 1);
+	bindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+
+	if(arr.texID) {
+		if(arr.layerCnt > 0) copyLayers(arr.texID, GL_TEXTURE_2D_ARRAY, 0, texID, 0, arr, arr.layerCnt);
+		glDeleteTextures(1, &(arr.texID));
+	}
+	arr.texID = texID;
+	arr.layerCapacity = capacity;
+}
+
+// Replace the material table (only when a material was added or placed)
+static void uploadMaterialTable(TextureArrays &ta) {
+	size_t bytes = max(ta.materials.size() * sizeof(MaterialLayer), (size_t)16);
+	bindBuffer(GL_SHADER_STORAGE_BUFFER, ta.materialSSBO);
+	if(bytes > ta.materialBytes) {
+		ta.materialBytes = max(bytes, ta.materialBytes * 2);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, ta.materialBytes, NULL, GL_DYNAMIC_DRAW);
+	}
+	if(!ta.materials.empty()) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, ta.materials.size() * sizeof(MaterialLayer), ta.materials.data());
+	bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	ta.tableDirty = false;
+}
+
+// Move every newly uploaded texture into an array layer and drop the cache's 2D copy
+// (unless someone else still holds it). Call after updateTextureCache(); returns how many were placed.
+int updateTextureArrays(TextureArrays &ta) {
+	auto start = chrono::steady_clock::now();
+	int placedCnt = 0;
+	for(size_t i = 0; i < ta.pending.size(); i++) {
+		Texture *texture = ta.pending[i];
+		if(!texture || !(texture->ready || texture->failed)) continue;
+
+		if(texture->ready) {
+			int arrayIndex = findTextureArray(ta, texture);
+			if(arrayIndex < 0) {
+				cerr << "WARNING: No texture array left for " << texture->key << " (" << texture->width << "x" << texture->height;
+				cerr << ", " << texture->mipCnt << " levels); drawn untextured" << endl;
+				ta.overflowCnt++;
+			}
+			else {
+				TextureArrayGL &arr = ta.arrays[arrayIndex];
+				if(arr.layerCnt == arr.layerCapacity) growTextureArray(arr);
+				copyLayers(texture->texID, GL_TEXTURE_2D, 0, arr.texID, arr.layerCnt, arr, 1);
+				ta.materials[i].arrayIndex = arrayIndex;
+				ta.materials[i].layer = arr.layerCnt++;
+				ta.copiedBytes += texture->gpuBytes;
+				ta.placedCnt++;
+				placedCnt++;
+			}
+		}
+		releaseTexture(*(ta.cache), texture);
+		ta.pending[i] = nullptr;
+		ta.tableDirty = true;
+	}
+	if(ta.tableDirty) uploadMaterialTable(ta);
+	if(placedCnt > 0) ta.copyMS += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	return placedCnt;
+}
+
+// True once every material has its layer (or has given up on it)
+bool isTextureArraysIdle(TextureArrays &ta) {
+	for(Texture *texture : ta.pending) {
+		if(texture) return false;
+	}
+	return true;
+}
+
+// Bind the material table and every array (once per pass, not per draw)
+void bindTextureArrays(TextureArrays &ta) {
+	if(ta.tableDirty) uploadMaterialTable(ta);
+	bindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_TABLE_BINDING, ta.materialSSBO);
+	for(size_t i = 0; i < ta.arrays.size(); i++) {
+		bindTexture(ALBEDO_ARRAY_UNIT + (GLuint)i, GL_TEXTURE_2D_ARRAY, ta.arrays[i].texID);
+	}
+}
+
+// Give back references to textures never placed and free the arrays (before cleanupTextureCache)
+void cleanupTextureArrays(TextureArrays &ta) {
+	for(Texture *texture : ta.pending) {
+		if(texture) releaseTexture(*(ta.cache), texture);
+	}
+	ta.keys.clear();
+	ta.pending.clear();
+	ta.materials.clear();
+	for(TextureArrayGL &arr : ta.arrays) {
+		if(arr.texID) glDeleteTextures(1, &(arr.texID));
+	}
+	ta.arrays.clear();
+	deleteBuffer(ta.materialSSBO);
+	ta.materialBytes = 0;
+}
+
+// Print the arrays and what went into them
+void printTextureArrayStats(TextureArrays &ta) {
+	cout << "Texture arrays: " << ta.materials.size() << " materials, " << ta.placedCnt << " layers in " << ta.arrays.size() << " arrays";
+	if(ta.overflowCnt > 0) cout << ", " << ta.overflowCnt << " did not fit";
+	cout << "; copied " << ta.copiedBytes / (1024 * 1024) << " MB in " << ta.copyMS << " ms" << endl;
+	for(TextureArrayGL &arr : ta.arrays) {
+		cout << "  " << arr.width << "x" << arr.height << ", " << arr.mipCnt << " levels, format 0x" << hex << arr.internalFormat << dec;
+		cout << ": " << arr.layerCnt << "/" << arr.layerCapacity << " layers" << endl;
+	}
+}
@@ -0,0 +1,436 @@
+#include "TextureCache.hpp"
+#include "GLState.hpp"
+#include "CompressedTexture.hpp"
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include "stb_image.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Average one row pair of RGBA8 pixels into dstWidth pixels (source width >= 2 * dstWidth)
+static void downsampleRow(const unsigned char *row0, const unsigned char *row1, unsigned char *dst, int dstWidth) {
+	int x = 0;
+#ifdef __SSE2__
+	// 4 destination pixels per step: widen 8 source pixels of each row to 16 bits,
+	// add the rows, add horizontal neighbours, round and narrow again
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+	for(; x + 4 <= dstWidth; x += 4) {
+		__m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+		__m128i a1 = _mm_loadu_si128((const __m128i*)(row0 + x * 8 + 16));
+		__m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+		__m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + x * 8 + 16));
+
+		__m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+		__m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+		__m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+		__m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+		__m128i h01 = _mm_add_epi16(s01, _mm_srli_si128(s01, 8));
+		__m128i h23 = _mm_add_epi16(s23, _mm_srli_si128(s23, 8));
+		__m128i h45 = _mm_add_epi16(s45, _mm_srli_si128(s45, 8));
+		__m128i h67 = _mm_add_epi16(s67, _mm_srli_si128(s67, 8));
+
+		__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(h01, h23), two), 2);
+		__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(h45, h67), two), 2);
+		_mm_storeu_si128((__m128i*)(dst + x * 4), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for(; x < dstWidth; x++) {
+		for(int c = 0; c < 4; c++) {
+			int sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c];
+			dst[x * 4 + c] = (unsigned char)((sum + 2) >> 2);
+		}
+	}
+}
+
+// Halve one level with a 2x2 box filter (odd last rows/columns are dropped;
+// a 1-pixel dimension is averaged with itself)
+static void downsampleLevel(const unsigned char *src, int srcWidth, int srcHeight, unsigned char *dst, int dstWidth, int dstHeight) {
+	if(srcWidth == 1) {
+		for(int y = 0; y < dstHeight; y++) {
+			const unsigned char *row0 = src + (size_t)(2 * y) * 4;
+			const unsigned char *row1 = src + (size_t)min(2 * y + 1, srcHeight - 1) * 4;
+			for(int c = 0; c < 4; c++) dst[y * 4 + c] = (unsigned char)((row0[c] + row1[c] + 1) >> 1);
+		}
+		return;
+	}
+	for(int y = 0; y < dstHeight; y++) {
+		const unsigned char *row0 = src + (size_t)(2 * y) * srcWidth * 4;
+		const unsigned char *row1 = src + (size_t)min(2 * y + 1, srcHeight - 1) * srcWidth * 4;
+		downsampleRow(row0, row1, dst + (size_t)y * dstWidth * 4, dstWidth);
+	}
+}
+
+// Append every mip level below level 0 (already in image.pixels) to image.pixels
+void generateMipChain(DecodedTexture &image, int width, int height) {
+	image.mipOffsets = { 0 };
+	image.mipWidths = { width };
+	image.mipHeights = { height };
+
+	// Size the whole chain first so the vector is not reallocated underneath the filter
+	size_t total = (size_t)width * height * 4;
+	for(int w = width, h = height; w > 1 || h > 1;) {
+		w = max(1, w / 2);
+		h = max(1, h / 2);
+		total += (size_t)w * h * 4;
+	}
+	image.pixels.resize(total);
+
+	size_t offset = (size_t)width * height * 4;
+	int w = width;
+	int h = height;
+	while(w > 1 || h > 1) {
+		int nw = max(1, w / 2);
+		int nh = max(1, h / 2);
+		downsampleLevel(image.pixels.data() + image.mipOffsets.back(), w, h, image.pixels.data() + offset, nw, nh);
+		image.mipOffsets.push_back(offset);
+		image.mipWidths.push_back(nw);
+		image.mipHeights.push_back(nh);
+		offset += (size_t)nw * nh * 4;
+		w = nw;
+		h = nh;
+	}
+}
+
+// Block-compressed container: the chain is used as stored (no decode, no mip generation)
+static bool readCompressedTexture(vector<unsigned char> &bytes, DecodedTexture &image) {
+	CompressedImage compressed;
+	string error;
+	if(!parseCompressedTexture(bytes, compressed, error)) {
+		cerr << "WARNING: Could not load texture " << image.key << ": " << error << endl;
+		return false;
+	}
+	image.compressedFormat = getCompressedGLFormat(compressed);
+	image.blockFormat = compressed.format;
+	image.pixels = move(compressed.data);
+	image.mipOffsets = move(compressed.mipOffsets);
+	image.mipWidths = move(compressed.mipWidths);
+	image.mipHeights = move(compressed.mipHeights);
+	return true;
+}
+
+static bool readFileBytes(string path, vector<unsigned char> &bytes) {
+	ifstream file(path, ios::binary | ios::ate);
+	if(!file) return false;
+	bytes.resize((size_t)file.tellg());
+	file.seekg(0);
+	file.read((char*)bytes.data(), bytes.size());
+	return (bool)file;
+}
+
+// Worker: decode one image (from a file, encoded bytes, or raw BGRA texels) and build its mips
+static void decodeTexture(TextureCache *cache, string key, string path, vector<unsigned char> encoded, int rawWidth, int rawHeight) {
+	auto start = chrono::steady_clock::now();
+	DecodedTexture image;
+	image.key = key;
+
+	int width = 0, height = 0, channels = 0;
+	if(encoded.empty() && rawWidth == 0 && !readFileBytes(path, encoded)) {
+		cerr << "WARNING: Could not read texture " << key << endl;
+		image.failed = true;
+	}
+	else if(isKTX2File(encoded) || isDDSFile(encoded)) {
+		image.failed = !readCompressedTexture(encoded, image);
+	}
+	else if(rawWidth > 0) {
+		width = rawWidth;
+		height = rawHeight;
+		image.pixels.resize((size_t)width * height * 4);
+		for(size_t i = 0; i < image.pixels.size(); i += 4) {
+			image.pixels[i] = encoded[i + 2];
+			image.pixels[i + 1] = encoded[i + 1];
+			image.pixels[i + 2] = encoded[i];
+			image.pixels[i + 3] = encoded[i + 3];
+		}
+		generateMipChain(image, width, height);
+	}
+	else {
+		stbi_uc *data = stbi_load_from_memory(encoded.data(), (int)encoded.size(), &width, &height, &channels, 4);
+		if(data) {
+			image.pixels.assign(data, data + (size_t)width * height * 4);
+			stbi_image_free(data);
+		}
+		else {
+			cerr << "WARNING: Could not load texture " << key << ": " << stbi_failure_reason() << endl;
+			image.failed = true;
+		}
+		if(!image.failed) generateMipChain(image, width, height);
+	}
+
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	{
+		lock_guard<mutex> guard(cache->decodedLock);
+		cache->decoded.push_back(move(image));
+		cache->decodingCnt--;
+		cache->decodeMS += ms;
+	}
+	cache->decodedWake.notify_all();
+	if(cache->onDecoded) cache->onDecoded();
+}
+
+// Create the fallback texture and upload buffer (needs a current context)
+void setupTextureCache(TextureCache &cache, ThreadPool &pool, size_t uploadBudget) {
+	cache.pool = &pool;
+	cache.uploadBudget = uploadBudget;
+
+	const unsigned char white[4] = { 255, 255, 255, 255 };
+	glGenTextures(1, &(cache.fallbackTex));
+	glBindTexture(GL_TEXTURE_2D, cache.fallbackTex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenBuffers(1, &(cache.uploadPBO));
+
+	// Substituting containers is only safe if every format they may hold can be uploaded
+	if(!isBlockFormatSupported(BLOCK_BC1) || !isBlockFormatSupported(BLOCK_BC7)) cache.preferCompressed = false;
+}
+
+// Look up or start loading an entry; the caller fills in how to decode it
+static Texture* acquireEntry(TextureCache &cache, string key, bool &isNew) {
+	cache.requestCnt++;
+	auto found = cache.textures.find(key);
+	isNew = (found == cache.textures.end());
+	Texture &texture = cache.textures[key];
+	texture.key = key;
+	texture.refCnt++;
+	if(isNew) {
+		cache.loadCnt++;
+		lock_guard<mutex> guard(cache.decodedLock);
+		cache.decodingCnt++;
+	}
+	return &texture;
+}
+
+// Precompressed version of an image next to it (foo.png -> foo.ktx2 or foo.dds), or "" if there is none
+static string findCompressedSibling(string path) {
+	filesystem::path file(path);
+	string ext = file.extension().string();
+	transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	if(ext == ".ktx2" || ext == ".dds") return "";
+
+	for(const char *candidate : { ".ktx2", ".dds" }) {
+		filesystem::path sibling = file;
+		sibling.replace_extension(candidate);
+		error_code ec;
+		if(filesystem::exists(sibling, ec)) return sibling.string();
+	}
+	return "";
+}
+
+// Reference to the texture at path (decoded in the background the first time it is requested)
+Texture* acquireTexture(TextureCache &cache, string path) {
+	replace(path.begin(), path.end(), '\\', '/');
+	if(cache.preferCompressed) {
+		string compressedPath = findCompressedSibling(path);
+		if(!compressedPath.empty()) path = compressedPath;
+	}
+	string key = filesystem::path(path).lexically_normal().generic_string();
+
+	bool isNew = false;
+	Texture *texture = acquireEntry(cache, key, isNew);
+	if(isNew) {
+		TextureCache *cachePtr = &cache;
+		submitJob(*cache.pool, [cachePtr, key]() {
+			decodeTexture(cachePtr, key, key, vector<unsigned char>(), 0, 0);
+		});
+	}
+	return texture;
+}
+
+// Base color texture of a material (nullptr if it has none).
+// File paths are relative to the model; "*N" (or a matching name) refers to an embedded image,
+// whose bytes are copied here so the decode does not depend on the scene staying alive.
+Texture* acquireMaterialTexture(TextureCache &cache, const aiScene *scene, unsigned int materialIndex, string modelPath) {
+	if(materialIndex >= scene->mNumMaterials) return nullptr;
+	aiMaterial *material = scene->mMaterials[materialIndex];
+
+	aiString texPath;
+	if(material->GetTextureCount(aiTextureType_BASE_COLOR) > 0) {
+		if(material->GetTexture(aiTextureType_BASE_COLOR, 0, &texPath) != aiReturn_SUCCESS) return nullptr;
+	}
+	else if(material->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
+		if(material->GetTexture(aiTextureType_DIFFUSE, 0, &texPath) != aiReturn_SUCCESS) return nullptr;
+	}
+	else {
+		return nullptr;
+	}
+
+	const aiTexture *embedded = scene->GetEmbeddedTexture(texPath.C_Str());
+	if(!embedded) {
+		filesystem::path modelDir = filesystem::path(modelPath).parent_path();
+		return acquireTexture(cache, (modelDir / texPath.C_Str()).string());
+	}
+
+	bool isNew = false;
+	Texture *texture = acquireEntry(cache, modelPath + texPath.C_Str(), isNew);
+	if(isNew) {
+		// mHeight == 0: mWidth bytes of a compressed file (PNG, JPEG...); otherwise mWidth x mHeight BGRA texels
+		vector<unsigned char> bytes;
+		int rawWidth = 0, rawHeight = 0;
+		const unsigned char *data = (const unsigned char*)embedded->pcData;
+		if(embedded->mHeight == 0) {
+			bytes.assign(data, data + embedded->mWidth);
+		}
+		else {
+			rawWidth = (int)embedded->mWidth;
+			rawHeight = (int)embedded->mHeight;
+			bytes.assign(data, data + (size_t)rawWidth * rawHeight * 4);
+		}
+		TextureCache *cachePtr = &cache;
+		string key = texture->key;
+		submitJob(*cache.pool, [cachePtr, key, bytes, rawWidth, rawHeight]() {
+			decodeTexture(cachePtr, key, "", bytes, rawWidth, rawHeight);
+		});
+	}
+	return texture;
+}
+
+// Drop one reference; the last one frees the GL texture.
+// An image still being decoded is discarded when it arrives (its entry is gone by then).
+void releaseTexture(TextureCache &cache, Texture *texture) {
+	if(!texture || --texture->refCnt > 0) return;
+	if(texture->texID) glDeleteTextures(1, &(texture->texID));
+	cache.textures.erase(texture->key);
+}
+
+// Upload one decoded image: storage for the whole chain, then each level from the unpack buffer
+static void uploadTexture(TextureCache &cache, Texture &texture, DecodedTexture &image) {
+	// Orphan the previous contents so the copy does not wait for the last upload to be consumed
+	bindBuffer(GL_PIXEL_UNPACK_BUFFER, cache.uploadPBO);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, image.pixels.size(), NULL, GL_STREAM_DRAW);
+	void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, image.pixels.size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if(!mapped) {
+		bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		cerr << "WARNING: Could not map texture upload buffer for " << texture.key << endl;
+		texture.failed = true;
+		cache.failedCnt++;
+		return;
+	}
+	memcpy(mapped, image.pixels.data(), image.pixels.size());
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	int mipCnt = (int)image.mipOffsets.size();
+	glGenTextures(1, &(texture.texID));
+	glBindTexture(GL_TEXTURE_2D, texture.texID);
+	if(image.compressedFormat) {
+		// Blocks go to the GPU as stored; the chain may stop before 1x1
+		for(int level = 0; level < mipCnt; level++) {
+			size_t end = (level + 1 < mipCnt) ? image.mipOffsets[level + 1] : image.pixels.size();
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, image.compressedFormat, image.mipWidths[level], image.mipHeights[level], 0,
+								   (GLsizei)(end - image.mipOffsets[level]), (void*)image.mipOffsets[level]);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipCnt - 1);
+	}
+	else {
+		glTexStorage2D(GL_TEXTURE_2D, mipCnt, GL_RGBA8, image.mipWidths[0], image.mipHeights[0]);
+		for(int level = 0; level < mipCnt; level++) {
+			glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, image.mipWidths[level], image.mipHeights[level],
+							GL_RGBA, GL_UNSIGNED_BYTE, (void*)image.mipOffsets[level]);
+		}
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	texture.width = image.mipWidths[0];
+	texture.height = image.mipHeights[0];
+	texture.mipCnt = mipCnt;
+	texture.internalFormat = image.compressedFormat ? image.compressedFormat : GL_RGBA8;
+	texture.gpuBytes = image.pixels.size();
+	texture.compressed = (image.compressedFormat != 0);
+	texture.ready = true;
+	cache.uploadedBytes += image.pixels.size();
+	if(texture.compressed) cache.compressedCnt++;
+}
+
+// Upload decoded images until this call's byte budget is spent (GL thread; once per frame).
+// Returns the number of textures that became ready.
+int updateTextureCache(TextureCache &cache) {
+	auto start = chrono::steady_clock::now();
+	int readyCnt = 0;
+	size_t spent = 0;
+	while(spent < cache.uploadBudget) {
+		DecodedTexture image;
+		{
+			lock_guard<mutex> guard(cache.decodedLock);
+			if(cache.decoded.empty()) break;
+			image = move(cache.decoded.front());
+			cache.decoded.pop_front();
+		}
+
+		// Released meanwhile (or a stale decode of a re-requested path): nothing to do
+		auto found = cache.textures.find(image.key);
+		if(found == cache.textures.end() || found->second.ready || found->second.failed) continue;
+		Texture &texture = found->second;
+		if(image.failed || (image.compressedFormat && !isBlockFormatSupported(image.blockFormat))) {
+			if(!image.failed) cerr << "WARNING: " << getBlockFormatName(image.blockFormat) << " textures are not supported here: " << texture.key << endl;
+			texture.failed = true;
+			cache.failedCnt++;
+			continue;
+		}
+		uploadTexture(cache, texture, image);
+		spent += image.pixels.size();
+		if(texture.ready) readyCnt++;
+	}
+	if(readyCnt > 0) cache.uploadMS += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	return readyCnt;
+}
+
+// True once every requested texture is either uploaded or failed
+bool isTextureCacheIdle(TextureCache &cache) {
+	lock_guard<mutex> guard(cache.decodedLock);
+	return cache.decodingCnt == 0 && cache.decoded.empty();
+}
+
+// Block until every queued decode has finished and been uploaded (loading screens, benchmarks)
+void waitTextureCache(TextureCache &cache) {
+	while(true) {
+		{
+			unique_lock<mutex> guard(cache.decodedLock);
+			cache.decodedWake.wait(guard, [&cache]() { return cache.decodingCnt == 0 || !cache.decoded.empty(); });
+			if(cache.decodingCnt == 0 && cache.decoded.empty()) return;
+		}
+		updateTextureCache(cache);
+	}
+}
+
+// Bind texture to unit (the white fallback while it is missing, loading or broken)
+void bindCachedTexture(TextureCache &cache, Texture *texture, GLuint unit) {
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, (texture && texture->ready) ? texture->texID : cache.fallbackTex);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+// Wait for outstanding decodes, then free every texture (call with the context current)
+void cleanupTextureCache(TextureCache &cache) {
+	{
+		unique_lock<mutex> guard(cache.decodedLock);
+		cache.decodedWake.wait(guard, [&cache]() { return cache.decodingCnt == 0; });
+		cache.decoded.clear();
+	}
+	for(auto &entry : cache.textures) {
+		if(entry.second.texID) glDeleteTextures(1, &(entry.second.texID));
+	}
+	cache.textures.clear();
+	if(cache.fallbackTex) glDeleteTextures(1, &(cache.fallbackTex));
+	deleteBuffer(cache.uploadPBO);
+	cache.fallbackTex = 0;
+}
+
+// Print requests vs. loads and the time spent decoding / uploading
+void printTextureCacheStats(TextureCache &cache) {
+	cout << "Textures: " << cache.requestCnt << " requested, " << cache.loadCnt << " loaded";
+	if(cache.compressedCnt > 0) cout << " (" << cache.compressedCnt << " precompressed)";
+	if(cache.failedCnt > 0) cout << ", " << cache.failedCnt << " failed";
+	cout << "; decode " << cache.decodeMS << " ms (all workers), upload " << cache.uploadMS << " ms";
+	cout << ", " << cache.uploadedBytes / (1024 * 1024) << " MB" << endl;
+}
@@ -0,0 +1,101 @@
+#include "ThreadPool.hpp"
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+// Worker loop: run jobs until the pool stops (remaining jobs are finished first)
+static void runWorker(ThreadPool *pool) {
+	while(true) {
+		function<void()> job;
+		{
+			unique_lock<mutex> guard(pool->lock);
+			pool->wake.wait(guard, [pool]() { return pool->stopping || !pool->jobs.empty(); });
+			if(pool->jobs.empty()) return;
+			job = move(pool->jobs.front());
+			pool->jobs.pop_front();
+			pool->runningCnt++;
+		}
+
+		job();
+
+		{
+			lock_guard<mutex> guard(pool->lock);
+			pool->runningCnt--;
+			if(pool->runningCnt == 0 && pool->jobs.empty()) pool->idle.notify_all();
+		}
+	}
+}
+
+// Start workers (threadCnt 0: one per core, minus the calling thread)
+void startThreadPool(ThreadPool &pool, int threadCnt) {
+	if(threadCnt <= 0) threadCnt = max(1, (int)thread::hardware_concurrency() - 1);
+	pool.stopping = false;
+	for(int i = 0; i < threadCnt; i++) {
+		pool.workers.push_back(thread(runWorker, &pool));
+	}
+}
+
+// Finish queued jobs and join the workers
+void stopThreadPool(ThreadPool &pool) {
+	{
+		lock_guard<mutex> guard(pool.lock);
+		pool.stopping = true;
+	}
+	pool.wake.notify_all();
+	for(thread &worker : pool.workers) worker.join();
+	pool.workers.clear();
+}
+
+// Queue job for any worker
+void submitJob(ThreadPool &pool, function<void()> job) {
+	{
+		lock_guard<mutex> guard(pool.lock);
+		pool.jobs.push_back(move(job));
+	}
+	pool.wake.notify_one();
+}
+
+// Block until every queued job has finished
+void waitThreadPool(ThreadPool &pool) {
+	unique_lock<mutex> guard(pool.lock);
+	pool.idle.wait(guard, [&pool]() { return pool.jobs.empty() && pool.runningCnt == 0; });
+}
+
+// Call body on [0, count) split into one chunk per worker plus one for the caller.
+// Returns when all chunks are done (only waits for its own chunks, not other jobs).
+// Chunks are claimed from a shared counter and the caller keeps claiming until none are left,
+// so it only ever waits for chunks that are already running: calling parallelFor from inside a
+// pool job (while every worker is busy) cannot deadlock, it just runs the chunks itself.
+void parallelFor(ThreadPool &pool, int count, function<void(int begin, int end)> body) {
+	int chunkCnt = min(count, (int)pool.workers.size() + 1);
+	if(chunkCnt <= 1) {
+		if(count > 0) body(0, count);
+		return;
+	}
+
+	struct Batch {
+		atomic<int> nextChunk{ 0 };
+		mutex lock;
+		condition_variable done;
+		int remaining = 0;
+	};
+	shared_ptr<Batch> batch = make_shared<Batch>();
+	batch->remaining = chunkCnt;
+
+	auto runChunks = [batch, body, count, chunkCnt]() {
+		while(true) {
+			int c = batch->nextChunk.fetch_add(1);
+			if(c >= chunkCnt) return;
+			body((int)((long long)count * c / chunkCnt), (int)((long long)count * (c + 1) / chunkCnt));
+			lock_guard<mutex> guard(batch->lock);
+			if(--batch->remaining == 0) batch->done.notify_all();
+		}
+	};
+	for(int c = 1; c < chunkCnt; c++) submitJob(pool, runChunks);
+
+	// Caller takes chunks too (all of them if the workers are busy elsewhere)
+	runChunks();
+
+	unique_lock<mutex> guard(batch->lock);
+	batch->done.wait(guard, [&batch]() { return batch->remaining == 0; });
+}
@@ -29,3 +29,51 @@ void printNodeInfo(aiNode *node, glm::mat4 &nodeT, glm::mat4 &parentMat, glm::ma
     cout << "Current Model Matrix:" << glm::to_string(currentMat) << endl;
     cout << endl;
 }
+
+
+// Remove argv[index] (and the following count-1 entries) from the argument list
+static void removeArgs(int &argc, char **argv, int index, int count) {
+    for(int i = index; i + count <= argc; i++) {
+        argv[i] = (i + count < argc) ? argv[i + count] : nullptr;
+    }
+    argc -= count;
+}
+
+// Look for a bare flag (e.g., "--uncapped"); returns true (and removes it) if present
+bool consumeFlag(int &argc, char **argv, string flag) {
+    for(int i = 1; i < argc; i++) {
+        if(flag == argv[i]) {
+            removeArgs(argc, argv, i, 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Look for an option with a value, either "--name value" or "--name=value"
+bool consumeOption(int &argc, char **argv, string name, string &value) {
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == name && i + 1 < argc) {
+            value = argv[i + 1];
+            removeArgs(argc, argv, i, 2);
+            return true;
+        }
+        if(arg.rfind(name + "=", 0) == 0) {
+            value = arg.substr(name.size() + 1);
+            removeArgs(argc, argv, i, 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Escape a string for JSON output
+string jsonString(string s) {
+    string out = "\"";
+    for(char c : s) {
+        if(c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}